@@ -820,10 +820,8 @@ generate_array_index(ir_exec_list *instructions,
 }
 
 static bool
-function_exists(_mesa_glsl_parse_state *state,
-                struct glsl_symbol_table *symbols, const char *name)
+function_exists(_mesa_glsl_parse_state *state, ir_function *f)
 {
-   ir_function *f = symbols->get_function(name);
    if (f != NULL) {
       ir_foreach_in_list(ir_function_signature, sig, &f->signatures) {
          if (sig->is_builtin() && !sig->is_builtin_available(state))
@@ -862,11 +860,11 @@ no_matching_function_error(const char *name,
                            ir_exec_list *actual_parameters,
                            _mesa_glsl_parse_state *state)
 {
-   struct glsl_symbol_table *symb = _mesa_glsl_get_builtin_function_symbols();
+   ir_function *builtin = state->uses_builtin_functions ?
+      _mesa_glsl_get_builtin_function(name) : NULL;
 
-   if (!function_exists(state, state->symbols, name)
-       && (!state->uses_builtin_functions
-           || !function_exists(state, symb, name))) {
+   if (!function_exists(state, state->symbols->get_function(name))
+       && !function_exists(state, builtin)) {
       _mesa_glsl_error(loc, state, "no function with name '%s'", name);
    } else {
       char *str = prototype_string(NULL, name, actual_parameters);
@@ -879,9 +877,7 @@ no_matching_function_error(const char *name,
       print_function_prototypes(state, loc,
                                 state->symbols->get_function(name));
 
-      if (state->uses_builtin_functions) {
-         print_function_prototypes(state, loc, symb->get_function(name));
-      }
+      print_function_prototypes(state, loc, builtin);
    }
 }
 
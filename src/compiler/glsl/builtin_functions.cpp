@@ -39,7 +39,8 @@
  *
  *    The builtin_builder::create_builtins() function contains lists of all
  *    built-in function signatures, where they're available, what types they
- *    take, and so on.
+ *    take, and so on.  Only the names are registered at initialization, the
+ *    signatures of a function are created when it's first looked up.
  *
  * 4. Implementations of built-in function signatures
  *
@@ -83,10 +84,14 @@
 #include "main/shaderobj.h"
 #include "ir_builder.h"
 #include "glsl_parser_extras.h"
+#include "ir_print_visitor.h"
 #include "program/prog_instruction.h"
 #include <math.h>
 #include "builtin_functions.h"
 #include "util/hash_table.h"
+#include "util/memstream.h"
+#include "util/set.h"
+#include "util/u_dynarray.h"
 
 #ifndef M_PIf
 #define M_PIf   ((float) M_PI)
@@ -1165,6 +1170,24 @@ public:
    ir_function_signature *find(_mesa_glsl_parse_state *state,
                                const char *name, ir_exec_list *actual_parameters);
 
+   /**
+    * Look up a built-in function by name, creating its signatures if this
+    * is the first lookup.
+    */
+   ir_function *get_function(const char *name);
+
+#ifndef NDEBUG
+   /**
+    * Create the signatures of all the built-ins that weren't created yet in
+    * one go, as was done at initialization time before they were created on
+    * demand.  Only used by the tests.
+    */
+   void create_all_functions();
+
+   /** Add the names of the built-ins not created yet to \p names. */
+   void get_pending_names(struct util_dynarray *names);
+#endif
+
    /**
     * A symbol table to hold all the built-in signatures; created by this
     * module.
@@ -1179,10 +1202,28 @@ private:
    void *mem_ctx;
    linear_ctx *linalloc;
 
+   /**
+    * Names of the built-in functions whose signatures haven't been created
+    * yet.  Most shaders use a small fraction of the built-ins, and creating
+    * all of them up front is a significant part of the startup time and
+    * memory of short-lived processes.
+    */
+   struct set *pending;
+
+   /** The function being created, or NULL while registering the names. */
+   const char *creating;
+
    void create_shader();
    void create_intrinsics();
    void create_builtins();
 
+   /**
+    * Whether create_intrinsics() and create_builtins() should create the
+    * signatures of \p name.  When registering, this adds the name to the
+    * pending set instead.
+    */
+   bool want_function(const char *name);
+
    /**
     * IR builder helpers:
     *
@@ -1633,6 +1674,8 @@ builtin_builder::builtin_builder()
 {
    mem_ctx = NULL;
    linalloc = NULL;
+   pending = NULL;
+   creating = NULL;
 }
 
 builtin_builder::~builtin_builder()
@@ -1643,6 +1686,7 @@ builtin_builder::~builtin_builder()
    mem_ctx = NULL;
    linalloc = NULL;
    symbols = NULL;
+   pending = NULL;
 
    simple_mtx_unlock(&builtins_lock);
 }
@@ -1660,7 +1704,7 @@ builtin_builder::find(_mesa_glsl_parse_state *state,
     */
    state->uses_builtin_functions = true;
 
-   ir_function *f = symbols->get_function(name);
+   ir_function *f = get_function(name);
    if (f == NULL)
       return NULL;
 
@@ -1675,6 +1719,64 @@ builtin_builder::find(_mesa_glsl_parse_state *state,
    return sig;
 }
 
+ir_function *
+builtin_builder::get_function(const char *name)
+{
+   struct set_entry *entry = _mesa_set_search(pending, name);
+
+   if (entry != NULL) {
+      /* Built-ins can call intrinsics, which are created the same way, so
+       * this can be nested.
+       */
+      const char *outer = creating;
+
+      _mesa_set_remove(pending, entry);
+      creating = name;
+      create_intrinsics();
+      create_builtins();
+      creating = outer;
+   }
+
+   return symbols->get_function(name);
+}
+
+#ifndef NDEBUG
+/* Value of builtin_builder::creating while creating all the built-ins. */
+static const char all_functions[] = "";
+
+void
+builtin_builder::create_all_functions()
+{
+   _mesa_set_clear(pending, NULL);
+   creating = all_functions;
+   create_intrinsics();
+   create_builtins();
+   creating = NULL;
+}
+
+void
+builtin_builder::get_pending_names(struct util_dynarray *names)
+{
+   set_foreach(pending, entry)
+      util_dynarray_append_typed(names, const char *, (const char *)entry->key);
+}
+#endif
+
+bool
+builtin_builder::want_function(const char *name)
+{
+#ifndef NDEBUG
+   if (creating == all_functions)
+      return true;
+#endif
+
+   if (creating != NULL)
+      return strcmp(name, creating) == 0;
+
+   _mesa_set_add(pending, name);
+   return false;
+}
+
 void
 builtin_builder::initialize()
 {
@@ -1686,7 +1788,11 @@ builtin_builder::initialize()
 
    mem_ctx = ralloc_context(NULL);
    linalloc = linear_context(mem_ctx);
+   pending = _mesa_set_create(mem_ctx, _mesa_hash_string,
+                              _mesa_key_string_equal);
    create_shader();
+
+   /* Only register the names. */
    create_intrinsics();
    create_builtins();
 }
@@ -1698,6 +1804,7 @@ builtin_builder::release()
    mem_ctx = NULL;
    linalloc = NULL;
    symbols = NULL;
+   pending = NULL;
 
    glsl_type_singleton_decref();
 }
@@ -1766,6 +1873,16 @@ builtin_builder::create_shader()
    func(&glsl_type_builtin_bvec3, ##__VA_ARGS__), \
    func(&glsl_type_builtin_bvec4, ##__VA_ARGS__)
 
+/**
+ * Evaluate the signatures only for the function being created, see
+ * builtin_builder::get_function().
+ */
+#define add_function(name, ...)                  \
+   do {                                          \
+      if (want_function(name))                   \
+         add_function(name, __VA_ARGS__);        \
+   } while (0)
+
 /**
  * Create ir_function and ir_function_signature objects for each
  * intrinsic.
@@ -6049,6 +6166,8 @@ builtin_builder::create_builtins()
 #undef FIU2_MIXED
 }
 
+#undef add_function
+
 void
 builtin_builder::add_function(const char *name, ...)
 {
@@ -6119,6 +6238,9 @@ builtin_builder::add_image_function(const char *name,
       &glsl_type_builtin_uimage2DMSArray
    };
 
+   if (!want_function(name))
+      return;
+
    ir_function *f = new(linalloc) ir_function(name);
 
    for (unsigned i = 0; i < ARRAY_SIZE(types); ++i) {
@@ -7800,7 +7922,7 @@ builtin_builder::_is_sparse_texels_resident(void)
 
    ir_variable *retval = body.make_temp(&glsl_type_builtin_bool, "retval");
    ir_function *f =
-      symbols->get_function("__intrinsic_is_sparse_texels_resident");
+      get_function("__intrinsic_is_sparse_texels_resident");
 
    body.emit(call(f, retval, sig->parameters));
    body.emit(ret(retval));
@@ -8651,7 +8773,7 @@ builtin_builder::_atomic_counter_op(const char *intrinsic,
    MAKE_SIG(&glsl_type_builtin_uint, avail, 1, counter);
 
    ir_variable *retval = body.make_temp(&glsl_type_builtin_uint, "atomic_retval");
-   body.emit(call(symbols->get_function(intrinsic), retval,
+   body.emit(call(get_function(intrinsic), retval,
                   sig->parameters));
    body.emit(ret(retval));
    return sig;
@@ -8682,7 +8804,7 @@ builtin_builder::_atomic_counter_op1(const char *intrinsic,
       parameters.push_tail(new(linalloc) ir_dereference_variable(neg_data));
 
       ir_function *const func =
-         symbols->get_function("__intrinsic_atomic_add");
+         get_function("__intrinsic_atomic_add");
       ir_instruction *const c = call(func, retval, parameters);
 
       assert(c != NULL);
@@ -8690,7 +8812,7 @@ builtin_builder::_atomic_counter_op1(const char *intrinsic,
 
       body.emit(c);
    } else {
-      body.emit(call(symbols->get_function(intrinsic), retval,
+      body.emit(call(get_function(intrinsic), retval,
                      sig->parameters));
    }
 
@@ -8708,7 +8830,7 @@ builtin_builder::_atomic_counter_op2(const char *intrinsic,
    MAKE_SIG(&glsl_type_builtin_uint, avail, 3, counter, compare, data);
 
    ir_variable *retval = body.make_temp(&glsl_type_builtin_uint, "atomic_retval");
-   body.emit(call(symbols->get_function(intrinsic), retval,
+   body.emit(call(get_function(intrinsic), retval,
                   sig->parameters));
    body.emit(ret(retval));
    return sig;
@@ -8726,7 +8848,7 @@ builtin_builder::_atomic_op2(const char *intrinsic,
    atomic->data.implicit_conversion_prohibited = true;
 
    ir_variable *retval = body.make_temp(type, "atomic_retval");
-   body.emit(call(symbols->get_function(intrinsic), retval,
+   body.emit(call(get_function(intrinsic), retval,
                   sig->parameters));
    body.emit(ret(retval));
    return sig;
@@ -8745,7 +8867,7 @@ builtin_builder::_atomic_op3(const char *intrinsic,
    atomic->data.implicit_conversion_prohibited = true;
 
    ir_variable *retval = body.make_temp(type, "atomic_retval");
-   body.emit(call(symbols->get_function(intrinsic), retval,
+   body.emit(call(get_function(intrinsic), retval,
                   sig->parameters));
    body.emit(ret(retval));
    return sig;
@@ -8963,7 +9085,7 @@ builtin_builder::_image(image_prototype_ctr prototype,
 
    if (flags & IMAGE_FUNCTION_EMIT_STUB) {
       ir_factory body(&sig->body, linalloc);
-      ir_function *f = symbols->get_function(intrinsic_name);
+      ir_function *f = get_function(intrinsic_name);
 
       if (flags & IMAGE_FUNCTION_RETURNS_VOID) {
          body.emit(call(f, NULL, sig->parameters));
@@ -9020,7 +9142,7 @@ builtin_builder::_memory_barrier(const char *intrinsic_name,
                                  builtin_available_predicate avail)
 {
    MAKE_SIG(&glsl_type_builtin_void, avail, 0);
-   body.emit(call(symbols->get_function(intrinsic_name),
+   body.emit(call(get_function(intrinsic_name),
                   NULL, sig->parameters));
    return sig;
 }
@@ -9042,11 +9164,11 @@ builtin_builder::_ballot(const glsl_type *type, builtin_available_predicate avai
    ir_variable *retval = body.make_temp(type, "retval");
 
    if (type == &glsl_type_builtin_uint64_t) {
-      body.emit(call(symbols->get_function("__intrinsic_ballot_uint64"),
+      body.emit(call(get_function("__intrinsic_ballot_uint64"),
                      retval, sig->parameters));
    } else {
       assert(type == &glsl_type_builtin_uvec4);
-      body.emit(call(symbols->get_function("__intrinsic_ballot_uvec4"),
+      body.emit(call(get_function("__intrinsic_ballot_uvec4"),
                      retval, sig->parameters));
    }
    body.emit(ret(retval));
@@ -9069,7 +9191,7 @@ builtin_builder::_inverse_ballot()
    MAKE_SIG(&glsl_type_builtin_bool, ballot_khr, 1, value);
    ir_variable *retval = body.make_temp(&glsl_type_builtin_bool, "retval");
 
-   body.emit(call(symbols->get_function("__intrinsic_inverse_ballot"),
+   body.emit(call(get_function("__intrinsic_inverse_ballot"),
                   retval, sig->parameters));
    body.emit(ret(retval));
    return sig;
@@ -9095,7 +9217,7 @@ builtin_builder::_ballot_bit_extract()
    MAKE_SIG(&glsl_type_builtin_bool, ballot_khr, 2, value, index);
    ir_variable *retval = body.make_temp(&glsl_type_builtin_bool, "retval");
 
-   body.emit(call(symbols->get_function("__intrinsic_ballot_bit_extract"),
+   body.emit(call(get_function("__intrinsic_ballot_bit_extract"),
                   retval, sig->parameters));
    body.emit(ret(retval));
    return sig;
@@ -9117,7 +9239,7 @@ builtin_builder::_ballot_bit(const char *intrinsic_name)
    MAKE_SIG(&glsl_type_builtin_uint, ballot_khr, 1, value);
    ir_variable *retval = body.make_temp(&glsl_type_builtin_uint, "retval");
 
-   body.emit(call(symbols->get_function(intrinsic_name), retval, sig->parameters));
+   body.emit(call(get_function(intrinsic_name), retval, sig->parameters));
    body.emit(ret(retval));
    return sig;
 }
@@ -9140,7 +9262,7 @@ builtin_builder::_read_first_invocation(const glsl_type *type, builtin_available
    MAKE_SIG(type, avail, 1, value);
    ir_variable *retval = body.make_temp(type, "retval");
 
-   body.emit(call(symbols->get_function("__intrinsic_read_first_invocation"),
+   body.emit(call(get_function("__intrinsic_read_first_invocation"),
                   retval, sig->parameters));
    body.emit(ret(retval));
    return sig;
@@ -9166,7 +9288,7 @@ builtin_builder::_read_invocation(const glsl_type *type, builtin_available_predi
    MAKE_SIG(type, avail, 2, value, invocation);
    ir_variable *retval = body.make_temp(type, "retval");
 
-   body.emit(call(symbols->get_function("__intrinsic_read_invocation"),
+   body.emit(call(get_function("__intrinsic_read_invocation"),
                   retval, sig->parameters));
    body.emit(ret(retval));
    return sig;
@@ -9185,7 +9307,7 @@ builtin_builder::_invocation_interlock(const char *intrinsic_name,
                                        builtin_available_predicate avail)
 {
    MAKE_SIG(&glsl_type_builtin_void, avail, 0);
-   body.emit(call(symbols->get_function(intrinsic_name),
+   body.emit(call(get_function(intrinsic_name),
                   NULL, sig->parameters));
    return sig;
 }
@@ -9206,7 +9328,7 @@ builtin_builder::_shader_clock(builtin_available_predicate avail,
 
    ir_variable *retval = body.make_temp(&glsl_type_builtin_uvec2, "clock_retval");
 
-   body.emit(call(symbols->get_function("__intrinsic_shader_clock"),
+   body.emit(call(get_function("__intrinsic_shader_clock"),
                   retval, sig->parameters));
 
    if (type == &glsl_type_builtin_uint64_t) {
@@ -9234,7 +9356,7 @@ builtin_builder::_shader_clock_realtime(builtin_available_predicate avail,
 
    ir_variable *retval = body.make_temp(&glsl_type_builtin_uvec2, "clock_retval");
 
-   body.emit(call(symbols->get_function("__intrinsic_shader_clock_realtime"),
+   body.emit(call(get_function("__intrinsic_shader_clock_realtime"),
                   retval, sig->parameters));
 
    if (type == &glsl_type_builtin_uint64_t) {
@@ -9267,7 +9389,7 @@ builtin_builder::_vote(const glsl_type *type,
 
    ir_variable *retval = body.make_temp(&glsl_type_builtin_bool, "retval");
 
-   body.emit(call(symbols->get_function(intrinsic_name),
+   body.emit(call(get_function(intrinsic_name),
                   retval, sig->parameters));
    body.emit(ret(retval));
    return sig;
@@ -9288,7 +9410,7 @@ builtin_builder::_helper_invocation()
 
    ir_variable *retval = body.make_temp(&glsl_type_builtin_bool, "retval");
 
-   body.emit(call(symbols->get_function("__intrinsic_helper_invocation"),
+   body.emit(call(get_function("__intrinsic_helper_invocation"),
                   retval, sig->parameters));
    body.emit(ret(retval));
 
@@ -9308,7 +9430,7 @@ builtin_builder::_subgroup_barrier(const char *intrinsic_name,
                                    builtin_available_predicate avail)
 {
    MAKE_SIG(&glsl_type_builtin_void, avail, 0);
-   body.emit(call(symbols->get_function(intrinsic_name), NULL, sig->parameters));
+   body.emit(call(get_function(intrinsic_name), NULL, sig->parameters));
    return sig;
 }
 
@@ -9326,7 +9448,7 @@ builtin_builder::_elect()
 
    ir_variable *retval = body.make_temp(&glsl_type_builtin_bool, "retval");
 
-   body.emit(call(symbols->get_function("__intrinsic_elect"), retval, sig->parameters));
+   body.emit(call(get_function("__intrinsic_elect"), retval, sig->parameters));
    body.emit(ret(retval));
 
    return sig;
@@ -9354,7 +9476,7 @@ builtin_builder::_shuffle(const glsl_type *type)
 
    ir_variable *retval = body.make_temp(type, "retval");
 
-   body.emit(call(symbols->get_function("__intrinsic_shuffle"), retval, sig->parameters));
+   body.emit(call(get_function("__intrinsic_shuffle"), retval, sig->parameters));
    body.emit(ret(retval));
    return sig;
 }
@@ -9381,7 +9503,7 @@ builtin_builder::_shuffle_xor(const glsl_type *type)
 
    ir_variable *retval = body.make_temp(type, "retval");
 
-   body.emit(call(symbols->get_function("__intrinsic_shuffle_xor"),
+   body.emit(call(get_function("__intrinsic_shuffle_xor"),
                   retval, sig->parameters));
    body.emit(ret(retval));
    return sig;
@@ -9408,7 +9530,7 @@ builtin_builder::_shuffle_up(const glsl_type *type)
             2, value, delta);
    ir_variable *retval = body.make_temp(type, "retval");
 
-   body.emit(call(symbols->get_function("__intrinsic_shuffle_up"),
+   body.emit(call(get_function("__intrinsic_shuffle_up"),
                   retval, sig->parameters));
    body.emit(ret(retval));
    return sig;
@@ -9435,7 +9557,7 @@ builtin_builder::_shuffle_down(const glsl_type *type)
             2, value, delta);
    ir_variable *retval = body.make_temp(type, "retval");
 
-   body.emit(call(symbols->get_function("__intrinsic_shuffle_down"),
+   body.emit(call(get_function("__intrinsic_shuffle_down"),
                   retval, sig->parameters));
    body.emit(ret(retval));
    return sig;
@@ -9459,7 +9581,7 @@ builtin_builder::_subgroup_arithmetic(const glsl_type *type, const char *intrins
             1, value);
 
    ir_variable *retval = body.make_temp(type, "retval");
-   body.emit(call(symbols->get_function(intrinsic_name), retval, sig->parameters));
+   body.emit(call(get_function(intrinsic_name), retval, sig->parameters));
    body.emit(ret(retval));
    return sig;
 }
@@ -9488,7 +9610,7 @@ builtin_builder::_subgroup_clustered(const glsl_type *type, const char *intrinsi
             2, value, size);
 
    ir_variable *retval = body.make_temp(type, "retval");
-   body.emit(call(symbols->get_function(intrinsic_name), retval, sig->parameters));
+   body.emit(call(get_function(intrinsic_name), retval, sig->parameters));
    body.emit(ret(retval));
    return sig;
 }
@@ -9514,7 +9636,7 @@ builtin_builder::_quad_broadcast(const glsl_type *type)
             2, value, id);
    ir_variable *retval = body.make_temp(type, "retval");
 
-   body.emit(call(symbols->get_function("__intrinsic_quad_broadcast"),
+   body.emit(call(get_function("__intrinsic_quad_broadcast"),
                   retval, sig->parameters));
    body.emit(ret(retval));
    return sig;
@@ -9538,7 +9660,7 @@ builtin_builder::_quad_swap(const glsl_type *type, const char *intrinsic_name)
             1, value);
 
    ir_variable *retval = body.make_temp(type, "retval");
-   body.emit(call(symbols->get_function(intrinsic_name), retval, sig->parameters));
+   body.emit(call(get_function(intrinsic_name), retval, sig->parameters));
    body.emit(ret(retval));
    return sig;
 }
@@ -9560,7 +9682,7 @@ ir_function_signature *builtin_builder::_emit_mesh_tasks()
    ir_variable *z = in_var(&glsl_type_builtin_uint, "num_group_z");
    MAKE_SIG(&glsl_type_builtin_void, mesh_shader, 3, x, y, z);
 
-   body.emit(call(symbols->get_function("__intrinsic_emit_mesh_tasks"),
+   body.emit(call(get_function("__intrinsic_emit_mesh_tasks"),
                   NULL, sig->parameters));
    return sig;
 }
@@ -9580,7 +9702,7 @@ ir_function_signature *builtin_builder::_set_mesh_outputs()
    ir_variable *pc = in_var(&glsl_type_builtin_uint, "primitive_count");
    MAKE_SIG(&glsl_type_builtin_void, mesh_shader, 2, vc, pc);
 
-   body.emit(call(symbols->get_function("__intrinsic_set_mesh_outputs"),
+   body.emit(call(get_function("__intrinsic_set_mesh_outputs"),
                   NULL, sig->parameters));
    return sig;
 }
@@ -9634,7 +9756,7 @@ _mesa_glsl_has_builtin_function(_mesa_glsl_parse_state *state, const char *name)
    ir_function *f;
    bool ret = false;
    simple_mtx_lock(&builtins_lock);
-   f = builtins.symbols->get_function(name);
+   f = builtins.get_function(name);
    if (f != NULL) {
       ir_foreach_in_list(ir_function_signature, sig, &f->signatures) {
          if (sig->is_builtin_available(state)) {
@@ -9648,12 +9770,70 @@ _mesa_glsl_has_builtin_function(_mesa_glsl_parse_state *state, const char *name)
    return ret;
 }
 
-struct glsl_symbol_table *
-_mesa_glsl_get_builtin_function_symbols()
+ir_function *
+_mesa_glsl_get_builtin_function(const char *name)
+{
+   ir_function *f;
+   simple_mtx_lock(&builtins_lock);
+   f = builtins.get_function(name);
+   simple_mtx_unlock(&builtins_lock);
+
+   return f;
+}
+
+#ifndef NDEBUG
+static int
+compare_names(const void *a, const void *b)
 {
-   return builtins.symbols;
+   return strcmp(*(const char **)a, *(const char **)b);
 }
 
+char *
+_mesa_glsl_print_builtin_functions(void *mem_ctx, bool create_all)
+{
+   builtin_builder builder;
+   struct util_dynarray names;
+   struct u_memstream mem;
+   char *buf = NULL;
+   size_t size = 0;
+
+   builder.initialize();
+
+   util_dynarray_init(&names, NULL);
+   builder.get_pending_names(&names);
+   qsort(names.data, util_dynarray_num_elements(&names, const char *),
+         sizeof(const char *), compare_names);
+
+   if (create_all)
+      builder.create_all_functions();
+
+   if (u_memstream_open(&mem, &buf, &size)) {
+      FILE *f = u_memstream_get(&mem);
+
+      util_dynarray_foreach(&names, const char *, name) {
+         ir_function *func = builder.get_function(*name);
+         if (func == NULL) {
+            fprintf(f, "(missing function %s)\n", *name);
+            continue;
+         }
+
+         ir_print_visitor v(f);
+         func->accept(&v);
+      }
+
+      u_memstream_close(&mem);
+   }
+
+   util_dynarray_fini(&names);
+   builder.release();
+
+   char *str = buf ? ralloc_strdup(mem_ctx, buf) : NULL;
+   free(buf);
+
+   return str;
+}
+#endif
+
 
 /**
  * Get the function signature for main from a shader
@@ -48,12 +48,22 @@ extern bool
 _mesa_glsl_has_builtin_function(_mesa_glsl_parse_state *state,
                                 const char *name);
 
-extern glsl_symbol_table *
-_mesa_glsl_get_builtin_function_symbols(void);
+extern ir_function *
+_mesa_glsl_get_builtin_function(const char *name);
 
 extern ir_function_signature *
 _mesa_get_main_function_signature(glsl_symbol_table *symbols);
 
+#ifndef NDEBUG
+/**
+ * Print the IR of all the built-in functions of a new built-in builder,
+ * creating them on demand as usual or all at once when \p create_all is set.
+ * Used to test that both produce the same IR, not built in release builds.
+ */
+extern char *
+_mesa_glsl_print_builtin_functions(void *mem_ctx, bool create_all);
+#endif
+
 namespace generate_ir {
 
 ir_function_signature *
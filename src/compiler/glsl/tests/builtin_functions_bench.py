@@ -0,0 +1,108 @@
+# Copyright © 2025 Mesa contributors
+# SPDX-License-Identifier: MIT
+
+"""Measure the startup time and peak memory of the standalone GLSL compiler.
+
+Built-in functions are created when a shader first uses them, so this
+compiles a shader which uses no built-ins and one which uses a typical set
+of them, and reports the time and peak resident memory per process.
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+# The meson version handles windows paths better, but if it's not available
+# fall back to shlex
+try:
+    from meson.mesonlib import split_args
+except ImportError:
+    from shlex import split as split_args
+
+
+SHADERS = {
+    'no built-ins': """#version 150
+in vec4 position;
+void main()
+{
+   gl_Position = position;
+}
+""",
+    'typical': """#version 150
+uniform mat4 mvp;
+uniform sampler2D tex;
+in vec4 position;
+in vec3 normal;
+in vec2 uv;
+out vec4 color;
+void main()
+{
+   vec3 n = normalize(normal);
+   float d = max(dot(n, vec3(0.0, 0.0, 1.0)), 0.0);
+   vec4 t = textureLod(tex, fract(uv), 0.0);
+   color = vec4(mix(t.rgb, vec3(pow(d, 8.0)), 0.5), clamp(t.a, 0.0, 1.0));
+   gl_Position = mvp * position;
+}
+""",
+}
+
+
+def arg_parser():
+    parser = argparse.ArgumentParser()
+    parser.add_argument(
+        '--glsl-compiler',
+        required=True,
+        help='Path to the standalone glsl compiler')
+    parser.add_argument(
+        '--runs',
+        type=int,
+        default=20,
+        help='Number of compiler processes per shader.')
+    return parser.parse_args()
+
+
+def get_test_runner(runner):
+    """Wrap the test runner in the exe wrapper if necessary."""
+    wrapper = os.environ.get('MESON_EXE_WRAPPER', None)
+    if wrapper is None:
+        return [runner]
+    return split_args(wrapper) + [runner]
+
+
+def run(runner, path, runs):
+    """Return the average wall time in ms and the peak RSS in KiB."""
+    peak_rss = 0
+    start = time.perf_counter()
+    for _ in range(runs):
+        proc = subprocess.Popen(runner + ['--version', '150', path],
+                                stdout=subprocess.DEVNULL)
+        _, status, usage = os.wait4(proc.pid, 0)
+        proc.returncode = os.waitstatus_to_exitcode(status)
+        if proc.returncode != 0:
+            print('{} returned error {}'.format(path, proc.returncode))
+            sys.exit(1)
+        peak_rss = max(peak_rss, usage.ru_maxrss)
+    elapsed = time.perf_counter() - start
+    return elapsed * 1000 / runs, peak_rss
+
+
+def main():
+    args = arg_parser()
+    runner = get_test_runner(args.glsl_compiler)
+
+    with tempfile.TemporaryDirectory() as tmp:
+        for name, source in SHADERS.items():
+            path = os.path.join(tmp, name.replace(' ', '_') + '.vert')
+            with open(path, 'w') as f:
+                f.write(source)
+
+            ms, rss = run(runner, path, args.runs)
+            print('{:<14} {:8.2f} ms per process, peak RSS {:8.1f} MiB'
+                  .format(name, ms, rss / 1024))
+
+
+if __name__ == '__main__':
+    main()
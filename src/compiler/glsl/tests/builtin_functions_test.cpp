@@ -0,0 +1,70 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+#include <gtest/gtest.h>
+#include <map>
+#include <string>
+#include "util/compiler.h"
+#include "util/ralloc.h"
+#include "ir.h"
+#include "glsl_parser_extras.h"
+#include "builtin_functions.h"
+
+#ifndef NDEBUG
+/**
+ * The IR printer makes variable names unique with a process-wide counter and
+ * names anonymous structure types by their address.  Renumber both in order
+ * of appearance, so that two prints can be compared.
+ */
+static std::string
+renumber_names(const char *ir)
+{
+   std::map<std::string, unsigned> numbers;
+   std::string out;
+
+   while (*ir) {
+      out += *ir;
+
+      if (*ir++ != '@' || !isdigit(*ir))
+         continue;
+
+      std::string number;
+      while (isxdigit(*ir) || *ir == 'x')
+         number += *ir++;
+
+      auto it = numbers.emplace(number, numbers.size()).first;
+      out += std::to_string(it->second);
+   }
+
+   return out;
+}
+#endif
+
+/**
+ * Built-in functions are created the first time they are looked up, by
+ * running the code which used to create all of them at initialization time
+ * for a single name.  Check that this produces the same IR, in particular
+ * for built-ins which call intrinsics or other built-ins.
+ */
+TEST(builtin_functions, lazy_creation_matches_eager)
+{
+#ifdef NDEBUG
+   GTEST_SKIP() << "_mesa_glsl_print_builtin_functions() is only built "
+                   "without NDEBUG";
+#else
+   void *mem_ctx = ralloc_context(NULL);
+
+   char *lazy = _mesa_glsl_print_builtin_functions(mem_ctx, false);
+   char *eager = _mesa_glsl_print_builtin_functions(mem_ctx, true);
+
+   ASSERT_NE(lazy, nullptr);
+   ASSERT_NE(eager, nullptr);
+   EXPECT_EQ(strstr(eager, "(missing function"), nullptr);
+   EXPECT_NE(strstr(eager, " function texture\n"), nullptr);
+   EXPECT_TRUE(renumber_names(lazy) == renumber_names(eager))
+      << "built-in functions created on demand differ from eager creation";
+
+   ralloc_free(mem_ctx);
+#endif
+}
@@ -37,6 +37,7 @@
 #include "util/u_qsort.h"
 #include "nir_builder.h"
 #include "nir_control_flow_private.h"
+#include "nir_parallel_private.h"
 #include "nir_worklist.h"
 
 #ifndef NDEBUG
@@ -275,14 +276,22 @@ nir_shader_add_variable(nir_shader *shader, nir_variable *var)
 nir_variable *
 nir_variable_create_zeroed(nir_shader *nir)
 {
-   return gc_zalloc_size(nir->gctx, sizeof(nir_variable), 8);
+   return gc_zalloc_size(nir_shader_gc_ctx(nir), sizeof(nir_variable), 8);
+}
+
+static void
+free_variable_name(nir_variable *var)
+{
+   if (!var->name || var->name == var->_name_storage)
+      return;
+
+   nir_ralloc_free(var->name);
 }
 
 void
 nir_variable_set_name(nir_shader *nir, nir_variable *var, const char *name)
 {
-   if (var->name && var->name != var->_name_storage)
-      ralloc_free(var->name);
+   free_variable_name(var);
 
    if (!name) {
       var->name = NULL;
@@ -294,15 +303,14 @@ nir_variable_set_name(nir_shader *nir, nir_variable *var, const char *name)
       var->name = var->_name_storage;
       strcpy(var->name, name);
    } else {
-      var->name = ralloc_strdup(nir, name);
+      var->name = ralloc_strdup(nir_shader_mem_ctx(nir), name);
    }
 }
 
 void
 nir_variable_set_namef(nir_shader *nir, nir_variable *var, const char *fmt, ...)
 {
-   if (var->name && var->name != var->_name_storage)
-      ralloc_free(var->name);
+   free_variable_name(var);
 
    va_list args;
    va_start(args, fmt);
@@ -312,7 +320,7 @@ nir_variable_set_namef(nir_shader *nir, nir_variable *var, const char *fmt, ...)
    if (name_size <= ARRAY_SIZE(var->_name_storage))
       var->name = var->_name_storage;
    else
-      var->name = ralloc_size(nir, name_size);
+      var->name = ralloc_size(nir_shader_mem_ctx(nir), name_size);
 
    if (var->name)
       vsnprintf(var->name, name_size, fmt, args);
@@ -342,7 +350,7 @@ nir_variable_append_namef(nir_shader *nir, nir_variable *var, const char *fmt, .
       } else if (var->name != var->_name_storage) {
          /* Move the name to _name_storage. */
          memcpy(var->_name_storage, var->name, old_len + 1);
-         ralloc_free(var->name);
+         nir_ralloc_free(var->name);
          var->name = var->_name_storage;
       }
    } else {
@@ -740,7 +748,7 @@ nir_block_destructor(void *block_)
 nir_block *
 nir_block_create(nir_shader *shader)
 {
-   nir_block *block = rzalloc(shader, nir_block);
+   nir_block *block = rzalloc(nir_shader_mem_ctx(shader), nir_block);
 
    cf_init(&block->cf_node, nir_cf_node_block);
 
@@ -766,7 +774,7 @@ src_init(nir_src *src)
 nir_if *
 nir_if_create(nir_shader *shader)
 {
-   nir_if *if_stmt = ralloc(shader, nir_if);
+   nir_if *if_stmt = ralloc(nir_shader_mem_ctx(shader), nir_if);
 
    if_stmt->control = nir_selection_control_none;
 
@@ -789,7 +797,7 @@ nir_if_create(nir_shader *shader)
 nir_loop *
 nir_loop_create(nir_shader *shader)
 {
-   nir_loop *loop = rzalloc(shader, nir_loop);
+   nir_loop *loop = rzalloc(nir_shader_mem_ctx(shader), nir_loop);
 
    cf_init(&loop->cf_node, nir_cf_node_loop);
    /* Assume that loops are divergent until proven otherwise */
@@ -812,14 +820,15 @@ nir_loop_create(nir_shader *shader)
 static void *
 nir_instr_create(nir_shader *shader, nir_instr_type type, uint32_t size)
 {
+   gc_ctx *gctx = nir_shader_gc_ctx(shader);
    nir_instr *instr;
    if (shader->has_debug_info) {
       nir_instr_debug_info *debug_info =
-         gc_zalloc_size(shader->gctx, offsetof(nir_instr_debug_info, instr) + size, 8);
+         gc_zalloc_size(gctx, offsetof(nir_instr_debug_info, instr) + size, 8);
       instr = &debug_info->instr;
       instr->has_debug_info = true;
    } else {
-      instr = gc_zalloc_size(shader->gctx, size, 8);
+      instr = gc_zalloc_size(gctx, size, 8);
    }
 
    instr->type = type;
@@ -975,7 +984,7 @@ nir_tex_instr_create(nir_shader *shader, unsigned num_srcs)
       nir_instr_create(shader, nir_instr_type_tex, sizeof(nir_tex_instr));
 
    instr->num_srcs = num_srcs;
-   instr->src = gc_alloc(shader->gctx, nir_tex_src, num_srcs);
+   instr->src = gc_alloc(nir_shader_gc_ctx(shader), nir_tex_src, num_srcs);
    for (unsigned i = 0; i < num_srcs; i++)
       src_init(&instr->src[i].src);
 
@@ -990,6 +999,10 @@ nir_tex_instr_create(nir_shader *shader, unsigned num_srcs)
 static gc_ctx *
 nir_instr_get_gc_context(nir_instr *instr)
 {
+   struct nir_parallel_worker *worker = nir_parallel_worker;
+   if (worker)
+      return worker->gctx;
+
    return gc_get_context(nir_instr_get_gc_pointer(instr));
 }
 
@@ -1007,7 +1020,7 @@ nir_tex_instr_add_src(nir_tex_instr *tex,
                          &tex->src[i].src);
    }
 
-   gc_free(tex->src);
+   nir_gc_free(tex->src);
    tex->src = new_srcs;
 
    tex->src[tex->num_srcs].src_type = src_type;
@@ -1384,13 +1397,13 @@ nir_instr_free(nir_instr *instr)
 {
    switch (instr->type) {
    case nir_instr_type_tex:
-      gc_free(nir_instr_as_tex(instr)->src);
+      nir_gc_free(nir_instr_as_tex(instr)->src);
       break;
 
    case nir_instr_type_phi: {
       nir_phi_instr *phi = nir_instr_as_phi(instr);
       nir_foreach_phi_src_safe(phi_src, phi)
-         gc_free(phi_src);
+         nir_gc_free(phi_src);
       break;
    }
 
@@ -1398,7 +1411,7 @@ nir_instr_free(nir_instr *instr)
       break;
    }
 
-   gc_free(nir_instr_get_gc_pointer(instr));
+   nir_gc_free(nir_instr_get_gc_pointer(instr));
 }
 
 void
@@ -4448,6 +4448,38 @@ nir_no_progress(nir_function_impl *impl)
    return nir_progress(false, impl, nir_metadata_none /* ignored */);
 }
 
+typedef bool (*nir_impl_pass_cb)(nir_function_impl *impl, void *data);
+
+/**
+ * Runs a function-local pass on every function implementation of the shader,
+ * spreading the implementations over several threads.  Returns whether the
+ * pass made progress on any of them.
+ *
+ * The pass may create and remove instructions, control flow and local
+ * variables of the implementation it's given, but must not touch anything
+ * else in the shader: no other implementations, shader variables, shader
+ * info or memory ralloc'd from the shader.  The data is shared by all
+ * threads.
+ *
+ * Passes run serially on the calling thread unless the driver opted in with
+ * nir_parallel_set_max_threads() or NIR_THREADS is set.  Shaders with a
+ * single implementation, and calls made from within a parallel pass, always
+ * run serially.
+ */
+bool nir_shader_parallel_impls_pass(nir_shader *shader,
+                                    nir_impl_pass_cb pass, void *data);
+
+/**
+ * Sets the number of threads nir_shader_parallel_impls_pass() may use,
+ * including the calling thread.  The default of 1 runs passes serially.
+ * NIR_THREADS takes precedence.
+ *
+ * The thread pool is shared by the whole process and created the first time
+ * a pass runs on more than one thread, with the number of threads set at
+ * that point.  Raising it afterwards doesn't add threads to the pool.
+ */
+void nir_parallel_set_max_threads(unsigned num_threads);
+
 /** creates an instruction with default swizzle/writemask/etc. with NULL registers */
 nir_alu_instr *nir_alu_instr_create(nir_shader *shader, nir_op op);
 
@@ -6785,6 +6817,7 @@ bool nir_opt_cse(nir_shader *shader);
 bool nir_opt_dce_impl(nir_function_impl *impl);
 bool nir_opt_dce(nir_shader *shader);
 
+bool nir_opt_dead_cf_impl(nir_function_impl *impl);
 bool nir_opt_dead_cf(nir_shader *shader);
 
 bool nir_opt_dead_write_vars(nir_shader *shader);
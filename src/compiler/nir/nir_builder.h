@@ -138,6 +138,40 @@ nir_shader_instructions_pass(nir_shader *shader,
    return progress;
 }
 
+struct nir_instructions_pass_state {
+   nir_instr_pass_cb pass;
+   nir_metadata preserved;
+   void *cb_data;
+};
+
+static inline bool
+nir_instructions_pass_impl(nir_function_impl *impl, void *data)
+{
+   struct nir_instructions_pass_state *state =
+      (struct nir_instructions_pass_state *)data;
+
+   return nir_function_instructions_pass(impl, state->pass, state->preserved,
+                                         state->cb_data);
+}
+
+/**
+ * As nir_shader_instructions_pass(), but runs the function implementations
+ * on several threads with nir_shader_parallel_impls_pass().  The pass must
+ * only modify the function it's called on, and cb_data is shared by all
+ * threads.
+ */
+static inline bool
+nir_shader_parallel_instructions_pass(nir_shader *shader,
+                                      nir_instr_pass_cb pass,
+                                      nir_metadata preserved,
+                                      void *cb_data)
+{
+   struct nir_instructions_pass_state state = { pass, preserved, cb_data };
+
+   return nir_shader_parallel_impls_pass(shader, nir_instructions_pass_impl,
+                                         &state);
+}
+
 /**
  * Iterates over all the intrinsics in a NIR function and calls the given pass
  * on them.
@@ -26,6 +26,7 @@
  */
 
 #include "nir_control_flow_private.h"
+#include "nir_parallel_private.h"
 
 /**
  * \name Control flow modification
@@ -457,7 +458,7 @@ remove_phi_src(nir_block *block, nir_block *pred)
          if (src->pred == pred) {
             list_del(&src->src.use_link);
             exec_node_remove(&src->node);
-            gc_free(src);
+            nir_gc_free(src);
          }
       }
    }
@@ -26,6 +26,7 @@
  */
 
 #include "nir.h"
+#include "nir_parallel_private.h"
 
 /*
  * Implements the algorithms for computing the dominance tree and the
@@ -123,7 +124,7 @@ calc_dom_frontier(nir_block *block)
 static void
 calc_dom_children(nir_function_impl *impl)
 {
-   void *mem_ctx = ralloc_parent(impl);
+   void *mem_ctx = nir_shader_mem_ctx(impl->function->shader);
 
    nir_foreach_block_unstructured(block, impl) {
       if (block->imm_dom)
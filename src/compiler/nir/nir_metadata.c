@@ -22,6 +22,7 @@
  */
 
 #include "nir.h"
+#include "nir_parallel_private.h"
 
 /*
  * Handles management of the metadata.
@@ -124,7 +125,7 @@ nir_metadata_invalidate(nir_shader *shader)
 
          if (impl->valid_metadata & nir_metadata_dominance &&
              block->dom_children != block->_dom_children_storage)
-            ralloc_free(block->dom_children);
+            nir_ralloc_free(block->dom_children);
          block->dom_children = NULL;
          block->num_dom_children = 1;
          block->dom_pre_index = block->dom_post_index = 0;
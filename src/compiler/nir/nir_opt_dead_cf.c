@@ -391,8 +391,8 @@ dead_cf_list(struct exec_list *list, bool *list_ends_in_jump)
    return progress;
 }
 
-static bool
-opt_dead_cf_impl(nir_function_impl *impl)
+bool
+nir_opt_dead_cf_impl(nir_function_impl *impl)
 {
    bool dummy;
    bool progress = dead_cf_list(&impl->body, &dummy);
@@ -418,13 +418,31 @@ opt_dead_cf_impl(nir_function_impl *impl)
    return progress;
 }
 
+static bool
+opt_dead_cf_impl_pass(nir_function_impl *impl, void *data)
+{
+   return nir_opt_dead_cf_impl(impl);
+}
+
+/* Below this many SSA defs, waking up other threads costs more than it
+ * saves.
+ */
+#define PARALLEL_MIN_DEFS 4096
+
 bool
 nir_opt_dead_cf(nir_shader *shader)
 {
    bool progress = false;
+   unsigned num_defs = 0;
+
+   nir_foreach_function_impl(impl, shader)
+      num_defs += impl->ssa_alloc;
+
+   if (num_defs >= PARALLEL_MIN_DEFS)
+      return nir_shader_parallel_impls_pass(shader, opt_dead_cf_impl_pass, NULL);
 
    nir_foreach_function_impl(impl, shader)
-      progress |= opt_dead_cf_impl(impl);
+      progress |= nir_opt_dead_cf_impl(impl);
 
    return progress;
 }
@@ -0,0 +1,167 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "nir.h"
+#include "nir_parallel_private.h"
+#include "util/u_atomic.h"
+#include "util/u_call_once.h"
+#include "util/u_debug.h"
+#include "util/u_queue.h"
+
+__THREAD_INITIAL_EXEC struct nir_parallel_worker *nir_parallel_worker;
+
+DEBUG_GET_ONCE_NUM_OPTION(nir_threads, "NIR_THREADS", 0)
+
+/* Shared by all shaders, the calling thread of a pass is one more worker. */
+static struct util_queue queue;
+static unsigned queue_threads;
+static util_once_flag queue_once = UTIL_ONCE_FLAG_INIT;
+
+/* Serial until a driver opts in, so that NIR doesn't start a thread per CPU
+ * in every process on top of the driver's own threads.
+ */
+static unsigned max_threads = 1;
+
+void
+nir_parallel_set_max_threads(unsigned num_threads)
+{
+   p_atomic_set(&max_threads, MAX2(num_threads, 1));
+}
+
+static unsigned
+get_max_threads(void)
+{
+   unsigned threads = debug_get_option_nir_threads();
+   return threads ? threads : p_atomic_read(&max_threads);
+}
+
+static void
+init_queue(void)
+{
+   unsigned threads = get_max_threads();
+
+   if (threads > 1 &&
+       util_queue_init(&queue, "nir", 16, threads - 1,
+                       UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                       UTIL_QUEUE_INIT_SET_FULL_THREAD_AFFINITY, NULL))
+      queue_threads = threads - 1;
+}
+
+struct parallel_pass {
+   nir_function_impl **impls;
+   bool *progress;
+   unsigned num_impls;
+   unsigned next_impl;
+
+   nir_impl_pass_cb pass;
+   void *data;
+};
+
+struct parallel_job {
+   struct parallel_pass *pass;
+   struct nir_parallel_worker worker;
+   struct util_queue_fence fence;
+};
+
+static void
+run_job(void *data, void *gdata, int thread_index)
+{
+   struct parallel_job *job = data;
+   struct parallel_pass *pass = job->pass;
+
+   nir_parallel_worker = &job->worker;
+
+   /* Implementations are handed out one at a time, since their sizes are
+    * usually very different.
+    */
+   unsigned i;
+   while ((i = p_atomic_inc_return(&pass->next_impl) - 1) < pass->num_impls)
+      pass->progress[i] = pass->pass(pass->impls[i], pass->data);
+
+   nir_parallel_worker = NULL;
+}
+
+bool
+nir_shader_parallel_impls_pass(nir_shader *shader,
+                               nir_impl_pass_cb pass, void *data)
+{
+   bool progress = false;
+   unsigned num_impls = 0;
+
+   nir_foreach_function_impl(impl, shader)
+      num_impls++;
+
+   unsigned threads = get_max_threads();
+   if (threads > 1)
+      util_call_once(&queue_once, init_queue);
+
+   unsigned num_jobs = MIN3(num_impls, threads, queue_threads + 1);
+   if (num_jobs <= 1 || nir_parallel_worker) {
+      nir_foreach_function_impl(impl, shader)
+         progress |= pass(impl, data);
+      return progress;
+   }
+
+   void *mem_ctx = ralloc_context(NULL);
+
+   struct parallel_pass state = {
+      .impls = ralloc_array(mem_ctx, nir_function_impl *, num_impls),
+      .progress = rzalloc_array(mem_ctx, bool, num_impls),
+      .num_impls = num_impls,
+      .pass = pass,
+      .data = data,
+   };
+
+   unsigned i = 0;
+   nir_foreach_function_impl(impl, shader)
+      state.impls[i++] = impl;
+
+   struct parallel_job *jobs =
+      rzalloc_array(mem_ctx, struct parallel_job, num_jobs);
+
+   for (unsigned j = 0; j < num_jobs; j++) {
+      jobs[j].pass = &state;
+      jobs[j].worker.gctx = gc_subcontext(shader->gctx);
+      jobs[j].worker.mem_ctx = ralloc_context(NULL);
+      util_dynarray_init(&jobs[j].worker.deferred_frees, NULL);
+      util_dynarray_init(&jobs[j].worker.deferred_ralloc_frees, NULL);
+      util_queue_fence_init(&jobs[j].fence);
+   }
+
+   for (unsigned j = 1; j < num_jobs; j++) {
+      util_queue_add_job(&queue, &jobs[j], &jobs[j].fence,
+                         run_job, NULL, 0);
+   }
+
+   run_job(&jobs[0], NULL, 0);
+
+   /* Once the calling thread runs out of work, the jobs which haven't
+    * started yet have nothing left to do.
+    */
+   for (unsigned j = 1; j < num_jobs; j++)
+      util_queue_drop_job(&queue, &jobs[j].fence);
+
+   for (unsigned j = 0; j < num_jobs; j++) {
+      gc_join_subcontext(shader->gctx, jobs[j].worker.gctx);
+      ralloc_adopt(shader, jobs[j].worker.mem_ctx);
+      ralloc_free(jobs[j].worker.mem_ctx);
+   }
+
+   for (unsigned j = 0; j < num_jobs; j++) {
+      util_dynarray_foreach(&jobs[j].worker.deferred_frees, void *, ptr)
+         gc_free(*ptr);
+      util_dynarray_foreach(&jobs[j].worker.deferred_ralloc_frees, void *, ptr)
+         ralloc_free(*ptr);
+      util_dynarray_fini(&jobs[j].worker.deferred_frees);
+      util_dynarray_fini(&jobs[j].worker.deferred_ralloc_frees);
+      util_queue_fence_destroy(&jobs[j].fence);
+   }
+
+   for (i = 0; i < num_impls; i++)
+      progress |= state.progress[i];
+
+   ralloc_free(mem_ctx);
+   return progress;
+}
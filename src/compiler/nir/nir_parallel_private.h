@@ -0,0 +1,65 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef NIR_PARALLEL_PRIVATE_H
+#define NIR_PARALLEL_PRIVATE_H
+
+#include "nir.h"
+#include "util/u_dynarray.h"
+#include "util/u_thread.h"
+
+/* State of a thread running nir_shader_parallel_impls_pass().
+ *
+ * The IR allocated by the thread comes from its own GC sub-context and
+ * ralloc context, which are merged into the shader when the pass is done.
+ * Memory which belongs to the shader can't be freed by the thread, so it's
+ * freed after the merge instead.
+ */
+struct nir_parallel_worker {
+   gc_ctx *gctx;
+   void *mem_ctx;
+   struct util_dynarray deferred_frees;
+   struct util_dynarray deferred_ralloc_frees;
+};
+
+extern __THREAD_INITIAL_EXEC struct nir_parallel_worker *nir_parallel_worker;
+
+static inline gc_ctx *
+nir_shader_gc_ctx(nir_shader *shader)
+{
+   struct nir_parallel_worker *worker = nir_parallel_worker;
+   return worker ? worker->gctx : shader->gctx;
+}
+
+static inline void *
+nir_shader_mem_ctx(nir_shader *shader)
+{
+   struct nir_parallel_worker *worker = nir_parallel_worker;
+   return worker ? worker->mem_ctx : shader;
+}
+
+/* gc_free() for IR which may be freed by a parallel pass. */
+static inline void
+nir_gc_free(void *ptr)
+{
+   struct nir_parallel_worker *worker = nir_parallel_worker;
+   if (worker && ptr && gc_get_context(ptr) != worker->gctx)
+      util_dynarray_append(&worker->deferred_frees, ptr);
+   else
+      gc_free(ptr);
+}
+
+/* ralloc_free() for memory allocated from nir_shader_mem_ctx(). */
+static inline void
+nir_ralloc_free(void *ptr)
+{
+   struct nir_parallel_worker *worker = nir_parallel_worker;
+   if (worker && ptr && ralloc_parent(ptr) != worker->mem_ctx)
+      util_dynarray_append(&worker->deferred_ralloc_frees, ptr);
+   else
+      ralloc_free(ptr);
+}
+
+#endif /* NIR_PARALLEL_PRIVATE_H */
@@ -26,11 +26,27 @@
 #include "util/u_math.h"
 #include "util/u_printf.h"
 #include "nir_control_flow.h"
+#include "nir_parallel_private.h"
 #include "nir_xfb_info.h"
 
 #define NIR_SERIALIZE_FUNC_HAS_IMPL ((void *)(intptr_t)1)
 #define MAX_OBJECT_IDS              (1 << 20)
 
+/* Bump this whenever the format changes.
+ *
+ * Version 1 added the version itself and made every function
+ * implementation a self-contained section, see write_function_impl().  The
+ * encoding of instructions is unchanged: sources are still written as one
+ * packed 32-bit word each, since the blob aligns all 32-bit fields and
+ * packing only the sources tighter wouldn't make blobs smaller.
+ */
+#define NIR_SERIALIZE_VERSION       1
+
+/* Function implementations are only decoded in parallel when there are
+ * enough of them to be worth waking up other threads.
+ */
+#define PARALLEL_DECODE_MIN_SIZE    (64 * 1024)
+
 typedef struct {
    size_t blob_offset;
    nir_def *src;
@@ -45,6 +61,11 @@ typedef struct {
    /* maps pointer to index */
    struct hash_table remap_table;
 
+   /* maps nir_def::index of the current function implementation to index,
+    * SSA defs are by far the most common objects
+    */
+   struct util_dynarray def_ids;
+
    /* the next index to assign to a NIR in-memory object */
    uint32_t next_idx;
 
@@ -90,7 +111,7 @@ typedef struct {
    const struct glsl_type *last_interface_type;
    struct nir_variable_data last_var_data;
 
-   struct hash_table strings;
+   struct hash_table *strings;
 } read_ctx;
 
 static void
@@ -109,6 +130,23 @@ write_lookup_object(write_ctx *ctx, const void *obj)
    return (uint32_t)(uintptr_t)entry->data;
 }
 
+static void
+write_add_def(write_ctx *ctx, const nir_def *def)
+{
+   uint32_t index = ctx->next_idx++;
+   assert(index != MAX_OBJECT_IDS);
+   *util_dynarray_element(&ctx->def_ids, uint32_t, def->index) = index;
+}
+
+static uint32_t
+write_lookup_def(write_ctx *ctx, const nir_def *def)
+{
+   uint32_t index = *util_dynarray_element(&ctx->def_ids, uint32_t,
+                                           def->index);
+   assert(index != UINT32_MAX);
+   return index;
+}
+
 static void
 read_add_object(read_ctx *ctx, void *obj)
 {
@@ -390,7 +428,8 @@ read_variable(read_ctx *ctx)
 
    var->num_state_slots = flags.u.num_state_slots;
    if (var->num_state_slots != 0) {
-      var->state_slots = ralloc_array(ctx->nir, nir_state_slot,
+      var->state_slots = ralloc_array(nir_shader_mem_ctx(ctx->nir),
+                                      nir_state_slot,
                                       var->num_state_slots);
       for (unsigned i = 0; i < var->num_state_slots; i++) {
          blob_copy_bytes(ctx->blob, &var->state_slots[i],
@@ -398,7 +437,8 @@ read_variable(read_ctx *ctx)
       }
    }
    if (flags.u.has_constant_initializer)
-      var->constant_initializer = read_constant(ctx, ctx->nir);
+      var->constant_initializer =
+         read_constant(ctx, nir_shader_mem_ctx(ctx->nir));
    else
       var->constant_initializer = NULL;
 
@@ -409,7 +449,8 @@ read_variable(read_ctx *ctx)
 
    var->num_members = flags.u.num_members;
    if (var->num_members > 0) {
-      var->members = ralloc_array(ctx->nir, struct nir_variable_data,
+      var->members = ralloc_array(nir_shader_mem_ctx(ctx->nir),
+                                  struct nir_variable_data,
                                   var->num_members);
       blob_copy_bytes(ctx->blob, (uint8_t *)var->members,
                       var->num_members * sizeof(*var->members));
@@ -463,7 +504,7 @@ union packed_src {
 static void
 write_src_full(write_ctx *ctx, const nir_src *src, union packed_src header)
 {
-   header.any.object_idx = write_lookup_object(ctx, src->ssa);
+   header.any.object_idx = write_lookup_def(ctx, src->ssa);
    blob_write_uint32(ctx->blob, header.u32);
 }
 
@@ -658,7 +699,7 @@ write_def(write_ctx *ctx, const nir_def *def, union packed_instr header,
    if (pdef.num_components == NUM_COMPONENTS_IS_SEPARATE_7)
       blob_write_uint32(ctx->blob, def->num_components);
 
-   write_add_object(ctx, def);
+   write_add_def(ctx, def);
 }
 
 static void
@@ -737,7 +778,7 @@ write_alu(write_ctx *ctx, const nir_alu_instr *alu)
 
    if (header.alu.packed_src_ssa_16bit) {
       for (unsigned i = 0; i < num_srcs; i++) {
-         unsigned idx = write_lookup_object(ctx, alu->src[i].src.ssa);
+         unsigned idx = write_lookup_def(ctx, alu->src[i].src.ssa);
          assert(idx < (1 << 16));
          blob_write_uint16(ctx->blob, idx);
       }
@@ -938,9 +979,9 @@ write_deref(write_ctx *ctx, const nir_deref_instr *deref)
    case nir_deref_type_ptr_as_array:
       if (header.deref.packed_src_ssa_16bit) {
          blob_write_uint16(ctx->blob,
-                           write_lookup_object(ctx, deref->parent.ssa));
+                           write_lookup_def(ctx, deref->parent.ssa));
          blob_write_uint16(ctx->blob,
-                           write_lookup_object(ctx, deref->arr.index.ssa));
+                           write_lookup_def(ctx, deref->arr.index.ssa));
       } else {
          write_src(ctx, &deref->parent);
          write_src(ctx, &deref->arr.index);
@@ -1254,7 +1295,7 @@ write_load_const(write_ctx *ctx, const nir_load_const_instr *lc)
       }
    }
 
-   write_add_object(ctx, &lc->def);
+   write_add_def(ctx, &lc->def);
 }
 
 static nir_load_const_instr *
@@ -1346,7 +1387,7 @@ write_ssa_undef(write_ctx *ctx, const nir_undef_instr *undef)
    header.undef.bit_size = encode_bit_size_3bits(undef->def.bit_size);
 
    blob_write_uint32(ctx->blob, header.u32);
-   write_add_object(ctx, &undef->def);
+   write_add_def(ctx, &undef->def);
 }
 
 static nir_undef_instr *
@@ -1505,7 +1546,7 @@ write_fixup_phis(write_ctx *ctx)
 {
    util_dynarray_foreach(&ctx->phi_fixups, write_phi_fixup, fixup) {
       blob_overwrite_uint32(ctx->blob, fixup->blob_offset,
-                            write_lookup_object(ctx, fixup->src));
+                            write_lookup_def(ctx, fixup->src));
       blob_overwrite_uint32(ctx->blob, fixup->blob_offset + sizeof(uint32_t),
                             write_lookup_object(ctx, fixup->block));
    }
@@ -1689,24 +1730,24 @@ read_debug_info(read_ctx *ctx, nir_instr_debug_info *debug_info)
    if (flags & NIR_SERIALIZE_FILENAME) {
       const char *filename = blob_read_string(ctx->blob);
 
-      struct hash_entry *entry = _mesa_hash_table_search(&ctx->strings, filename);
+      struct hash_entry *entry = _mesa_hash_table_search(ctx->strings, filename);
       if (entry) {
          debug_info->filename = entry->data;
       } else {
          debug_info->filename = ralloc_strdup(ctx->nir, filename);
-         _mesa_hash_table_insert(&ctx->strings, filename, debug_info->filename);
+         _mesa_hash_table_insert(ctx->strings, filename, debug_info->filename);
       }
    }
 
    if (flags & NIR_SERIALIZE_VARIABLE_NAME) {
       const char *variable_name = blob_read_string(ctx->blob);
 
-      struct hash_entry *entry = _mesa_hash_table_search(&ctx->strings, variable_name);
+      struct hash_entry *entry = _mesa_hash_table_search(ctx->strings, variable_name);
       if (entry) {
          debug_info->variable_name = entry->data;
       } else {
          debug_info->variable_name = ralloc_strdup(ctx->nir, variable_name);
-         _mesa_hash_table_insert(&ctx->strings, variable_name, debug_info->variable_name);
+         _mesa_hash_table_insert(ctx->strings, variable_name, debug_info->variable_name);
       }
    }
 }
@@ -1972,9 +2013,33 @@ read_cf_list(read_ctx *ctx, struct exec_list *cf_list)
       read_cf_node(ctx, cf_list);
 }
 
+/* Every function implementation is a section of its own, which starts with
+ * its size and the number of object IDs it assigns.  It doesn't depend on
+ * anything written by the previous sections, so nir_deserialize() can skip
+ * over the sections and decode them in parallel later.
+ */
 static void
 write_function_impl(write_ctx *ctx, const nir_function_impl *fi)
 {
+   size_t size_offset = blob_reserve_uint32(ctx->blob);
+   size_t num_ids_offset = blob_reserve_uint32(ctx->blob);
+   size_t start = ctx->blob->size;
+   uint32_t first_idx = ctx->next_idx;
+
+   ctx->last_type = NULL;
+   ctx->last_interface_type = NULL;
+   memset(&ctx->last_var_data, 0, sizeof(ctx->last_var_data));
+
+   if (fi->ssa_alloc) {
+      if (!util_dynarray_resize(&ctx->def_ids, uint32_t, fi->ssa_alloc)) {
+         ctx->blob->out_of_memory = true;
+         return;
+      }
+#ifndef NDEBUG
+      memset(ctx->def_ids.data, 0xff, ctx->def_ids.size);
+#endif
+   }
+
    blob_write_uint8(ctx->blob, fi->structured);
    blob_write_uint8(ctx->blob, !!fi->preamble);
 
@@ -1985,12 +2050,18 @@ write_function_impl(write_ctx *ctx, const nir_function_impl *fi)
 
    write_cf_list(ctx, &fi->body);
    write_fixup_phis(ctx);
+
+   blob_overwrite_uint32(ctx->blob, size_offset, ctx->blob->size - start);
+   blob_overwrite_uint32(ctx->blob, num_ids_offset,
+                         ctx->next_idx - first_idx);
 }
 
-static nir_function_impl *
-read_function_impl(read_ctx *ctx)
+static void
+read_function_impl_body(read_ctx *ctx, nir_function_impl *fi)
 {
-   nir_function_impl *fi = nir_function_impl_create_bare(ctx->nir);
+   ctx->last_type = NULL;
+   ctx->last_interface_type = NULL;
+   memset(&ctx->last_var_data, 0, sizeof(ctx->last_var_data));
 
    fi->structured = blob_read_uint8(ctx->blob);
    bool preamble = blob_read_uint8(ctx->blob);
@@ -2004,10 +2075,92 @@ read_function_impl(read_ctx *ctx)
    read_fixup_phis(ctx);
 
    fi->valid_metadata = 0;
+}
+
+static nir_function_impl *
+read_function_impl(read_ctx *ctx)
+{
+   nir_function_impl *fi = nir_function_impl_create_bare(ctx->nir);
+
+   /* The size and the number of object IDs only matter for parallel
+    * decoding.
+    */
+   blob_read_uint32(ctx->blob);
+   blob_read_uint32(ctx->blob);
+
+   read_function_impl_body(ctx, fi);
 
    return fi;
 }
 
+typedef struct {
+   /* Offset of the implementation after the section header */
+   size_t offset;
+   uint32_t size;
+   uint32_t first_idx;
+   uint32_t num_ids;
+   bool overrun;
+} read_impl_section;
+
+typedef struct {
+   read_ctx *ctx;
+
+   /* maps nir_function_impl to read_impl_section */
+   struct hash_table sections;
+} read_impls_state;
+
+/* Reads the header of a function implementation section and skips the
+ * rest, which is decoded by read_impl_section_body().
+ */
+static void
+read_impl_section_header(read_ctx *ctx, read_impl_section *section)
+{
+   section->size = blob_read_uint32(ctx->blob);
+   section->num_ids = blob_read_uint32(ctx->blob);
+   section->offset = ctx->blob->current - ctx->blob->data;
+   section->first_idx = ctx->next_idx;
+
+   blob_skip_bytes(ctx->blob, section->size);
+
+   if (section->num_ids > ctx->idx_table_len - ctx->next_idx)
+      ctx->blob->overrun = true;
+   else
+      ctx->next_idx += section->num_ids;
+}
+
+static bool
+read_impl_section_body(nir_function_impl *fi, void *data)
+{
+   read_impls_state *state = data;
+   read_ctx *shader_ctx = state->ctx;
+   read_impl_section *section =
+      _mesa_hash_table_search(&state->sections, fi)->data;
+
+   /* Keep the start of the blob, so that reads are aligned the same way as
+    * they were written.
+    */
+   struct blob_reader blob;
+   blob_reader_init(&blob, shader_ctx->blob->data,
+                    section->offset + section->size);
+   blob.current += section->offset;
+
+   read_ctx ctx = {
+      .nir = shader_ctx->nir,
+      .blob = &blob,
+      .next_idx = section->first_idx,
+      .idx_table_len = section->first_idx + section->num_ids,
+      .idx_table = shader_ctx->idx_table,
+      .strings = shader_ctx->strings,
+   };
+   list_inithead(&ctx.phi_srcs);
+
+   read_function_impl_body(&ctx, fi);
+
+   section->overrun = blob.overrun || blob.current != blob.end ||
+                      ctx.next_idx != ctx.idx_table_len;
+   return false;
+}
+
 static void
 write_function(write_ctx *ctx, const nir_function *fxn)
 {
@@ -2179,7 +2332,9 @@ nir_serialize_function(struct blob *blob, const nir_function *fxn)
    ctx.nir = fxn->shader;
    ctx.strip = true;
    ctx.phi_fixups = UTIL_DYNARRAY_INIT;
+   ctx.def_ids = UTIL_DYNARRAY_INIT;
 
+   blob_write_uint32(blob, NIR_SERIALIZE_VERSION);
    size_t idx_size_offset = blob_reserve_uint32(blob);
 
    write_function(&ctx, fxn);
@@ -2189,6 +2344,7 @@ nir_serialize_function(struct blob *blob, const nir_function *fxn)
 
    _mesa_hash_table_fini(&ctx.remap_table, NULL);
    util_dynarray_fini(&ctx.phi_fixups);
+   util_dynarray_fini(&ctx.def_ids);
 }
 
 static void
@@ -2201,7 +2357,9 @@ serialize_internal(struct blob *blob, const nir_shader *nir, bool strip, bool se
    ctx.strip = strip;
    ctx.debug_info = nir->has_debug_info && !strip;
    ctx.phi_fixups = UTIL_DYNARRAY_INIT;
+   ctx.def_ids = UTIL_DYNARRAY_INIT;
 
+   blob_write_uint32(blob, NIR_SERIALIZE_VERSION);
    size_t idx_size_offset = blob_reserve_uint32(blob);
 
    struct shader_info info = nir->info;
@@ -2253,6 +2411,7 @@ serialize_internal(struct blob *blob, const nir_shader *nir, bool strip, bool se
 
    _mesa_hash_table_fini(&ctx.remap_table, NULL);
    util_dynarray_fini(&ctx.phi_fixups);
+   util_dynarray_fini(&ctx.def_ids);
 }
 
 /**
@@ -2268,11 +2427,22 @@ nir_serialize(struct blob *blob, const nir_shader *nir, bool strip)
    serialize_internal(blob, nir, strip, true);
 }
 
+/**
+ * Deserialize NIR from a binary blob.
+ *
+ * Returns NULL and sets blob->overrun if the blob was written with a
+ * different version of the format, or if out of memory.
+ */
 nir_shader *
 nir_deserialize(void *mem_ctx,
                 const struct nir_shader_compiler_options *options,
                 struct blob_reader *blob)
 {
+   if (blob_read_uint32(blob) != NIR_SERIALIZE_VERSION) {
+      blob->overrun = true;
+      return NULL;
+   }
+
    read_ctx ctx = { 0 };
    ctx.blob = blob;
    list_inithead(&ctx.phi_srcs);
@@ -2289,8 +2459,11 @@ nir_deserialize(void *mem_ctx,
    ctx.nir = nir_shader_create(mem_ctx, info.stage, options);
 
    ctx.nir->has_debug_info = !!(flags & NIR_SERIALIZE_DEBUG_INFO);
-   if (ctx.nir->has_debug_info)
-      _mesa_hash_table_init(&ctx.strings, NULL, _mesa_hash_string, _mesa_key_string_equal);
+   struct hash_table strings;
+   if (ctx.nir->has_debug_info) {
+      _mesa_hash_table_init(&strings, NULL, _mesa_hash_string, _mesa_key_string_equal);
+      ctx.strings = &strings;
+   }
 
    info.name = name ? ralloc_strdup(ctx.nir, name) : NULL;
    info.label = label ? ralloc_strdup(ctx.nir, label) : NULL;
@@ -2308,9 +2481,35 @@ nir_deserialize(void *mem_ctx,
    for (unsigned i = 0; i < num_functions; i++)
       read_function(&ctx);
 
+   /* Function implementations are decoded once the rest of the shader is
+    * there, in parallel if the shader is big enough.  Debug info strings
+    * are shared by all implementations, so they are decoded serially then.
+    */
+   read_impls_state impls = { .ctx = &ctx };
+   _mesa_pointer_hash_table_init(&impls.sections, NULL);
+   read_impl_section *sections =
+      calloc(num_functions, sizeof(read_impl_section));
+   if (!sections && num_functions) {
+      blob->overrun = true;
+      _mesa_hash_table_fini(&impls.sections, NULL);
+      free(ctx.idx_table);
+      if (ctx.strings)
+         _mesa_hash_table_fini(ctx.strings, NULL);
+      ralloc_free(ctx.nir);
+      return NULL;
+   }
+
+   size_t impls_size = 0;
+   unsigned num_impls = 0;
+
    nir_foreach_function(fxn, ctx.nir) {
-      if (fxn->impl == NIR_SERIALIZE_FUNC_HAS_IMPL)
-         nir_function_set_impl(fxn, read_function_impl(&ctx));
+      if (fxn->impl == NIR_SERIALIZE_FUNC_HAS_IMPL) {
+         read_impl_section *section = &sections[num_impls++];
+         nir_function_set_impl(fxn, nir_function_impl_create_bare(ctx.nir));
+         read_impl_section_header(&ctx, section);
+         _mesa_hash_table_insert(&impls.sections, fxn->impl, section);
+         impls_size += section->size;
+      }
    }
 
    ctx.nir->constant_data_size = blob_read_uint32(blob);
@@ -2329,8 +2528,25 @@ nir_deserialize(void *mem_ctx,
                                    &ctx.nir->printf_info_count);
    }
 
+   if (!blob->overrun) {
+      if (!ctx.nir->has_debug_info &&
+          impls_size >= PARALLEL_DECODE_MIN_SIZE) {
+         nir_shader_parallel_impls_pass(ctx.nir, read_impl_section_body,
+                                        &impls);
+      } else {
+         nir_foreach_function_impl(impl, ctx.nir)
+            read_impl_section_body(impl, &impls);
+      }
+
+      for (unsigned i = 0; i < num_impls; i++)
+         blob->overrun |= sections[i].overrun;
+   }
+
+   free(sections);
+   _mesa_hash_table_fini(&impls.sections, NULL);
    free(ctx.idx_table);
-   _mesa_hash_table_fini(&ctx.strings, NULL);
+   if (ctx.strings)
+      _mesa_hash_table_fini(ctx.strings, NULL);
 
    nir_validate_shader(ctx.nir, "after deserialize");
 
@@ -2342,6 +2558,11 @@ nir_deserialize_function(void *mem_ctx,
                          const struct nir_shader_compiler_options *options,
                          struct blob_reader *blob)
 {
+   if (blob_read_uint32(blob) != NIR_SERIALIZE_VERSION) {
+      blob->overrun = true;
+      return NULL;
+   }
+
    read_ctx ctx = { 0 };
    ctx.blob = blob;
    list_inithead(&ctx.phi_srcs);
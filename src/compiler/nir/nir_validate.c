@@ -30,6 +30,7 @@
 #include "util/hash_table.h"
 #include "util/simple_mtx.h"
 #include "nir.h"
+#include "nir_parallel_private.h"
 #include "nir_xfb_info.h"
 
 /*
@@ -1973,7 +1974,7 @@ validate_dominance(nir_function_impl *impl, validate_state *state)
       block_dom_metadata *md = &blocks[entry - state->blocks->table];
 
       if (block->dom_children != block->_dom_children_storage)
-         ralloc_free(block->dom_children);
+         nir_ralloc_free(block->dom_children);
       _mesa_set_fini(&block->dom_frontier, NULL);
 
       block->index = md->index;
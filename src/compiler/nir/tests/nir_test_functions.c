@@ -0,0 +1,47 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+
+#include "nir_builder.h"
+#include "nir_test_functions.h"
+
+void
+nir_test_build_functions(nir_shader *shader, unsigned num_functions,
+                         unsigned num_ops)
+{
+   for (unsigned f = 0; f < num_functions; f++) {
+      char name[32];
+      snprintf(name, sizeof(name), "func%u", f);
+
+      nir_function *func = nir_function_create(shader, name);
+      nir_function_impl *impl = nir_function_impl_create(func);
+      nir_builder b = nir_builder_at(nir_after_impl(impl));
+
+      nir_def *addr = nir_imm_int64(&b, f * 4);
+      nir_def *v = nir_load_global(&b, 1, 32, addr);
+      nir_intrinsic_set_align(nir_def_as_intrinsic(v), 4, 0);
+
+      for (unsigned i = 0; i < num_ops; i++) {
+         nir_def *t = nir_fmul(&b, v, nir_imm_float(&b, 1.0f));
+
+         if (i % 8 == 0) {
+            nir_push_if(&b, nir_flt(&b, t, nir_imm_float(&b, i)));
+            nir_def *then_def = nir_fadd(&b, t, t);
+            nir_push_else(&b, NULL);
+            nir_def *else_def = nir_mov(&b, t);
+            nir_pop_if(&b, NULL);
+            v = nir_if_phi(&b, then_def, else_def);
+         } else {
+            v = nir_fadd(&b, nir_fadd(&b, t, t), nir_imm_float(&b, i));
+         }
+
+         /* Dead */
+         nir_fmul(&b, v, nir_mov(&b, v));
+      }
+
+      nir_intrinsic_set_align(nir_store_global(&b, v, addr), 4, 0);
+   }
+}
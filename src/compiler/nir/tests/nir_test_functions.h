@@ -0,0 +1,28 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef NIR_TESTS_NIR_TEST_FUNCTIONS_H
+#define NIR_TESTS_NIR_TEST_FUNCTIONS_H
+
+#include "nir.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Adds num_functions functions to the shader, each with num_ops rounds of
+ * work for copy propagation, DCE and algebraic folding, and an if with a phi
+ * every eighth round.  Shared by the tests and benchmarks of parallel passes
+ * and serialization.
+ */
+void
+nir_test_build_functions(nir_shader *shader, unsigned num_functions,
+                         unsigned num_ops);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NIR_TESTS_NIR_TEST_FUNCTIONS_H */
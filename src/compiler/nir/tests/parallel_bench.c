@@ -0,0 +1,72 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Measures an optimization loop run with nir_shader_parallel_impls_pass()
+ * against the same loop run serially, on a kernel with many large functions
+ * like an OpenCL kernel after inlining was skipped.  It opts in to one
+ * thread per CPU like a driver would, NIR_THREADS overrides that.
+ *
+ * Usage: nir_parallel_bench [num_functions] [num_ops]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "nir.h"
+#include "nir_builder.h"
+#include "nir_test_functions.h"
+#include "util/os_time.h"
+#include "util/u_cpu_detect.h"
+
+static bool
+optimize_impl(nir_function_impl *impl, void *data)
+{
+   bool progress, any_progress = false;
+
+   do {
+      progress = false;
+      progress |= nir_opt_copy_prop_impl(impl);
+      progress |= nir_opt_dce_impl(impl);
+      progress |= nir_opt_dead_cf_impl(impl);
+      any_progress |= progress;
+   } while (progress);
+
+   return any_progress;
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned num_functions = argc > 1 ? atoi(argv[1]) : 64;
+   unsigned num_ops = argc > 2 ? atoi(argv[2]) : 512;
+   const nir_shader_compiler_options options = { 0 };
+
+   glsl_type_singleton_init_or_ref();
+   nir_parallel_set_max_threads(util_get_cpu_caps()->nr_cpus);
+
+   nir_builder b =
+      nir_builder_init_simple_shader(MESA_SHADER_KERNEL, &options, "bench");
+   nir_test_build_functions(b.shader, num_functions, num_ops);
+
+   nir_shader *serial = nir_shader_clone(NULL, b.shader);
+
+   int64_t start = os_time_get_nano();
+   nir_foreach_function_impl(impl, serial)
+      optimize_impl(impl, NULL);
+   int64_t serial_ns = os_time_get_nano() - start;
+
+   start = os_time_get_nano();
+   nir_shader_parallel_impls_pass(b.shader, optimize_impl, NULL);
+   int64_t parallel_ns = os_time_get_nano() - start;
+
+   printf("%u functions, %u ops: serial %8.2f ms, parallel %8.2f ms\n",
+          num_functions, num_ops, serial_ns / 1e6, parallel_ns / 1e6);
+
+   ralloc_free(serial);
+   ralloc_free(b.shader);
+   glsl_type_singleton_decref();
+
+   return 0;
+}
@@ -0,0 +1,258 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ *
+ * Check that running function-local passes with
+ * nir_shader_parallel_impls_pass() gives the same shader as running them
+ * serially.  NIR_THREADS sets the number of threads.
+ */
+
+#include <string>
+
+#include "nir_test.h"
+#include "nir_test_functions.h"
+
+namespace {
+
+class nir_parallel_test : public nir_test {
+protected:
+   nir_parallel_test()
+      : nir_test::nir_test("nir_parallel_test", MESA_SHADER_KERNEL)
+   {
+   }
+};
+
+/* fmul(a, 1.0) -> a, fadd(a, a) -> fmul(a, 2.0) */
+bool
+fold_alu(nir_builder *b, nir_instr *instr, void *data)
+{
+   if (instr->type != nir_instr_type_alu)
+      return false;
+
+   nir_alu_instr *alu = nir_instr_as_alu(instr);
+   b->cursor = nir_before_instr(instr);
+
+   if (alu->op == nir_op_fmul && nir_src_is_const(alu->src[1].src) &&
+       nir_src_as_float(alu->src[1].src) == 1.0) {
+      nir_def_replace(&alu->def, alu->src[0].src.ssa);
+      return true;
+   }
+
+   if (alu->op == nir_op_fadd && alu->src[0].src.ssa == alu->src[1].src.ssa) {
+      nir_def *a = alu->src[0].src.ssa;
+      nir_def_replace(&alu->def, nir_fmul(b, a, nir_imm_float(b, 2.0f)));
+      return true;
+   }
+
+   return false;
+}
+
+bool
+optimize_impl(nir_function_impl *impl, void *data)
+{
+   bool progress, any_progress = false;
+
+   do {
+      progress = false;
+      progress |= nir_opt_copy_prop_impl(impl);
+      progress |= nir_function_instructions_pass(impl, fold_alu,
+                                                 nir_metadata_control_flow,
+                                                 NULL);
+      progress |= nir_opt_dce_impl(impl);
+      any_progress |= progress;
+   } while (progress);
+
+   return any_progress;
+}
+
+bool
+optimize_serially(nir_shader *shader)
+{
+   bool progress = false;
+
+   nir_foreach_function_impl(impl, shader)
+      progress |= optimize_impl(impl, NULL);
+
+   return progress;
+}
+
+bool
+add_control_flow(nir_function_impl *impl, void *data)
+{
+   nir_builder b = nir_builder_at(nir_before_impl(impl));
+
+   nir_variable *var =
+      nir_local_variable_create(impl, glsl_uint_type(),
+                                "a_local_variable_with_a_long_name");
+
+   nir_push_loop(&b);
+   nir_push_if(&b, nir_ieq_imm(&b, nir_load_var(&b, var), 0));
+   nir_jump(&b, nir_jump_break);
+   nir_pop_if(&b, NULL);
+   nir_store_var(&b, var, nir_imm_int(&b, 0), 1);
+   nir_pop_loop(&b, NULL);
+
+   return nir_progress(true, impl, nir_metadata_none);
+}
+
+void
+add_return(nir_block *block)
+{
+   if (nir_block_ends_in_jump(block))
+      return;
+
+   nir_builder b = nir_builder_at(nir_after_block(block));
+   nir_jump(&b, nir_jump_return);
+}
+
+/* Ends the then branch of every if with a return, which removes the edge to
+ * the block after the if and the phi sources of that edge.  The fourth if
+ * returns from both branches, which leaves everything after it unreachable.
+ */
+bool
+add_returns(nir_function_impl *impl, void *data)
+{
+   bool progress = false;
+   unsigned num_ifs = 0;
+
+   foreach_list_typed(nir_cf_node, node, node, &impl->body) {
+      if (node->type != nir_cf_node_if)
+         continue;
+
+      nir_if *nif = nir_cf_node_as_if(node);
+      add_return(nir_if_last_then_block(nif));
+      if (++num_ifs == 4)
+         add_return(nir_if_last_else_block(nif));
+      progress = true;
+   }
+
+   return nir_progress(progress, impl, nir_metadata_none);
+}
+
+bool
+remove_dead_cf_serially(nir_shader *shader)
+{
+   bool progress = false;
+
+   nir_foreach_function_impl(impl, shader)
+      progress |= nir_opt_dead_cf_impl(impl);
+
+   return progress;
+}
+
+std::string
+print_shader(nir_shader *shader)
+{
+   char *buf = NULL;
+   size_t size = 0;
+   struct u_memstream mem;
+   if (!u_memstream_open(&mem, &buf, &size))
+      return "";
+
+   nir_print_shader(shader, u_memstream_get(&mem));
+   u_memstream_close(&mem);
+
+   std::string str(buf, size);
+   free(buf);
+   return str;
+}
+
+} /* anonymous namespace */
+
+TEST_F(nir_parallel_test, matches_serial)
+{
+   nir_test_build_functions(b->shader, 16, 64);
+   nir_validate_shader(b->shader, "after building");
+
+   nir_shader *serial = nir_shader_clone(NULL, b->shader);
+
+   EXPECT_TRUE(optimize_serially(serial));
+   EXPECT_TRUE(nir_shader_parallel_impls_pass(b->shader, optimize_impl, NULL));
+   nir_validate_shader(b->shader, "after parallel pass");
+
+   const std::string expected = print_shader(serial);
+   EXPECT_EQ(print_shader(b->shader), expected);
+
+   /* Everything allocated by the threads now belongs to the shader. */
+   nir_sweep(b->shader);
+   nir_validate_shader(b->shader, "after sweep");
+   EXPECT_EQ(print_shader(b->shader), expected);
+
+   EXPECT_FALSE(nir_shader_parallel_impls_pass(b->shader, optimize_impl, NULL));
+
+   ralloc_free(serial);
+}
+
+TEST_F(nir_parallel_test, instructions_pass)
+{
+   nir_test_build_functions(b->shader, 8, 16);
+
+   nir_shader *serial = nir_shader_clone(NULL, b->shader);
+
+   EXPECT_TRUE(nir_shader_instructions_pass(serial, fold_alu,
+                                            nir_metadata_control_flow, NULL));
+   EXPECT_TRUE(nir_shader_parallel_instructions_pass(b->shader, fold_alu,
+                                                     nir_metadata_control_flow,
+                                                     NULL));
+   nir_validate_shader(b->shader, "after parallel pass");
+
+   EXPECT_EQ(print_shader(b->shader), print_shader(serial));
+
+   ralloc_free(serial);
+}
+
+TEST_F(nir_parallel_test, control_flow_and_variables)
+{
+   nir_test_build_functions(b->shader, 8, 4);
+
+   EXPECT_TRUE(nir_shader_parallel_impls_pass(b->shader, add_control_flow,
+                                              NULL));
+   nir_validate_shader(b->shader, "after parallel pass");
+
+   nir_foreach_function_impl(impl, b->shader) {
+      EXPECT_EQ(nir_cf_node_next(&nir_start_block(impl)->cf_node)->type,
+                nir_cf_node_loop);
+
+      unsigned num_locals = 0;
+      nir_foreach_function_temp_variable(var, impl) {
+         EXPECT_STREQ(var->name, "a_local_variable_with_a_long_name");
+         num_locals++;
+      }
+      EXPECT_EQ(num_locals, 1u);
+   }
+
+   nir_sweep(b->shader);
+   nir_validate_shader(b->shader, "after sweep");
+   EXPECT_TRUE(optimize_serially(b->shader));
+}
+
+TEST_F(nir_parallel_test, remove_control_flow)
+{
+   nir_test_build_functions(b->shader, 16, 64);
+
+   nir_shader *serial = nir_shader_clone(NULL, b->shader);
+
+   bool progress = false;
+   nir_foreach_function_impl(impl, serial)
+      progress |= add_returns(impl, NULL);
+   EXPECT_TRUE(progress);
+   EXPECT_TRUE(nir_shader_parallel_impls_pass(b->shader, add_returns, NULL));
+   nir_validate_shader(b->shader, "after adding returns");
+
+   const std::string expected = print_shader(serial);
+   EXPECT_EQ(print_shader(b->shader), expected);
+
+   /* Removes the code after the returns.  The shader is big enough for
+    * nir_opt_dead_cf() to run in parallel.
+    */
+   EXPECT_TRUE(remove_dead_cf_serially(serial));
+   EXPECT_TRUE(nir_opt_dead_cf(b->shader));
+   nir_validate_shader(b->shader, "after nir_opt_dead_cf");
+
+   EXPECT_EQ(print_shader(b->shader), print_shader(serial));
+
+   nir_sweep(b->shader);
+   nir_validate_shader(b->shader, "after sweep");
+
+   ralloc_free(serial);
+}
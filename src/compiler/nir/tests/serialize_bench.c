@@ -0,0 +1,84 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Measures nir_serialize() and nir_deserialize() on a shader with many
+ * functions with control flow and phis.  Each blob is decoded serially, the
+ * way the format without sections had to be decoded, and with the sections
+ * spread over num_threads threads.  NIR_THREADS must not be set, it would
+ * override both.
+ *
+ * Usage: nir_serialize_bench [num_functions] [num_ops] [iterations]
+ *                            [num_threads]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "nir.h"
+#include "nir_builder.h"
+#include "nir_serialize.h"
+#include "nir_test_functions.h"
+#include "util/os_time.h"
+#include "util/u_cpu_detect.h"
+
+int
+main(int argc, char **argv)
+{
+   unsigned num_functions = argc > 1 ? atoi(argv[1]) : 64;
+   unsigned num_ops = argc > 2 ? atoi(argv[2]) : 512;
+   unsigned iterations = argc > 3 ? atoi(argv[3]) : 8;
+   unsigned num_threads =
+      argc > 4 ? atoi(argv[4]) : util_get_cpu_caps()->nr_cpus;
+   const nir_shader_compiler_options options = { 0 };
+   int64_t serialize_ns = 0, serial_ns = 0, parallel_ns = 0;
+   size_t size = 0;
+   int ret = 0;
+
+   glsl_type_singleton_init_or_ref();
+
+   nir_builder b =
+      nir_builder_init_simple_shader(MESA_SHADER_COMPUTE, &options, "bench");
+   nir_test_build_functions(b.shader, num_functions, num_ops);
+
+   for (unsigned i = 0; i < iterations; i++) {
+      struct blob blob;
+      blob_init(&blob);
+
+      int64_t start = os_time_get_nano();
+      nir_serialize(&blob, b.shader, true);
+      serialize_ns += os_time_get_nano() - start;
+      size = blob.size;
+
+      for (unsigned parallel = 0; parallel < 2; parallel++) {
+         struct blob_reader reader;
+         blob_reader_init(&reader, blob.data, blob.size);
+         nir_parallel_set_max_threads(parallel ? num_threads : 1);
+
+         start = os_time_get_nano();
+         nir_shader *shader = nir_deserialize(NULL, &options, &reader);
+         *(parallel ? &parallel_ns : &serial_ns) += os_time_get_nano() - start;
+
+         if (reader.overrun) {
+            fprintf(stderr, "nir_deserialize failed\n");
+            ret = 1;
+         }
+
+         ralloc_free(shader);
+      }
+
+      blob_finish(&blob);
+   }
+
+   printf("%u functions, %u ops, %zu bytes: serialize %8.2f ms, "
+          "deserialize %8.2f ms serially, %8.2f ms on %u threads\n",
+          num_functions, num_ops, size, serialize_ns / 1e6 / iterations,
+          serial_ns / 1e6 / iterations, parallel_ns / 1e6 / iterations,
+          num_threads);
+
+   ralloc_free(b.shader);
+   glsl_type_singleton_decref();
+
+   return ret;
+}
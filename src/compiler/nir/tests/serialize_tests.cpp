@@ -22,10 +22,13 @@
  */
 
 #include <gtest/gtest.h>
+#include <string>
 
 #include "nir.h"
 #include "nir_builder.h"
 #include "nir_serialize.h"
+#include "nir_test_functions.h"
+#include "util/memstream.h"
 
 namespace {
 
@@ -85,6 +88,23 @@ nir_serialize_test::serialize() {
    nir_validate_shader(b->shader, "cloned");
 }
 
+static std::string
+print_shader(nir_shader *shader)
+{
+   char *buf = NULL;
+   size_t size = 0;
+   struct u_memstream mem;
+   if (!u_memstream_open(&mem, &buf, &size))
+      return "";
+
+   nir_print_shader(shader, u_memstream_get(&mem));
+   u_memstream_close(&mem);
+
+   std::string str(buf, size);
+   free(buf);
+   return str;
+}
+
 nir_alu_instr *
 nir_serialize_test::get_last_alu(nir_shader *nir)
 {
@@ -195,3 +215,44 @@ TEST_P(nir_serialize_all_but_one_test, single_channel)
 
    ASSERT_SWIZZLE_EQ(vec_alu, vec_alu_dup, 1, 0);
 }
+
+TEST_F(nir_serialize_test, functions)
+{
+   /* Big enough for the function implementations to be decoded in
+    * parallel.
+    */
+   nir_test_build_functions(b->shader, 16, 256);
+
+   /* A local variable in every function, so that each section has variable
+    * data of its own.
+    */
+   nir_foreach_function_impl(impl, b->shader) {
+      nir_variable *local =
+         nir_local_variable_create(impl, glsl_float_type(), "local");
+      nir_builder fb = nir_builder_at(nir_before_impl(impl));
+      nir_store_var(&fb, local, nir_imm_float(&fb, 1.0f), 1);
+   }
+   nir_validate_shader(b->shader, "after building");
+
+   serialize();
+
+   EXPECT_EQ(print_shader(dup), print_shader(b->shader));
+}
+
+TEST_F(nir_serialize_test, version)
+{
+   struct blob blob;
+   struct blob_reader reader;
+
+   blob_init(&blob);
+   nir_serialize(&blob, b->shader, false);
+
+   /* The version comes first. */
+   *(uint32_t *)blob.data += 1;
+
+   blob_reader_init(&reader, blob.data, blob.size);
+   EXPECT_EQ(nir_deserialize(NULL, &options, &reader), nullptr);
+   EXPECT_TRUE(reader.overrun);
+
+   blob_finish(&blob);
+}
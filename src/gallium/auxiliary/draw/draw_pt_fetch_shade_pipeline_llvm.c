@@ -25,9 +25,12 @@
  *
  **************************************************************************/
 
+#include "c11/threads.h"
+#include "util/u_debug.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_prim.h"
+#include "util/u_queue.h"
 #include "draw/draw_context.h"
 #include "draw/draw_gs.h"
 #include "draw/draw_tess.h"
@@ -41,6 +44,31 @@
 #include "gallivm/lp_bld_debug.h"
 
 
+/*
+ * Vertex fetch/shade of big enough runs is split into jobs of at least
+ * this many vertices, which are executed on a worker pool while the
+ * calling thread shades the first one. Must be a multiple of the widest
+ * vector length, so that the padding vertices written past the end of a
+ * job don't overwrite the next one.
+ */
+#define LLVM_VS_JOB_MIN_VERTICES 128
+#define LLVM_VS_MAX_JOBS         16
+
+DEBUG_GET_ONCE_NUM_OPTION(draw_vs_threads, "DRAW_VS_THREADS", 0)
+
+struct llvm_middle_end;
+
+struct llvm_vs_job {
+   struct llvm_middle_end *fpme;
+   struct vertex_header *verts;
+   const unsigned *elts;
+   unsigned count;
+   unsigned start;
+   unsigned vertex_id_offset;
+   bool clipped;
+   struct util_queue_fence fence;
+};
+
 struct llvm_middle_end {
    struct draw_pt_middle_end base;
    struct draw_context *draw;
@@ -61,6 +89,30 @@ struct llvm_middle_end {
 };
 
 
+/* Worker pool for parallel vertex shading, shared by all the draw contexts
+ * of the process and created on first use.
+ */
+static struct util_queue vs_queue;
+static unsigned vs_num_threads;
+static once_flag vs_queue_once = ONCE_FLAG_INIT;
+
+
+static void
+llvm_vs_queue_init(void)
+{
+   /* Off unless asked for: the threads come on top of the rasterizer
+    * threads of the driver, which already use all the cores.
+    */
+   int threads = debug_get_option_draw_vs_threads();
+   threads = MIN2(threads, LLVM_VS_MAX_JOBS - 1);
+
+   if (threads > 0 &&
+       util_queue_init(&vs_queue, "draw_vs", LLVM_VS_MAX_JOBS, threads, 0,
+                       NULL))
+      vs_num_threads = threads;
+}
+
+
 /** cast wrapper */
 static inline struct llvm_middle_end *
 llvm_middle_end(struct draw_pt_middle_end *middle)
@@ -465,6 +517,110 @@ llvm_middle_end_bind_parameters(struct draw_pt_middle_end *middle)
 }
 
 
+static void
+llvm_vs_job_run(struct llvm_vs_job *job)
+{
+   struct llvm_middle_end *fpme = job->fpme;
+   struct draw_context *draw = fpme->draw;
+
+   job->clipped =
+      fpme->current_variant->jit_func(&fpme->llvm->vs_jit_context,
+                                      &fpme->llvm->jit_resources[MESA_SHADER_VERTEX],
+                                      job->verts,
+                                      draw->pt.user.vbuffer,
+                                      job->count,
+                                      job->start,
+                                      fpme->vertex_size,
+                                      draw->pt.vertex_buffer,
+                                      draw->instance_id,
+                                      job->vertex_id_offset,
+                                      draw->start_instance,
+                                      job->elts,
+                                      draw->pt.user.drawid,
+                                      draw->pt.user.viewid);
+}
+
+
+static void
+llvm_vs_job_execute(void *data, void *gdata, int thread_index)
+{
+   llvm_vs_job_run((struct llvm_vs_job *)data);
+}
+
+
+/**
+ * Run the vertex fetch shader over 'count' vertices, splitting the work
+ * between the calling thread and the worker pool when there are enough
+ * vertices. Each job shades a contiguous range of the output vertices, so
+ * the result is identical to a single call.
+ */
+static bool
+llvm_middle_end_run_vs(struct llvm_middle_end *fpme,
+                       struct vertex_header *verts,
+                       unsigned count,
+                       unsigned start,
+                       unsigned vertex_id_offset,
+                       const unsigned *elts)
+{
+   struct llvm_vs_job jobs[LLVM_VS_MAX_JOBS];
+   unsigned num_jobs = 1;
+
+   if (count >= 2 * LLVM_VS_JOB_MIN_VERTICES) {
+      call_once(&vs_queue_once, llvm_vs_queue_init);
+      num_jobs = MIN3(count / LLVM_VS_JOB_MIN_VERTICES, vs_num_threads + 1,
+                      LLVM_VS_MAX_JOBS);
+   }
+
+   if (num_jobs <= 1) {
+      jobs[0] = (struct llvm_vs_job) {
+         .fpme = fpme,
+         .verts = verts,
+         .elts = elts,
+         .count = count,
+         .start = start,
+         .vertex_id_offset = vertex_id_offset,
+      };
+      llvm_vs_job_run(&jobs[0]);
+      return jobs[0].clipped;
+   }
+
+   unsigned job_size = align(DIV_ROUND_UP(count, num_jobs),
+                             LLVM_VS_JOB_MIN_VERTICES);
+   num_jobs = DIV_ROUND_UP(count, job_size);
+
+   for (unsigned i = 0; i < num_jobs; i++) {
+      unsigned first = i * job_size;
+
+      jobs[i] = (struct llvm_vs_job) {
+         .fpme = fpme,
+         .verts = (struct vertex_header *)
+            ((uint8_t *)verts + first * fpme->vertex_size),
+         .elts = elts ? elts + first : NULL,
+         .count = MIN2(job_size, count - first),
+         .start = elts ? start : start + first,
+         .vertex_id_offset = vertex_id_offset,
+      };
+
+      if (i > 0) {
+         util_queue_fence_init(&jobs[i].fence);
+         util_queue_add_job(&vs_queue, &jobs[i], &jobs[i].fence,
+                            llvm_vs_job_execute, NULL, 0);
+      }
+   }
+
+   llvm_vs_job_run(&jobs[0]);
+
+   bool clipped = jobs[0].clipped;
+   for (unsigned i = 1; i < num_jobs; i++) {
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+      clipped |= jobs[i].clipped;
+   }
+
+   return clipped;
+}
+
+
 static void
 pipeline(struct llvm_middle_end *llvm,
          const struct draw_vertex_info *vert_info,
@@ -553,20 +709,9 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
          elts = fetch_info->elts;
       }
       /* Run vertex fetch shader */
-      clipped = fpme->current_variant->jit_func(&fpme->llvm->vs_jit_context,
-                                                &fpme->llvm->jit_resources[MESA_SHADER_VERTEX],
-                                                llvm_vert_info.verts,
-                                                draw->pt.user.vbuffer,
-                                                fetch_info->count,
-                                                start,
-                                                fpme->vertex_size,
-                                                draw->pt.vertex_buffer,
-                                                draw->instance_id,
-                                                vertex_id_offset,
-                                                draw->start_instance,
-                                                elts,
-                                                draw->pt.user.drawid,
-                                                draw->pt.user.viewid);
+      clipped = llvm_middle_end_run_vs(fpme, llvm_vert_info.verts,
+                                       fetch_info->count, start,
+                                       vertex_id_offset, elts);
 
       /* Finished with fetch and vs */
       fetch_info = NULL;
@@ -26,26 +26,75 @@
  **************************************************************************/
 
 
+#include "util/format/u_format.h"
+
 #include "lp_bld_format.h"
 
+
+/**
+ * Whether fetches from the given format can go through the block cache.
+ *
+ * This covers every block compressed format with 4x4 blocks which decodes
+ * to at most 8 bits per channel: S3TC and RGTC (decoded in generated code),
+ * plus BPTC unorm/srgb and ETC1 (decoded with the util_format unpack
+ * functions).  sRGB formats are cached in their encoded form, conversion
+ * happens after the lookup.
+ */
+bool
+lp_build_format_cache_supported(const struct util_format_description *format_desc)
+{
+   if (format_desc->block.width != 4 || format_desc->block.height != 4 ||
+       (format_desc->block.bits != 64 && format_desc->block.bits != 128))
+      return false;
+
+   switch (format_desc->layout) {
+   case UTIL_FORMAT_LAYOUT_S3TC:
+   case UTIL_FORMAT_LAYOUT_RGTC:
+      return true;
+   case UTIL_FORMAT_LAYOUT_BPTC:
+   case UTIL_FORMAT_LAYOUT_ETC: {
+      const struct util_format_description *linear_desc =
+         util_format_description(util_format_linear(format_desc->format));
+      const struct util_format_unpack_description *unpack =
+         util_format_unpack_description(linear_desc->format);
+      return util_format_fits_8unorm(linear_desc) &&
+             unpack && unpack->unpack_rgba_8unorm_rect;
+   }
+   default:
+      return false;
+   }
+}
+
 LLVMTypeRef lp_build_format_cache_elem_type(struct gallivm_state *gallivm, enum cache_member member) {
-   assert(member == LP_BUILD_FORMAT_CACHE_MEMBER_DATA || member == LP_BUILD_FORMAT_CACHE_MEMBER_TAGS);
    switch (member) {
    case LP_BUILD_FORMAT_CACHE_MEMBER_DATA:
       return LLVMInt32TypeInContext(gallivm->context);
    case LP_BUILD_FORMAT_CACHE_MEMBER_TAGS:
       return LLVMInt64TypeInContext(gallivm->context);
+   case LP_BUILD_FORMAT_CACHE_MEMBER_VICTIM:
+      return LLVMInt8TypeInContext(gallivm->context);
    default:
       UNREACHABLE("lp_build_format_cache_elem_type unhandled member type");
    }
 }
 
 LLVMTypeRef lp_build_format_cache_member_type(struct gallivm_state *gallivm, enum cache_member member) {
-   assert(member == LP_BUILD_FORMAT_CACHE_MEMBER_DATA || member == LP_BUILD_FORMAT_CACHE_MEMBER_TAGS);
-   unsigned elem_count =
-         member == LP_BUILD_FORMAT_CACHE_MEMBER_DATA ? LP_BUILD_FORMAT_CACHE_SIZE * 16 :
-         member == LP_BUILD_FORMAT_CACHE_MEMBER_TAGS ? LP_BUILD_FORMAT_CACHE_SIZE : 0;
-   return LLVMArrayType(lp_build_format_cache_elem_type(gallivm, member), elem_count);
+   switch (member) {
+   case LP_BUILD_FORMAT_CACHE_MEMBER_DATA:
+      return LLVMArrayType(lp_build_format_cache_elem_type(gallivm, member),
+                           LP_BUILD_FORMAT_CACHE_SIZE * 16);
+   case LP_BUILD_FORMAT_CACHE_MEMBER_TAGS:
+      return LLVMArrayType(lp_build_format_cache_elem_type(gallivm, member),
+                           LP_BUILD_FORMAT_CACHE_SIZE);
+   case LP_BUILD_FORMAT_CACHE_MEMBER_VICTIM:
+      return LLVMArrayType(lp_build_format_cache_elem_type(gallivm, member),
+                           LP_BUILD_FORMAT_CACHE_SETS);
+   case LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL:
+   case LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS:
+      return LLVMInt64TypeInContext(gallivm->context);
+   default:
+      UNREACHABLE("lp_build_format_cache_member_type unhandled member type");
+   }
 }
 
 LLVMTypeRef
@@ -54,18 +103,8 @@ lp_build_format_cache_type(struct gallivm_state *gallivm)
    LLVMTypeRef elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_COUNT];
    LLVMTypeRef s;
 
-   int members[] = {LP_BUILD_FORMAT_CACHE_MEMBER_DATA, LP_BUILD_FORMAT_CACHE_MEMBER_TAGS};
-   for (int i = 0; i < ARRAY_SIZE(members); ++i) {
-      int member = members[i];
+   for (int member = 0; member < LP_BUILD_FORMAT_CACHE_MEMBER_COUNT; ++member)
       elem_types[member] = lp_build_format_cache_member_type(gallivm, member);
-   }
-
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-   elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL] =
-         LLVMInt64TypeInContext(gallivm->context);
-   elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS] =
-         LLVMInt64TypeInContext(gallivm->context);
-#endif
 
    s = LLVMStructTypeInContext(gallivm->context, elem_types,
                                LP_BUILD_FORMAT_CACHE_MEMBER_COUNT, 0);
@@ -34,6 +34,8 @@
  * Pixel format helpers.
  */
 
+#include <string.h>
+
 #include "gallivm/lp_bld_init.h"
 #include "util/macros.h"
 
@@ -42,15 +44,38 @@ struct lp_type;
 struct lp_build_context;
 
 
-#define LP_BUILD_FORMAT_CACHE_DEBUG 0
 /*
  * Block cache
  *
- * Optional block cache to be used when unpacking big pixel blocks.
- * Must be a power of 2
+ * Optional per-thread cache of decoded 4x4 texel blocks, used when fetching
+ * from compressed formats (see lp_build_format_cache_supported()).  Each
+ * entry holds one block unpacked to RGBA8, column-major ([i][j]), and is
+ * tagged with the address of the compressed block and the format it was
+ * decoded with (in bits 48 and up, so different views of the same data
+ * don't alias).
+ *
+ * The cache is LP_BUILD_FORMAT_CACHE_WAYS-way set associative with
+ * round-robin replacement within a set.  Both values must be powers of two
+ * and can be overridden at build time.
  */
+#ifndef LP_BUILD_FORMAT_CACHE_SIZE
+#define LP_BUILD_FORMAT_CACHE_SIZE 256
+#endif
 
-#define LP_BUILD_FORMAT_CACHE_SIZE 128
+#ifndef LP_BUILD_FORMAT_CACHE_WAYS
+#define LP_BUILD_FORMAT_CACHE_WAYS 2
+#endif
+
+#define LP_BUILD_FORMAT_CACHE_SETS \
+   (LP_BUILD_FORMAT_CACHE_SIZE / LP_BUILD_FORMAT_CACHE_WAYS)
+
+/*
+ * Whether the generated code counts cache accesses and misses.  The counters
+ * are always present in the structure, but only updated when this is set.
+ */
+#ifndef LP_BUILD_FORMAT_CACHE_STATS
+#define LP_BUILD_FORMAT_CACHE_STATS MESA_DEBUG
+#endif
 
 /*
  * Note: cache_data needs 16 byte alignment.
@@ -59,24 +84,51 @@ struct lp_build_format_cache
 {
    alignas(16) uint32_t cache_data[LP_BUILD_FORMAT_CACHE_SIZE][4][4];
    uint64_t cache_tags[LP_BUILD_FORMAT_CACHE_SIZE];
-#if LP_BUILD_FORMAT_CACHE_DEBUG
+   /** next way to replace, per set */
+   uint8_t cache_victim[LP_BUILD_FORMAT_CACHE_SETS];
    uint64_t cache_access_total;
    uint64_t cache_access_miss;
-#endif
+
+   /*
+    * Not accessed by generated code.  Owners use this to remember which
+    * resource generation the cached blocks belong to, see
+    * lp_build_format_cache_validate().
+    */
+   unsigned generation;
 };
 
 
 enum cache_member {
    LP_BUILD_FORMAT_CACHE_MEMBER_DATA = 0,
    LP_BUILD_FORMAT_CACHE_MEMBER_TAGS,
-#if LP_BUILD_FORMAT_CACHE_DEBUG
+   LP_BUILD_FORMAT_CACHE_MEMBER_VICTIM,
    LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL,
    LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS,
-#endif
    LP_BUILD_FORMAT_CACHE_MEMBER_COUNT
 };
 
 
+/**
+ * Drop all cached blocks if the cache was last filled under a different
+ * generation.  Cheaper than clearing unconditionally, and allows the cache
+ * to stay warm across scenes and dispatches as long as no compressed
+ * texture was modified or released in between.
+ */
+static inline void
+lp_build_format_cache_validate(struct lp_build_format_cache *cache,
+                               unsigned generation)
+{
+   if (cache->generation != generation) {
+      memset(cache->cache_tags, 0, sizeof(cache->cache_tags));
+      memset(cache->cache_victim, 0, sizeof(cache->cache_victim));
+      cache->generation = generation;
+   }
+}
+
+
+bool
+lp_build_format_cache_supported(const struct util_format_description *format_desc);
+
 LLVMTypeRef
 lp_build_format_cache_type(struct gallivm_state *gallivm);
 
@@ -192,6 +244,20 @@ lp_build_fetch_s3tc_rgba_aos(struct gallivm_state *gallivm,
                              LLVMValueRef j,
                              LLVMValueRef cache);
 
+/**
+ * Fetch texels of any format accepted by lp_build_format_cache_supported()
+ * through the block cache, decoding whole blocks on a miss.
+ */
+LLVMValueRef
+lp_build_fetch_cached_rgba_aos(struct gallivm_state *gallivm,
+                               const struct util_format_description *format_desc,
+                               unsigned n,
+                               LLVMValueRef base_ptr,
+                               LLVMValueRef offset,
+                               LLVMValueRef i,
+                               LLVMValueRef j,
+                               LLVMValueRef cache);
+
 /*
  * RGTC
  */
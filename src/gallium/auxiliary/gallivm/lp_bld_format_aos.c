@@ -784,6 +784,26 @@ lp_build_fetch_rgba_aos(struct gallivm_state *gallivm,
        return tmp;
    }
 
+   /*
+    * Other compressed formats (bptc, etc1) through the block cache, which
+    * decodes whole blocks with util_format_description::unpack_rgba_8unorm().
+    * sRGB variants are fetched through their linear format by the SoA path.
+    */
+
+   if (cache && lp_build_format_cache_supported(format_desc) &&
+       format_desc->colorspace != UTIL_FORMAT_COLORSPACE_SRGB &&
+       !type.floating && type.width == 8 && !type.sign && type.norm) {
+      LLVMValueRef tmp = lp_build_fetch_cached_rgba_aos(gallivm,
+                                                        format_desc,
+                                                        num_pixels,
+                                                        base_ptr,
+                                                        offset,
+                                                        i, j,
+                                                        cache);
+
+      return LLVMBuildBitCast(builder, tmp, bld.vec_type, "");
+   }
+
    /*
     * Fallback to util_format_description::fetch_rgba_8unorm().
     */
@@ -39,6 +39,7 @@
 #include "util/format/u_format.h"
 #include "util/u_math.h"
 #include "util/u_cpu_detect.h"
+#include "util/u_pointer.h"
 
 #include "lp_bld_arit.h"
 #include "lp_bld_type.h"
@@ -53,6 +54,8 @@
 #include "lp_bld_init.h"
 #include "lp_bld_debug.h"
 #include "lp_bld_intr.h"
+#include "lp_bld_misc.h"
+#include "lp_bld_struct.h"
 
 
 /**
@@ -1105,79 +1108,84 @@ lp_build_gather_s3tc_simple_scalar(struct gallivm_state *gallivm,
 }
 
 
+/**
+ * Tag of a compressed block in the block cache.  The format goes into the
+ * upper bits, above the 48 bits of user space addresses, so that the same
+ * memory viewed with another format (e.g. signed vs. unsigned or sRGB vs.
+ * linear views) doesn't hit blocks decoded for a different one.
+ */
+static LLVMValueRef
+cache_block_tag(struct gallivm_state *gallivm,
+                const struct util_format_description *format_desc,
+                LLVMValueRef addr)
+{
+   LLVMTypeRef i64t = LLVMInt64TypeInContext(gallivm->context);
+
+   return LLVMBuildOr(gallivm->builder, addr,
+                      LLVMConstInt(i64t, (uint64_t)format_desc->format << 48, 0),
+                      "");
+}
+
+
+static LLVMValueRef
+cache_member_ptr(struct gallivm_state *gallivm, LLVMValueRef cache,
+                 enum cache_member member, LLVMValueRef index)
+{
+   LLVMValueRef indices[3];
+
+   indices[0] = lp_build_const_int32(gallivm, 0);
+   indices[1] = lp_build_const_int32(gallivm, member);
+   indices[2] = index;
+
+   return LLVMBuildGEP2(gallivm->builder, lp_build_format_cache_type(gallivm),
+                        cache, indices, ARRAY_SIZE(indices), "cache_gep");
+}
+
+
 static void
-s3tc_store_cached_block(struct gallivm_state *gallivm,
-                        LLVMValueRef *col,
-                        LLVMValueRef tag_value,
-                        LLVMValueRef hash_index,
-                        LLVMValueRef cache)
+cache_store_block(struct gallivm_state *gallivm,
+                  LLVMValueRef *col,
+                  LLVMValueRef tag_value,
+                  LLVMValueRef slot,
+                  LLVMValueRef cache)
 {
    LLVMBuilderRef builder = gallivm->builder;
-   LLVMValueRef ptr, indices[3];
-   LLVMTypeRef type_ptr4x32;
+   LLVMValueRef ptr, index;
    unsigned count;
 
-   type_ptr4x32 = LLVMPointerType(LLVMVectorType(LLVMInt32TypeInContext(gallivm->context), 4), 0);
-   indices[0] = lp_build_const_int32(gallivm, 0);
-   indices[1] = lp_build_const_int32(gallivm, LP_BUILD_FORMAT_CACHE_MEMBER_TAGS);
-   indices[2] = hash_index;
-   LLVMTypeRef cache_type = lp_build_format_cache_type(gallivm);
-   ptr = LLVMBuildGEP2(builder, cache_type, cache, indices, ARRAY_SIZE(indices), "");
+   ptr = cache_member_ptr(gallivm, cache, LP_BUILD_FORMAT_CACHE_MEMBER_TAGS, slot);
    LLVMBuildStore(builder, tag_value, ptr);
 
-   indices[1] = lp_build_const_int32(gallivm, LP_BUILD_FORMAT_CACHE_MEMBER_DATA);
-   hash_index = LLVMBuildMul(builder, hash_index, lp_build_const_int32(gallivm, 16), "");
+   index = LLVMBuildMul(builder, slot, lp_build_const_int32(gallivm, 16), "");
    for (count = 0; count < 4; count++) {
-      indices[2] = hash_index;
-      ptr = LLVMBuildGEP2(builder, cache_type, cache, indices, ARRAY_SIZE(indices), "");
-      ptr = LLVMBuildBitCast(builder, ptr, type_ptr4x32, "");
+      ptr = cache_member_ptr(gallivm, cache, LP_BUILD_FORMAT_CACHE_MEMBER_DATA, index);
       LLVMBuildStore(builder, col[count], ptr);
-      hash_index = LLVMBuildAdd(builder, hash_index, lp_build_const_int32(gallivm, 4), "");
+      index = LLVMBuildAdd(builder, index, lp_build_const_int32(gallivm, 4), "");
    }
 }
 
 static LLVMValueRef
 lookup_cache_member(struct gallivm_state *gallivm, LLVMValueRef cache, enum cache_member member, LLVMValueRef index) {
-   assert(member == LP_BUILD_FORMAT_CACHE_MEMBER_DATA || member == LP_BUILD_FORMAT_CACHE_MEMBER_TAGS);
-   LLVMBuilderRef builder = gallivm->builder;
-   LLVMValueRef member_ptr, indices[3];
-
-   indices[0] = lp_build_const_int32(gallivm, 0);
-   indices[1] = lp_build_const_int32(gallivm, member);
-   indices[2] = index;
+   assert(member == LP_BUILD_FORMAT_CACHE_MEMBER_DATA ||
+          member == LP_BUILD_FORMAT_CACHE_MEMBER_TAGS ||
+          member == LP_BUILD_FORMAT_CACHE_MEMBER_VICTIM);
+   LLVMValueRef member_ptr;
 
    const char *name =
          member == LP_BUILD_FORMAT_CACHE_MEMBER_DATA ? "cache_data" :
-         member == LP_BUILD_FORMAT_CACHE_MEMBER_TAGS ? "tag_data" : "";
+         member == LP_BUILD_FORMAT_CACHE_MEMBER_TAGS ? "tag_data" : "victim";
 
-   member_ptr = LLVMBuildGEP2(builder, lp_build_format_cache_type(gallivm),
-                              cache, indices, ARRAY_SIZE(indices), "cache_gep");
+   member_ptr = cache_member_ptr(gallivm, cache, member, index);
 
-   return LLVMBuildLoad2(builder, lp_build_format_cache_elem_type(gallivm, member), member_ptr, name);
-}
-
-static LLVMValueRef
-s3tc_lookup_cached_pixel(struct gallivm_state *gallivm,
-                         LLVMValueRef cache,
-                         LLVMValueRef index)
-{
-   return lookup_cache_member(gallivm, cache, LP_BUILD_FORMAT_CACHE_MEMBER_DATA, index);
-}
-
-static LLVMValueRef
-s3tc_lookup_tag_data(struct gallivm_state *gallivm,
-                     LLVMValueRef cache,
-                     LLVMValueRef index)
-{
-   return lookup_cache_member(gallivm, cache, LP_BUILD_FORMAT_CACHE_MEMBER_TAGS, index);
+   return LLVMBuildLoad2(gallivm->builder, lp_build_format_cache_elem_type(gallivm, member), member_ptr, name);
 }
 
-#if LP_BUILD_FORMAT_CACHE_DEBUG
+#if LP_BUILD_FORMAT_CACHE_STATS
 static void
-s3tc_update_cache_access(struct gallivm_state *gallivm,
-                         LLVMValueRef ptr,
-                         unsigned count,
-                         unsigned index)
+cache_update_access(struct gallivm_state *gallivm,
+                    LLVMValueRef ptr,
+                    unsigned count,
+                    unsigned index)
 {
    LLVMBuilderRef builder = gallivm->builder;
    LLVMValueRef member_ptr, cache_access;
@@ -1898,6 +1906,119 @@ s3tc_decode_block_dxt5(struct gallivm_state *gallivm,
 }
 
 
+/**
+ * Split 16 texels in column-major order into the four <4 x i32> columns
+ * stored per cache entry.
+ */
+static void
+cache_split_columns(struct gallivm_state *gallivm,
+                    LLVMValueRef texels,
+                    LLVMValueRef *col)
+{
+   LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
+   unsigned count;
+
+   texels = LLVMBuildBitCast(gallivm->builder, texels,
+                             LLVMVectorType(i32t, 16), "");
+   for (count = 0; count < 4; count++)
+      col[count] = lp_build_extract_range(gallivm, texels, count * 4, 4);
+}
+
+
+/**
+ * Decode a whole RGTC block by fetching all of its texels with the regular
+ * (uncached) code path.
+ */
+static void
+rgtc_decode_block(struct gallivm_state *gallivm,
+                  const struct util_format_description *format_desc,
+                  LLVMValueRef ptr_addr,
+                  LLVMValueRef *col)
+{
+   LLVMValueRef i_elems[16], j_elems[16];
+   struct lp_type type32;
+   LLVMValueRef rgba;
+   unsigned k;
+
+   memset(&type32, 0, sizeof type32);
+   type32.width = 32;
+   type32.length = 16;
+
+   for (k = 0; k < 16; k++) {
+      i_elems[k] = lp_build_const_int32(gallivm, k / 4);
+      j_elems[k] = lp_build_const_int32(gallivm, k % 4);
+   }
+
+   rgba = lp_build_fetch_rgtc_rgba_aos(gallivm, format_desc, 16, ptr_addr,
+                                       lp_build_const_int_vec(gallivm, type32, 0),
+                                       LLVMConstVector(i_elems, 16),
+                                       LLVMConstVector(j_elems, 16),
+                                       NULL);
+   cache_split_columns(gallivm, rgba, col);
+}
+
+
+/**
+ * Decode a whole block by calling util_format's unpack_rgba_8unorm_rect().
+ * This is what makes caching worthwhile for formats like BPTC where decoding
+ * a single texel costs nearly as much as decoding the whole block.
+ */
+static void
+unpack_decode_block(struct gallivm_state *gallivm,
+                    const struct util_format_description *format_desc,
+                    LLVMValueRef ptr_addr,
+                    LLVMValueRef *col)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   const struct util_format_unpack_description *unpack =
+      util_format_unpack_description(util_format_linear(format_desc->format));
+   LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
+   LLVMTypeRef pi8t = LLVMPointerType(i8t, 0);
+   LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
+   LLVMTypeRef block_type = LLVMVectorType(i32t, 16);
+   LLVMValueRef function, tmp_ptr, texels, args[6], shuffles[16];
+   unsigned k;
+
+   assert(unpack && unpack->unpack_rgba_8unorm_rect);
+
+   /*
+    * Function to call looks like:
+    *   unpack(uint8_t *dst, unsigned dst_stride,
+    *          const uint8_t *src, unsigned src_stride,
+    *          unsigned width, unsigned height)
+    */
+   LLVMTypeRef arg_types[6] = { pi8t, i32t, pi8t, i32t, i32t, i32t };
+   LLVMTypeRef function_type =
+      LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context),
+                       arg_types, ARRAY_SIZE(arg_types), 0);
+
+   if (gallivm->cache)
+      gallivm->cache->dont_cache = true;
+   function = lp_build_const_func_pointer_from_type(gallivm,
+                                                    func_to_pointer((func_pointer) unpack->unpack_rgba_8unorm_rect),
+                                                    function_type,
+                                                    format_desc->short_name);
+
+   tmp_ptr = lp_build_alloca(gallivm, block_type, "block");
+
+   args[0] = LLVMBuildBitCast(builder, tmp_ptr, pi8t, "");
+   args[1] = lp_build_const_int32(gallivm, 4 * 4);
+   args[2] = ptr_addr;
+   args[3] = lp_build_const_int32(gallivm, format_desc->block.bits / 8);
+   args[4] = lp_build_const_int32(gallivm, 4);
+   args[5] = lp_build_const_int32(gallivm, 4);
+   LLVMBuildCall2(builder, function_type, function, args, ARRAY_SIZE(args), "");
+
+   /* The unpacked block is row-major, cache entries are column-major. */
+   texels = LLVMBuildLoad2(builder, block_type, tmp_ptr, "");
+   for (k = 0; k < 16; k++)
+      shuffles[k] = lp_build_const_int32(gallivm, (k % 4) * 4 + k / 4);
+   texels = LLVMBuildShuffleVector(builder, texels, LLVMGetUndef(block_type),
+                                   LLVMConstVector(shuffles, 16), "");
+   cache_split_columns(gallivm, texels, col);
+}
+
+
 static void
 generate_update_cache_one_block(struct gallivm_state *gallivm,
                                 LLVMValueRef function,
@@ -1906,17 +2027,17 @@ generate_update_cache_one_block(struct gallivm_state *gallivm,
    LLVMBasicBlockRef block;
    LLVMBuilderRef old_builder;
    LLVMValueRef ptr_addr;
-   LLVMValueRef hash_index;
+   LLVMValueRef slot;
    LLVMValueRef cache;
    LLVMValueRef dxt_block, tag_value;
    LLVMValueRef col[LP_MAX_VECTOR_LENGTH];
 
    ptr_addr     = LLVMGetParam(function, 0);
-   hash_index   = LLVMGetParam(function, 1);
+   slot         = LLVMGetParam(function, 1);
    cache        = LLVMGetParam(function, 2);
 
    lp_build_name(ptr_addr,   "ptr_addr"  );
-   lp_build_name(hash_index, "hash_index");
+   lp_build_name(slot,       "slot"      );
    lp_build_name(cache,      "cache_addr");
 
    /*
@@ -1928,33 +2049,44 @@ generate_update_cache_one_block(struct gallivm_state *gallivm,
    gallivm->builder = LLVMCreateBuilderInContext(gallivm->context);
    LLVMPositionBuilderAtEnd(gallivm->builder, block);
 
-   lp_build_gather_s3tc_simple_scalar(gallivm, format_desc, &dxt_block,
-                                      ptr_addr);
+   switch (format_desc->layout) {
+   case UTIL_FORMAT_LAYOUT_S3TC:
+      lp_build_gather_s3tc_simple_scalar(gallivm, format_desc, &dxt_block,
+                                         ptr_addr);
 
-   switch (format_desc->format) {
-   case PIPE_FORMAT_DXT1_RGB:
-   case PIPE_FORMAT_DXT1_RGBA:
-   case PIPE_FORMAT_DXT1_SRGB:
-   case PIPE_FORMAT_DXT1_SRGBA:
-      s3tc_decode_block_dxt1(gallivm, format_desc->format, dxt_block, col);
-      break;
-   case PIPE_FORMAT_DXT3_RGBA:
-   case PIPE_FORMAT_DXT3_SRGBA:
-      s3tc_decode_block_dxt3(gallivm, format_desc->format, dxt_block, col);
+      switch (format_desc->format) {
+      case PIPE_FORMAT_DXT1_RGB:
+      case PIPE_FORMAT_DXT1_RGBA:
+      case PIPE_FORMAT_DXT1_SRGB:
+      case PIPE_FORMAT_DXT1_SRGBA:
+         s3tc_decode_block_dxt1(gallivm, format_desc->format, dxt_block, col);
+         break;
+      case PIPE_FORMAT_DXT3_RGBA:
+      case PIPE_FORMAT_DXT3_SRGBA:
+         s3tc_decode_block_dxt3(gallivm, format_desc->format, dxt_block, col);
+         break;
+      case PIPE_FORMAT_DXT5_RGBA:
+      case PIPE_FORMAT_DXT5_SRGBA:
+         s3tc_decode_block_dxt5(gallivm, format_desc->format, dxt_block, col);
+         break;
+      default:
+         assert(0);
+         s3tc_decode_block_dxt1(gallivm, format_desc->format, dxt_block, col);
+         break;
+      }
       break;
-   case PIPE_FORMAT_DXT5_RGBA:
-   case PIPE_FORMAT_DXT5_SRGBA:
-      s3tc_decode_block_dxt5(gallivm, format_desc->format, dxt_block, col);
+   case UTIL_FORMAT_LAYOUT_RGTC:
+      rgtc_decode_block(gallivm, format_desc, ptr_addr, col);
       break;
    default:
-      assert(0);
-      s3tc_decode_block_dxt1(gallivm, format_desc->format, dxt_block, col);
+      unpack_decode_block(gallivm, format_desc, ptr_addr, col);
       break;
    }
 
    tag_value = LLVMBuildPtrToInt(gallivm->builder, ptr_addr,
                                  LLVMInt64TypeInContext(gallivm->context), "");
-   s3tc_store_cached_block(gallivm, col, tag_value, hash_index, cache);
+   tag_value = cache_block_tag(gallivm, format_desc, tag_value);
+   cache_store_block(gallivm, col, tag_value, slot, cache);
 
    LLVMBuildRetVoid(gallivm->builder);
 
@@ -1969,7 +2101,7 @@ static void
 update_cached_block(struct gallivm_state *gallivm,
                     const struct util_format_description *format_desc,
                     LLVMValueRef ptr_addr,
-                    LLVMValueRef hash_index,
+                    LLVMValueRef slot,
                     LLVMValueRef cache)
 
 {
@@ -2006,7 +2138,7 @@ update_cached_block(struct gallivm_state *gallivm,
    }
 
    args[0] = ptr_addr;
-   args[1] = hash_index;
+   args[1] = slot;
    args[2] = cache;
 
    LLVMBuildCall2(builder, function_type, function, args, ARRAY_SIZE(args), "");
@@ -2015,29 +2147,108 @@ update_cached_block(struct gallivm_state *gallivm,
    LLVMSetInstructionCallConv(inst, LLVMFastCallConv);
 }
 
+
+/**
+ * Find the cache entry holding the block at addr within the given set,
+ * decoding the block into the set's next victim way on a miss.
+ * Returns the (scalar) index of the entry.
+ */
+static LLVMValueRef
+cache_lookup_block(struct gallivm_state *gallivm,
+                   const struct util_format_description *format_desc,
+                   LLVMValueRef cache,
+                   LLVMValueRef set,
+                   LLVMValueRef addr)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
+   LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
+   LLVMValueRef tag, first, slot, slot_ptr, hit;
+   struct lp_build_if_state if_ctx;
+   unsigned way;
+
+   tag = cache_block_tag(gallivm, format_desc, addr);
+   first = LLVMBuildMul(builder, set,
+                        lp_build_const_int32(gallivm, LP_BUILD_FORMAT_CACHE_WAYS), "");
+
+   /* compare against all ways of the set */
+   slot = first;
+   hit = LLVMConstInt(LLVMInt1TypeInContext(gallivm->context), 0, 0);
+   for (way = 0; way < LP_BUILD_FORMAT_CACHE_WAYS; way++) {
+      LLVMValueRef index, tag_stored, match;
+
+      index = LLVMBuildAdd(builder, first, lp_build_const_int32(gallivm, way), "");
+      tag_stored = lookup_cache_member(gallivm, cache,
+                                       LP_BUILD_FORMAT_CACHE_MEMBER_TAGS, index);
+      match = LLVMBuildICmp(builder, LLVMIntEQ, tag_stored, tag, "");
+      hit = LLVMBuildOr(builder, hit, match, "");
+      slot = LLVMBuildSelect(builder, match, index, slot, "");
+   }
+
+   slot_ptr = lp_build_alloca(gallivm, i32t, "cache_slot");
+   LLVMBuildStore(builder, slot, slot_ptr);
+
+   lp_build_if(&if_ctx, gallivm, LLVMBuildNot(builder, hit, ""));
+   {
+      LLVMValueRef victim = first;
+
+      if (LP_BUILD_FORMAT_CACHE_WAYS > 1) {
+         /* round-robin replacement */
+         LLVMValueRef victim_ptr, next;
+
+         victim_ptr = cache_member_ptr(gallivm, cache,
+                                       LP_BUILD_FORMAT_CACHE_MEMBER_VICTIM, set);
+         victim = LLVMBuildLoad2(builder, i8t, victim_ptr, "victim");
+         next = LLVMBuildAdd(builder, victim, LLVMConstInt(i8t, 1, 0), "");
+         next = LLVMBuildAnd(builder, next,
+                             LLVMConstInt(i8t, LP_BUILD_FORMAT_CACHE_WAYS - 1, 0), "");
+         LLVMBuildStore(builder, next, victim_ptr);
+         victim = LLVMBuildZExt(builder, victim, i32t, "");
+         victim = LLVMBuildAdd(builder, first, victim, "");
+      }
+
+      update_cached_block(gallivm, format_desc,
+                          LLVMBuildIntToPtr(builder, addr,
+                                            LLVMPointerType(i8t, 0), ""),
+                          victim, cache);
+      LLVMBuildStore(builder, victim, slot_ptr);
+#if LP_BUILD_FORMAT_CACHE_STATS
+      cache_update_access(gallivm, cache, 1,
+                          LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS);
+#endif
+   }
+   lp_build_endif(&if_ctx);
+
+   return LLVMBuildLoad2(builder, i32t, slot_ptr, "");
+}
+
+
 /*
  * cached lookup
  */
-static LLVMValueRef
-compressed_fetch_cached(struct gallivm_state *gallivm,
-                        const struct util_format_description *format_desc,
-                        unsigned n,
-                        LLVMValueRef base_ptr,
-                        LLVMValueRef offset,
-                        LLVMValueRef i,
-                        LLVMValueRef j,
-                        LLVMValueRef cache)
+LLVMValueRef
+lp_build_fetch_cached_rgba_aos(struct gallivm_state *gallivm,
+                               const struct util_format_description *format_desc,
+                               unsigned n,
+                               LLVMValueRef base_ptr,
+                               LLVMValueRef offset,
+                               LLVMValueRef i,
+                               LLVMValueRef j,
+                               LLVMValueRef cache)
 
 {
    LLVMBuilderRef builder = gallivm->builder;
    unsigned count, low_bit, log2size;
-   LLVMValueRef color, offset_stored, addr, ptr_addrtrunc, tmp;
-   LLVMValueRef ij_index, hash_index, hash_mask, block_index;
+   LLVMValueRef color, addr, ptr_addrtrunc, tmp;
+   LLVMValueRef ij_index, hash_index, hash_mask;
    LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
    LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
    LLVMTypeRef i64t = LLVMInt64TypeInContext(gallivm->context);
    struct lp_type type;
    struct lp_build_context bld32;
+
+   assert(lp_build_format_cache_supported(format_desc));
+
    memset(&type, 0, sizeof type);
    type.width = 32;
    type.length = n;
@@ -2045,17 +2256,17 @@ compressed_fetch_cached(struct gallivm_state *gallivm,
    lp_build_context_init(&bld32, gallivm, type);
 
    /*
-    * compute hash - we use direct mapped cache, the hash function could
+    * compute hash (selecting the set) - the hash function could
     *                be better but it needs to be simple
     * per-element:
-    *    compare offset with offset stored at tag (hash)
-    *    if not equal extract block, store block, update tag
+    *    compare address with the tags of all ways in the set
+    *    if none matches, decode the block into the next victim way
     *    extract color from cache
     *    assemble colors
     */
 
    low_bit = util_logbase2(format_desc->block.bits / 8);
-   log2size = util_logbase2(LP_BUILD_FORMAT_CACHE_SIZE);
+   log2size = util_logbase2(LP_BUILD_FORMAT_CACHE_SETS);
    addr = LLVMBuildPtrToInt(builder, base_ptr, i64t, "");
    ptr_addrtrunc = LLVMBuildPtrToInt(builder, base_ptr, i32t, "");
    ptr_addrtrunc = lp_build_broadcast_scalar(&bld32, ptr_addrtrunc);
@@ -2064,7 +2275,7 @@ compressed_fetch_cached(struct gallivm_state *gallivm,
    ptr_addrtrunc = LLVMBuildAdd(builder, offset, ptr_addrtrunc, "");
    ptr_addrtrunc = LLVMBuildLShr(builder, ptr_addrtrunc,
                                  lp_build_const_int_vec(gallivm, type, low_bit), "");
-   /* This only really makes sense for size 64,128,256 */
+   /* This only really makes sense for 64 to 256 sets */
    hash_index = ptr_addrtrunc;
    ptr_addrtrunc = LLVMBuildLShr(builder, ptr_addrtrunc,
                                  lp_build_const_int_vec(gallivm, type, 2*log2size), "");
@@ -2073,74 +2284,46 @@ compressed_fetch_cached(struct gallivm_state *gallivm,
                        lp_build_const_int_vec(gallivm, type, log2size), "");
    hash_index = LLVMBuildXor(builder, hash_index, tmp, "");
 
-   hash_mask = lp_build_const_int_vec(gallivm, type, LP_BUILD_FORMAT_CACHE_SIZE - 1);
+   hash_mask = lp_build_const_int_vec(gallivm, type, LP_BUILD_FORMAT_CACHE_SETS - 1);
    hash_index = LLVMBuildAnd(builder, hash_index, hash_mask, "");
    ij_index = LLVMBuildShl(builder, i, lp_build_const_int_vec(gallivm, type, 2), "");
    ij_index = LLVMBuildAdd(builder, ij_index, j, "");
-   block_index = LLVMBuildShl(builder, hash_index,
-                              lp_build_const_int_vec(gallivm, type, 4), "");
-   block_index = LLVMBuildAdd(builder, ij_index, block_index, "");
 
-   if (n > 1) {
-      color = bld32.undef;
-      for (count = 0; count < n; count++) {
-         LLVMValueRef index, cond, colorx;
-         LLVMValueRef block_indexx, hash_indexx, addrx, offsetx, ptr_addrx;
-         struct lp_build_if_state if_ctx;
+   color = bld32.undef;
+   for (count = 0; count < n; count++) {
+      LLVMValueRef offsetx, addrx, setx, ijx, slot, texel_index, colorx;
 
-         index = lp_build_const_int32(gallivm, count);
+      if (n > 1) {
+         LLVMValueRef index = lp_build_const_int32(gallivm, count);
          offsetx = LLVMBuildExtractElement(builder, offset, index, "");
-         addrx = LLVMBuildZExt(builder, offsetx, i64t, "");
-         addrx = LLVMBuildAdd(builder, addrx, addr, "");
-         block_indexx = LLVMBuildExtractElement(builder, block_index, index, "");
-         hash_indexx = LLVMBuildLShr(builder, block_indexx,
-                                     lp_build_const_int32(gallivm, 4), "");
-         offset_stored = s3tc_lookup_tag_data(gallivm, cache, hash_indexx);
-         cond = LLVMBuildICmp(builder, LLVMIntNE, offset_stored, addrx, "");
-
-         lp_build_if(&if_ctx, gallivm, cond);
-         {
-            ptr_addrx = LLVMBuildIntToPtr(builder, addrx,
-                                          LLVMPointerType(i8t, 0), "");
-            update_cached_block(gallivm, format_desc, ptr_addrx, hash_indexx, cache);
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-            s3tc_update_cache_access(gallivm, cache, 1,
-                                     LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS);
-#endif
-         }
-         lp_build_endif(&if_ctx);
+         setx = LLVMBuildExtractElement(builder, hash_index, index, "");
+         ijx = LLVMBuildExtractElement(builder, ij_index, index, "");
+      } else {
+         offsetx = offset;
+         setx = hash_index;
+         ijx = ij_index;
+      }
+
+      addrx = LLVMBuildZExt(builder, offsetx, i64t, "");
+      addrx = LLVMBuildAdd(builder, addrx, addr, "");
 
-         colorx = s3tc_lookup_cached_pixel(gallivm, cache, block_indexx);
+      slot = cache_lookup_block(gallivm, format_desc, cache, setx, addrx);
 
+      texel_index = LLVMBuildShl(builder, slot, lp_build_const_int32(gallivm, 4), "");
+      texel_index = LLVMBuildAdd(builder, texel_index, ijx, "");
+      colorx = lookup_cache_member(gallivm, cache,
+                                   LP_BUILD_FORMAT_CACHE_MEMBER_DATA, texel_index);
+
+      if (n > 1) {
          color = LLVMBuildInsertElement(builder, color, colorx,
                                         lp_build_const_int32(gallivm, count), "");
+      } else {
+         color = colorx;
       }
    }
-   else {
-      LLVMValueRef cond;
-      struct lp_build_if_state if_ctx;
-
-      tmp = LLVMBuildZExt(builder, offset, i64t, "");
-      addr = LLVMBuildAdd(builder, tmp, addr, "");
-      offset_stored = s3tc_lookup_tag_data(gallivm, cache, hash_index);
-      cond = LLVMBuildICmp(builder, LLVMIntNE, offset_stored, addr, "");
-
-      lp_build_if(&if_ctx, gallivm, cond);
-      {
-         tmp = LLVMBuildIntToPtr(builder, addr, LLVMPointerType(i8t, 0), "");
-         update_cached_block(gallivm, format_desc, tmp, hash_index, cache);
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-         s3tc_update_cache_access(gallivm, cache, 1,
-                                  LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS);
-#endif
-      }
-      lp_build_endif(&if_ctx);
-
-      color = s3tc_lookup_cached_pixel(gallivm, cache, block_index);
-   }
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-   s3tc_update_cache_access(gallivm, cache, n,
-                            LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL);
+#if LP_BUILD_FORMAT_CACHE_STATS
+   cache_update_access(gallivm, cache, n,
+                       LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL);
 #endif
    return LLVMBuildBitCast(builder, color, LLVMVectorType(i8t, n * 4), "");
 }
@@ -2193,8 +2376,8 @@ lp_build_fetch_s3tc_rgba_aos(struct gallivm_state *gallivm,
 
 /*   debug_printf("format = %d\n", format_desc->format);*/
    if (cache) {
-      rgba = compressed_fetch_cached(gallivm, format_desc, n,
-                                     base_ptr, offset, i, j, cache);
+      rgba = lp_build_fetch_cached_rgba_aos(gallivm, format_desc, n,
+                                            base_ptr, offset, i, j, cache);
       return rgba;
    }
 
@@ -2556,6 +2739,11 @@ lp_build_fetch_rgtc_rgba_aos(struct gallivm_state *gallivm,
 
    assert((n == 1) || (n % 4 == 0));
 
+   if (cache) {
+      return lp_build_fetch_cached_rgba_aos(gallivm, format_desc, n,
+                                            base_ptr, offset, i, j, cache);
+   }
+
    if (n > 4) {
       unsigned count;
       LLVMTypeRef i128_type = LLVMIntTypeInContext(gallivm->context, 128);
@@ -153,7 +153,7 @@ init_gallivm_engine(struct gallivm_state *gallivm)
       char *error = NULL;
       int ret;
 
-      if (gallivm_perf & GALLIVM_PERF_NO_OPT) {
+      if ((gallivm_perf & GALLIVM_PERF_NO_OPT) || gallivm->fast_compile) {
          optlevel = None;
       }
       else {
@@ -417,10 +417,13 @@ gallivm_compile_module(struct gallivm_state *gallivm)
                    "[-mattr=<-mattr option(s)>]");
    }
 
+   int64_t opt_begin = os_time_get();
    lp_passmgr_run(gallivm->passmgr,
                   gallivm->module,
                   LLVMGetExecutionEngineTargetMachine(gallivm->engine),
-                  gallivm->module_name);
+                  gallivm->module_name,
+                  gallivm->fast_compile);
+   gallivm->opt_time = os_time_get() - opt_begin;
 
    /* Setting the module's DataLayout to an empty string will cause the
     * ExecutionEngine to copy to the DataLayout string from its target machine
@@ -75,6 +75,15 @@ struct gallivm_state
    LLVMDIBuilderRef di_builder;
    struct lp_cached_code *cache;
    unsigned compiled;
+   /* Favour compile time over code quality: only the passes needed for
+    * correctness and no codegen optimizations.  Set before
+    * gallivm_compile_module(), ignored by ORCJIT.
+    */
+   bool fast_compile;
+   /* Time spent in the optimization passes by gallivm_compile_module(), in
+    * microseconds.  Zero for cached code and with ORCJIT.
+    */
+   int64_t opt_time;
    LLVMValueRef coro_malloc_hook;
    LLVMValueRef coro_free_hook;
    LLVMValueRef debug_printf_hook;
@@ -308,7 +308,8 @@ LLVMErrorRef module_transform(void *Ctx, LLVMModuleRef mod) {
 
    lp_passmgr_run(mgr, mod,
                   LPJit::get_instance()->tm,
-                  get_module_name(mod));
+                  get_module_name(mod),
+                  false);
 
    lp_passmgr_dispose(mgr);
    return LLVMErrorSuccess;
@@ -130,7 +130,8 @@ void
 lp_passmgr_run(struct lp_passmgr *mgr,
                LLVMModuleRef module,
                LLVMTargetMachineRef tm,
-               const char *module_name)
+               const char *module_name,
+               bool fast)
 {
    int64_t time_begin;
 
@@ -150,7 +151,7 @@ lp_passmgr_run(struct lp_passmgr *mgr,
    LLVMPassBuilderOptionsRef opts = LLVMCreatePassBuilderOptions();
    LLVMRunPasses(module, passes, tm, opts);
 
-   if (!(gallivm_perf & GALLIVM_PERF_NO_OPT))
+   if (!(gallivm_perf & GALLIVM_PERF_NO_OPT) && !fast)
 #if LLVM_VERSION_MAJOR >= 18
       strcpy(passes, "sroa,early-cse,simplifycfg,reassociate,mem2reg,instsimplify,instcombine<no-verify-fixpoint>");
 #else
@@ -163,8 +164,19 @@ lp_passmgr_run(struct lp_passmgr *mgr,
    LLVMDisposePassBuilderOptions(opts);
 #else
    LLVMRunPassManager(mgr->cgpassmgr, module);
+
+   /* The optimization passes are baked into mgr->passmgr, use the same
+    * passes as GALLIVM_PERF_NO_OPT instead.
+    */
+   LLVMPassManagerRef passmgr = mgr->passmgr;
+   if (fast) {
+      passmgr = LLVMCreateFunctionPassManagerForModule(module);
+      LLVMAddPromoteMemoryToRegisterPass(passmgr);
+      LLVMAddCoroCleanupPass(passmgr);
+   }
+
    /* Run optimization passes */
-   LLVMInitializeFunctionPassManager(mgr->passmgr);
+   LLVMInitializeFunctionPassManager(passmgr);
    LLVMValueRef func;
    func = LLVMGetFirstFunction(module);
    while (func) {
@@ -179,10 +191,13 @@ lp_passmgr_run(struct lp_passmgr *mgr,
       LLVMAddTargetDependentFunctionAttr(func, "no-frame-pointer-elim-non-leaf", "true");
 #endif
 
-      LLVMRunFunctionPassManager(mgr->passmgr, func);
+      LLVMRunFunctionPassManager(passmgr, func);
       func = LLVMGetNextFunction(func);
    }
-   LLVMFinalizeFunctionPassManager(mgr->passmgr);
+   LLVMFinalizeFunctionPassManager(passmgr);
+
+   if (passmgr != mgr->passmgr)
+      LLVMDisposePassManager(passmgr);
 #endif
 
    if (gallivm_debug & GALLIVM_DEBUG_PERF) {
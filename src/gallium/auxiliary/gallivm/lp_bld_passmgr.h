@@ -43,10 +43,15 @@ struct lp_passmgr;
  * so use a bool to denote success/fail.
  */
 bool lp_passmgr_create(LLVMModuleRef module, struct lp_passmgr **mgr);
+/*
+ * fast only runs the passes needed for correctness, like
+ * GALLIVM_PERF_NO_OPT does.
+ */
 void lp_passmgr_run(struct lp_passmgr *mgr,
                     LLVMModuleRef module,
                     LLVMTargetMachineRef tm,
-                    const char *module_name);
+                    const char *module_name,
+                    bool fast);
 void lp_passmgr_dispose(struct lp_passmgr *mgr);
 
 #ifdef __cplusplus
@@ -3937,7 +3937,7 @@ lp_build_sample_gen_func(struct gallivm_state *gallivm,
    if (dynamic_state->cache_ptr) {
       const struct util_format_description *format_desc;
       format_desc = util_format_description(static_texture_state->format);
-      if (format_desc->layout == UTIL_FORMAT_LAYOUT_S3TC) {
+      if (lp_build_format_cache_supported(format_desc)) {
          need_cache = true;
       }
    }
@@ -4060,7 +4060,7 @@ lp_build_sample_soa_func(struct gallivm_state *gallivm,
    if (dynamic_state->cache_ptr) {
       const struct util_format_description *format_desc;
       format_desc = util_format_description(static_texture_state->format);
-      if (format_desc->layout == UTIL_FORMAT_LAYOUT_S3TC) {
+      if (lp_build_format_cache_supported(format_desc)) {
          need_cache = true;
       }
    }
@@ -44,6 +44,10 @@
 #include "util/format/u_formats.h"
 #include "pipe/p_state.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
  * Translate has to work on two more attributes because
  * the draw module has to be able to pass a few fixed
@@ -173,4 +177,15 @@ struct translate *translate_generic_create( const struct translate_key *key );
 
 bool translate_generic_is_output_format_supported(enum pipe_format format);
 
+/* Converts src[0..count-1] to float[4] at dst + i * dst_stride */
+typedef void (*translate_fetch_func)(uint8_t *dst, unsigned dst_stride,
+                                     const uint8_t *const *src,
+                                     unsigned count);
+
+translate_fetch_func translate_get_fetch_func(enum pipe_format format);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,311 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Vertex attribute fetch kernels for the generic translate path.
+ *
+ * Each kernel converts a batch of vertices of one input format to
+ * float[4], with the same arithmetic as the util_format unpack functions
+ * so that the results are bit-identical.  The source pointers are passed
+ * in an array, which covers linear, indexed and instanced fetches alike.
+ *
+ * The common 8 and 16 bit normalized formats and the three component
+ * float format have SSE2 versions, the others are plain C loops which the
+ * compiler can vectorize for the target.
+ */
+
+#include <string.h>
+
+#include "util/detect.h"
+#include "util/half_float.h"
+#include "util/macros.h"
+#include "util/u_math.h"
+#include "translate.h"
+
+#if DETECT_ARCH_SSE
+#include <emmintrin.h>
+#endif
+
+
+#define CONV_FLOAT(x)    (x)
+#define CONV_HALF(x)     _mesa_half_to_float(x)
+#define CONV_SCALED(x)   ((float)(x))
+#define CONV_UNORM8(x)   ubyte_to_float(x)
+#define CONV_SNORM8(x)   MAX2(-1.0f, (float)((x) * (1.0f/0x7f)))
+#define CONV_UNORM16(x)  ((float)((x) * (1.0f/0xffff)))
+#define CONV_SNORM16(x)  MAX2(-1.0f, (float)((x) * (1.0f/0x7fff)))
+
+/* Missing channels read as (0, 0, 0, 1), as in util_format. */
+#define FETCH_FUNC(NAME, NR, TYPE, CONV)                                 \
+static UNUSED void                                                       \
+fetch_##NAME(uint8_t *restrict dst, unsigned dst_stride,                 \
+             const uint8_t *const *restrict src, unsigned count)         \
+{                                                                        \
+   for (unsigned i = 0; i < count; i++, dst += dst_stride) {             \
+      TYPE in[NR];                                                       \
+      float out[4];                                                      \
+      memcpy(in, src[i], sizeof(in));                                    \
+      for (unsigned c = 0; c < 4; c++)                                   \
+         out[c] = c < NR ? CONV(in[c]) : (c == 3 ? 1.0f : 0.0f);         \
+      memcpy(dst, out, sizeof(out));                                     \
+   }                                                                     \
+}
+
+#define FETCH_FUNCS(NAME, TYPE, CONV)                                    \
+   FETCH_FUNC(NAME##x1, 1, TYPE, CONV)                                   \
+   FETCH_FUNC(NAME##x2, 2, TYPE, CONV)                                   \
+   FETCH_FUNC(NAME##x3, 3, TYPE, CONV)                                   \
+   FETCH_FUNC(NAME##x4, 4, TYPE, CONV)
+
+FETCH_FUNCS(float,    float,    CONV_FLOAT)
+FETCH_FUNCS(half,     uint16_t, CONV_HALF)
+FETCH_FUNCS(unorm8,   uint8_t,  CONV_UNORM8)
+FETCH_FUNCS(snorm8,   int8_t,   CONV_SNORM8)
+FETCH_FUNCS(uscaled8, uint8_t,  CONV_SCALED)
+FETCH_FUNCS(sscaled8, int8_t,   CONV_SCALED)
+FETCH_FUNCS(unorm16,  uint16_t, CONV_UNORM16)
+FETCH_FUNCS(snorm16,  int16_t,  CONV_SNORM16)
+FETCH_FUNCS(uscaled16, uint16_t, CONV_SCALED)
+FETCH_FUNCS(sscaled16, int16_t, CONV_SCALED)
+
+static UNUSED void
+fetch_bgra_unorm8(uint8_t *restrict dst, unsigned dst_stride,
+                  const uint8_t *const *restrict src, unsigned count)
+{
+   for (unsigned i = 0; i < count; i++, dst += dst_stride) {
+      const float out[4] = {
+         ubyte_to_float(src[i][2]),
+         ubyte_to_float(src[i][1]),
+         ubyte_to_float(src[i][0]),
+         ubyte_to_float(src[i][3]),
+      };
+      memcpy(dst, out, sizeof(out));
+   }
+}
+
+
+#if DETECT_ARCH_SSE
+
+static inline __m128i
+load_32(const uint8_t *src)
+{
+   int32_t v;
+   memcpy(&v, src, sizeof(v));
+   return _mm_cvtsi32_si128(v);
+}
+
+static inline __m128i
+load_64(const uint8_t *src)
+{
+   return _mm_loadl_epi64((const __m128i *)src);
+}
+
+/* Widen the low four bytes to 32 bits */
+static inline __m128i
+unpack_u8(__m128i v)
+{
+   const __m128i zero = _mm_setzero_si128();
+   return _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, zero), zero);
+}
+
+static inline __m128i
+unpack_s8(__m128i v)
+{
+   v = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+   return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+}
+
+/* Widen the low four words to 32 bits */
+static inline __m128i
+unpack_u16(__m128i v)
+{
+   return _mm_unpacklo_epi16(v, _mm_setzero_si128());
+}
+
+static inline __m128i
+unpack_s16(__m128i v)
+{
+   return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+}
+
+static void
+fetch_unorm8x4_sse2(uint8_t *restrict dst, unsigned dst_stride,
+                    const uint8_t *const *restrict src, unsigned count)
+{
+   const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+
+   for (unsigned i = 0; i < count; i++, dst += dst_stride) {
+      __m128 v = _mm_cvtepi32_ps(unpack_u8(load_32(src[i])));
+      _mm_storeu_ps((float *)dst, _mm_mul_ps(v, scale));
+   }
+}
+
+static void
+fetch_bgra_unorm8_sse2(uint8_t *restrict dst, unsigned dst_stride,
+                       const uint8_t *const *restrict src, unsigned count)
+{
+   const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+
+   for (unsigned i = 0; i < count; i++, dst += dst_stride) {
+      __m128 v = _mm_cvtepi32_ps(unpack_u8(load_32(src[i])));
+      v = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2));
+      _mm_storeu_ps((float *)dst, _mm_mul_ps(v, scale));
+   }
+}
+
+static void
+fetch_snorm8x4_sse2(uint8_t *restrict dst, unsigned dst_stride,
+                    const uint8_t *const *restrict src, unsigned count)
+{
+   const __m128 scale = _mm_set1_ps(1.0f / 0x7f);
+   const __m128 min = _mm_set1_ps(-1.0f);
+
+   for (unsigned i = 0; i < count; i++, dst += dst_stride) {
+      __m128 v = _mm_cvtepi32_ps(unpack_s8(load_32(src[i])));
+      _mm_storeu_ps((float *)dst, _mm_max_ps(_mm_mul_ps(v, scale), min));
+   }
+}
+
+static void
+fetch_unorm16x2_sse2(uint8_t *restrict dst, unsigned dst_stride,
+                     const uint8_t *const *restrict src, unsigned count)
+{
+   const __m128 scale = _mm_set1_ps(1.0f / 0xffff);
+   const __m128 w = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+
+   for (unsigned i = 0; i < count; i++, dst += dst_stride) {
+      __m128 v = _mm_cvtepi32_ps(unpack_u16(load_32(src[i])));
+      _mm_storeu_ps((float *)dst, _mm_or_ps(_mm_mul_ps(v, scale), w));
+   }
+}
+
+static void
+fetch_unorm16x4_sse2(uint8_t *restrict dst, unsigned dst_stride,
+                     const uint8_t *const *restrict src, unsigned count)
+{
+   const __m128 scale = _mm_set1_ps(1.0f / 0xffff);
+
+   for (unsigned i = 0; i < count; i++, dst += dst_stride) {
+      __m128 v = _mm_cvtepi32_ps(unpack_u16(load_64(src[i])));
+      _mm_storeu_ps((float *)dst, _mm_mul_ps(v, scale));
+   }
+}
+
+static void
+fetch_snorm16x2_sse2(uint8_t *restrict dst, unsigned dst_stride,
+                     const uint8_t *const *restrict src, unsigned count)
+{
+   const __m128 scale = _mm_set1_ps(1.0f / 0x7fff);
+   const __m128 min = _mm_set1_ps(-1.0f);
+   const __m128 w = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+
+   for (unsigned i = 0; i < count; i++, dst += dst_stride) {
+      __m128 v = _mm_cvtepi32_ps(unpack_s16(load_32(src[i])));
+      v = _mm_max_ps(_mm_mul_ps(v, scale), min);
+      _mm_storeu_ps((float *)dst, _mm_or_ps(v, w));
+   }
+}
+
+static void
+fetch_snorm16x4_sse2(uint8_t *restrict dst, unsigned dst_stride,
+                     const uint8_t *const *restrict src, unsigned count)
+{
+   const __m128 scale = _mm_set1_ps(1.0f / 0x7fff);
+   const __m128 min = _mm_set1_ps(-1.0f);
+
+   for (unsigned i = 0; i < count; i++, dst += dst_stride) {
+      __m128 v = _mm_cvtepi32_ps(unpack_s16(load_64(src[i])));
+      _mm_storeu_ps((float *)dst, _mm_max_ps(_mm_mul_ps(v, scale), min));
+   }
+}
+
+static void
+fetch_floatx3_sse2(uint8_t *restrict dst, unsigned dst_stride,
+                   const uint8_t *const *restrict src, unsigned count)
+{
+   const __m128 one = _mm_set_ss(1.0f);
+
+   /* Never read past the 12 bytes of the vertex */
+   for (unsigned i = 0; i < count; i++, dst += dst_stride) {
+      __m128 xy = _mm_castsi128_ps(load_64(src[i]));
+      float z_val;
+      memcpy(&z_val, src[i] + 8, sizeof(z_val));
+      __m128 z = _mm_set_ss(z_val);
+      _mm_storeu_ps((float *)dst, _mm_movelh_ps(xy, _mm_unpacklo_ps(z, one)));
+   }
+}
+
+#endif /* DETECT_ARCH_SSE */
+
+
+/**
+ * Return a fetch kernel for the given input format, or NULL if there is
+ * none and the format's unpack function has to be used.  Pure integer
+ * formats are not handled, as their unpacked values are not floats.
+ */
+translate_fetch_func
+translate_get_fetch_func(enum pipe_format format)
+{
+   switch (format) {
+   case PIPE_FORMAT_R32_FLOAT:            return fetch_floatx1;
+   case PIPE_FORMAT_R32G32_FLOAT:         return fetch_floatx2;
+   case PIPE_FORMAT_R32G32B32A32_FLOAT:   return fetch_floatx4;
+   case PIPE_FORMAT_R16_FLOAT:            return fetch_halfx1;
+   case PIPE_FORMAT_R16G16_FLOAT:         return fetch_halfx2;
+   case PIPE_FORMAT_R16G16B16_FLOAT:      return fetch_halfx3;
+   case PIPE_FORMAT_R16G16B16A16_FLOAT:   return fetch_halfx4;
+
+   case PIPE_FORMAT_R8_UNORM:             return fetch_unorm8x1;
+   case PIPE_FORMAT_R8G8_UNORM:           return fetch_unorm8x2;
+   case PIPE_FORMAT_R8G8B8_UNORM:         return fetch_unorm8x3;
+   case PIPE_FORMAT_R8_SNORM:             return fetch_snorm8x1;
+   case PIPE_FORMAT_R8G8_SNORM:           return fetch_snorm8x2;
+   case PIPE_FORMAT_R8G8B8_SNORM:         return fetch_snorm8x3;
+   case PIPE_FORMAT_R8_USCALED:           return fetch_uscaled8x1;
+   case PIPE_FORMAT_R8G8_USCALED:         return fetch_uscaled8x2;
+   case PIPE_FORMAT_R8G8B8_USCALED:       return fetch_uscaled8x3;
+   case PIPE_FORMAT_R8G8B8A8_USCALED:     return fetch_uscaled8x4;
+   case PIPE_FORMAT_R8_SSCALED:           return fetch_sscaled8x1;
+   case PIPE_FORMAT_R8G8_SSCALED:         return fetch_sscaled8x2;
+   case PIPE_FORMAT_R8G8B8_SSCALED:       return fetch_sscaled8x3;
+   case PIPE_FORMAT_R8G8B8A8_SSCALED:     return fetch_sscaled8x4;
+
+   case PIPE_FORMAT_R16_UNORM:            return fetch_unorm16x1;
+   case PIPE_FORMAT_R16G16B16_UNORM:      return fetch_unorm16x3;
+   case PIPE_FORMAT_R16_SNORM:            return fetch_snorm16x1;
+   case PIPE_FORMAT_R16G16B16_SNORM:      return fetch_snorm16x3;
+   case PIPE_FORMAT_R16_USCALED:          return fetch_uscaled16x1;
+   case PIPE_FORMAT_R16G16_USCALED:       return fetch_uscaled16x2;
+   case PIPE_FORMAT_R16G16B16_USCALED:    return fetch_uscaled16x3;
+   case PIPE_FORMAT_R16G16B16A16_USCALED: return fetch_uscaled16x4;
+   case PIPE_FORMAT_R16_SSCALED:          return fetch_sscaled16x1;
+   case PIPE_FORMAT_R16G16_SSCALED:       return fetch_sscaled16x2;
+   case PIPE_FORMAT_R16G16B16_SSCALED:    return fetch_sscaled16x3;
+   case PIPE_FORMAT_R16G16B16A16_SSCALED: return fetch_sscaled16x4;
+
+#if DETECT_ARCH_SSE
+   case PIPE_FORMAT_R32G32B32_FLOAT:      return fetch_floatx3_sse2;
+   case PIPE_FORMAT_R8G8B8A8_UNORM:       return fetch_unorm8x4_sse2;
+   case PIPE_FORMAT_B8G8R8A8_UNORM:       return fetch_bgra_unorm8_sse2;
+   case PIPE_FORMAT_R8G8B8A8_SNORM:       return fetch_snorm8x4_sse2;
+   case PIPE_FORMAT_R16G16_UNORM:         return fetch_unorm16x2_sse2;
+   case PIPE_FORMAT_R16G16B16A16_UNORM:   return fetch_unorm16x4_sse2;
+   case PIPE_FORMAT_R16G16_SNORM:         return fetch_snorm16x2_sse2;
+   case PIPE_FORMAT_R16G16B16A16_SNORM:   return fetch_snorm16x4_sse2;
+#else
+   case PIPE_FORMAT_R32G32B32_FLOAT:      return fetch_floatx3;
+   case PIPE_FORMAT_R8G8B8A8_UNORM:       return fetch_unorm8x4;
+   case PIPE_FORMAT_B8G8R8A8_UNORM:       return fetch_bgra_unorm8;
+   case PIPE_FORMAT_R8G8B8A8_SNORM:       return fetch_snorm8x4;
+   case PIPE_FORMAT_R16G16_UNORM:         return fetch_unorm16x2;
+   case PIPE_FORMAT_R16G16B16A16_UNORM:   return fetch_unorm16x4;
+   case PIPE_FORMAT_R16G16_SNORM:         return fetch_snorm16x2;
+   case PIPE_FORMAT_R16G16B16A16_SNORM:   return fetch_snorm16x4;
+#endif
+
+   default:
+      return NULL;
+   }
+}
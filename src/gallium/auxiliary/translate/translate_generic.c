@@ -52,11 +52,15 @@ struct translate_generic {
 
       void (*fetch)(void *restrict dst, const uint8_t *restrict src,
                     unsigned width);
+      /* Batched version of fetch, if there is one for the format */
+      translate_fetch_func fetch_batch;
       unsigned buffer;
       unsigned input_offset;
       unsigned instance_divisor;
 
       emit_func emit;
+      /* Size of the float output, which is copied instead of emitted */
+      unsigned emit_size;
       unsigned output_offset;
 
       const uint8_t *input_ptr;
@@ -584,73 +588,129 @@ get_emit_func(enum pipe_format format)
    }
 }
 
-static ALWAYS_INLINE void UTIL_CDECL
-generic_run_one(struct translate_generic *tg,
-                unsigned elt,
-                unsigned start_instance,
-                unsigned instance_id,
-                void *vert,
-                unsigned index_size)
+/* Vertices converted at once, bounded by the stack space for the
+ * intermediate floats.
+ */
+#define GENERIC_BATCH 64
+
+/**
+ * Fetch 'count' <= GENERIC_BATCH vertices, one attribute at a time.  The
+ * element index of vertex i is elts[i] for the given index size, or
+ * start + i if there are no elts.
+ */
+static ALWAYS_INLINE void
+generic_run_batch(struct translate_generic *tg,
+                  const void *elts,
+                  unsigned index_size,
+                  unsigned start,
+                  unsigned count,
+                  unsigned start_instance,
+                  unsigned instance_id,
+                  uint8_t *vert)
 {
-   unsigned nr_attrs = tg->nr_attrib;
-   unsigned attr;
-
-   for (attr = 0; attr < nr_attrs; attr++) {
-      float data[4];
-      uint8_t *dst = (uint8_t *)vert + tg->attrib[attr].output_offset;
-
-      if (tg->attrib[attr].type == TRANSLATE_ELEMENT_NORMAL) {
-         const uint8_t *src;
-         unsigned index;
-         int copy_size;
-
-         if (tg->attrib[attr].instance_divisor) {
-            index = start_instance;
-            index += (instance_id  / tg->attrib[attr].instance_divisor);
-            /* XXX we need to clamp the index here too, but to a
-             * per-array max value, not the draw->pt.max_index value
-             * that's being given to us via translate->set_buffer().
-             */
+   const unsigned stride = tg->translate.key.output_stride;
+   const uint8_t *src[GENERIC_BATCH];
+   float data[GENERIC_BATCH][4];
+
+   for (unsigned attr = 0; attr < tg->nr_attrib; attr++) {
+      uint8_t *dst = vert + tg->attrib[attr].output_offset;
+
+      if (tg->attrib[attr].type == TRANSLATE_ELEMENT_INSTANCE_ID) {
+         for (unsigned i = 0; i < count; i++, dst += stride) {
+            if (likely(tg->attrib[attr].copy_size >= 0)) {
+               memcpy(dst, &instance_id, 4);
+            } else {
+               data[0][0] = (float)instance_id;
+               tg->attrib[attr].emit(data[0], dst);
+            }
          }
-         else {
-            index = elt;
+         continue;
+      }
+
+      if (tg->attrib[attr].instance_divisor) {
+         unsigned index = start_instance +
+                          instance_id / tg->attrib[attr].instance_divisor;
+         /* XXX we need to clamp the index here too, but to a
+          * per-array max value, not the draw->pt.max_index value
+          * that's being given to us via translate->set_buffer().
+          */
+         for (unsigned i = 0; i < count; i++)
+            src[i] = tg->attrib[attr].input_ptr +
+                     (ptrdiff_t)tg->attrib[attr].input_stride * index;
+      } else {
+         for (unsigned i = 0; i < count; i++) {
+            unsigned index;
+
+            switch (index_size) {
+            case 4: index = ((const unsigned *)elts)[i]; break;
+            case 2: index = ((const uint16_t *)elts)[i]; break;
+            case 1: index = ((const uint8_t *)elts)[i]; break;
+            default: index = start + i; break;
+            }
+
             if (index_size > 0) {
                /* clamp to avoid going out of bounds */
                index = MIN2(index, tg->attrib[attr].max_index);
             }
+
+            src[i] = tg->attrib[attr].input_ptr +
+                     (ptrdiff_t)tg->attrib[attr].input_stride * index;
          }
+      }
+
+      const int copy_size = tg->attrib[attr].copy_size;
+      if (likely(copy_size >= 0)) {
+         for (unsigned i = 0; i < count; i++, dst += stride)
+            memcpy(dst, src[i], copy_size);
+         continue;
+      }
 
-         src = tg->attrib[attr].input_ptr +
-               (ptrdiff_t)tg->attrib[attr].input_stride * index;
-
-         copy_size = tg->attrib[attr].copy_size;
-         if (likely(copy_size >= 0)) {
-            memcpy(dst, src, copy_size);
-         } else {
-            tg->attrib[attr].fetch(data, src, 1);
-
-            if (0)
-               debug_printf("Fetch linear attr %d  from %p  stride %d  index %d: "
-                         " %f, %f, %f, %f \n",
-                         attr,
-                         tg->attrib[attr].input_ptr,
-                         tg->attrib[attr].input_stride,
-                         index,
-                         data[0], data[1],data[2], data[3]);
-
-            tg->attrib[attr].emit(data, dst);
+      const unsigned emit_size = tg->attrib[attr].emit_size;
+
+      if (tg->attrib[attr].fetch_batch) {
+         /* Straight to the output when it is a float[4] */
+         if (emit_size == sizeof(data[0])) {
+            tg->attrib[attr].fetch_batch(dst, stride, src, count);
+            continue;
          }
+         tg->attrib[attr].fetch_batch((uint8_t *)data, sizeof(data[0]),
+                                      src, count);
       } else {
-         if (likely(tg->attrib[attr].copy_size >= 0)) {
-            memcpy(data, &instance_id, 4);
-         } else {
-            data[0] = (float)instance_id;
-            tg->attrib[attr].emit(data, dst);
-         }
+         for (unsigned i = 0; i < count; i++)
+            tg->attrib[attr].fetch(data[i], src[i], 1);
+      }
+
+      if (emit_size) {
+         for (unsigned i = 0; i < count; i++, dst += stride)
+            memcpy(dst, data[i], emit_size);
+      } else {
+         for (unsigned i = 0; i < count; i++, dst += stride)
+            tg->attrib[attr].emit(data[i], dst);
       }
    }
 }
 
+static ALWAYS_INLINE void
+generic_run_batches(struct translate_generic *tg,
+                    const void *elts,
+                    unsigned index_size,
+                    unsigned start,
+                    unsigned count,
+                    unsigned start_instance,
+                    unsigned instance_id,
+                    void *output_buffer)
+{
+   uint8_t *vert = output_buffer;
+
+   for (unsigned i = 0; i < count; i += GENERIC_BATCH) {
+      const void *batch_elts = elts ? (const uint8_t *)elts + i * index_size : NULL;
+      generic_run_batch(tg, batch_elts, index_size,
+                        start + i, MIN2(count - i, GENERIC_BATCH),
+                        start_instance, instance_id, vert);
+      vert += GENERIC_BATCH * tg->translate.key.output_stride;
+   }
+}
+
 /**
  * Fetch vertex attributes for 'count' vertices.
  */
@@ -662,14 +722,8 @@ generic_run_elts(struct translate *translate,
                  unsigned instance_id,
                  void *output_buffer)
 {
-   struct translate_generic *tg = translate_generic(translate);
-   char *vert = output_buffer;
-   unsigned i;
-
-   for (i = 0; i < count; i++) {
-      generic_run_one(tg, *elts++, start_instance, instance_id, vert, 4);
-      vert += tg->translate.key.output_stride;
-   }
+   generic_run_batches(translate_generic(translate), elts, 4, 0, count,
+                       start_instance, instance_id, output_buffer);
 }
 
 static void UTIL_CDECL
@@ -680,14 +734,8 @@ generic_run_elts16(struct translate *translate,
                    unsigned instance_id,
                    void *output_buffer)
 {
-   struct translate_generic *tg = translate_generic(translate);
-   char *vert = output_buffer;
-   unsigned i;
-
-   for (i = 0; i < count; i++) {
-      generic_run_one(tg, *elts++, start_instance, instance_id, vert, 2);
-      vert += tg->translate.key.output_stride;
-   }
+   generic_run_batches(translate_generic(translate), elts, 2, 0, count,
+                       start_instance, instance_id, output_buffer);
 }
 
 static void UTIL_CDECL
@@ -698,14 +746,8 @@ generic_run_elts8(struct translate *translate,
                   unsigned instance_id,
                   void *output_buffer)
 {
-   struct translate_generic *tg = translate_generic(translate);
-   char *vert = output_buffer;
-   unsigned i;
-
-   for (i = 0; i < count; i++) {
-      generic_run_one(tg, *elts++, start_instance, instance_id, vert, 1);
-      vert += tg->translate.key.output_stride;
-   }
+   generic_run_batches(translate_generic(translate), elts, 1, 0, count,
+                       start_instance, instance_id, output_buffer);
 }
 
 static void UTIL_CDECL
@@ -716,14 +758,8 @@ generic_run(struct translate *translate,
             unsigned instance_id,
             void *output_buffer)
 {
-   struct translate_generic *tg = translate_generic(translate);
-   char *vert = output_buffer;
-   unsigned i;
-
-   for (i = 0; i < count; i++) {
-      generic_run_one(tg, start + i, start_instance, instance_id, vert, 0);
-      vert += tg->translate.key.output_stride;
-   }
+   generic_run_batches(translate_generic(translate), NULL, 0, start, count,
+                       start_instance, instance_id, output_buffer);
 }
 
 
@@ -816,6 +852,8 @@ translate_generic_create(const struct translate_key *key)
       }
 
       tg->attrib[i].fetch = unpack->unpack_rgba;
+      tg->attrib[i].fetch_batch =
+         translate_get_fetch_func(key->element[i].input_format);
       tg->attrib[i].buffer = key->element[i].input_buffer;
       tg->attrib[i].input_offset = key->element[i].input_offset;
       tg->attrib[i].instance_divisor = key->element[i].instance_divisor;
@@ -839,6 +877,14 @@ translate_generic_create(const struct translate_key *key)
          tg->attrib[i].emit = get_emit_func(key->element[i].output_format);
       else
          tg->attrib[i].emit  = NULL;
+
+      switch (key->element[i].output_format) {
+      case PIPE_FORMAT_R32G32B32A32_FLOAT: tg->attrib[i].emit_size = 16; break;
+      case PIPE_FORMAT_R32G32B32_FLOAT:    tg->attrib[i].emit_size = 12; break;
+      case PIPE_FORMAT_R32G32_FLOAT:       tg->attrib[i].emit_size = 8; break;
+      case PIPE_FORMAT_R32_FLOAT:          tg->attrib[i].emit_size = 4; break;
+      default:                             tg->attrib[i].emit_size = 0; break;
+      }
    }
 
    tg->nr_attrib = key->nr_elements;
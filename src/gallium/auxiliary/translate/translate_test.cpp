@@ -0,0 +1,248 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ *
+ * Check that the batched generic translate path gives the same result as
+ * unpacking one vertex at a time.  translate_bench measures the throughput
+ * of both.
+ */
+
+#include <gtest/gtest.h>
+#include <string.h>
+#include <vector>
+
+#include "util/format/u_format.h"
+#include "util/u_math.h"
+#include "translate/translate.h"
+
+namespace {
+
+const pipe_format input_formats[] = {
+   PIPE_FORMAT_R32_FLOAT,
+   PIPE_FORMAT_R32G32_FLOAT,
+   PIPE_FORMAT_R32G32B32_FLOAT,
+   PIPE_FORMAT_R32G32B32A32_FLOAT,
+   PIPE_FORMAT_R16_FLOAT,
+   PIPE_FORMAT_R16G16_FLOAT,
+   PIPE_FORMAT_R16G16B16_FLOAT,
+   PIPE_FORMAT_R16G16B16A16_FLOAT,
+   PIPE_FORMAT_R8_UNORM,
+   PIPE_FORMAT_R8G8_UNORM,
+   PIPE_FORMAT_R8G8B8_UNORM,
+   PIPE_FORMAT_R8G8B8A8_UNORM,
+   PIPE_FORMAT_B8G8R8A8_UNORM,
+   PIPE_FORMAT_R8_SNORM,
+   PIPE_FORMAT_R8G8_SNORM,
+   PIPE_FORMAT_R8G8B8_SNORM,
+   PIPE_FORMAT_R8G8B8A8_SNORM,
+   PIPE_FORMAT_R8G8B8A8_USCALED,
+   PIPE_FORMAT_R8G8B8_SSCALED,
+   PIPE_FORMAT_R8G8B8A8_SSCALED,
+   PIPE_FORMAT_R16_UNORM,
+   PIPE_FORMAT_R16G16_UNORM,
+   PIPE_FORMAT_R16G16B16_UNORM,
+   PIPE_FORMAT_R16G16B16A16_UNORM,
+   PIPE_FORMAT_R16_SNORM,
+   PIPE_FORMAT_R16G16_SNORM,
+   PIPE_FORMAT_R16G16B16_SNORM,
+   PIPE_FORMAT_R16G16B16A16_SNORM,
+   PIPE_FORMAT_R16G16_USCALED,
+   PIPE_FORMAT_R16G16B16A16_SSCALED,
+   PIPE_FORMAT_R10G10B10A2_UNORM,
+};
+
+const unsigned num_vertices = 1000;
+
+/* Random bytes, except that float formats get finite values. */
+std::vector<uint8_t>
+make_vertices(pipe_format format, unsigned stride, unsigned count)
+{
+   std::vector<uint8_t> data((size_t)stride * count);
+   uint32_t seed = 12345;
+
+   for (size_t i = 0; i < data.size(); i++) {
+      seed = seed * 1103515245 + 12345;
+      data[i] = seed >> 16;
+   }
+
+   const struct util_format_description *desc = util_format_description(format);
+   if (desc->channel[0].type == UTIL_FORMAT_TYPE_FLOAT &&
+       desc->channel[0].size == 32) {
+      for (size_t i = 0; i + 4 <= data.size(); i += 4) {
+         float f = (float)(i % 2003) / 7.0f - 100.0f;
+         memcpy(&data[i], &f, 4);
+      }
+   }
+
+   return data;
+}
+
+/* What the generic path used to do, one vertex and attribute at a time. */
+void
+reference_fetch(pipe_format format, const uint8_t *src, unsigned stride,
+                const unsigned *elts, unsigned count, unsigned max_index,
+                float (*dst)[4])
+{
+   for (unsigned i = 0; i < count; i++) {
+      unsigned index = elts ? MIN2(elts[i], max_index) : i;
+      util_format_unpack_rgba(format, dst[i], src + (size_t)stride * index, 1);
+   }
+}
+
+struct translate *
+create_fetch(pipe_format format, unsigned output_stride)
+{
+   struct translate_key key;
+   memset(&key, 0, sizeof(key));
+   key.output_stride = output_stride;
+   key.nr_elements = 1;
+   key.element[0].type = TRANSLATE_ELEMENT_NORMAL;
+   key.element[0].input_format = format;
+   key.element[0].output_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   return translate_generic_create(&key);
+}
+
+} /* anonymous namespace */
+
+TEST(TranslateGeneric, LinearMatchesUnpack)
+{
+   for (pipe_format format : input_formats) {
+      SCOPED_TRACE(util_format_name(format));
+
+      /* Odd stride, so that most sources are unaligned. */
+      const unsigned stride = util_format_get_blocksize(format) + 3;
+      std::vector<uint8_t> src = make_vertices(format, stride, num_vertices);
+      std::vector<float> expected(num_vertices * 4), actual(num_vertices * 4);
+
+      struct translate *t = create_fetch(format, 16);
+      ASSERT_NE(t, nullptr);
+      t->set_buffer(t, 0, src.data(), stride, num_vertices - 1);
+      t->run(t, 0, num_vertices, 0, 0, actual.data());
+      t->release(t);
+
+      reference_fetch(format, src.data(), stride, NULL, num_vertices,
+                      num_vertices - 1, (float (*)[4])expected.data());
+
+      EXPECT_EQ(memcmp(expected.data(), actual.data(),
+                       expected.size() * sizeof(float)), 0);
+   }
+}
+
+TEST(TranslateGeneric, EltsMatchUnpack)
+{
+   std::vector<unsigned> elts(num_vertices);
+   std::vector<uint16_t> elts16(num_vertices);
+   for (unsigned i = 0; i < num_vertices; i++) {
+      /* Some indices are out of bounds and must be clamped. */
+      elts[i] = (i * 7919) % (num_vertices + 50);
+      elts16[i] = elts[i];
+   }
+
+   for (pipe_format format : input_formats) {
+      SCOPED_TRACE(util_format_name(format));
+
+      const unsigned stride = util_format_get_blocksize(format);
+      std::vector<uint8_t> src = make_vertices(format, stride, num_vertices);
+      std::vector<float> expected(num_vertices * 4);
+      std::vector<float> actual(num_vertices * 4), actual16(num_vertices * 4);
+
+      struct translate *t = create_fetch(format, 16);
+      ASSERT_NE(t, nullptr);
+      t->set_buffer(t, 0, src.data(), stride, num_vertices - 1);
+      t->run_elts(t, elts.data(), num_vertices, 0, 0, actual.data());
+      t->run_elts16(t, elts16.data(), num_vertices, 0, 0, actual16.data());
+      t->release(t);
+
+      reference_fetch(format, src.data(), stride, elts.data(), num_vertices,
+                      num_vertices - 1, (float (*)[4])expected.data());
+
+      EXPECT_EQ(memcmp(expected.data(), actual.data(),
+                       expected.size() * sizeof(float)), 0);
+      EXPECT_EQ(memcmp(expected.data(), actual16.data(),
+                       expected.size() * sizeof(float)), 0);
+   }
+}
+
+TEST(TranslateGeneric, InstancedAndInstanceId)
+{
+   const float per_instance[3][2] = { { 1, 2 }, { 3, 4 }, { 5, 6 } };
+
+   struct translate_key key;
+   memset(&key, 0, sizeof(key));
+   key.output_stride = 12;
+   key.nr_elements = 2;
+   key.element[0].type = TRANSLATE_ELEMENT_NORMAL;
+   key.element[0].input_format = PIPE_FORMAT_R32G32_FLOAT;
+   key.element[0].output_format = PIPE_FORMAT_R32G32_FLOAT;
+   key.element[0].instance_divisor = 2;
+   key.element[1].type = TRANSLATE_ELEMENT_INSTANCE_ID;
+   key.element[1].input_format = PIPE_FORMAT_R32_USCALED;
+   key.element[1].output_format = PIPE_FORMAT_R32_USCALED;
+   key.element[1].output_offset = 8;
+
+   struct translate *t = translate_generic_create(&key);
+   ASSERT_NE(t, nullptr);
+   t->set_buffer(t, 0, per_instance, sizeof(per_instance[0]), 2);
+
+   struct { float v[2]; uint32_t instance_id; } out[100];
+   t->run(t, 0, ARRAY_SIZE(out), 1, 3, out);
+   t->release(t);
+
+   /* Instance 3 with divisor 2 and start instance 1 reads element 2. */
+   for (unsigned i = 0; i < ARRAY_SIZE(out); i++) {
+      EXPECT_EQ(out[i].v[0], 5.0f);
+      EXPECT_EQ(out[i].v[1], 6.0f);
+      EXPECT_EQ(out[i].instance_id, 3u);
+   }
+}
+
+TEST(TranslateGeneric, MeshLayoutMatchesUnpack)
+{
+   /* Position, normal, texcoord and color, as in a typical mesh. */
+   const struct {
+      pipe_format format;
+      unsigned offset;
+   } attribs[] = {
+      { PIPE_FORMAT_R32G32B32_FLOAT, 0 },
+      { PIPE_FORMAT_R8G8B8A8_SNORM, 12 },
+      { PIPE_FORMAT_R16G16_UNORM, 16 },
+      { PIPE_FORMAT_R8G8B8A8_UNORM, 20 },
+   };
+   const unsigned stride = 24;
+   const unsigned count = num_vertices;
+
+   struct translate_key key;
+   memset(&key, 0, sizeof(key));
+   key.output_stride = 16 * ARRAY_SIZE(attribs);
+   key.nr_elements = ARRAY_SIZE(attribs);
+   for (unsigned i = 0; i < ARRAY_SIZE(attribs); i++) {
+      key.element[i].type = TRANSLATE_ELEMENT_NORMAL;
+      key.element[i].input_format = attribs[i].format;
+      key.element[i].input_offset = attribs[i].offset;
+      key.element[i].output_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+      key.element[i].output_offset = 16 * i;
+   }
+
+   std::vector<uint8_t> src = make_vertices(PIPE_FORMAT_R8G8B8A8_UNORM,
+                                            stride, count);
+   std::vector<float> expected((size_t)count * 4 * ARRAY_SIZE(attribs));
+   std::vector<float> actual(expected.size());
+
+   for (unsigned v = 0; v < count; v++) {
+      for (unsigned i = 0; i < ARRAY_SIZE(attribs); i++) {
+         util_format_unpack_rgba(attribs[i].format,
+                                 &expected[((size_t)v * ARRAY_SIZE(attribs) + i) * 4],
+                                 &src[(size_t)v * stride + attribs[i].offset], 1);
+      }
+   }
+
+   struct translate *t = translate_generic_create(&key);
+   ASSERT_NE(t, nullptr);
+   t->set_buffer(t, 0, src.data(), stride, count - 1);
+
+   t->run(t, 0, count, 0, 0, actual.data());
+   t->release(t);
+
+   EXPECT_EQ(memcmp(expected.data(), actual.data(),
+                    expected.size() * sizeof(float)), 0);
+}
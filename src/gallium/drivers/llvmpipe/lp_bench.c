@@ -0,0 +1,469 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Draw throughput of llvmpipe on the null software winsys.
+ *
+ * "geometry" draws many small triangles in a few big draws, like a CAD
+ * scene, which is bound by vertex processing and binning on the context
+ * thread.  DRAW_VS_THREADS sets the number of vertex shading threads.
+ *
+ * "raster" blends fullscreen quads and "compute" runs an ALU heavy compute
+ * shader over a large image, once for each of the given LP_NUM_THREADS
+ * values, to show how fragment and compute throughput scale with the number
+ * of threads.  LP_THREAD_AFFINITY applies as usual.
+ *
+ * Usage: lp_bench geometry [num_triangles] [iterations]
+ *        lp_bench raster|compute [num_threads...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cso_cache/cso_context.h"
+#include "compiler/nir/nir_builder.h"
+#include "frontend/sw_winsys.h"
+#include "pipe/p_screen.h"
+#include "sw/null/null_sw_winsys.h"
+#include "util/os_misc.h"
+#include "util/os_time.h"
+#include "util/u_debug.h"
+#include "util/u_inlines.h"
+#include "util/u_simple_shaders.h"
+
+#include "lp_public.h"
+#include "lp_screen.h"
+
+#define FB_SIZE 1024
+#define SCALING_FB_SIZE 2048
+
+struct lp_bench {
+   struct pipe_screen *screen;
+   struct pipe_context *pipe;
+   struct cso_context *cso;
+   struct pipe_resource *cb;
+   unsigned fb_size;
+   void *vs;
+   void *fs;
+};
+
+
+static bool
+lp_bench_init(struct lp_bench *b, unsigned fb_size)
+{
+   memset(b, 0, sizeof(*b));
+   b->fb_size = fb_size;
+
+   struct sw_winsys *winsys = null_sw_create();
+   if (!winsys)
+      return false;
+
+   b->screen = llvmpipe_create_screen(winsys);
+   if (!b->screen) {
+      winsys->destroy(winsys);
+      return false;
+   }
+
+   b->pipe = b->screen->context_create(b->screen, NULL, 0);
+   if (!b->pipe)
+      return false;
+   b->cso = cso_create_context(b->pipe, 0);
+
+   struct pipe_resource templ = {0};
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+   templ.width0 = fb_size;
+   templ.height0 = fb_size;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.usage = PIPE_USAGE_DEFAULT;
+   templ.bind = PIPE_BIND_RENDER_TARGET | PIPE_BIND_SHADER_IMAGE;
+   b->cb = b->screen->resource_create(b->screen, &templ);
+   if (!b->cb)
+      return false;
+
+   struct pipe_framebuffer_state fb = {0};
+   fb.width = fb_size;
+   fb.height = fb_size;
+   fb.cbufs[0].format = b->cb->format;
+   fb.cbufs[0].texture = b->cb;
+   fb.nr_cbufs = 1;
+   cso_set_framebuffer(b->cso, &fb);
+
+   struct pipe_blend_state blend = {0};
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+   cso_set_blend(b->cso, &blend);
+
+   struct pipe_depth_stencil_alpha_state dsa = {{{0}}};
+   cso_set_depth_stencil_alpha(b->cso, &dsa);
+
+   struct pipe_rasterizer_state rs = {0};
+   rs.half_pixel_center = 1;
+   rs.bottom_edge_rule = 1;
+   rs.depth_clip_near = 1;
+   rs.depth_clip_far = 1;
+   cso_set_rasterizer(b->cso, &rs);
+
+   struct pipe_viewport_state viewport = {
+      .scale = { 0.5f * fb_size, 0.5f * fb_size, 1.0f },
+      .translate = { 0.5f * fb_size, 0.5f * fb_size, 0.0f },
+      .swizzle_x = PIPE_VIEWPORT_SWIZZLE_POSITIVE_X,
+      .swizzle_y = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Y,
+      .swizzle_z = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Z,
+      .swizzle_w = PIPE_VIEWPORT_SWIZZLE_POSITIVE_W,
+   };
+   cso_set_viewport(b->cso, &viewport);
+
+   static const enum tgsi_semantic vs_attribs[] = {
+      TGSI_SEMANTIC_POSITION,
+      TGSI_SEMANTIC_GENERIC
+   };
+   static const unsigned vs_indices[] = {0, 0};
+   b->vs = util_make_vertex_passthrough_shader(b->pipe, 2, vs_attribs,
+                                               vs_indices, false);
+   b->fs = util_make_fragment_passthrough_shader(b->pipe,
+                                                 TGSI_SEMANTIC_GENERIC,
+                                                 TGSI_INTERPOLATE_LINEAR,
+                                                 true);
+   cso_set_vertex_shader_handle(b->cso, b->vs);
+   cso_set_fragment_shader_handle(b->cso, b->fs);
+
+   return b->vs && b->fs;
+}
+
+
+static void
+lp_bench_fini(struct lp_bench *b)
+{
+   if (b->cso) {
+      cso_set_vertex_shader_handle(b->cso, NULL);
+      cso_set_fragment_shader_handle(b->cso, NULL);
+      cso_destroy_context(b->cso);
+   }
+   if (b->vs)
+      b->pipe->delete_vs_state(b->pipe, b->vs);
+   if (b->fs)
+      b->pipe->delete_fs_state(b->pipe, b->fs);
+   pipe_resource_reference(&b->cb, NULL);
+   if (b->pipe)
+      b->pipe->destroy(b->pipe);
+   if (b->screen)
+      b->screen->destroy(b->screen);
+}
+
+
+/* Flush and wait for the rasterizer. */
+static void
+lp_bench_finish(struct lp_bench *b)
+{
+   struct pipe_fence_handle *fence = NULL;
+
+   b->pipe->flush(b->pipe, &fence, 0);
+   b->screen->fence_finish(b->screen, NULL, fence, OS_TIMEOUT_INFINITE);
+   b->screen->fence_reference(b->screen, &fence, NULL);
+}
+
+
+/*
+ * Triangles of a few pixels spread over the framebuffer, with a position
+ * and a color per vertex.
+ */
+static struct pipe_resource *
+create_triangles(struct lp_bench *b, unsigned num_triangles)
+{
+   const unsigned grid = 256;
+   const float cell = 2.0f / grid;
+   float *data = malloc((size_t)num_triangles * 3 * 8 * sizeof(float));
+   if (!data)
+      return NULL;
+
+   float *v = data;
+   for (unsigned t = 0; t < num_triangles; t++) {
+      const float x = -1.0f + (t % grid) * cell;
+      const float y = -1.0f + (t / grid % grid) * cell;
+      const float pos[3][2] = {
+         { x, y }, { x + cell, y }, { x, y + cell },
+      };
+
+      for (unsigned i = 0; i < 3; i++) {
+         *v++ = pos[i][0];
+         *v++ = pos[i][1];
+         *v++ = 0.0f;
+         *v++ = 1.0f;
+         *v++ = (t % 7) / 7.0f;
+         *v++ = i / 2.0f;
+         *v++ = 0.5f;
+         *v++ = 1.0f;
+      }
+   }
+
+   struct pipe_resource *vbuf =
+      pipe_buffer_create_with_data(b->pipe, PIPE_BIND_VERTEX_BUFFER,
+                                   PIPE_USAGE_IMMUTABLE,
+                                   num_triangles * 3 * 8 * sizeof(float),
+                                   data);
+   free(data);
+   return vbuf;
+}
+
+
+static void
+set_vertex_elements(struct lp_bench *b)
+{
+   struct cso_velems_state velems;
+   memset(&velems, 0, sizeof(velems));
+   velems.count = 2;
+   for (unsigned i = 0; i < 2; i++) {
+      velems.velems[i].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+      velems.velems[i].src_offset = i * 16;
+      velems.velems[i].src_stride = 8 * sizeof(float);
+   }
+   cso_set_vertex_elements(b->cso, &velems);
+}
+
+
+static bool
+bench_geometry(struct lp_bench *b, unsigned num_triangles,
+               unsigned iterations)
+{
+   struct pipe_resource *vbuf = create_triangles(b, num_triangles);
+   if (!vbuf)
+      return false;
+
+   set_vertex_elements(b);
+
+   struct pipe_vertex_buffer vb = {0};
+   vb.buffer.resource = vbuf;
+   cso_set_vertex_buffers(b->cso, 1, &vb);
+
+   /* Compiles the shader variants */
+   cso_draw_arrays(b->cso, MESA_PRIM_TRIANGLES, 0, 3);
+   lp_bench_finish(b);
+
+   int64_t start = os_time_get_nano();
+   for (unsigned i = 0; i < iterations; i++) {
+      cso_draw_arrays(b->cso, MESA_PRIM_TRIANGLES, 0, num_triangles * 3);
+      lp_bench_finish(b);
+   }
+   int64_t elapsed = MAX2(os_time_get_nano() - start, 1);
+
+   const char *vs_threads = os_get_option("DRAW_VS_THREADS");
+   printf("geometry: %u triangles, %u rasterizer threads, "
+          "DRAW_VS_THREADS=%s: %8.2f Mtri/s\n",
+          num_triangles, llvmpipe_screen(b->screen)->num_threads,
+          vs_threads ? vs_threads : "0",
+          (double)num_triangles * iterations * 1000.0 / elapsed);
+
+   cso_set_vertex_buffers(b->cso, 0, NULL);
+   pipe_resource_reference(&vbuf, NULL);
+   return true;
+}
+
+
+/*
+ * Additively blended fullscreen quads, so that no draw can be discarded as
+ * overwritten by the next one.
+ */
+static double
+bench_raster(struct lp_bench *b, unsigned num_quads)
+{
+   static const float quad[6][8] = {
+      { -1, -1, 0, 1,  1, 0, 0, 1 },
+      {  1, -1, 0, 1,  0, 1, 0, 1 },
+      { -1,  1, 0, 1,  0, 0, 1, 1 },
+      { -1,  1, 0, 1,  0, 0, 1, 1 },
+      {  1, -1, 0, 1,  0, 1, 0, 1 },
+      {  1,  1, 0, 1,  1, 1, 1, 1 },
+   };
+   struct pipe_resource *vbuf =
+      pipe_buffer_create_with_data(b->pipe, PIPE_BIND_VERTEX_BUFFER,
+                                   PIPE_USAGE_IMMUTABLE, sizeof(quad), quad);
+   if (!vbuf)
+      return 0.0;
+
+   struct pipe_blend_state blend = {0};
+   blend.rt[0].blend_enable = 1;
+   blend.rt[0].rgb_func = PIPE_BLEND_ADD;
+   blend.rt[0].rgb_src_factor = PIPE_BLENDFACTOR_ONE;
+   blend.rt[0].rgb_dst_factor = PIPE_BLENDFACTOR_ONE;
+   blend.rt[0].alpha_func = PIPE_BLEND_ADD;
+   blend.rt[0].alpha_src_factor = PIPE_BLENDFACTOR_ONE;
+   blend.rt[0].alpha_dst_factor = PIPE_BLENDFACTOR_ONE;
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+   cso_set_blend(b->cso, &blend);
+
+   set_vertex_elements(b);
+
+   struct pipe_vertex_buffer vb = {0};
+   vb.buffer.resource = vbuf;
+   cso_set_vertex_buffers(b->cso, 1, &vb);
+
+   /* Compiles the shader variants */
+   cso_draw_arrays(b->cso, MESA_PRIM_TRIANGLES, 0, 6);
+   lp_bench_finish(b);
+
+   int64_t start = os_time_get_nano();
+   for (unsigned i = 0; i < num_quads; i++)
+      cso_draw_arrays(b->cso, MESA_PRIM_TRIANGLES, 0, 6);
+   lp_bench_finish(b);
+   int64_t elapsed = MAX2(os_time_get_nano() - start, 1);
+
+   cso_set_vertex_buffers(b->cso, 0, NULL);
+   pipe_resource_reference(&vbuf, NULL);
+
+   return (double)b->fb_size * b->fb_size * num_quads * 1000.0 / elapsed;
+}
+
+
+#define COMPUTE_ALU_OPS 64
+
+/*
+ * One invocation per pixel of the color buffer, each doing a chain of
+ * COMPUTE_ALU_OPS dependent multiply-adds before storing the result.
+ */
+static nir_shader *
+create_compute_shader(struct lp_bench *b)
+{
+   nir_builder nb =
+      nir_builder_init_simple_shader(MESA_SHADER_COMPUTE,
+                                     b->screen->nir_options[MESA_SHADER_COMPUTE],
+                                     "lp_bench_cs");
+   nb.shader->info.workgroup_size[0] = 8;
+   nb.shader->info.workgroup_size[1] = 8;
+   nb.shader->info.workgroup_size[2] = 1;
+   nb.shader->info.num_images = 1;
+   BITSET_SET(nb.shader->info.images_used, 0);
+
+   nir_def *id = nir_iadd(&nb, nir_imul_imm(&nb, nir_load_workgroup_id(&nb), 8),
+                          nir_load_local_invocation_id(&nb));
+   nir_def *x = nir_channel(&nb, id, 0);
+   nir_def *y = nir_channel(&nb, id, 1);
+   nir_def *v = nir_u2f32(&nb, nir_vec4(&nb, x, y, x, y));
+
+   for (unsigned i = 0; i < COMPUTE_ALU_OPS; i++) {
+      v = nir_fmul(&nb, v, nir_imm_vec4(&nb, 0.999f, 0.998f, 0.997f, 0.0f));
+      v = nir_fadd(&nb, v, nir_imm_vec4(&nb, 0.5f, 0.25f, 0.125f, 1.0f));
+   }
+
+   nir_def *coord = nir_vec4(&nb, x, y, nir_undef(&nb, 1, 32),
+                             nir_undef(&nb, 1, 32));
+   nir_image_store(&nb, nir_imm_int(&nb, 0), coord, nir_imm_int(&nb, 0), v,
+                   nir_imm_int(&nb, 0), .access = ACCESS_NON_READABLE,
+                   .image_dim = GLSL_SAMPLER_DIM_2D, .image_array = false,
+                   .src_type = nir_type_float32);
+
+   b->screen->finalize_nir(b->screen, nb.shader, true);
+   return nb.shader;
+}
+
+
+static double
+bench_compute(struct lp_bench *b, unsigned iterations)
+{
+   struct pipe_compute_state state = {0};
+   state.ir_type = PIPE_SHADER_IR_NIR;
+   state.prog = create_compute_shader(b);
+   void *cs = b->pipe->create_compute_state(b->pipe, &state);
+   if (!cs)
+      return 0.0;
+   b->pipe->bind_compute_state(b->pipe, cs);
+
+   struct pipe_image_view image = {0};
+   image.resource = b->cb;
+   image.shader_access = image.access = PIPE_IMAGE_ACCESS_WRITE;
+   image.format = b->cb->format;
+   b->pipe->set_shader_images(b->pipe, MESA_SHADER_COMPUTE, 0, 1, 0, &image);
+
+   struct pipe_grid_info info = {0};
+   info.block[0] = 8;
+   info.block[1] = 8;
+   info.block[2] = 1;
+   info.grid[0] = b->fb_size / 8;
+   info.grid[1] = b->fb_size / 8;
+   info.grid[2] = 1;
+
+   /* Compiles the shader variant */
+   b->pipe->launch_grid(b->pipe, &info);
+   lp_bench_finish(b);
+
+   int64_t start = os_time_get_nano();
+   for (unsigned i = 0; i < iterations; i++)
+      b->pipe->launch_grid(b->pipe, &info);
+   lp_bench_finish(b);
+   int64_t elapsed = MAX2(os_time_get_nano() - start, 1);
+
+   b->pipe->set_shader_images(b->pipe, MESA_SHADER_COMPUTE, 0, 0, 1, NULL);
+   b->pipe->bind_compute_state(b->pipe, NULL);
+   b->pipe->delete_compute_state(b->pipe, cs);
+
+   return (double)b->fb_size * b->fb_size * iterations * 1000.0 / elapsed;
+}
+
+
+/*
+ * Runs the raster or compute benchmark on a new screen for each thread
+ * count, since LP_NUM_THREADS is read when the screen is created.
+ */
+static bool
+bench_scaling(const char *mode, unsigned num_counts, char **counts)
+{
+   static const char *default_counts[] = {
+      "1", "2", "4", "8", "16", "32", "48", "64", "96", "128",
+   };
+   const bool compute = strcmp(mode, "compute") == 0;
+   double base = 0.0;
+
+   if (num_counts == 0) {
+      num_counts = ARRAY_SIZE(default_counts);
+      counts = (char **)default_counts;
+   }
+
+   for (unsigned i = 0; i < num_counts; i++) {
+      struct lp_bench b;
+      double rate = 0.0;
+
+      setenv("LP_NUM_THREADS", counts[i], 1);
+      if (lp_bench_init(&b, SCALING_FB_SIZE))
+         rate = compute ? bench_compute(&b, 16) : bench_raster(&b, 64);
+      unsigned num_threads =
+         b.screen ? llvmpipe_screen(b.screen)->num_threads : 0;
+      lp_bench_fini(&b);
+
+      if (rate == 0.0)
+         return false;
+      if (i == 0)
+         base = rate;
+
+      printf("%s: %4u threads: %10.2f M%s/s, %6.2fx\n", mode, num_threads,
+             rate, compute ? "invocation" : "pix", rate / base);
+   }
+
+   return true;
+}
+
+
+int
+main(int argc, char **argv)
+{
+   const char *mode = argc > 1 ? argv[1] : "geometry";
+   struct lp_bench b;
+   bool success = false;
+
+   if (strcmp(mode, "geometry") == 0) {
+      unsigned num_triangles = argc > 2 ? atoi(argv[2]) : 1 << 20;
+      unsigned iterations = argc > 3 ? atoi(argv[3]) : 8;
+
+      if (lp_bench_init(&b, FB_SIZE))
+         success = bench_geometry(&b, num_triangles, iterations);
+      lp_bench_fini(&b);
+   } else if (strcmp(mode, "raster") == 0 || strcmp(mode, "compute") == 0) {
+      success = bench_scaling(mode, argc - 2, argv + 2);
+   } else {
+      fprintf(stderr, "unknown mode %s\n", mode);
+   }
+
+   return success ? 0 : 1;
+}
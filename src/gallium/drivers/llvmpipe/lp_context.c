@@ -274,11 +274,15 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    }
 #endif
 
-   list_inithead(&llvmpipe->fs_variants_list.list);
+   lp_variant_cache_init(&llvmpipe->fs_variants,
+                         LP_MAX_SHADER_CODE_SIZE, LP_MAX_SHADER_VARIANTS);
 
-   list_inithead(&llvmpipe->setup_variants_list.list);
+   /* Setup variants are small and similar, so they are simply counted */
+   lp_variant_cache_init(&llvmpipe->setup_variants,
+                         LP_MAX_SETUP_VARIANTS, LP_MAX_SETUP_VARIANTS);
 
-   list_inithead(&llvmpipe->cs_variants_list.list);
+   lp_variant_cache_init(&llvmpipe->cs_variants,
+                         LP_MAX_SHADER_CODE_SIZE, LP_MAX_SHADER_VARIANTS);
 
    llvmpipe->pipe.screen = screen;
    llvmpipe->pipe.priv = priv;
@@ -165,19 +165,22 @@ struct llvmpipe_context {
 
    unsigned tex_timestamp;
 
-   /** List of all fragment shader variants */
-   struct lp_fs_variant_list_item fs_variants_list;
+   /** Start a new texture cache generation with the next scene/dispatch */
+   bool tex_cache_flushed;
+
+   /** All fragment shader variants */
+   struct lp_variant_cache fs_variants;
    unsigned nr_fs_variants;
    unsigned nr_fs_instrs;
 
    bool permit_linear_rasterizer;
    bool single_vp;
 
-   struct lp_setup_variant_list_item setup_variants_list;
+   struct lp_variant_cache setup_variants;
    unsigned nr_setup_variants;
 
-   /** List of all compute shader variants */
-   struct lp_cs_variant_list_item cs_variants_list;
+   /** All compute shader variants */
+   struct lp_variant_cache cs_variants;
    unsigned nr_cs_variants;
    unsigned nr_cs_instrs;
    struct lp_cs_context *csctx;
@@ -29,15 +29,89 @@
  */
 
 #include "util/u_thread.h"
+#include "util/u_atomic.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
 #include "lp_cs_tpool.h"
+#include "lp_screen.h"
 #include "compiler/shader_enums.h"
 
+
+/**
+ * Try to claim up to chunk iterations from a range.  The owner of the
+ * range claims from the front, other threads steal from the back, so
+ * owners keep working on contiguous iterations as long as possible.
+ * \return  number of claimed iterations, starting at *start
+ */
+static unsigned
+lp_cs_tpool_claim(struct lp_cs_tpool_range *range, unsigned chunk,
+                  bool steal, unsigned *start)
+{
+   uint64_t old = p_atomic_read(&range->state);
+
+   while (1) {
+      const unsigned begin = (uint32_t)old;
+      const unsigned end = old >> 32;
+
+      if (begin >= end)
+         return 0;
+
+      const unsigned count = MIN2(chunk, end - begin);
+      const uint64_t new_state = steal ?
+         ((uint64_t)(end - count) << 32) | begin :
+         ((uint64_t)end << 32) | (begin + count);
+
+      const uint64_t prev = p_atomic_cmpxchg(&range->state, old, new_state);
+      if (prev == old) {
+         *start = steal ? end - count : begin;
+         return count;
+      }
+      old = prev;
+   }
+}
+
+
+/**
+ * Execute iterations of a task until none are left: first from the
+ * calling thread's own range, then stolen from the other ranges.
+ */
+static void
+lp_cs_tpool_run_task(struct lp_cs_tpool_task *task, unsigned slot,
+                     struct lp_cs_local_mem *lmem)
+{
+   for (unsigned i = 0; i < task->num_ranges; i++) {
+      struct lp_cs_tpool_range *range =
+         &task->ranges[(slot + i) % task->num_ranges];
+      unsigned start, count;
+
+      while ((count = lp_cs_tpool_claim(range, task->chunk, i != 0, &start))) {
+         for (unsigned j = 0; j < count; j++)
+            task->work(task->data, start + j, lmem);
+      }
+   }
+}
+
+
+static bool
+lp_cs_tpool_flush_denorms(const struct lp_cs_tpool_task *task)
+{
+   const struct lp_cs_job_info *job_info = task->data;
+   return job_info->current->variant->stage != MESA_SHADER_KERNEL;
+}
+
+
+static void
+lp_cs_local_mem_fini(struct lp_cs_local_mem *lmem)
+{
+   FREE(lmem->local_mem_ptr);
+   align_free(lmem->tex_cache);
+}
+
 static int
 lp_cs_tpool_worker(void *data)
 {
-   struct lp_cs_tpool *pool = data;
+   struct lp_cs_tpool_thread *thread = data;
+   struct lp_cs_tpool *pool = thread->pool;
    struct lp_cs_local_mem lmem;
 
    memset(&lmem, 0, sizeof(lmem));
@@ -48,7 +122,6 @@ lp_cs_tpool_worker(void *data)
 
    while (!pool->shutdown) {
       struct lp_cs_tpool_task *task;
-      unsigned iter_per_thread;
 
       while (list_is_empty(&pool->workqueue) && !pool->shutdown)
          cnd_wait(&pool->new_work, &pool->m);
@@ -58,26 +131,11 @@ lp_cs_tpool_worker(void *data)
 
       task = list_first_entry(&pool->workqueue, struct lp_cs_tpool_task,
                               list);
-
-      unsigned this_iter = task->iter_start;
-
-      iter_per_thread = task->iter_per_thread;
-
-      if (task->iter_remainder &&
-          task->iter_start + task->iter_remainder == task->iter_total) {
-         task->iter_remainder--;
-         iter_per_thread = 1;
-      }
-
-      task->iter_start += iter_per_thread;
-
-      if (task->iter_start == task->iter_total)
-         list_del(&task->list);
+      task->num_workers++;
 
       mtx_unlock(&pool->m);
 
-      struct lp_cs_job_info *job_info = task->data;
-      if ((job_info->current->variant->stage == MESA_SHADER_KERNEL) == flush_denorms) {
+      if (lp_cs_tpool_flush_denorms(task) != flush_denorms) {
          if (flush_denorms) {
             util_fpstate_set(fpstate);
             flush_denorms = false;
@@ -86,16 +144,19 @@ lp_cs_tpool_worker(void *data)
             flush_denorms = true;
          }
       }
-      for (unsigned i = 0; i < iter_per_thread; i++)
-         task->work(task->data, this_iter + i, &lmem);
+
+      lp_cs_tpool_run_task(task, thread->index, &lmem);
 
       mtx_lock(&pool->m);
-      task->iter_finished += iter_per_thread;
-      if (task->iter_finished == task->iter_total)
+
+      /* All iterations have been claimed, don't hand the task out again. */
+      list_delinit(&task->list);
+
+      if (--task->num_workers == 0)
          cnd_broadcast(&task->finish);
    }
    mtx_unlock(&pool->m);
-   FREE(lmem.local_mem_ptr);
+   lp_cs_local_mem_fini(&lmem);
    return 0;
 }
 
@@ -112,11 +173,25 @@ lp_cs_tpool_create(unsigned num_threads)
 
    list_inithead(&pool->workqueue);
    assert (num_threads <= LP_MAX_THREADS);
+   if (num_threads) {
+      pool->threads = CALLOC(num_threads, sizeof(*pool->threads));
+      if (!pool->threads) {
+         cnd_destroy(&pool->new_work);
+         mtx_destroy(&pool->m);
+         FREE(pool);
+         return NULL;
+      }
+   }
    for (unsigned i = 0; i < num_threads; i++) {
-      if (thrd_success != u_thread_create(pool->threads + i, lp_cs_tpool_worker, pool)) {
+      pool->threads[i].pool = pool;
+      pool->threads[i].index = i;
+      if (thrd_success != u_thread_create(&pool->threads[i].thread,
+                                          lp_cs_tpool_worker,
+                                          &pool->threads[i])) {
          num_threads = i;  /* previous thread is max */
          break;
       }
+      llvmpipe_set_thread_affinity(pool->threads[i].thread, i, num_threads);
    }
    pool->num_threads = num_threads;
    return pool;
@@ -134,11 +209,12 @@ lp_cs_tpool_destroy(struct lp_cs_tpool *pool)
    mtx_unlock(&pool->m);
 
    for (unsigned i = 0; i < pool->num_threads; i++) {
-      thrd_join(pool->threads[i], NULL);
+      thrd_join(pool->threads[i].thread, NULL);
    }
 
    cnd_destroy(&pool->new_work);
    mtx_destroy(&pool->m);
+   FREE(pool->threads);
    FREE(pool);
 }
 
@@ -165,24 +241,40 @@ lp_cs_tpool_queue_task(struct lp_cs_tpool *pool,
       for (unsigned t = 0; t < num_iters; t++) {
          work(data, t, &lmem);
       }
-      FREE(lmem.local_mem_ptr);
+      lp_cs_local_mem_fini(&lmem);
 
       if (flush_denorms) {
          util_fpstate_set(fpstate);
       }
       return NULL;
    }
-   task = CALLOC_STRUCT(lp_cs_tpool_task);
+
+   /* One range per pool thread, plus one for the thread which waits for
+    * the task, see lp_cs_tpool_wait_for_task().
+    */
+   const unsigned num_ranges = pool->num_threads + 1;
+   task = CALLOC_VARIANT_LENGTH_STRUCT(lp_cs_tpool_task,
+                                       num_ranges * sizeof(task->ranges[0]));
    if (!task) {
       return NULL;
    }
 
    task->work = work;
    task->data = data;
-   task->iter_total = num_iters;
-
-   task->iter_per_thread = num_iters / pool->num_threads;
-   task->iter_remainder = num_iters % pool->num_threads;
+   task->num_ranges = num_ranges;
+
+   /* Split the iterations evenly over the ranges, and let threads claim
+    * them a quarter range at a time so that there is something left to
+    * steal when threads finish unevenly.
+    */
+   const unsigned iter_per_range = DIV_ROUND_UP(num_iters, num_ranges);
+   task->chunk = MAX2(1, iter_per_range / 4);
+
+   for (unsigned i = 0; i < num_ranges; i++) {
+      const unsigned begin = MIN2(i * iter_per_range, num_iters);
+      const unsigned end = MIN2(begin + iter_per_range, num_iters);
+      task->ranges[i].state = ((uint64_t)end << 32) | begin;
+   }
 
    cnd_init(&task->finish);
 
@@ -204,8 +296,29 @@ lp_cs_tpool_wait_for_task(struct lp_cs_tpool *pool,
    if (!pool || !task)
       return;
 
+   /* Rather than just blocking, help executing the task. */
+   struct lp_cs_local_mem lmem;
+   unsigned fpstate = 0;
+   const bool flush_denorms = lp_cs_tpool_flush_denorms(task);
+
+   if (flush_denorms) {
+      fpstate = util_fpstate_get();
+      util_fpstate_set_denorms_to_zero(fpstate);
+   }
+
+   memset(&lmem, 0, sizeof(lmem));
+   lp_cs_tpool_run_task(task, pool->num_threads, &lmem);
+   lp_cs_local_mem_fini(&lmem);
+
+   if (flush_denorms)
+      util_fpstate_set(fpstate);
+
+   /* Every iteration has been claimed, wait for the pool threads still
+    * executing some of them.
+    */
    mtx_lock(&pool->m);
-   while (task->iter_finished < task->iter_total)
+   list_delinit(&task->list);
+   while (task->num_workers)
       cnd_wait(&task->finish, &pool->m);
    mtx_unlock(&pool->m);
 
@@ -42,11 +42,20 @@
 
 #include "lp_limits.h"
 
+struct lp_cs_tpool;
+struct lp_build_format_cache;
+
+struct lp_cs_tpool_thread {
+   struct lp_cs_tpool *pool;
+   unsigned index;
+   thrd_t thread;
+};
+
 struct lp_cs_tpool {
    mtx_t m;
    cnd_t new_work;
 
-   thrd_t threads[LP_MAX_THREADS];
+   struct lp_cs_tpool_thread *threads;
    unsigned num_threads;
    struct list_head workqueue;
    bool shutdown;
@@ -55,20 +64,35 @@ struct lp_cs_tpool {
 struct lp_cs_local_mem {
    unsigned local_size;
    void *local_mem_ptr;
+   struct lp_build_format_cache *tex_cache;
 };
 
 typedef void (*lp_cs_tpool_task_func)(void *data, int iter_idx, struct lp_cs_local_mem *lmem);
 
+/**
+ * A contiguous range of iterations of a task, packed as begin (low 32 bits)
+ * and end (high 32 bits) so that it can be updated with a single atomic
+ * compare-and-swap.  Padded to avoid false sharing between threads.
+ */
+struct lp_cs_tpool_range {
+   uint64_t state;
+   uint8_t pad[56];
+};
+
+/**
+ * The iterations of a task are split evenly over one range per pool
+ * thread plus one for the waiting thread.  Each thread claims chunks of
+ * iterations from its own range, then steals chunks from the others.
+ */
 struct lp_cs_tpool_task {
    lp_cs_tpool_task_func work;
    void *data;
    struct list_head list;
    cnd_t finish;
-   unsigned iter_total;
-   unsigned iter_start;
-   unsigned iter_finished;
-   unsigned iter_per_thread;
-   unsigned iter_remainder;
+   unsigned num_workers;   /**< pool threads executing the task */
+   unsigned chunk;         /**< iterations claimed at a time */
+   unsigned num_ranges;
+   struct lp_cs_tpool_range ranges[];
 };
 
 struct lp_cs_tpool *lp_cs_tpool_create(unsigned num_threads);
@@ -65,6 +65,9 @@
 #define PERF_NO_ALPHATEST   0x80  	/* disable alpha testing */
 #define PERF_NO_RAST_LINEAR 0x100  	/* disable linear rast */
 #define PERF_NO_SHADE       0x200  	/* disable fragment shaders */
+#define PERF_NO_SCENE_PIPELINE 0x400	/* rasterize one scene at a time */
+#define PERF_NO_TEX_CACHE   0x800  	/* don't cache decoded texture blocks */
+#define PERF_NO_TIERED_JIT  0x1000 	/* fully optimize fs variants up front */
 
 
 extern int LP_PERF;
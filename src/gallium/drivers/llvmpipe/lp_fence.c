@@ -86,8 +86,7 @@ static int sync_fd_wait(int fd, uint64_t timeout)
 /**
  * Create a new fence object.
  *
- * The rank will be the number of bins in the scene.  Whenever a rendering
- * thread hits a fence command, it'll increment the fence counter.  When
+ * Each call to lp_fence_signal() increments the fence counter.  When
  * the counter == the rank, the fence is finished.
  *
  * \param rank  the expected finished value of the fence counter.
@@ -59,6 +59,8 @@ llvmpipe_flush(struct pipe_context *pipe,
    /* ask the setup module to flush */
    lp_setup_flush(llvmpipe->setup, reason);
 
+   llvmpipe->tex_cache_flushed = true;
+
    mtx_lock(&screen->rast_mutex);
    lp_rast_fence(screen->rast, (struct lp_fence **)fence);
    mtx_unlock(&screen->rast_mutex);
@@ -66,7 +66,12 @@
 
 #define LP_MAX_SAMPLES 8
 
-#define LP_MAX_THREADS 32
+/**
+ * Upper bound for the number of rasterizer and compute threads.  The
+ * per-thread state is allocated for the actual thread count, so this is
+ * only a sanity clamp for LP_NUM_THREADS.
+ */
+#define LP_MAX_THREADS 1024
 
 
 /**
@@ -76,10 +81,16 @@
 #define LP_MAX_SHADER_VARIANTS 1024
 
 /**
- * Max number of instructions (for all fragment shaders combined per context)
- * that will be kept around (counted in terms of llvm ir).
+ * Max size of the generated code (for all fragment shaders combined, and
+ * for all compute shaders combined, per context) that will be kept around.
+ */
+#define LP_MAX_SHADER_CODE_SIZE (32 * 1024 * 1024)
+
+/**
+ * Estimated code size per llvm ir instruction, for the variants whose
+ * object code size isn't known.
  */
-#define LP_MAX_SHADER_INSTRUCTIONS (2048 * LP_MAX_SHADER_VARIANTS)
+#define LP_SHADER_BYTES_PER_INSTR 8
 
 /**
  * Max number of setup variants that will be kept around.
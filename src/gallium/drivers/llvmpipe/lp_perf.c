@@ -25,6 +25,8 @@
  *
  **************************************************************************/
 
+#include <inttypes.h>
+
 #include "util/u_debug.h"
 #include "lp_debug.h"
 #include "lp_perf.h"
@@ -118,9 +120,35 @@ lp_print_counters(void)
       debug_printf("llvmpipe: nr_color_tile_load:           %9u\n", lp_count.nr_color_tile_load);
       debug_printf("llvmpipe: nr_color_tile_store:          %9u\n", lp_count.nr_color_tile_store);
 
+      if (lp_count.nr_tex_cache_access) {
+         p1 = 100.0 * (float) (lp_count.nr_tex_cache_access - lp_count.nr_tex_cache_miss) /
+              (float) lp_count.nr_tex_cache_access;
+      } else {
+         p1 = 0.0;
+      }
+
+      debug_printf("llvmpipe: nr_tex_cache_access:          %9" PRIu64 "\n", lp_count.nr_tex_cache_access);
+      debug_printf("llvmpipe:   nr_tex_cache_miss:          %9" PRIu64 " (%3.0f%% hit rate)\n", lp_count.nr_tex_cache_miss, p1);
+
       debug_printf("llvmpipe: nr_llvm_compiles:             %u\n", lp_count.nr_llvm_compiles);
       debug_printf("llvmpipe: total LLVM compile time:      %.2f sec\n", lp_count.llvm_compile_time / 1000000.0);
       debug_printf("llvmpipe: average LLVM compile time:    %.2f sec\n", lp_count.llvm_compile_time / 1000000.0 / lp_count.nr_llvm_compiles);
 
+      debug_printf("llvmpipe: nr_fs_tier_ups_queued:        %9u\n", lp_count.nr_fs_tier_ups_queued);
+      debug_printf("llvmpipe:   nr_fs_tier_ups:             %9u\n", lp_count.nr_fs_tier_ups);
+      debug_printf("llvmpipe:   nr_fs_tier_ups_dropped:     %9u\n", lp_count.nr_fs_tier_ups_dropped);
+
+      debug_printf("llvmpipe: nr_fs_variants_compiled:      %9u\n", lp_count.nr_fs_variants_compiled);
+      debug_printf("llvmpipe:   nr_fs_variant_disk_hits:    %9u\n", lp_count.nr_fs_variant_disk_hits);
+      debug_printf("llvmpipe: nr_fs_variant_memory_hits:    %9u\n", lp_count.nr_fs_variant_memory_hits);
+      debug_printf("llvmpipe: nr_fs_variants_evicted:       %9u\n", lp_count.nr_fs_variants_evicted);
+      debug_printf("llvmpipe: total fs variant compile time: %.2f sec\n", lp_count.fs_compile_time / 1000000.0);
+
+      debug_printf("llvmpipe: nr_variants_promoted:         %9u\n", lp_count.nr_variants_promoted);
+      debug_printf("llvmpipe: nr_variant_ghost_hits:        %9u\n", lp_count.nr_variant_ghost_hits);
+      debug_printf("llvmpipe: nr_variants_evicted_probation: %8u\n", lp_count.nr_variants_evicted_probation);
+      debug_printf("llvmpipe: nr_variants_evicted_protected: %8u\n", lp_count.nr_variants_evicted_protected);
+      debug_printf("llvmpipe: variant_bytes_evicted:        %9" PRIu64 "\n", lp_count.variant_bytes_evicted);
+
    }
 }
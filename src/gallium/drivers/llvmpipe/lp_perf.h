@@ -65,9 +65,31 @@ struct lp_counters
    unsigned nr_llvm_compiles;
    int64_t llvm_compile_time;  /**< total, in microseconds */
 
+   /* Tiered fs variant compilation, always counted (atomically) */
+   unsigned nr_fs_tier_ups_queued;
+   unsigned nr_fs_tier_ups;
+   unsigned nr_fs_tier_ups_dropped;
+
+   /* Fragment shader variant cache, always counted (atomically) */
+   unsigned nr_fs_variants_compiled;
+   unsigned nr_fs_variant_disk_hits;    /**< compiles served by the disk cache */
+   unsigned nr_fs_variant_memory_hits;  /**< lookups served by the variant list */
+   unsigned nr_fs_variants_evicted;
+   uint64_t fs_compile_time;            /**< total, in microseconds */
+
+   /* Shader variant cache replacement, always counted (atomically) */
+   unsigned nr_variants_promoted;          /**< probation -> protected */
+   unsigned nr_variant_ghost_hits;         /**< recompiled soon after eviction */
+   unsigned nr_variants_evicted_probation;
+   unsigned nr_variants_evicted_protected;
+   uint64_t variant_bytes_evicted;
+
    unsigned nr_color_tile_clear;
    unsigned nr_color_tile_load;
    unsigned nr_color_tile_store;
+
+   uint64_t nr_tex_cache_access;  /**< texels fetched through the block cache */
+   uint64_t nr_tex_cache_miss;    /**< blocks decoded into the block cache */
 };
 
 
@@ -32,11 +32,13 @@
 
 #include "draw/draw_context.h"
 #include "pipe/p_defines.h"
+#include "util/u_atomic.h"
 #include "util/u_memory.h"
 #include "util/os_time.h"
 #include "lp_context.h"
 #include "lp_flush.h"
 #include "lp_fence.h"
+#include "lp_perf.h"
 #include "lp_query.h"
 #include "lp_screen.h"
 #include "lp_state.h"
@@ -50,17 +52,85 @@ llvmpipe_query(struct pipe_query *p)
 }
 
 
+static const struct pipe_driver_query_info lp_driver_queries[] = {
+   {"fs-variants-compiled", LP_QUERY_FS_VARIANTS_COMPILED, { 0 },
+    PIPE_DRIVER_QUERY_TYPE_UINT64, PIPE_DRIVER_QUERY_RESULT_TYPE_CUMULATIVE},
+   {"fs-variant-disk-hits", LP_QUERY_FS_VARIANT_DISK_HITS, { 0 },
+    PIPE_DRIVER_QUERY_TYPE_UINT64, PIPE_DRIVER_QUERY_RESULT_TYPE_CUMULATIVE},
+   {"fs-variant-memory-hits", LP_QUERY_FS_VARIANT_MEMORY_HITS, { 0 },
+    PIPE_DRIVER_QUERY_TYPE_UINT64, PIPE_DRIVER_QUERY_RESULT_TYPE_CUMULATIVE},
+   {"fs-variants-evicted", LP_QUERY_FS_VARIANTS_EVICTED, { 0 },
+    PIPE_DRIVER_QUERY_TYPE_UINT64, PIPE_DRIVER_QUERY_RESULT_TYPE_CUMULATIVE},
+   {"fs-compile-time", LP_QUERY_FS_COMPILE_TIME, { 0 },
+    PIPE_DRIVER_QUERY_TYPE_MICROSECONDS, PIPE_DRIVER_QUERY_RESULT_TYPE_CUMULATIVE},
+   {"fs-tier-ups", LP_QUERY_FS_TIER_UPS, { 0 },
+    PIPE_DRIVER_QUERY_TYPE_UINT64, PIPE_DRIVER_QUERY_RESULT_TYPE_CUMULATIVE},
+};
+
+
+int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info)
+{
+   if (!info)
+      return ARRAY_SIZE(lp_driver_queries);
+
+   if (index >= ARRAY_SIZE(lp_driver_queries))
+      return 0;
+
+   *info = lp_driver_queries[index];
+   return 1;
+}
+
+
+/**
+ * Current value of the counter behind a driver specific query.  The
+ * counters are global, so the queries also see the compiles of other
+ * contexts.
+ */
+static uint64_t
+lp_driver_query_value(unsigned type)
+{
+   switch (type) {
+   case LP_QUERY_FS_VARIANTS_COMPILED:
+      return p_atomic_read(&lp_count.nr_fs_variants_compiled);
+   case LP_QUERY_FS_VARIANT_DISK_HITS:
+      return p_atomic_read(&lp_count.nr_fs_variant_disk_hits);
+   case LP_QUERY_FS_VARIANT_MEMORY_HITS:
+      return p_atomic_read(&lp_count.nr_fs_variant_memory_hits);
+   case LP_QUERY_FS_VARIANTS_EVICTED:
+      return p_atomic_read(&lp_count.nr_fs_variants_evicted);
+   case LP_QUERY_FS_COMPILE_TIME:
+      return p_atomic_read(&lp_count.fs_compile_time);
+   case LP_QUERY_FS_TIER_UPS:
+      return p_atomic_read(&lp_count.nr_fs_tier_ups);
+   default:
+      assert(0);
+      return 0;
+   }
+}
+
+
 static struct pipe_query *
 llvmpipe_create_query(struct pipe_context *pipe,
                       unsigned type,
                       unsigned index)
 {
-   assert(type < PIPE_QUERY_TYPES);
+   assert(type < PIPE_QUERY_TYPES || type >= PIPE_QUERY_DRIVER_SPECIFIC);
+
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   const unsigned num_threads = MAX2(1, screen->num_threads);
 
-   struct llvmpipe_query *pq = CALLOC_STRUCT(llvmpipe_query);
+   struct llvmpipe_query *pq =
+      CALLOC_VARIANT_LENGTH_STRUCT(llvmpipe_query,
+                                   2 * num_threads * sizeof(uint64_t));
    if (pq) {
       pq->type = type;
       pq->index = index;
+      pq->num_threads = num_threads;
+      pq->start = pq->counters;
+      pq->end = pq->counters + num_threads;
    }
 
    return (struct pipe_query *) pq;
@@ -99,6 +169,11 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
    const unsigned num_threads = MAX2(1, screen->num_threads);
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+      result->u64 = pq->end[0] - pq->start[0];
+      return true;
+   }
+
    if (pq->fence) {
       /* only have a fence if there was a scene */
       if (!lp_fence_signalled(pq->fence)) {
@@ -400,6 +475,11 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+      pq->start[0] = pq->end[0] = lp_driver_query_value(pq->type);
+      return true;
+   }
+
    /* Check if the query is already in the scene.  If so, we need to
     * flush the scene now.  Real apps shouldn't re-use a query in a
     * frame of rendering.
@@ -408,8 +488,8 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
       llvmpipe_finish(pipe, __func__);
    }
 
-   memset(pq->start, 0, sizeof(pq->start));
-   memset(pq->end, 0, sizeof(pq->end));
+   memset(pq->start, 0, pq->num_threads * sizeof(*pq->start));
+   memset(pq->end, 0, pq->num_threads * sizeof(*pq->end));
    lp_setup_begin_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
@@ -462,6 +542,11 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+      pq->end[0] = lp_driver_query_value(pq->type);
+      return true;
+   }
+
    lp_setup_end_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
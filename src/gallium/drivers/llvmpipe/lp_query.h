@@ -39,11 +39,23 @@
 
 
 struct llvmpipe_context;
+struct pipe_driver_query_info;
+struct pipe_screen;
+
+
+/* Driver specific queries, for the HUD */
+#define LP_QUERY_FS_VARIANTS_COMPILED     (PIPE_QUERY_DRIVER_SPECIFIC + 0)
+#define LP_QUERY_FS_VARIANT_DISK_HITS     (PIPE_QUERY_DRIVER_SPECIFIC + 1)
+#define LP_QUERY_FS_VARIANT_MEMORY_HITS   (PIPE_QUERY_DRIVER_SPECIFIC + 2)
+#define LP_QUERY_FS_VARIANTS_EVICTED      (PIPE_QUERY_DRIVER_SPECIFIC + 3)
+#define LP_QUERY_FS_COMPILE_TIME          (PIPE_QUERY_DRIVER_SPECIFIC + 4)
+#define LP_QUERY_FS_TIER_UPS              (PIPE_QUERY_DRIVER_SPECIFIC + 5)
 
 
 struct llvmpipe_query {
-   uint64_t start[LP_MAX_THREADS];  /* start count value for each thread */
-   uint64_t end[LP_MAX_THREADS];    /* end count value for each thread */
+   uint64_t *start;                 /* start count value for each thread */
+   uint64_t *end;                   /* end count value for each thread */
+   unsigned num_threads;            /* size of the start/end arrays */
    struct lp_fence *fence;          /* fence from last scene this was binned in */
    enum pipe_query_type type;
    unsigned index;
@@ -51,6 +63,8 @@ struct llvmpipe_query {
    unsigned num_primitives_written[PIPE_MAX_VERTEX_STREAMS];
 
    struct pipe_query_data_pipeline_statistics stats;
+
+   uint64_t counters[];             /* storage for start and end */
 };
 
 
@@ -58,4 +72,8 @@ extern void llvmpipe_init_query_funcs(struct llvmpipe_context * );
 
 extern bool llvmpipe_check_render_cond(struct llvmpipe_context *);
 
+extern int llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                                          unsigned index,
+                                          struct pipe_driver_query_info *info);
+
 #endif /* LP_QUERY_H */
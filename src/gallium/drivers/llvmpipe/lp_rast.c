@@ -79,11 +79,8 @@ const float lp_sample_pos_8x[8][2] = { { 0.5625, 0.3125 },
  * Called once per scene by one thread.
  */
 static void
-lp_rast_begin(struct lp_rasterizer *rast,
-              struct lp_scene *scene)
+lp_rast_begin(struct lp_scene *scene)
 {
-   rast->curr_scene = scene;
-
    LP_DBG(DEBUG_RAST, "%s\n", __func__);
 
    lp_scene_begin_rasterization(scene);
@@ -91,13 +88,6 @@ lp_rast_begin(struct lp_rasterizer *rast,
 }
 
 
-static void
-lp_rast_end(struct lp_rasterizer *rast)
-{
-   rast->curr_scene = NULL;
-}
-
-
 /**
  * Beginning rasterization of a tile.
  * \param x  window X position of the tile, in pixels
@@ -1031,20 +1021,6 @@ rasterize_bin(struct lp_rasterizer_task *task,
 }
 
 
-/* An empty bin is one that just loads the contents of the tile and
- * stores them again unchanged.  This typically happens when bins have
- * been flushed for some reason in the middle of a frame, or when
- * incremental updates are being made to a render target.
- *
- * Try to avoid doing pointless work in this case.
- */
-static bool
-is_empty_bin(const struct cmd_bin *bin)
-{
-   return bin->head == NULL;
-}
-
-
 /**
  * Rasterize/execute all bins within a scene.
  * Called per thread.
@@ -1055,47 +1031,27 @@ rasterize_scene(struct lp_rasterizer_task *task,
 {
    task->scene = scene;
 
-   /* Clear the cache tags. This should not always be necessary but
-    * simpler for now.
+   /* Cached texture blocks stay valid until a compressed texture changes.
+    * Scenes are handed to each thread in order, so generations only move
+    * forward here.
     */
-#if LP_USE_TEXTURE_CACHE
-   memset(task->thread_data.cache->cache_tags, 0,
-          sizeof(task->thread_data.cache->cache_tags));
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-   task->thread_data.cache->cache_access_total = 0;
-   task->thread_data.cache->cache_access_miss = 0;
-#endif
-#endif
+   lp_build_format_cache_validate(task->thread_data.cache,
+                                  scene->tex_cache_generation);
 
    if (!task->rast->no_rast) {
-      /* loop over scene bins, rasterize each */
+      /* loop over scene bins, rasterize each.  Empty bins, which would
+       * just load the contents of the tile and store them again
+       * unchanged, are skipped by the bin iterator.
+       */
       struct cmd_bin *bin;
       int i, j;
 
       assert(scene);
-      while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
-         if (!is_empty_bin(bin))
-            rasterize_bin(task, bin, i, j);
-      }
+      while ((bin = lp_scene_bin_iter_next(scene, &i, &j)))
+         rasterize_bin(task, bin, i, j);
    }
 
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-   {
-      uint64_t total, miss;
-      total = task->thread_data.cache->cache_access_total;
-      miss = task->thread_data.cache->cache_access_miss;
-      if (total) {
-         debug_printf("thread %d cache access %llu miss %llu hit rate %f\n",
-                 task->thread_index, (long long unsigned)total,
-                 (long long unsigned)miss,
-                 (float)(total - miss)/(float)total);
-      }
-   }
-#endif
-
-   if (scene->fence) {
-      lp_fence_signal(scene->fence);
-   }
+   lp_tex_cache_count(task->thread_data.cache);
 
    task->scene = NULL;
 }
@@ -1123,15 +1079,14 @@ lp_rast_queue_scene(struct lp_rasterizer *rast,
        */
       util_fpstate_set_denorms_to_zero(fpstate);
 
-      lp_rast_begin(rast, scene);
+      lp_rast_begin(scene);
 
       rasterize_scene(&rast->tasks[0], scene);
 
-      lp_rast_end(rast);
+      if (scene->fence)
+         lp_fence_signal(scene->fence);
 
       util_fpstate_set(fpstate);
-
-      rast->curr_scene = NULL;
    } else {
       /* threaded rendering! */
       lp_scene_enqueue(rast->full_scenes, scene);
@@ -1160,6 +1115,94 @@ lp_rast_finish(struct lp_rasterizer *rast)
 }
 
 
+/**
+ * Get the scene with the given sequence number, beginning it if this is
+ * the first thread to get to it, and wait until all the earlier scenes
+ * it depends on have been retired.
+ * Called per thread.
+ */
+static struct lp_scene *
+lp_rast_acquire_scene(struct lp_rasterizer *rast, unsigned seq)
+{
+   const unsigned slot = seq % LP_RAST_MAX_ACTIVE_SCENES;
+
+   mtx_lock(&rast->active_mutex);
+
+   /* Wait for a free slot if too many scenes are in flight.
+    */
+   while (seq == rast->num_begun &&
+          seq - rast->num_retired >= LP_RAST_MAX_ACTIVE_SCENES)
+      cnd_wait(&rast->active_cond, &rast->active_mutex);
+
+   if (seq == rast->num_begun) {
+      /* The work_ready semaphore was signalled after the scene was
+       * queued, so this won't block.
+       */
+      struct lp_scene *scene = lp_scene_dequeue(rast->full_scenes, true);
+      unsigned min_retired = rast->num_retired;
+
+      for (unsigned prev = rast->num_retired; prev != seq; prev++) {
+         const struct lp_scene *prev_scene =
+            rast->active[prev % LP_RAST_MAX_ACTIVE_SCENES].scene;
+
+         if ((LP_PERF & PERF_NO_SCENE_PIPELINE) ||
+             lp_scene_depends_on(scene, prev_scene))
+            min_retired = prev + 1;
+      }
+
+      lp_rast_begin(scene);
+
+      rast->active[slot].scene = scene;
+      rast->active[slot].min_retired = min_retired;
+      rast->active[slot].threads_left = rast->num_threads;
+      rast->num_begun++;
+   }
+
+   while ((int)(rast->num_retired - rast->active[slot].min_retired) < 0)
+      cnd_wait(&rast->active_cond, &rast->active_mutex);
+
+   struct lp_scene *scene = rast->active[slot].scene;
+
+   mtx_unlock(&rast->active_mutex);
+
+   return scene;
+}
+
+
+/**
+ * Called by each thread once it has run out of bins in the scene with the
+ * given sequence number.  Retire all the leading scenes every thread is
+ * done with, signalling their fences in order.
+ * Called per thread.
+ */
+static void
+lp_rast_release_scene(struct lp_rasterizer *rast, unsigned seq)
+{
+   mtx_lock(&rast->active_mutex);
+
+   rast->active[seq % LP_RAST_MAX_ACTIVE_SCENES].threads_left--;
+
+   while (rast->num_retired != rast->num_begun) {
+      const unsigned slot = rast->num_retired % LP_RAST_MAX_ACTIVE_SCENES;
+      if (rast->active[slot].threads_left)
+         break;
+
+      /* The scene may be reused by the setup code as soon as its fence
+       * is signalled, so don't touch it afterwards.
+       */
+      struct lp_scene *scene = rast->active[slot].scene;
+      rast->active[slot].scene = NULL;
+      rast->num_retired++;
+
+      if (scene->fence)
+         lp_fence_signal(scene->fence);
+   }
+
+   cnd_broadcast(&rast->active_cond);
+   mtx_unlock(&rast->active_mutex);
+}
+
+
 /**
  * This is the thread's main entrypoint.
  * It's a simple loop:
@@ -1193,33 +1236,19 @@ thread_function(void *init_data)
       if (rast->exit_flag)
          break;
 
-      if (task->thread_index == 0) {
-         /* thread[0]:
-          *  - get next scene to rasterize
-          *  - map the framebuffer surfaces
-          */
-         lp_rast_begin(rast, lp_scene_dequeue(rast->full_scenes, true));
-      }
-
-      /* Wait for all threads to get here so that threads[1+] don't
-       * get a null rast->curr_scene pointer.
+      /* Get the next scene to rasterize.  The first thread to get
+       * there maps the framebuffer surfaces.
        */
-      util_barrier_wait(&rast->barrier);
+      struct lp_scene *scene = lp_rast_acquire_scene(rast, task->scene_seq);
 
       /* do work */
       if (debug)
          debug_printf("thread %d doing work\n", task->thread_index);
 
-      rasterize_scene(task, rast->curr_scene);
-
-      /* wait for all threads to finish with this scene */
-      util_barrier_wait(&rast->barrier);
+      rasterize_scene(task, scene);
 
-      /* XXX: shouldn't be necessary:
-       */
-      if (task->thread_index == 0) {
-         lp_rast_end(rast);
-      }
+      lp_rast_release_scene(rast, task->scene_seq);
+      task->scene_seq++;
 
       /* signal done with work */
       if (debug)
@@ -1254,6 +1283,7 @@ create_rast_threads(struct lp_rasterizer *rast)
          rast->num_threads = i; /* previous thread is max */
          break;
       }
+      llvmpipe_set_thread_affinity(rast->threads[i], i, rast->num_threads);
    }
 }
 
@@ -1276,12 +1306,19 @@ lp_rast_create(unsigned num_threads)
       goto no_full_scenes;
    }
 
+   /* Even without threads, rendering uses the first task. */
+   rast->tasks = CALLOC(MAX2(1, num_threads), sizeof(*rast->tasks));
+   rast->threads = CALLOC(MAX2(1, num_threads), sizeof(*rast->threads));
+   if (!rast->tasks || !rast->threads) {
+      goto no_tasks;
+   }
+
    for (unsigned i = 0; i < MAX2(1, num_threads); i++) {
       struct lp_rasterizer_task *task = &rast->tasks[i];
       task->rast = rast;
       task->thread_index = i;
       task->thread_data.cache =
-         align_malloc(sizeof(struct lp_build_format_cache), 16);
+         align_calloc(sizeof(struct lp_build_format_cache), 16);
       if (!task->thread_data.cache) {
          goto no_thread_data_cache;
       }
@@ -1291,24 +1328,24 @@ lp_rast_create(unsigned num_threads)
 
    rast->no_rast = debug_get_bool_option("LP_NO_RAST", false);
 
-   create_rast_threads(rast);
+   (void) mtx_init(&rast->active_mutex, mtx_plain);
+   cnd_init(&rast->active_cond);
 
-   /* for synchronizing rasterization threads */
-   if (rast->num_threads > 0) {
-      util_barrier_init(&rast->barrier, rast->num_threads);
-   }
+   create_rast_threads(rast);
 
    memset(lp_dummy_tile, 0, sizeof lp_dummy_tile);
 
    return rast;
 
 no_thread_data_cache:
-   for (unsigned i = 0; i < MAX2(1, rast->num_threads); i++) {
+   for (unsigned i = 0; i < MAX2(1, num_threads); i++) {
       if (rast->tasks[i].thread_data.cache) {
          align_free(rast->tasks[i].thread_data.cache);
       }
    }
-
+no_tasks:
+   FREE(rast->tasks);
+   FREE(rast->threads);
    lp_scene_queue_destroy(rast->full_scenes);
 no_full_scenes:
    FREE(rast);
@@ -1363,13 +1400,13 @@ lp_rast_destroy(struct lp_rasterizer *rast)
 
    lp_fence_reference(&rast->last_fence, NULL);
 
-   /* for synchronizing rasterization threads */
-   if (rast->num_threads > 0) {
-      util_barrier_destroy(&rast->barrier);
-   }
+   cnd_destroy(&rast->active_cond);
+   mtx_destroy(&rast->active_mutex);
 
    lp_scene_queue_destroy(rast->full_scenes);
 
+   FREE(rast->tasks);
+   FREE(rast->threads);
    FREE(rast);
 }
 
@@ -42,6 +42,12 @@
 #define TILE_VECTOR_HEIGHT 4
 #define TILE_VECTOR_WIDTH 4
 
+/**
+ * Max number of scenes the rasterizer threads may be working on at the
+ * same time.  Must be a power of two.
+ */
+#define LP_RAST_MAX_ACTIVE_SCENES 4
+
 /* If we crash in a jitted function, we can examine jit_line and jit_state
  * to get some info.  This is not thread-safe, however.
  */
@@ -97,6 +103,9 @@ struct lp_rasterizer_task
    /** "my" index */
    unsigned thread_index;
 
+   /** Sequence number of the next scene this thread will work on */
+   unsigned scene_seq;
+
    /** Non-interpolated passthru state and occlude counter for visible pixels */
    struct lp_jit_thread_data thread_data;
 
@@ -121,17 +130,34 @@ struct lp_rasterizer
    /** The incoming queue of scenes ready to rasterize */
    struct lp_scene_queue *full_scenes;
 
-   /** The scene currently being rasterized by the threads */
-   struct lp_scene *curr_scene;
+   /**
+    * The scenes currently being rasterized by the threads, indexed by
+    * scene sequence number modulo LP_RAST_MAX_ACTIVE_SCENES.
+    *
+    * Every thread works through the scenes in sequence order, but a
+    * thread that has run out of bins in one scene may start on the next
+    * one while other threads are still busy, unless the next scene
+    * depends on an unfinished one (see lp_scene_depends_on()).  Scenes
+    * are retired, and their fences signalled, strictly in order.
+    */
+   struct {
+      struct lp_scene *scene;
+      unsigned min_retired;   /**< num_retired required before starting */
+      unsigned threads_left;  /**< threads which haven't finished it */
+   } active[LP_RAST_MAX_ACTIVE_SCENES];
 
-   /** A task object for each rasterization thread */
-   struct lp_rasterizer_task tasks[LP_MAX_THREADS];
+   unsigned num_begun;    /**< sequence number of the next scene to begin */
+   unsigned num_retired;  /**< sequence number of the oldest active scene */
 
-   unsigned num_threads;
-   thrd_t threads[LP_MAX_THREADS];
+   /** Protects the above and signals scene retirement */
+   mtx_t active_mutex;
+   cnd_t active_cond;
 
-   /** For synchronizing the rasterization threads */
-   util_barrier barrier;
+   /** A task object for each rasterization thread (at least one) */
+   struct lp_rasterizer_task *tasks;
+
+   unsigned num_threads;
+   thrd_t *threads;
 
    struct lp_fence *last_fence;
 };
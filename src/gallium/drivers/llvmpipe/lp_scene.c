@@ -25,6 +25,7 @@
  *
  **************************************************************************/
 
+#include "util/u_atomic.h"
 #include "util/u_framebuffer.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
@@ -103,6 +104,7 @@ lp_scene_destroy(struct lp_scene *scene)
    lp_scene_end_rasterization(scene);
    mtx_destroy(&scene->mutex);
    free(scene->tiles);
+   free(scene->bin_order);
    assert(scene->data.head == &scene->data.first);
    slab_free_st(&scene->setup->scene_slab, scene);
 }
@@ -534,64 +536,168 @@ lp_scene_is_resource_referenced(const struct lp_scene *scene,
 }
 
 
-/** advance curr_x,y to the next bin */
+/**
+ * Does the scene write the resource?  Unlike
+ * lp_scene_is_resource_referenced(), this finds resources which the scene
+ * both reads and writes.
+ */
 static bool
-next_bin(struct lp_scene *scene)
+lp_scene_writes_resource(const struct lp_scene *scene,
+                         const struct pipe_resource *resource)
 {
-   scene->curr_x++;
-   if (scene->curr_x >= scene->tiles_x) {
-      scene->curr_x = 0;
-      scene->curr_y++;
+   const struct resource_ref *ref;
+
+   for (unsigned j = 0; j < scene->fb.nr_cbufs; j++) {
+      if (scene->fb.cbufs[j].texture == resource)
+         return true;
    }
-   if (scene->curr_y >= scene->tiles_y) {
-      /* no more bins */
-      return false;
+   if (scene->fb.zsbuf.texture == resource)
+      return true;
+
+   for (ref = scene->writeable_resources; ref; ref = ref->next) {
+      for (int i = 0; i < ref->count; i++)
+         if (ref->resource[i] == resource)
+            return true;
    }
-   return true;
+
+   return false;
 }
 
 
+/**
+ * Does rasterizing this scene have to wait until the (earlier) prev scene
+ * has been completely rasterized?  That's the case when either scene
+ * writes a resource the other one references.  Render targets count as
+ * written.
+ */
+bool
+lp_scene_depends_on(const struct lp_scene *scene,
+                    const struct lp_scene *prev)
+{
+   const struct resource_ref *ref;
+
+   for (unsigned i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (scene->fb.cbufs[i].texture &&
+          lp_scene_is_resource_referenced(prev, scene->fb.cbufs[i].texture))
+         return true;
+   }
+   if (scene->fb.zsbuf.texture &&
+       lp_scene_is_resource_referenced(prev, scene->fb.zsbuf.texture))
+      return true;
+
+   for (ref = scene->writeable_resources; ref; ref = ref->next) {
+      for (int i = 0; i < ref->count; i++)
+         if (lp_scene_is_resource_referenced(prev, ref->resource[i]))
+            return true;
+   }
+
+   for (ref = scene->resources; ref; ref = ref->next) {
+      for (int i = 0; i < ref->count; i++)
+         if (lp_scene_writes_resource(prev, ref->resource[i]))
+            return true;
+   }
+
+   return false;
+}
+
+
+/** Extract the even bits of a Morton code (i.e. de-interleave). */
+static inline unsigned
+morton_compact(unsigned v)
+{
+   v &= 0x55555555;
+   v = (v | (v >> 1)) & 0x33333333;
+   v = (v | (v >> 2)) & 0x0f0f0f0f;
+   v = (v | (v >> 4)) & 0x00ff00ff;
+   v = (v | (v >> 8)) & 0x0000ffff;
+   return v;
+}
+
+
+/**
+ * Fill the first part of scene->bin_order with the indices of all the
+ * scene's tiles, visited in Morton order.  Rebuilding is only needed
+ * when the tile grid dimensions change.
+ */
+static void
+build_tile_order(struct lp_scene *scene)
+{
+   const unsigned dim =
+      util_next_power_of_two(MAX2(scene->tiles_x, scene->tiles_y));
+   unsigned n = 0;
+
+   for (unsigned code = 0; code < dim * dim; code++) {
+      const unsigned x = morton_compact(code);
+      const unsigned y = morton_compact(code >> 1);
+      if (x < scene->tiles_x && y < scene->tiles_y)
+         scene->bin_order[n++] = y * scene->tiles_x + x;
+   }
+   assert(n == lp_scene_get_num_bins(scene));
+
+   scene->bin_order_x = scene->tiles_x;
+   scene->bin_order_y = scene->tiles_y;
+}
+
+
+/**
+ * Prepare the scene's bins for rasterization.
+ * Called once per scene, by one thread, before any rasterizer thread
+ * calls lp_scene_bin_iter_next().
+ */
 void
 lp_scene_bin_iter_begin(struct lp_scene *scene)
 {
-   scene->curr_x = scene->curr_y = -1;
+   const unsigned num_bins = lp_scene_get_num_bins(scene);
+   unsigned *active_bins = scene->bin_order + scene->num_alloced_tiles;
+   unsigned n = 0;
+
+   if (scene->bin_order_x != scene->tiles_x ||
+       scene->bin_order_y != scene->tiles_y)
+      build_tile_order(scene);
+
+   /* Empty bins are never handed out, so threads don't need to spin
+    * through them.
+    */
+   for (unsigned i = 0; i < num_bins; i++) {
+      const unsigned idx = scene->bin_order[i];
+      if (scene->tiles[idx].head)
+         active_bins[n++] = idx;
+   }
+
+   scene->num_active_bins = n;
+   scene->curr_bin = 0;
 }
 
 
 /**
- * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
+ * Return pointer to next non-empty bin to be rendered, or NULL once all
+ * bins have been handed out.
  * Multiple rendering threads will call this function to get a chunk
- * of work (a bin) to work on.
+ * of work (a bin) to work on.  This is lock-free: each call claims one
+ * entry of the active bin list with an atomic increment.
  */
 struct cmd_bin *
-lp_scene_bin_iter_next(struct lp_scene *scene , int *x, int *y)
+lp_scene_bin_iter_next(struct lp_scene *scene, int *x, int *y)
 {
-   struct cmd_bin *bin = NULL;
+   const unsigned i = p_atomic_inc_return(&scene->curr_bin) - 1;
 
-   mtx_lock(&scene->mutex);
-
-   if (scene->curr_x < 0) {
-      /* first bin */
-      scene->curr_x = 0;
-      scene->curr_y = 0;
-   } else if (!next_bin(scene)) {
-      /* no more bins left */
-      goto end;
-   }
+   if (i >= scene->num_active_bins)
+      return NULL;
 
-   bin = lp_scene_get_bin(scene, scene->curr_x, scene->curr_y);
-   *x = scene->curr_x;
-   *y = scene->curr_y;
+   const unsigned idx = scene->bin_order[scene->num_alloced_tiles + i];
+   *x = idx % scene->tiles_x;
+   *y = idx / scene->tiles_x;
 
-end:
-   /*printf("return bin %p at %d, %d\n", (void *) bin, *bin_x, *bin_y);*/
-   mtx_unlock(&scene->mutex);
-   return bin;
+   return &scene->tiles[idx];
 }
 
 
-void
+/**
+ * Returns false if the bins for the framebuffer couldn't be allocated, in
+ * which case the scene keeps its previous (smaller) bins and must not be
+ * used for binning.
+ */
+bool
 lp_scene_begin_binning(struct lp_scene *scene,
                        struct pipe_framebuffer_state *fb)
 {
@@ -599,21 +705,37 @@ lp_scene_begin_binning(struct lp_scene *scene,
 
    util_copy_framebuffer_state(&scene->fb, fb);
 
-   scene->tiles_x = align(fb->width, TILE_SIZE) / TILE_SIZE;
-   scene->tiles_y = align(fb->height, TILE_SIZE) / TILE_SIZE;
-   assert(scene->tiles_x <= TILES_X);
-   assert(scene->tiles_y <= TILES_Y);
+   unsigned tiles_x = align(fb->width, TILE_SIZE) / TILE_SIZE;
+   unsigned tiles_y = align(fb->height, TILE_SIZE) / TILE_SIZE;
+   assert(tiles_x <= TILES_X);
+   assert(tiles_y <= TILES_Y);
 
-   unsigned num_required_tiles = scene->tiles_x * scene->tiles_y;
+   unsigned num_required_tiles = tiles_x * tiles_y;
    if (scene->num_alloced_tiles < num_required_tiles) {
-      scene->tiles = reallocarray(scene->tiles, num_required_tiles,
-                                  sizeof(struct cmd_bin));
-      if (!scene->tiles)
-         return;
-      memset(scene->tiles, 0, sizeof(struct cmd_bin) * num_required_tiles);
+      /* Only replace the buffers once both are allocated, so that they
+       * always match num_alloced_tiles.
+       */
+      struct cmd_bin *tiles = calloc(num_required_tiles,
+                                     sizeof(struct cmd_bin));
+      unsigned *bin_order = calloc(2 * num_required_tiles,
+                                   sizeof(unsigned));
+      if (!tiles || !bin_order) {
+         free(tiles);
+         free(bin_order);
+         return false;
+      }
+
+      free(scene->tiles);
+      free(scene->bin_order);
+      scene->tiles = tiles;
+      scene->bin_order = bin_order;
       scene->num_alloced_tiles = num_required_tiles;
+      scene->bin_order_x = scene->bin_order_y = 0;
    }
 
+   scene->tiles_x = tiles_x;
+   scene->tiles_y = tiles_y;
+
    /*
     * Determine how many layers the fb has (used for clamping layer value).
     * OpenGL (but not d3d10) permits different amount of layers per rt,
@@ -639,6 +761,8 @@ lp_scene_begin_binning(struct lp_scene *scene,
    }
 
    scene->fb_max_layer = max_layer;
+
+   return true;
 }
 
 
@@ -151,6 +151,9 @@ struct lp_scene {
    /* If queries were either active or there were begin/end query commands */
    bool had_queries;
 
+   /** Texture block cache generation, see llvmpipe_texture_cache_generation() */
+   unsigned tex_cache_generation;
+
    /* Framebuffer mappings - valid only between begin_rasterization()
     * and end_rasterization().
     */
@@ -197,7 +200,21 @@ struct lp_scene {
     */
    unsigned tiles_x, tiles_y;
 
-   int curr_x, curr_y;  /**< for iterating over bins */
+   /**
+    * Bin dispenser used by the rasterizer threads.
+    *
+    * bin_order holds two arrays of num_alloced_tiles entries: all tile
+    * indices in Morton (Z) order for a tiles_x * tiles_y grid (rebuilt
+    * only when the grid size changes), followed by the non-empty subset
+    * of those gathered by lp_scene_bin_iter_begin().  Threads claim
+    * bins from the latter by atomically incrementing curr_bin, so
+    * neighbouring tiles are rasterized at roughly the same time.
+    */
+   unsigned *bin_order;
+   unsigned bin_order_x, bin_order_y;
+   unsigned num_active_bins;
+   unsigned curr_bin;
+
    mtx_t mutex;
 
    unsigned num_alloced_tiles;
@@ -228,6 +245,9 @@ bool lp_scene_add_resource_reference(struct lp_scene *scene,
 unsigned lp_scene_is_resource_referenced(const struct lp_scene *scene,
                                          const struct pipe_resource *resource);
 
+bool lp_scene_depends_on(const struct lp_scene *scene,
+                         const struct lp_scene *prev);
+
 bool lp_scene_add_frag_shader_reference(struct lp_scene *scene,
                                         struct lp_fragment_shader_variant *variant);
 
@@ -409,7 +429,7 @@ lp_scene_bin_iter_next(struct lp_scene *scene, int *x, int *y);
 
 /* Begin/end binning of a scene
  */
-void
+bool
 lp_scene_begin_binning(struct lp_scene *scene,
                        struct pipe_framebuffer_state *fb);
 
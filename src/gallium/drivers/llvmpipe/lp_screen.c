@@ -39,6 +39,7 @@
 #include "gallivm/lp_bld_type.h"
 #include "gallivm/lp_bld_nir.h"
 #include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_debug.h"
 #include "util/disk_cache.h"
 #include "util/hex.h"
 #include "util/os_misc.h"
@@ -56,6 +57,8 @@
 #include "lp_rast.h"
 #include "lp_cs_tpool.h"
 #include "lp_flush.h"
+#include "lp_query.h"
+#include "lp_shader_stats.h"
 
 #include "frontend/sw_winsys.h"
 
@@ -102,9 +105,49 @@ static const struct debug_named_value lp_perf_flags[] = {
    { "no_alphatest",   PERF_NO_ALPHATEST, NULL },
    { "no_rast_linear", PERF_NO_RAST_LINEAR, NULL },
    { "no_shade",       PERF_NO_SHADE, NULL },
+   { "no_scene_pipeline", PERF_NO_SCENE_PIPELINE, NULL },
+   { "no_tex_cache",   PERF_NO_TEX_CACHE, NULL },
+   { "no_tiered_jit",  PERF_NO_TIERED_JIT, NULL },
    DEBUG_NAMED_VALUE_END
 };
 
+DEBUG_GET_ONCE_OPTION(lp_thread_affinity, "LP_THREAD_AFFINITY", NULL)
+
+
+/**
+ * Apply the LP_THREAD_AFFINITY policy to one of the rasterizer or
+ * compute threads:
+ *  - "cpu": pin thread N to CPU N.
+ *  - "l3": pin the threads, in evenly sized groups of consecutive thread
+ *    indices, to the CPUs sharing an L3 cache (core complex / NUMA node).
+ * The threads aren't pinned by default.
+ */
+void
+llvmpipe_set_thread_affinity(thrd_t thread, unsigned index,
+                             unsigned num_threads)
+{
+   const char *policy = debug_get_option_lp_thread_affinity();
+   const struct util_cpu_caps_t *caps = util_get_cpu_caps();
+
+   if (!policy)
+      return;
+
+   if (!strcmp(policy, "cpu")) {
+      util_affinity_mask mask = {0};
+      const unsigned cpu = index % MAX2(1, caps->max_cpus);
+
+      mask[cpu / 32] = 1u << (cpu % 32);
+      util_set_thread_affinity(thread, mask, NULL, caps->num_cpu_mask_bits);
+   } else if (!strcmp(policy, "l3")) {
+      if (caps->num_L3_caches <= 1 || !caps->L3_affinity_mask)
+         return;
+
+      const unsigned L3 = index * caps->num_L3_caches / MAX2(1, num_threads);
+      util_set_thread_affinity(thread, caps->L3_affinity_mask[L3], NULL,
+                               caps->num_cpu_mask_bits);
+   }
+}
+
 
 static const char *
 llvmpipe_get_vendor(struct pipe_screen *screen)
@@ -793,6 +836,9 @@ llvmpipe_destroy_screen(struct pipe_screen *_screen)
 {
    struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
 
+   if (util_queue_is_initialized(&screen->jit_queue))
+      util_queue_destroy(&screen->jit_queue);
+
    if (screen->cs_tpool)
       lp_cs_tpool_destroy(screen->cs_tpool);
 
@@ -802,6 +848,7 @@ llvmpipe_destroy_screen(struct pipe_screen *_screen)
    lp_jit_screen_cleanup(screen);
 
    disk_cache_destroy(screen->disk_shader_cache);
+   lp_shader_stats_fini(screen);
 
    glsl_type_singleton_decref();
 
@@ -994,6 +1041,16 @@ llvmpipe_screen_late_init(struct llvmpipe_screen *screen)
    lp_build_init(); /* get lp_native_vector_width initialised */
 
    lp_disk_cache_create(screen);
+
+#if !GALLIVM_USE_ORCJIT
+   if (!(LP_PERF & PERF_NO_TIERED_JIT) &&
+       !(gallivm_get_perf_flags() & GALLIVM_PERF_NO_OPT)) {
+      util_queue_init(&screen->jit_queue, "lpjit", 32, 1,
+                      UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                      UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY, NULL);
+   }
+#endif
+
    screen->late_init_done = true;
 out:
    mtx_unlock(&screen->late_mutex);
@@ -1044,6 +1101,7 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
 
    screen->base.finalize_nir = llvmpipe_finalize_nir;
 
+   screen->base.get_driver_query_info = llvmpipe_get_driver_query_info;
    screen->base.get_disk_shader_cache = lp_get_disk_shader_cache;
    llvmpipe_init_screen_resource_funcs(&screen->base);
 
@@ -1089,6 +1147,8 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
 
    (void) mtx_init(&screen->late_mutex, mtx_plain);
 
+   lp_shader_stats_init(screen);
+
    llvmpipe_init_shader_caps(&screen->base);
    llvmpipe_init_compute_caps(&screen->base);
    llvmpipe_init_screen_caps(&screen->base);
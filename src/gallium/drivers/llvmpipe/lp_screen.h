@@ -34,10 +34,13 @@
 #ifndef LP_SCREEN_H
 #define LP_SCREEN_H
 
+#include <stdio.h>
+
 #include "pipe/p_screen.h"
 #include "pipe/p_defines.h"
 #include "util/u_thread.h"
 #include "util/list.h"
+#include "util/u_queue.h"
 #include "util/mesa-blake3.h"
 #include "util/vma.h"
 #include "gallivm/lp_bld.h"
@@ -58,6 +61,11 @@ struct llvmpipe_screen
     */
    unsigned timestamp;
 
+   /* Generation of the per-thread texture block caches, increments whenever
+    * a compressed texture may have been modified or released.
+    */
+   unsigned tex_cache_generation;
+
    struct lp_rasterizer *rast;
    mtx_t rast_mutex;
 
@@ -76,6 +84,14 @@ struct llvmpipe_screen
 
    struct disk_cache *disk_shader_cache;
 
+   /* Optimized recompiles of fragment shader variants which were first
+    * compiled with gallivm's fast_compile, see generate_variant().
+    */
+   struct util_queue jit_queue;
+
+   /* LP_SHADER_STATS output, see lp_shader_stats.h */
+   FILE *shader_stats;
+
 #if defined(HAVE_LIBDRM) && defined(HAVE_LINUX_UDMABUF_H)
    int udmabuf_fd;
 #endif
@@ -106,6 +122,10 @@ lp_disk_cache_insert_shader(struct llvmpipe_screen *screen,
 bool
 llvmpipe_screen_late_init(struct llvmpipe_screen *screen);
 
+void
+llvmpipe_set_thread_affinity(thrd_t thread, unsigned index,
+                             unsigned num_threads);
+
 
 static inline struct llvmpipe_screen *
 llvmpipe_screen(struct pipe_screen *pipe)
@@ -77,7 +77,7 @@ lp_setup_wait_empty_scene(struct lp_setup_context *setup)
 }
 
 
-static void
+static bool
 lp_setup_get_empty_scene(struct lp_setup_context *setup)
 {
    assert(setup->scene == NULL);
@@ -142,7 +142,7 @@ lp_setup_get_empty_scene(struct lp_setup_context *setup)
       }
    }
 
-   lp_scene_begin_binning(setup->scene, &setup->fb);
+   return lp_scene_begin_binning(setup->scene, &setup->fb);
 }
 
 
@@ -256,12 +256,16 @@ begin_binning(struct lp_setup_context *setup)
    assert(scene);
    assert(scene->fence == NULL);
 
-   /* Always create a fence:
+   /* Always create a fence.  The rasterizer signals it once, when the
+    * scene is retired.
     */
-   scene->fence = lp_fence_create(MAX2(1, setup->num_threads));
+   scene->fence = lp_fence_create(1);
    if (!scene->fence)
       return false;
 
+   scene->tex_cache_generation =
+      llvmpipe_texture_cache_generation(llvmpipe_context(setup->pipe));
+
    if (!try_update_scene_state(setup)) {
       return false;
    }
@@ -371,8 +375,8 @@ set_scene_state(struct lp_setup_context *setup,
 
    /* wait for a free/empty scene
     */
-   if (old_state == SETUP_FLUSHED)
-      lp_setup_get_empty_scene(setup);
+   if (old_state == SETUP_FLUSHED && !lp_setup_get_empty_scene(setup))
+      goto fail;
 
    switch (new_state) {
    case SETUP_CLEARED:
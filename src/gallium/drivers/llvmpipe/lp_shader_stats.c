@@ -0,0 +1,73 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "util/log.h"
+#include "util/os_time.h"
+#include "util/u_debug.h"
+#include "lp_screen.h"
+#include "lp_shader_stats.h"
+
+
+DEBUG_GET_ONCE_OPTION(lp_shader_stats, "LP_SHADER_STATS", NULL)
+
+
+void
+lp_shader_stats_init(struct llvmpipe_screen *screen)
+{
+   const char *path = debug_get_option_lp_shader_stats();
+   if (!path)
+      return;
+
+   screen->shader_stats = fopen(path, "a");
+   if (!screen->shader_stats) {
+      mesa_loge("llvmpipe: can't open LP_SHADER_STATS file %s\n", path);
+      return;
+   }
+
+   /* Records come from the context threads and the jit_queue, each one is
+    * written by a single call so that lines don't interleave.
+    */
+   setvbuf(screen->shader_stats, NULL, _IOLBF, 0);
+}
+
+
+void
+lp_shader_stats_fini(struct llvmpipe_screen *screen)
+{
+   if (screen->shader_stats) {
+      fclose(screen->shader_stats);
+      screen->shader_stats = NULL;
+   }
+}
+
+
+void
+lp_shader_stats_printf(struct llvmpipe_screen *screen,
+                       const char *format, ...)
+{
+   if (!screen->shader_stats)
+      return;
+
+   char line[512];
+   int len = snprintf(line, sizeof(line), "{\"time_us\":%" PRId64 ",",
+                      os_time_get());
+
+   va_list args;
+   va_start(args, format);
+   len += vsnprintf(line + len, sizeof(line) - len, format, args);
+   va_end(args);
+
+   if (len > (int)sizeof(line) - 3)
+      return;
+
+   line[len++] = '}';
+   line[len++] = '\n';
+   line[len] = '\0';
+   fputs(line, screen->shader_stats);
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Per-variant shader compile statistics, written as one JSON object per
+ * line to the file named by LP_SHADER_STATS.
+ */
+
+#ifndef LP_SHADER_STATS_H
+#define LP_SHADER_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "util/macros.h"
+
+struct llvmpipe_screen;
+
+
+/**
+ * Where the time of a variant compile went, in microseconds.
+ */
+struct lp_variant_stats
+{
+   int64_t ir_time;        /**< building the LLVM IR */
+   int64_t opt_time;       /**< LLVM optimization passes */
+   int64_t codegen_time;   /**< machine code generation or cache load */
+   unsigned memory_hits;   /**< lookups served by the variant list */
+   bool disk_cache_hit;
+   bool fast_compile;
+};
+
+
+void
+lp_shader_stats_init(struct llvmpipe_screen *screen);
+
+void
+lp_shader_stats_fini(struct llvmpipe_screen *screen);
+
+/**
+ * Write a record.  The format gives the members of the JSON object after
+ * the timestamp, without the braces.
+ */
+void
+lp_shader_stats_printf(struct llvmpipe_screen *screen,
+                       const char *format, ...) PRINTFLIKE(2, 3);
+
+#endif /* LP_SHADER_STATS_H */
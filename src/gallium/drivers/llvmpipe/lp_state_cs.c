@@ -23,7 +23,10 @@
  *
  **************************************************************************/
 
+#include <inttypes.h>
+
 #include "util/u_memory.h"
+#include "util/hash_table.h"
 #include "util/os_time.h"
 #include "util/u_dump.h"
 #include "util/u_string.h"
@@ -46,6 +49,8 @@
 #include "lp_memory.h"
 #include "lp_query.h"
 #include "lp_cs_tpool.h"
+#include "lp_tex_sample.h"
+#include "lp_texture.h"
 #include "frontend/sw_winsys.h"
 #include "nir/nir_to_tgsi_info.h"
 #include "nir/tgsi_to_nir.h"
@@ -1061,7 +1066,8 @@ llvmpipe_get_compute_state_info(struct pipe_context *pipe, void *cs,
  */
 static void
 llvmpipe_remove_cs_shader_variant(struct llvmpipe_context *lp,
-                                  struct lp_compute_shader_variant *variant)
+                                  struct lp_compute_shader_variant *variant,
+                                  bool evicted)
 {
    if ((LP_DEBUG & DEBUG_CS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
       debug_printf("llvmpipe: del cs #%u var %u v created %u v cached %u "
@@ -1079,7 +1085,7 @@ llvmpipe_remove_cs_shader_variant(struct llvmpipe_context *lp,
    variant->shader->variants_cached--;
 
    /* remove from context's list */
-   list_del(&variant->list_item_global.list);
+   lp_variant_cache_remove(&lp->cs_variants, &variant->cache_entry, evicted);
    lp->nr_cs_variants--;
    lp->nr_cs_instrs -= variant->nr_instrs;
 
@@ -1104,7 +1110,7 @@ llvmpipe_delete_compute_state(struct pipe_context *pipe,
 
    /* Delete all the variants */
    LIST_FOR_EACH_ENTRY_SAFE(li, next, &shader->variants.list, list) {
-      llvmpipe_remove_cs_shader_variant(llvmpipe, li->base);
+      llvmpipe_remove_cs_shader_variant(llvmpipe, li->base, false);
    }
    ralloc_free(shader->base.ir.nir);
    FREE(shader);
@@ -1318,7 +1324,6 @@ generate_variant(struct llvmpipe_context *lp,
       return NULL;
    }
 
-   variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
    variant->no = shader->variants_created++;
 
@@ -1359,6 +1364,11 @@ generate_variant(struct llvmpipe_context *lp,
    if (needs_caching) {
       lp_disk_cache_insert_shader(screen, &cached, ir_blake3_cache_key);
    }
+
+   /* The object code is only captured when the JIT supports caching */
+   variant->code_size = cached.data_size ? cached.data_size :
+      (size_t)variant->nr_instrs * LP_SHADER_BYTES_PER_INSTR;
+
    gallivm_free_ir(variant->gallivm);
    return variant;
 }
@@ -1372,6 +1382,37 @@ lp_cs_ctx_set_cs_variant(struct lp_cs_context *csctx,
 }
 
 
+/**
+ * Evict variants until the code of all of them fits in
+ * LP_MAX_SHADER_CODE_SIZE, sparing the one which was just created.
+ */
+static void
+llvmpipe_cull_cs_variants(struct llvmpipe_context *lp,
+                          struct lp_compute_shader_variant *keep)
+{
+   if (!lp_variant_cache_full(&lp->cs_variants))
+      return;
+
+   if (gallivm_debug & GALLIVM_DEBUG_PERF) {
+      debug_printf("Evicting CS: %u total variants,\t%u instrs,"
+                   "\t%" PRIu64 " bytes of code\n",
+                   lp->nr_cs_variants, lp->nr_cs_instrs,
+                   lp->cs_variants.size);
+   }
+
+   while (lp_variant_cache_full(&lp->cs_variants)) {
+      struct lp_variant_cache_entry *entry =
+         lp_variant_cache_victim(&lp->cs_variants);
+      if (!entry || entry == &keep->cache_entry)
+         break;
+
+      llvmpipe_remove_cs_shader_variant(lp,
+         container_of(entry, struct lp_compute_shader_variant, cache_entry),
+         true);
+   }
+}
+
+
 static struct lp_compute_shader_variant *
 llvmpipe_update_cs_variant(struct llvmpipe_context *lp,
                            mesa_shader_stage sh_type,
@@ -1392,11 +1433,7 @@ llvmpipe_update_cs_variant(struct llvmpipe_context *lp,
    }
 
    if (variant) {
-      /* Move this variant to the head of the list to implement LRU
-       * deletion of shader's when we have too many.
-       */
-      list_move_to(&variant->list_item_global.list,
-                   &lp->cs_variants_list.list);
+      lp_variant_cache_hit(&lp->cs_variants, &variant->cache_entry);
    } else {
       /* variant not found, create it now */
 
@@ -1408,43 +1445,6 @@ llvmpipe_update_cs_variant(struct llvmpipe_context *lp,
                       ? lp->nr_cs_instrs / lp->nr_cs_variants : 0);
       }
 
-      /* First, check if we've exceeded the max number of shader variants.
-       * If so, free 6.25% of them (the least recently used ones).
-       */
-      unsigned variants_to_cull = lp->nr_cs_variants >= LP_MAX_SHADER_VARIANTS
-         ? LP_MAX_SHADER_VARIANTS / 16 : 0;
-
-      if (variants_to_cull ||
-          lp->nr_cs_instrs >= LP_MAX_SHADER_INSTRUCTIONS) {
-         if (gallivm_debug & GALLIVM_DEBUG_PERF) {
-            debug_printf("Evicting CS: %u cs variants,\t%u total variants,"
-                         "\t%u instrs,\t%u instrs/variant\n",
-                         shader->variants_cached,
-                         lp->nr_cs_variants, lp->nr_cs_instrs,
-                         lp->nr_cs_variants
-                         ? lp->nr_cs_instrs / lp->nr_cs_variants : 0);
-         }
-
-         /*
-          * We need to re-check lp->nr_cs_variants because an arbitrarily large
-          * number of shader variants (potentially all of them) could be
-          * pending for destruction on flush.
-          */
-         for (unsigned i = 0;
-              i < variants_to_cull ||
-                 lp->nr_cs_instrs >= LP_MAX_SHADER_INSTRUCTIONS; i++) {
-            struct lp_cs_variant_list_item *item;
-            if (list_is_empty(&lp->cs_variants_list.list)) {
-               break;
-            }
-            item = list_last_entry(&lp->cs_variants_list.list,
-                                   struct lp_cs_variant_list_item, list);
-            assert(item);
-            assert(item->base);
-            llvmpipe_remove_cs_shader_variant(lp, item->base);
-         }
-      }
-
       /*
        * Generate the new variant.
        */
@@ -1459,10 +1459,16 @@ llvmpipe_update_cs_variant(struct llvmpipe_context *lp,
       /* Put the new variant into the list */
       if (variant) {
          list_add(&variant->list_item_local.list, &shader->variants.list);
-         list_add(&variant->list_item_global.list, &lp->cs_variants_list.list);
+         lp_variant_cache_add(&lp->cs_variants, &variant->cache_entry,
+                              _mesa_hash_data_with_seed(&variant->key,
+                                                        shader->variant_key_size,
+                                                        shader->no),
+                              variant->code_size);
          lp->nr_cs_variants++;
          lp->nr_cs_instrs += variant->nr_instrs;
          shader->variants_cached++;
+
+         llvmpipe_cull_cs_variants(lp, variant);
       }
    }
    return variant;
@@ -1713,6 +1719,12 @@ cs_exec_fn(void *init_data, int iter_idx, struct lp_cs_local_mem *lmem)
       memset(lmem->local_mem_ptr, 0, job_info->req_local_mem);
    thread_data.shared = lmem->local_mem_ptr;
 
+   if (!lmem->tex_cache)
+      lmem->tex_cache = align_calloc(sizeof(*lmem->tex_cache), 16);
+   lp_build_format_cache_validate(lmem->tex_cache,
+                                  job_info->tex_cache_generation);
+   thread_data.cache = lmem->tex_cache;
+
    thread_data.payload = job_info->payload;
 
    unsigned grid_z, grid_y, grid_x;
@@ -1749,6 +1761,8 @@ cs_exec_fn(void *init_data, int iter_idx, struct lp_cs_local_mem *lmem)
                          job_info->work_dim, job_info->draw_id,
                          io_ptr,
                          &thread_data);
+
+   lp_tex_cache_count(lmem->tex_cache);
 }
 
 
@@ -1809,6 +1823,7 @@ llvmpipe_launch_grid(struct pipe_context *pipe,
    job_info.req_local_mem = llvmpipe->cs->req_local_mem + info->variable_shared_mem;
    job_info.zero_initialize_shared_memory = llvmpipe->cs->zero_initialize_shared_memory;
    job_info.current = &llvmpipe->csctx->cs.current;
+   job_info.tex_cache_generation = llvmpipe_texture_cache_generation(llvmpipe);
    /* Not really sure this should be done here? */
    job_info.current->jit_context.shared_size = job_info.req_local_mem;
 
@@ -1967,7 +1982,7 @@ llvmpipe_delete_ts_state(struct pipe_context *pipe, void *_task)
 
    /* Delete all the variants */
    LIST_FOR_EACH_ENTRY_SAFE(li, next, &shader->variants.list, list) {
-      llvmpipe_remove_cs_shader_variant(llvmpipe, li->base);
+      llvmpipe_remove_cs_shader_variant(llvmpipe, li->base, false);
    }
    ralloc_free(shader->base.ir.nir);
    FREE(shader);
@@ -2047,7 +2062,7 @@ llvmpipe_delete_ms_state(struct pipe_context *pipe, void *_mesh)
 
    /* Delete all the variants */
    LIST_FOR_EACH_ENTRY_SAFE(li, next, &shader->variants.list, list) {
-      llvmpipe_remove_cs_shader_variant(llvmpipe, li->base);
+      llvmpipe_remove_cs_shader_variant(llvmpipe, li->base, false);
    }
 
    draw_delete_mesh_shader(llvmpipe->draw, shader->draw_mesh_data);
@@ -2138,6 +2153,7 @@ llvmpipe_draw_mesh_tasks(struct pipe_context *pipe,
       return;
 
    memset(&job_info, 0, sizeof(job_info));
+   job_info.tex_cache_generation = llvmpipe_texture_cache_generation(lp);
    if (lp->dirty)
       llvmpipe_update_derived(lp);
 
@@ -51,6 +51,7 @@ struct lp_cs_job_info {
    size_t io_stride;
    void *payload;
    size_t payload_stride;
+   unsigned tex_cache_generation;
 };
 
 
@@ -115,7 +116,11 @@ struct lp_compute_shader_variant
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
 
-   struct lp_cs_variant_list_item list_item_global, list_item_local;
+   /* Size of the generated code, in bytes */
+   size_t code_size;
+
+   struct lp_cs_variant_list_item list_item_local;
+   struct lp_variant_cache_entry cache_entry;
 
    struct lp_compute_shader *shader;
 
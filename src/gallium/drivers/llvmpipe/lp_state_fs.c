@@ -57,6 +57,7 @@
  * @author Jose Fonseca <jfonseca@vmware.com>
  */
 
+#include <inttypes.h>
 #include <limits.h>
 #include "pipe/p_defines.h"
 #include "util/u_inlines.h"
@@ -67,6 +68,8 @@
 #include "util/u_string.h"
 #include "util/u_dual_blend.h"
 #include "util/u_upload_mgr.h"
+#include "util/u_atomic.h"
+#include "util/hash_table.h"
 #include "util/os_time.h"
 #include "pipe/p_shader_tokens.h"
 #include "draw/draw_context.h"
@@ -3835,6 +3838,230 @@ lp_fs_get_ir_cache_key(struct lp_fragment_shader_variant *variant,
 }
 
 
+/**
+ * Optimized recompile of a fragment shader variant.
+ *
+ * Variants which aren't in the disk cache are first compiled with gallivm's
+ * fast_compile, so that the draw isn't stalled by LLVM's optimizations. The
+ * IR is then built again into a private LLVM context and optimized/compiled
+ * on the screen's jit_queue, after which the jit functions of the variant
+ * are swapped.
+ */
+struct lp_fs_tier_up_job {
+   struct util_queue_fence fence;
+   struct llvmpipe_screen *screen;
+   struct lp_fragment_shader_variant *variant;
+
+   /* Copy of the variant holding the LLVM state of the recompile */
+   struct lp_fragment_shader_variant *shadow;
+   lp_context_ref context;
+   struct lp_cached_code cached;
+   unsigned char ir_blake3_cache_key[BLAKE3_KEY_LEN];
+
+   /* The fast_compile functions, [RAST_WHOLE], [RAST_EDGE_TEST] */
+   lp_jit_frag_func fast_function[2];
+   int64_t ir_time;
+   bool done;
+
+   /* Size of the optimized code counted in the variant's code_size.  It is
+    * an estimate until the recompile is done.
+    */
+   size_t code_size;
+   bool code_size_final;
+};
+
+
+static void
+lp_fs_tier_up_execute(void *data, void *gdata, int thread_index)
+{
+   struct lp_fs_tier_up_job *job = (struct lp_fs_tier_up_job *)data;
+   struct lp_fragment_shader_variant *variant = job->variant;
+   struct lp_fragment_shader_variant *shadow = job->shadow;
+   lp_jit_frag_func function[2] = { NULL, NULL };
+   lp_jit_linear_llvm_func linear_function = NULL;
+
+   int64_t compile_begin = os_time_get();
+   gallivm_compile_module(shadow->gallivm);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(function); i++) {
+      if (shadow->function[i]) {
+         function[i] = (lp_jit_frag_func)
+            gallivm_jit_function(shadow->gallivm, shadow->function[i],
+                                 shadow->function_name[i]);
+      }
+   }
+
+   if (shadow->linear_function) {
+      linear_function = (lp_jit_linear_llvm_func)
+         gallivm_jit_function(shadow->gallivm, shadow->linear_function,
+                              shadow->linear_function_name);
+   }
+
+   const int64_t opt_time = shadow->gallivm->opt_time;
+   const int64_t codegen_time = os_time_get() - compile_begin - opt_time;
+
+   lp_disk_cache_insert_shader(job->screen, &job->cached,
+                               job->ir_blake3_cache_key);
+
+   gallivm_free_ir(shadow->gallivm);
+
+   /* The rasterizer threads may still be running the fast_compile code,
+    * which is only freed together with the variant. Note that
+    * jit_function[RAST_WHOLE] may alias the edge test function.
+    */
+   for (unsigned i = 0; i < ARRAY_SIZE(variant->jit_function); i++) {
+      for (unsigned j = 0; j < ARRAY_SIZE(function); j++) {
+         if (job->fast_function[j] && function[j] &&
+             variant->jit_function[i] == job->fast_function[j]) {
+            p_atomic_set(&variant->jit_function[i], function[j]);
+            break;
+         }
+      }
+   }
+
+   if (linear_function && variant->jit_linear_llvm)
+      p_atomic_set(&variant->jit_linear_llvm, linear_function);
+
+   job->done = true;
+   p_atomic_inc(&lp_count.nr_fs_tier_ups);
+
+   lp_shader_stats_printf(job->screen,
+                          "\"event\":\"tier_up\",\"stage\":\"fs\","
+                          "\"shader\":%u,\"variant\":%u,"
+                          "\"ir_us\":%" PRId64 ",\"opt_us\":%" PRId64 ","
+                          "\"codegen_us\":%" PRId64,
+                          variant->shader->no, variant->no,
+                          job->ir_time, opt_time, codegen_time);
+}
+
+
+static void
+lp_fs_tier_up_job_destroy(struct lp_fs_tier_up_job *job)
+{
+   struct lp_fragment_shader_variant *shadow = job->shadow;
+
+   if (shadow->gallivm)
+      gallivm_destroy(shadow->gallivm);
+   FREE(shadow->function_name[RAST_EDGE_TEST]);
+   FREE(shadow->function_name[RAST_WHOLE]);
+   FREE(shadow->linear_function_name);
+   FREE(shadow);
+
+   lp_context_destroy(&job->context);
+   util_queue_fence_destroy(&job->fence);
+   FREE(job);
+}
+
+
+/**
+ * Queue the optimized recompile of a variant compiled with fast_compile.
+ * The IR is built here, as the shader's NIR is modified by the IR
+ * generation and can't be accessed from the queue.
+ */
+static void
+lp_fs_variant_tier_up(struct llvmpipe_context *lp,
+                      struct lp_fragment_shader_variant *variant,
+                      const unsigned char ir_blake3_cache_key[BLAKE3_KEY_LEN])
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   struct lp_fragment_shader *shader = variant->shader;
+   const size_t variant_size =
+      sizeof *variant + shader->variant_key_size - sizeof variant->key;
+
+   struct lp_fs_tier_up_job *job = CALLOC_STRUCT(lp_fs_tier_up_job);
+   if (!job)
+      return;
+
+   job->shadow = MALLOC(variant_size);
+   if (!job->shadow) {
+      FREE(job);
+      return;
+   }
+
+   struct lp_fragment_shader_variant *shadow = job->shadow;
+   memcpy(shadow, variant, variant_size);
+   shadow->tier_up = NULL;
+   shadow->jit_context_ptr_type = NULL;
+   shadow->function[RAST_WHOLE] = NULL;
+   shadow->function[RAST_EDGE_TEST] = NULL;
+   shadow->function_name[RAST_WHOLE] = NULL;
+   shadow->function_name[RAST_EDGE_TEST] = NULL;
+   shadow->linear_function = NULL;
+   shadow->linear_function_name = NULL;
+
+   job->screen = screen;
+   job->variant = variant;
+   memcpy(job->ir_blake3_cache_key, ir_blake3_cache_key, BLAKE3_KEY_LEN);
+   util_queue_fence_init(&job->fence);
+   lp_context_create(&job->context);
+
+   char module_name[64];
+   snprintf(module_name, sizeof(module_name), "fs%u_variant%u_opt",
+            shader->no, variant->no);
+   shadow->gallivm = gallivm_create(module_name, &job->context, &job->cached);
+   if (!shadow->gallivm) {
+      lp_fs_tier_up_job_destroy(job);
+      return;
+   }
+
+   int64_t ir_begin = os_time_get();
+   lp_jit_init_types(shadow);
+
+   /* Same functions, in the same order as generate_variant(), so that the
+    * disk cache entry matches the module built on a later cache hit.
+    */
+   if (variant->function[RAST_EDGE_TEST]) {
+      job->fast_function[RAST_EDGE_TEST] = variant->jit_function[RAST_EDGE_TEST];
+      generate_fragment(lp, shader, shadow, RAST_EDGE_TEST);
+   }
+
+   if (variant->function[RAST_WHOLE]) {
+      job->fast_function[RAST_WHOLE] = variant->jit_function[RAST_WHOLE];
+      generate_fragment(lp, shader, shadow, RAST_WHOLE);
+   }
+
+   if (variant->linear_function)
+      llvmpipe_fs_variant_linear_llvm(lp, shader, shadow);
+
+   job->ir_time = os_time_get() - ir_begin;
+
+   /* The optimized code is kept as long as the variant */
+   job->code_size = (size_t)variant->nr_instrs * LP_SHADER_BYTES_PER_INSTR;
+   variant->code_size += job->code_size;
+
+   variant->tier_up = job;
+   p_atomic_inc(&lp_count.nr_fs_tier_ups_queued);
+   util_queue_add_job(&screen->jit_queue, job, &job->fence,
+                      lp_fs_tier_up_execute, NULL, 0);
+}
+
+
+/**
+ * Replace the estimated size of the optimized code in the variant's
+ * code_size with the real one, once the recompile is done.
+ */
+static void
+lp_fs_variant_update_code_size(struct llvmpipe_context *lp,
+                               struct lp_fragment_shader_variant *variant)
+{
+   struct lp_fs_tier_up_job *job = variant->tier_up;
+
+   if (!job || job->code_size_final ||
+       !util_queue_fence_is_signalled(&job->fence))
+      return;
+
+   job->code_size_final = true;
+   if (!job->done || !job->cached.data_size)
+      return;
+
+   variant->code_size = variant->code_size - job->code_size +
+                        job->cached.data_size;
+   job->code_size = job->cached.data_size;
+   lp_variant_cache_resize(&lp->fs_variants, &variant->cache_entry,
+                           variant->code_size);
+}
+
+
 /**
  * Generate a new fragment shader variant from the shader code and
  * other state indicated by the key.
@@ -3867,8 +4094,17 @@ generate_variant(struct llvmpipe_context *lp,
       lp_disk_cache_find_shader(screen, &cached, ir_blake3_cache_key);
       if (!cached.data_size)
          needs_caching = true;
+      variant->stats.disk_cache_hit = !needs_caching;
    }
 
+   /* Skip the optimizations now and recompile in the background, unless
+    * the code came from the disk cache or is being dumped.
+    */
+   const bool tier_up = needs_caching &&
+                        util_queue_is_initialized(&screen->jit_queue) &&
+                        !(gallivm_debug & (GALLIVM_DEBUG_ASM |
+                                           GALLIVM_DEBUG_DUMP_BC));
+
    char module_name[64];
    snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
             shader->no, shader->variants_created);
@@ -3877,8 +4113,11 @@ generate_variant(struct llvmpipe_context *lp,
       FREE(variant);
       return NULL;
    }
+   variant->gallivm->fast_compile = tier_up;
+   variant->stats.fast_compile = tier_up;
+
+   const int64_t ir_begin = os_time_get();
 
-   variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
    variant->no = shader->variants_created++;
 
@@ -4036,6 +4275,9 @@ generate_variant(struct llvmpipe_context *lp,
     * Compile everything
     */
 
+   const int64_t compile_begin = os_time_get();
+   variant->stats.ir_time = compile_begin - ir_begin;
+
 #if GALLIVM_USE_ORCJIT
 /* module has been moved into ORCJIT after gallivm_compile_module */
    variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
@@ -4064,13 +4306,20 @@ generate_variant(struct llvmpipe_context *lp,
          variant->jit_function[RAST_EDGE_TEST];
    }
 
-   if (linear_pipeline) {
-      if (variant->linear_function) {
-         variant->jit_linear_llvm = (lp_jit_linear_llvm_func)
-            gallivm_jit_function(variant->gallivm, variant->linear_function,
-                                 variant->linear_function_name);
-      }
+   if (linear_pipeline && variant->linear_function) {
+      variant->jit_linear_llvm = (lp_jit_linear_llvm_func)
+         gallivm_jit_function(variant->gallivm, variant->linear_function,
+                              variant->linear_function_name);
+   }
+
+   /* MCJIT only generates the machine code when the functions are looked
+    * up, so this is counted as codegen rather than optimization.
+    */
+   variant->stats.opt_time = variant->gallivm->opt_time;
+   variant->stats.codegen_time =
+      os_time_get() - compile_begin - variant->stats.opt_time;
 
+   if (linear_pipeline) {
       /*
        * This must be done after LLVM compilation, as it will call the JIT'ed
        * code to determine active inputs.
@@ -4078,12 +4327,20 @@ generate_variant(struct llvmpipe_context *lp,
       lp_linear_check_variant(variant);
    }
 
-   if (needs_caching) {
+   /* Only the optimized code goes into the disk cache. */
+   if (needs_caching && !tier_up) {
       lp_disk_cache_insert_shader(screen, &cached, ir_blake3_cache_key);
    }
 
+   /* The object code is only captured when the JIT supports caching */
+   variant->code_size = cached.data_size ? cached.data_size :
+      (size_t)variant->nr_instrs * LP_SHADER_BYTES_PER_INSTR;
+
    gallivm_free_ir(variant->gallivm);
 
+   if (tier_up)
+      lp_fs_variant_tier_up(lp, variant, ir_blake3_cache_key);
+
    return variant;
 }
 
@@ -4104,6 +4361,8 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
 
    shader->base.type = PIPE_SHADER_IR_NIR;
 
+   const int64_t nir_begin = os_time_get();
+
    if (templ->type == PIPE_SHADER_IR_TGSI) {
       shader->base.ir.nir = tgsi_to_nir(templ->tokens, pipe->screen, false);
    } else {
@@ -4187,6 +4446,8 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
 
    llvmpipe_fs_analyse_nir(shader);
 
+   shader->nir_time = os_time_get() - nir_begin;
+
    return shader;
 }
 
@@ -4216,7 +4477,8 @@ llvmpipe_bind_fs_state(struct pipe_context *pipe, void *fs)
  */
 static void
 llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
-                               struct lp_fragment_shader_variant *variant)
+                               struct lp_fragment_shader_variant *variant,
+                               bool evicted)
 {
    if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
       debug_printf("llvmpipe: del fs #%u var %u v created %u v cached %u "
@@ -4232,7 +4494,7 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
    variant->shader->variants_cached--;
 
    /* remove from context's list */
-   list_del(&variant->list_item_global.list);
+   lp_variant_cache_remove(&lp->fs_variants, &variant->cache_entry, evicted);
    lp->nr_fs_variants--;
    lp->nr_fs_instrs -= variant->nr_instrs;
 }
@@ -4242,6 +4504,16 @@ void
 llvmpipe_destroy_shader_variant(struct llvmpipe_context *lp,
                                 struct lp_fragment_shader_variant *variant)
 {
+   if (variant->tier_up) {
+      struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+
+      /* Waits for the recompile if it is already running. */
+      util_queue_drop_job(&screen->jit_queue, &variant->tier_up->fence);
+      if (!variant->tier_up->done)
+         p_atomic_inc(&lp_count.nr_fs_tier_ups_dropped);
+      lp_fs_tier_up_job_destroy(variant->tier_up);
+   }
+
    gallivm_destroy(variant->gallivm);
    lp_fs_reference(lp, &variant->shader, NULL);
    FREE(variant->function_name[RAST_EDGE_TEST]);
@@ -4275,7 +4547,7 @@ llvmpipe_delete_fs_state(struct pipe_context *pipe, void *fs)
    LIST_FOR_EACH_ENTRY_SAFE(li, next, &shader->variants.list, list) {
       struct lp_fragment_shader_variant *variant;
       variant = li->base;
-      llvmpipe_remove_shader_variant(llvmpipe, li->base);
+      llvmpipe_remove_shader_variant(llvmpipe, li->base, false);
       lp_fs_variant_reference(llvmpipe, &variant, NULL);
    }
 
@@ -4755,9 +5027,61 @@ make_variant_key(struct llvmpipe_context *lp,
  * Update fragment shader state.  This is called just prior to drawing
  * something when some fragment-related state has changed.
  */
+/**
+ * Evict variants until the code of all of them fits in
+ * LP_MAX_SHADER_CODE_SIZE, sparing the one which was just created.
+ */
+static void
+llvmpipe_cull_fs_variants(struct llvmpipe_context *lp,
+                          struct lp_fragment_shader_variant *keep)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+
+   if (!lp_variant_cache_full(&lp->fs_variants))
+      return;
+
+   if (gallivm_debug & GALLIVM_DEBUG_PERF) {
+      debug_printf("Evicting FS: %u total variants,\t%u instrs,"
+                   "\t%" PRIu64 " bytes of code\n",
+                   lp->nr_fs_variants, lp->nr_fs_instrs,
+                   lp->fs_variants.size);
+   }
+
+   /*
+    * Variants pending for destruction on flush are no longer in the cache,
+    * so this terminates even if the evicted variants are still referenced.
+    */
+   while (lp_variant_cache_full(&lp->fs_variants)) {
+      struct lp_variant_cache_entry *entry =
+         lp_variant_cache_victim(&lp->fs_variants);
+      if (!entry || entry == &keep->cache_entry)
+         break;
+
+      struct lp_fragment_shader_variant *variant =
+         container_of(entry, struct lp_fragment_shader_variant, cache_entry);
+      p_atomic_inc(&lp_count.nr_fs_variants_evicted);
+      lp_shader_stats_printf(screen,
+                             "\"event\":\"evict\",\"stage\":\"fs\","
+                             "\"shader\":%u,\"variant\":%u,"
+                             "\"reason\":\"%s\",\"segment\":\"%s\","
+                             "\"memory_hits\":%u,\"bytes\":%zu",
+                             variant->shader->no, variant->no,
+                             lp->fs_variants.count > lp->fs_variants.max_count
+                             ? "variants" : "size",
+                             entry->segment == LP_VARIANT_PROTECTED
+                             ? "protected" : "probation",
+                             variant->stats.memory_hits,
+                             variant->code_size);
+      llvmpipe_remove_shader_variant(lp, variant, true);
+      lp_fs_variant_reference(lp, &variant, NULL);
+   }
+}
+
+
 void
 llvmpipe_update_fs(struct llvmpipe_context *lp)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
    struct lp_fragment_shader *shader = lp->fs;
 
    char store[LP_FS_MAX_VARIANT_KEY_SIZE];
@@ -4775,10 +5099,10 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
    }
 
    if (variant) {
-      /* Move this variant to the head of the list to implement LRU
-       * deletion of shader's when we have too many.
-       */
-      list_move_to(&variant->list_item_global.list, &lp->fs_variants_list.list);
+      lp_fs_variant_update_code_size(lp, variant);
+      lp_variant_cache_hit(&lp->fs_variants, &variant->cache_entry);
+      variant->stats.memory_hits++;
+      p_atomic_inc(&lp_count.nr_fs_variant_memory_hits);
    } else {
       /* variant not found, create it now */
 
@@ -4789,47 +5113,6 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
                       lp->nr_fs_variants ? lp->nr_fs_instrs / lp->nr_fs_variants : 0);
       }
 
-      /* First, check if we've exceeded the max number of shader variants.
-       * If so, free 6.25% of them (the least recently used ones).
-       */
-      const unsigned variants_to_cull =
-         lp->nr_fs_variants >= LP_MAX_SHADER_VARIANTS
-         ? LP_MAX_SHADER_VARIANTS / 16 : 0;
-
-      if (variants_to_cull ||
-          lp->nr_fs_instrs >= LP_MAX_SHADER_INSTRUCTIONS) {
-         if (gallivm_debug & GALLIVM_DEBUG_PERF) {
-            debug_printf("Evicting FS: %u fs variants,\t%u total variants,"
-                         "\t%u instrs,\t%u instrs/variant\n",
-                         shader->variants_cached,
-                         lp->nr_fs_variants, lp->nr_fs_instrs,
-                         lp->nr_fs_variants ? lp->nr_fs_instrs / lp->nr_fs_variants : 0);
-         }
-
-         /*
-          * We need to re-check lp->nr_fs_variants because an arbitrarily
-          * large number of shader variants (potentially all of them) could
-          * be pending for destruction on flush.
-          */
-
-         for (unsigned i = 0;
-              i < variants_to_cull ||
-                 lp->nr_fs_instrs >= LP_MAX_SHADER_INSTRUCTIONS;
-              i++) {
-            struct lp_fs_variant_list_item *item;
-            if (list_is_empty(&lp->fs_variants_list.list)) {
-               break;
-            }
-            item = list_last_entry(&lp->fs_variants_list.list,
-                                   struct lp_fs_variant_list_item, list);
-            assert(item);
-            assert(item->base);
-            llvmpipe_remove_shader_variant(lp, item->base);
-            struct lp_fragment_shader_variant *variant = item->base;
-            lp_fs_variant_reference(lp, &variant, NULL);
-         }
-      }
-
       /*
        * Generate the new variant.
        */
@@ -4842,11 +5125,39 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
 
       /* Put the new variant into the list */
       if (variant) {
+         p_atomic_inc(&lp_count.nr_fs_variants_compiled);
+         p_atomic_add(&lp_count.fs_compile_time, dt);
+         if (variant->stats.disk_cache_hit)
+            p_atomic_inc(&lp_count.nr_fs_variant_disk_hits);
+
+         lp_shader_stats_printf(screen,
+                                "\"event\":\"compile\",\"stage\":\"fs\","
+                                "\"shader\":%u,\"variant\":%u,"
+                                "\"kind\":\"%s\",\"source\":\"%s\","
+                                "\"nir_us\":%" PRId64 ",\"ir_us\":%" PRId64 ","
+                                "\"opt_us\":%" PRId64 ","
+                                "\"codegen_us\":%" PRId64 ","
+                                "\"total_us\":%" PRId64 ",\"instrs\":%u",
+                                shader->no, variant->no,
+                                lp_debug_fs_kind(shader->kind),
+                                variant->stats.disk_cache_hit ? "disk" :
+                                variant->stats.fast_compile ? "jit_fast" : "jit",
+                                shader->nir_time, variant->stats.ir_time,
+                                variant->stats.opt_time,
+                                variant->stats.codegen_time, dt,
+                                variant->nr_instrs);
+
          list_add(&variant->list_item_local.list, &shader->variants.list);
-         list_add(&variant->list_item_global.list, &lp->fs_variants_list.list);
+         lp_variant_cache_add(&lp->fs_variants, &variant->cache_entry,
+                              _mesa_hash_data_with_seed(&variant->key,
+                                                        shader->variant_key_size,
+                                                        shader->no),
+                              variant->code_size);
          lp->nr_fs_variants++;
          lp->nr_fs_instrs += variant->nr_instrs;
          shader->variants_cached++;
+
+         llvmpipe_cull_fs_variants(lp, variant);
       }
    }
 
@@ -39,6 +39,8 @@
 #include "lp_bld_interp.h" /* for struct lp_shader_input */
 #include "util/u_inlines.h"
 #include "lp_jit.h"
+#include "lp_shader_stats.h"
+#include "lp_variant_cache.h"
 
 struct lp_fragment_shader;
 
@@ -144,6 +146,8 @@ struct lp_fs_variant_list_item
 };
 
 
+struct lp_fs_tier_up_job;
+
 struct lp_fragment_shader_variant
 {
    /*
@@ -158,6 +162,11 @@ struct lp_fragment_shader_variant
 
    struct gallivm_state *gallivm;
 
+   /* Pending or finished optimized recompile, if the variant was first
+    * compiled with gallivm's fast_compile.
+    */
+   struct lp_fs_tier_up_job *tier_up;
+
    LLVMTypeRef jit_context_type;
    LLVMTypeRef jit_context_ptr_type;
    LLVMTypeRef jit_thread_data_type;
@@ -190,7 +199,15 @@ struct lp_fragment_shader_variant
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
 
-   struct lp_fs_variant_list_item list_item_global, list_item_local;
+   /* Size of the generated code, in bytes, including the code of the
+    * optimized recompile
+    */
+   size_t code_size;
+
+   struct lp_variant_stats stats;
+
+   struct lp_fs_variant_list_item list_item_local;
+   struct lp_variant_cache_entry cache_entry;
    struct lp_fragment_shader *shader;
 
    /* For debugging/profiling purposes */
@@ -221,6 +238,7 @@ struct lp_fragment_shader
    unsigned no;
    unsigned variants_created;
    unsigned variants_cached;
+   int64_t nir_time;  /**< NIR lowering at creation, in microseconds */
 
    /** Fragment shader input interpolation info */
    struct lp_shader_input inputs[PIPE_MAX_SHADER_INPUTS];
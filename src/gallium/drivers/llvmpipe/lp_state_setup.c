@@ -28,6 +28,7 @@
 
 #include "util/u_math.h"
 #include "util/u_memory.h"
+#include "util/hash_table.h"
 #include "util/os_time.h"
 #include "gallivm/lp_bld_arit.h"
 #include "gallivm/lp_bld_bitarit.h"
@@ -664,7 +665,6 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    }
 
    memcpy(&variant->key, key, key->size);
-   variant->list_item_global.base = variant;
 
    /* Currently always deal with full 4-wide vertex attributes from
     * the vertices.
@@ -833,7 +833,8 @@ lp_make_setup_variant_key(const struct llvmpipe_context *lp,
 
 static void
 remove_setup_variant(struct llvmpipe_context *lp,
-                     struct lp_setup_variant *variant)
+                     struct lp_setup_variant *variant,
+                     bool evicted)
 {
    if (gallivm_debug & GALLIVM_DEBUG_IR) {
       debug_printf("llvmpipe: del setup_variant #%u total %u\n",
@@ -844,7 +845,8 @@ remove_setup_variant(struct llvmpipe_context *lp,
       gallivm_destroy(variant->gallivm);
    }
 
-   list_del(&variant->list_item_global.list);
+   lp_variant_cache_remove(&lp->setup_variants, &variant->cache_entry,
+                           evicted);
    lp->nr_setup_variants--;
    FREE(variant->function_name);
    FREE(variant);
@@ -852,7 +854,7 @@ remove_setup_variant(struct llvmpipe_context *lp,
 
 
 /* When the number of setup variants exceeds a threshold, cull a
- * fraction (currently a quarter) of them.
+ * fraction (currently a quarter) of them, as chosen by the variant cache.
  */
 static void
 cull_setup_variants(struct llvmpipe_context *lp)
@@ -867,15 +869,12 @@ cull_setup_variants(struct llvmpipe_context *lp)
    llvmpipe_finish(pipe, __func__);
 
    for (int i = 0; i < LP_MAX_SETUP_VARIANTS / 4; i++) {
-      struct lp_setup_variant_list_item *item;
-      if (list_is_empty(&lp->setup_variants_list.list)) {
+      struct lp_variant_cache_entry *entry =
+         lp_variant_cache_victim(&lp->setup_variants);
+      if (!entry)
          break;
-      }
-      item = list_last_entry(&lp->setup_variants_list.list,
-                             struct lp_setup_variant_list_item, list);
-      assert(item);
-      assert(item->base);
-      remove_setup_variant(lp, item->base);
+      remove_setup_variant(lp,
+         container_of(entry, struct lp_setup_variant, cache_entry), true);
    }
 }
 
@@ -890,20 +889,24 @@ llvmpipe_update_setup(struct llvmpipe_context *lp)
 {
    struct lp_setup_variant_key *key = &lp->setup_variant.key;
    struct lp_setup_variant *variant = NULL;
-   struct lp_setup_variant_list_item *li;
 
    lp_make_setup_variant_key(lp, key);
 
-   LIST_FOR_EACH_ENTRY(li, &lp->setup_variants_list.list, list) {
-      if (li->base->key.size == key->size &&
-         memcmp(&li->base->key, key, key->size) == 0) {
-         variant = li->base;
-         break;
+   for (unsigned s = 0; s < LP_VARIANT_SEGMENTS && !variant; s++) {
+      list_for_each_entry(struct lp_variant_cache_entry, entry,
+                          &lp->setup_variants.segment[s], list) {
+         struct lp_setup_variant *v =
+            container_of(entry, struct lp_setup_variant, cache_entry);
+         if (v->key.size == key->size &&
+            memcmp(&v->key, key, key->size) == 0) {
+            variant = v;
+            break;
+         }
       }
    }
 
    if (variant) {
-      list_move_to(&variant->list_item_global.list, &lp->setup_variants_list.list);
+      lp_variant_cache_hit(&lp->setup_variants, &variant->cache_entry);
    } else {
       if (lp->nr_setup_variants >= LP_MAX_SETUP_VARIANTS) {
          cull_setup_variants(lp);
@@ -911,7 +914,8 @@ llvmpipe_update_setup(struct llvmpipe_context *lp)
 
       variant = generate_setup_variant(key, lp);
       if (variant) {
-         list_add(&variant->list_item_global.list, &lp->setup_variants_list.list);
+         lp_variant_cache_add(&lp->setup_variants, &variant->cache_entry,
+                              _mesa_hash_data(&variant->key, key->size), 1);
          lp->nr_setup_variants++;
       }
    }
@@ -923,9 +927,9 @@ llvmpipe_update_setup(struct llvmpipe_context *lp)
 void
 lp_delete_setup_variants(struct llvmpipe_context *lp)
 {
-   struct lp_setup_variant_list_item *li, *next;
-   LIST_FOR_EACH_ENTRY_SAFE(li, next, &lp->setup_variants_list.list, list) {
-      remove_setup_variant(lp, li->base);
+   LP_VARIANT_CACHE_FOREACH_SAFE(entry, &lp->setup_variants) {
+      remove_setup_variant(lp,
+         container_of(entry, struct lp_setup_variant, cache_entry), false);
    }
 }
 
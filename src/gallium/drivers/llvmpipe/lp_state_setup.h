@@ -2,18 +2,12 @@
 #define LP_STATE_SETUP_H
 
 #include "lp_bld_interp.h"
+#include "lp_variant_cache.h"
 
 
 struct llvmpipe_context;
 struct lp_setup_variant;
 
-struct lp_setup_variant_list_item
-{
-   struct list_head list;
-   struct lp_setup_variant *base;
-};
-
-
 struct lp_setup_variant_key {
    unsigned size:16;
    unsigned num_inputs:8;
@@ -55,7 +49,7 @@ typedef void (*lp_jit_setup_triangle)(const float (*v0)[4],
 struct lp_setup_variant {
    struct lp_setup_variant_key key;
 
-   struct lp_setup_variant_list_item list_item_global;
+   struct lp_variant_cache_entry cache_entry;
 
    struct gallivm_state *gallivm;
 
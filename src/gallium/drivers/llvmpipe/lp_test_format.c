@@ -395,10 +395,13 @@ test_all(unsigned verbose, FILE *fp)
             continue;
 
          /* only test twice with formats which can use cache */
-         if (format_desc->layout != UTIL_FORMAT_LAYOUT_S3TC && use_cache) {
+         if (!lp_build_format_cache_supported(format_desc) && use_cache) {
             continue;
          }
 
+         /* the same test data is used for all formats */
+         memset(cache_ptr, 0, sizeof(*cache_ptr));
+
          if (!test_one(verbose, fp, format_desc, use_cache)) {
             success = false;
          }
@@ -0,0 +1,242 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Unit tests of the 2Q replacement policy of the shader variant caches.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "lp_test.h"
+#include "lp_variant_cache.h"
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "test\t"
+           "hit_rate\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp, const char *test, double hit_rate, bool success)
+{
+   fprintf(fp, "%s\t%s\t%f\n", success ? "pass" : "fail", test, hit_rate);
+
+   fflush(fp);
+}
+
+
+/*
+ * Add an entry with a size of one, then evict until the cache fits, like
+ * llvmpipe_cull_fs_variants().
+ */
+static void
+add_and_cull(struct lp_variant_cache *cache,
+             struct lp_variant_cache_entry *entries, bool *cached,
+             unsigned index)
+{
+   lp_variant_cache_add(cache, &entries[index], index, 1);
+   cached[index] = true;
+
+   while (lp_variant_cache_full(cache)) {
+      struct lp_variant_cache_entry *victim = lp_variant_cache_victim(cache);
+      if (!victim || victim == &entries[index])
+         break;
+
+      lp_variant_cache_remove(cache, victim, true);
+      cached[victim - entries] = false;
+   }
+}
+
+
+/*
+ * Cycle through a few more variants than fit in the budget.  Plain LRU
+ * misses every time, 2Q keeps most of them in the protected segment.
+ */
+static bool
+test_cyclic(unsigned verbose, FILE *fp)
+{
+   const unsigned num_keys = 1100;
+   const unsigned budget = 1024;
+   const unsigned warmup_rounds = 10;
+   const unsigned rounds = 20;
+   struct lp_variant_cache cache;
+   struct lp_variant_cache_entry *entries = calloc(num_keys, sizeof *entries);
+   bool *cached = calloc(num_keys, sizeof *cached);
+   unsigned hits = 0, lookups = 0;
+   bool success = true;
+
+   lp_variant_cache_init(&cache, budget, ~0u);
+
+   for (unsigned round = 0; round < rounds; round++) {
+      for (unsigned i = 0; i < num_keys; i++) {
+         /* Measure once the segments settled */
+         if (round >= warmup_rounds)
+            lookups++;
+
+         if (cached[i]) {
+            lp_variant_cache_hit(&cache, &entries[i]);
+            if (round >= warmup_rounds)
+               hits++;
+         } else {
+            add_and_cull(&cache, entries, cached, i);
+         }
+
+         if (cache.size > budget || cache.count != cache.size) {
+            success = false;
+         }
+      }
+   }
+
+   const double hit_rate = (double)hits / lookups;
+   if (hit_rate < 0.75)
+      success = false;
+
+   if (verbose || !success) {
+      printf("cyclic: %u keys, budget %u: hit rate %.1f%%\n",
+             num_keys, budget, hit_rate * 100.0);
+   }
+   if (fp)
+      write_tsv_row(fp, "cyclic", hit_rate, success);
+
+   free(cached);
+   free(entries);
+
+   return success;
+}
+
+
+/*
+ * Recompiled variants whose ghost is still remembered go straight to the
+ * protected segment.  The ghosts are forgotten oldest first, regardless of
+ * ghosts taken in between.
+ */
+static bool
+test_ghosts(unsigned verbose, FILE *fp)
+{
+   const unsigned num_keys = LP_VARIANT_CACHE_GHOSTS + 16;
+   struct lp_variant_cache cache;
+   struct lp_variant_cache_entry *entries = calloc(num_keys, sizeof *entries);
+   bool success = true;
+
+   lp_variant_cache_init(&cache, num_keys, num_keys);
+
+   /* Evict the first LP_VARIANT_CACHE_GHOSTS keys from probation */
+   for (unsigned i = 0; i < LP_VARIANT_CACHE_GHOSTS; i++) {
+      lp_variant_cache_add(&cache, &entries[i], i, 1);
+      lp_variant_cache_remove(&cache, &entries[i], true);
+   }
+
+   /* Recompile key 10, which takes its ghost */
+   lp_variant_cache_add(&cache, &entries[10], 10, 1);
+   if (entries[10].segment != LP_VARIANT_PROTECTED)
+      success = false;
+   lp_variant_cache_remove(&cache, &entries[10], false);
+
+   /* Evicting 12 more keys forgets the ghosts of keys 0 to 9 and 11 */
+   for (unsigned i = LP_VARIANT_CACHE_GHOSTS; i < LP_VARIANT_CACHE_GHOSTS + 12; i++) {
+      lp_variant_cache_add(&cache, &entries[i], i, 1);
+      lp_variant_cache_remove(&cache, &entries[i], true);
+   }
+
+   for (unsigned i = 0; i < LP_VARIANT_CACHE_GHOSTS + 12; i++) {
+      const enum lp_variant_segment expected =
+         i > 11 ? LP_VARIANT_PROTECTED : LP_VARIANT_PROBATION;
+
+      lp_variant_cache_add(&cache, &entries[i], i, 1);
+      if (entries[i].segment != expected) {
+         if (verbose || success)
+            printf("ghosts: key %u added to the wrong segment\n", i);
+         success = false;
+      }
+      lp_variant_cache_remove(&cache, &entries[i], false);
+   }
+
+   if (cache.size != 0 || cache.count != 0)
+      success = false;
+
+   if (fp)
+      write_tsv_row(fp, "ghosts", 0.0, success);
+
+   free(entries);
+
+   return success;
+}
+
+
+static bool
+test_resize(unsigned verbose, FILE *fp)
+{
+   struct lp_variant_cache cache;
+   struct lp_variant_cache_entry entries[2];
+   bool success = true;
+
+   lp_variant_cache_init(&cache, 100, 10);
+
+   lp_variant_cache_add(&cache, &entries[0], 0, 30);
+   lp_variant_cache_add(&cache, &entries[1], 1, 30);
+   lp_variant_cache_hit(&cache, &entries[1]);
+
+   /* Growing an entry can make the cache full */
+   lp_variant_cache_resize(&cache, &entries[1], 80);
+   if (cache.size != 110 || !lp_variant_cache_full(&cache) ||
+       cache.segment_size[LP_VARIANT_PROBATION] != 30 ||
+       cache.segment_size[LP_VARIANT_PROTECTED] != 80)
+      success = false;
+
+   lp_variant_cache_resize(&cache, &entries[1], 20);
+   if (cache.size != 50 || lp_variant_cache_full(&cache) ||
+       cache.segment_size[LP_VARIANT_PROTECTED] != 20)
+      success = false;
+
+   lp_variant_cache_remove(&cache, &entries[0], false);
+   lp_variant_cache_remove(&cache, &entries[1], false);
+   if (cache.size != 0 || cache.segment_size[LP_VARIANT_PROBATION] != 0 ||
+       cache.segment_size[LP_VARIANT_PROTECTED] != 0)
+      success = false;
+
+   if (!success)
+      printf("resize: wrong sizes\n");
+   if (fp)
+      write_tsv_row(fp, "resize", 0.0, success);
+
+   return success;
+}
+
+
+bool
+test_all(unsigned verbose, FILE *fp)
+{
+   bool success = true;
+
+   success &= test_cyclic(verbose, fp);
+   success &= test_ghosts(verbose, fp);
+   success &= test_resize(verbose, fp);
+
+   return success;
+}
+
+
+bool
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+bool
+test_single(unsigned verbose, FILE *fp)
+{
+   printf("no test_single()");
+   return true;
+}
@@ -30,13 +30,29 @@
 
 
 #include "gallivm/lp_bld.h"
+#include "gallivm/lp_bld_format.h"
+#include "lp_perf.h"
 
 struct lp_build_sampler_soa;
 struct lp_sampler_static_state;
 /**
- * Whether texture cache is used for s3tc textures.
+ * Whether the per-thread block cache is used for compressed textures
+ * (can be disabled at runtime with LP_PERF=no_tex_cache).
  */
-#define LP_USE_TEXTURE_CACHE 0
+#define LP_USE_TEXTURE_CACHE 1
+
+
+/**
+ * Move a thread's texture block cache statistics into lp_count.
+ */
+static inline void
+lp_tex_cache_count(struct lp_build_format_cache *cache)
+{
+   LP_COUNT_ADD(nr_tex_cache_access, cache->cache_access_total);
+   LP_COUNT_ADD(nr_tex_cache_miss, cache->cache_access_miss);
+   cache->cache_access_total = 0;
+   cache->cache_access_miss = 0;
+}
 
 struct lp_build_sampler_soa *
 lp_llvm_sampler_soa_create(const struct lp_sampler_static_state *static_state,
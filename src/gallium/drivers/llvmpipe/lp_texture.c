@@ -38,6 +38,7 @@
 #include "util/detect_os.h"
 #include "util/os_file.h"
 #include "util/simple_mtx.h"
+#include "util/u_atomic.h"
 #include "util/u_inlines.h"
 #include "util/u_cpu_detect.h"
 #include "util/format/u_format.h"
@@ -578,6 +579,10 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
    struct llvmpipe_screen *screen = llvmpipe_screen(pscreen);
    struct llvmpipe_resource *lpr = llvmpipe_resource(pt);
 
+   /* The memory may be reused, don't let texture caches hit on it. */
+   if (llvmpipe_resource_is_texture(pt) && util_format_is_compressed(pt->format))
+      llvmpipe_texture_modified(screen);
+
    if (!lpr->backable && !lpr->user_ptr) {
       if (lpr->dt) {
          /* display target */
@@ -1074,6 +1079,9 @@ llvmpipe_transfer_map_ms(struct pipe_context *pipe,
       /* Do something to notify sharing contexts of a texture change.
        */
       screen->timestamp++;
+
+      if (util_format_is_compressed(format))
+         llvmpipe_texture_modified(screen);
    }
 
    map +=
@@ -1084,6 +1092,38 @@ llvmpipe_transfer_map_ms(struct pipe_context *pipe,
    return map;
 }
 
+/**
+ * Note that compressed texture contents changed (or texture memory was
+ * released), so that rasterizer/compute threads drop their cached texture
+ * blocks.
+ */
+void
+llvmpipe_texture_modified(struct llvmpipe_screen *screen)
+{
+   p_atomic_inc(&screen->tex_cache_generation);
+}
+
+
+/**
+ * Return the generation that work submitted now tags the per-thread texture
+ * block caches with.  The first scene or dispatch after a flush starts a new
+ * generation: the application may have written to (persistently) mapped
+ * memory backing a texture while the work was idle, which we don't see.
+ */
+unsigned
+llvmpipe_texture_cache_generation(struct llvmpipe_context *llvmpipe)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(llvmpipe->pipe.screen);
+
+   if (llvmpipe->tex_cache_flushed) {
+      llvmpipe->tex_cache_flushed = false;
+      llvmpipe_texture_modified(screen);
+   }
+
+   return p_atomic_read(&screen->tex_cache_generation);
+}
+
+
 uint32_t
 llvmpipe_get_texel_offset(struct pipe_resource *resource,
                           uint32_t level, uint32_t x,
@@ -1721,6 +1761,9 @@ llvmpipe_resource_bind_backing(struct pipe_screen *pscreen,
 
       lpr->tex_data = (char *)addr + offset;
 
+      if (util_format_is_compressed(lpr->base.format))
+         llvmpipe_texture_modified(screen);
+
       if (lpr->dmabuf) {
          if (lpr->dt)
          {
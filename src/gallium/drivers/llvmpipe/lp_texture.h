@@ -297,6 +297,14 @@ unsigned
 llvmpipe_get_format_alignment(enum pipe_format format);
 
 
+void
+llvmpipe_texture_modified(struct llvmpipe_screen *screen);
+
+
+unsigned
+llvmpipe_texture_cache_generation(struct llvmpipe_context *llvmpipe);
+
+
 void *
 llvmpipe_transfer_map_ms(struct pipe_context *pipe,
                          struct pipe_resource *resource,
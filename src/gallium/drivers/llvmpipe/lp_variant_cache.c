@@ -0,0 +1,163 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <string.h>
+
+#include "util/u_atomic.h"
+#include "lp_perf.h"
+#include "lp_variant_cache.h"
+
+
+void
+lp_variant_cache_init(struct lp_variant_cache *cache,
+                      uint64_t budget, unsigned max_count)
+{
+   memset(cache, 0, sizeof(*cache));
+   for (unsigned i = 0; i < LP_VARIANT_SEGMENTS; i++)
+      list_inithead(&cache->segment[i]);
+   cache->budget = budget;
+   cache->max_count = max_count;
+}
+
+
+static void
+move_to_segment(struct lp_variant_cache *cache,
+                struct lp_variant_cache_entry *entry,
+                enum lp_variant_segment segment)
+{
+   cache->segment_size[entry->segment] -= entry->size;
+   cache->segment_size[segment] += entry->size;
+   entry->segment = segment;
+   list_move_to(&entry->list, &cache->segment[segment]);
+}
+
+
+/* The ghosts are kept oldest first */
+static bool
+take_ghost(struct lp_variant_cache *cache, uint32_t hash)
+{
+   for (unsigned i = 0; i < cache->num_ghosts; i++) {
+      if (cache->ghosts[i] == hash) {
+         memmove(&cache->ghosts[i], &cache->ghosts[i + 1],
+                 (cache->num_ghosts - i - 1) * sizeof(cache->ghosts[0]));
+         cache->num_ghosts--;
+         return true;
+      }
+   }
+   return false;
+}
+
+
+static void
+add_ghost(struct lp_variant_cache *cache, uint32_t hash)
+{
+   if (cache->num_ghosts == LP_VARIANT_CACHE_GHOSTS) {
+      /* Full, forget the oldest */
+      memmove(&cache->ghosts[0], &cache->ghosts[1],
+              (LP_VARIANT_CACHE_GHOSTS - 1) * sizeof(cache->ghosts[0]));
+      cache->num_ghosts--;
+   }
+
+   cache->ghosts[cache->num_ghosts++] = hash;
+}
+
+
+void
+lp_variant_cache_add(struct lp_variant_cache *cache,
+                     struct lp_variant_cache_entry *entry,
+                     uint32_t hash, uint64_t size)
+{
+   entry->size = size;
+   entry->hash = hash;
+   entry->segment = LP_VARIANT_PROBATION;
+
+   if (take_ghost(cache, hash)) {
+      entry->segment = LP_VARIANT_PROTECTED;
+      p_atomic_inc(&lp_count.nr_variant_ghost_hits);
+   }
+
+   list_add(&entry->list, &cache->segment[entry->segment]);
+   cache->segment_size[entry->segment] += size;
+   cache->size += size;
+   cache->count++;
+}
+
+
+void
+lp_variant_cache_resize(struct lp_variant_cache *cache,
+                        struct lp_variant_cache_entry *entry,
+                        uint64_t size)
+{
+   cache->segment_size[entry->segment] += size - entry->size;
+   cache->size += size - entry->size;
+   entry->size = size;
+}
+
+
+void
+lp_variant_cache_hit(struct lp_variant_cache *cache,
+                     struct lp_variant_cache_entry *entry)
+{
+   if (entry->segment == LP_VARIANT_PROTECTED) {
+      list_move_to(&entry->list, &cache->segment[LP_VARIANT_PROTECTED]);
+      return;
+   }
+
+   move_to_segment(cache, entry, LP_VARIANT_PROTECTED);
+   p_atomic_inc(&lp_count.nr_variants_promoted);
+
+   /* Keep a quarter of the budget for probation by demoting the least
+    * recently used protected entries, which get one more chance there.
+    */
+   const uint64_t max_protected = cache->budget - cache->budget / 4;
+   while (cache->segment_size[LP_VARIANT_PROTECTED] > max_protected) {
+      struct lp_variant_cache_entry *last =
+         list_last_entry(&cache->segment[LP_VARIANT_PROTECTED],
+                         struct lp_variant_cache_entry, list);
+      if (last == entry)
+         break;
+      move_to_segment(cache, last, LP_VARIANT_PROBATION);
+   }
+}
+
+
+void
+lp_variant_cache_remove(struct lp_variant_cache *cache,
+                        struct lp_variant_cache_entry *entry,
+                        bool evicted)
+{
+   if (evicted) {
+      if (entry->segment == LP_VARIANT_PROBATION) {
+         add_ghost(cache, entry->hash);
+         p_atomic_inc(&lp_count.nr_variants_evicted_probation);
+      } else {
+         p_atomic_inc(&lp_count.nr_variants_evicted_protected);
+      }
+      p_atomic_add(&lp_count.variant_bytes_evicted, entry->size);
+   }
+
+   list_del(&entry->list);
+   cache->segment_size[entry->segment] -= entry->size;
+   cache->size -= entry->size;
+   cache->count--;
+}
+
+
+struct lp_variant_cache_entry *
+lp_variant_cache_victim(const struct lp_variant_cache *cache)
+{
+   enum lp_variant_segment segment = LP_VARIANT_PROTECTED;
+
+   if (list_is_empty(&cache->segment[LP_VARIANT_PROTECTED]) ||
+       (cache->segment_size[LP_VARIANT_PROBATION] > cache->budget / 4 &&
+        !list_is_empty(&cache->segment[LP_VARIANT_PROBATION])))
+      segment = LP_VARIANT_PROBATION;
+
+   if (list_is_empty(&cache->segment[segment]))
+      return NULL;
+
+   return list_last_entry(&cache->segment[segment],
+                          struct lp_variant_cache_entry, list);
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Replacement policy for the per-context shader variant caches.
+ *
+ * This is a 2Q style cache with two LRU segments.  New variants start in
+ * the probation segment and move to the protected segment when they are
+ * looked up again, so that a burst of variants which are only used once
+ * doesn't flush the ones which are reused.  Victims are taken from the
+ * probation segment while it holds more than a quarter of the budget, and
+ * from the protected segment otherwise.
+ *
+ * The hashes of the keys recently evicted from probation are remembered
+ * as ghosts.  A variant which is recompiled while its ghost is still
+ * around was evicted too early, and goes straight to the protected
+ * segment.
+ *
+ * Sizes are in bytes of generated code for the shader variants, but any
+ * unit works as long as it matches the budget.
+ */
+
+#ifndef LP_VARIANT_CACHE_H
+#define LP_VARIANT_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "util/list.h"
+
+#define LP_VARIANT_CACHE_GHOSTS 256
+
+enum lp_variant_segment {
+   LP_VARIANT_PROBATION,
+   LP_VARIANT_PROTECTED,
+   LP_VARIANT_SEGMENTS,
+};
+
+
+/** Embedded in the variants */
+struct lp_variant_cache_entry
+{
+   struct list_head list;
+   uint64_t size;
+   uint32_t hash;
+   enum lp_variant_segment segment;
+};
+
+
+struct lp_variant_cache
+{
+   /* Most recently used first */
+   struct list_head segment[LP_VARIANT_SEGMENTS];
+   uint64_t segment_size[LP_VARIANT_SEGMENTS];
+
+   uint64_t size;
+   unsigned count;
+
+   uint64_t budget;
+   unsigned max_count;
+
+   /* Oldest first */
+   uint32_t ghosts[LP_VARIANT_CACHE_GHOSTS];
+   unsigned num_ghosts;
+};
+
+
+/* Note that break only leaves the current segment */
+#define LP_VARIANT_CACHE_FOREACH_SAFE(entry, cache)                           \
+   for (unsigned _seg = 0; _seg < LP_VARIANT_SEGMENTS; _seg++)                \
+      list_for_each_entry_safe(struct lp_variant_cache_entry, entry,          \
+                               &(cache)->segment[_seg], list)
+
+
+void
+lp_variant_cache_init(struct lp_variant_cache *cache,
+                      uint64_t budget, unsigned max_count);
+
+void
+lp_variant_cache_add(struct lp_variant_cache *cache,
+                     struct lp_variant_cache_entry *entry,
+                     uint32_t hash, uint64_t size);
+
+/**
+ * Update the size of an entry, e.g. once more of its code was compiled.
+ */
+void
+lp_variant_cache_resize(struct lp_variant_cache *cache,
+                        struct lp_variant_cache_entry *entry,
+                        uint64_t size);
+
+void
+lp_variant_cache_hit(struct lp_variant_cache *cache,
+                     struct lp_variant_cache_entry *entry);
+
+/**
+ * Remove an entry.  Evicted entries leave a ghost and are counted in the
+ * lp_perf counters, entries of deleted shaders don't.
+ */
+void
+lp_variant_cache_remove(struct lp_variant_cache *cache,
+                        struct lp_variant_cache_entry *entry,
+                        bool evicted);
+
+/**
+ * The entry which should be evicted next, or NULL if the cache is empty.
+ */
+struct lp_variant_cache_entry *
+lp_variant_cache_victim(const struct lp_variant_cache *cache);
+
+
+static inline bool
+lp_variant_cache_full(const struct lp_variant_cache *cache)
+{
+   return cache->size > cache->budget || cache->count > cache->max_count;
+}
+
+#endif /* LP_VARIANT_CACHE_H */
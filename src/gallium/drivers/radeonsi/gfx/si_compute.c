@@ -154,7 +154,7 @@ static void si_get_compute_state_info(struct pipe_context *ctx, void *state,
    struct si_shader_selector *sel = &program->sel;
 
    /* Wait because we need the compilation to finish first */
-   util_queue_fence_wait(&sel->ready);
+   util_queue_job_wait(&sel->screen->shader_compiler_queue, &sel->ready);
 
    uint8_t wave_size = program->shader.wave_size;
    info->private_memory = DIV_ROUND_UP(program->shader.config.scratch_bytes_per_wave, wave_size);
@@ -2677,7 +2677,7 @@ current_not_ready:
     * compilation calls this function too, and therefore must enter
     * the mutex first.
     */
-   util_queue_fence_wait(&sel->ready);
+   util_queue_job_wait(&sel->screen->shader_compiler_queue, &sel->ready);
 
    simple_mtx_lock(&sel->mutex);
 
@@ -231,6 +231,28 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDescriptorSetLayout(
 
    set_layout->dynamic_offset_count = dynamic_offset_count;
 
+   /* Used by the pipeline cache: everything the shader lowering reads from
+    * the layout has to be part of the hash.
+    */
+   blake3_hasher blake3_ctx;
+   _mesa_blake3_init(&blake3_ctx);
+   _mesa_blake3_update(&blake3_ctx, &set_layout->vk.flags, sizeof(set_layout->vk.flags));
+   _mesa_blake3_update(&blake3_ctx, &set_layout->binding_count, sizeof(set_layout->binding_count));
+   _mesa_blake3_update(&blake3_ctx, &set_layout->size, sizeof(set_layout->size));
+   _mesa_blake3_update(&blake3_ctx, &set_layout->dynamic_offset_count, sizeof(set_layout->dynamic_offset_count));
+   for (uint32_t i = 0; i < set_layout->binding_count; i++) {
+      const struct lvp_descriptor_set_binding_layout *binding = &set_layout->binding[i];
+      _mesa_blake3_update(&blake3_ctx, binding,
+                          offsetof(struct lvp_descriptor_set_binding_layout, immutable_samplers));
+      if (binding->immutable_samplers) {
+         _mesa_blake3_update(&blake3_ctx, binding->immutable_samplers,
+                             binding->array_size * sizeof(*binding->immutable_samplers));
+         _mesa_blake3_update(&blake3_ctx, binding->immutable_ycbcr,
+                             binding->array_size * sizeof(*binding->immutable_ycbcr));
+      }
+   }
+   _mesa_blake3_final(&blake3_ctx, set_layout->vk.blake3);
+
    if (set_layout->binding_count == set_layout->immutable_sampler_count) {
       /* create a bindable set with all the immutable samplers */
       lvp_descriptor_set_create(device, set_layout, &set_layout->immutable_set);
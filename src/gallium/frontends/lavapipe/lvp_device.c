@@ -28,9 +28,12 @@
 #include "pipe-loader/pipe_loader.h"
 #include "git_sha1.h"
 #include "vk_cmd_enqueue_entrypoints.h"
+#include "vk_pipeline_cache.h"
 #include "vk_sampler.h"
 #include "vk_util.h"
 #include "util/detect.h"
+#include "util/disk_cache.h"
+#include "util/hex.h"
 #include "pipe/p_defines.h"
 #include "pipe/p_state.h"
 #include "pipe/p_context.h"
@@ -43,6 +46,7 @@
 #include "util/os_time.h"
 #include "util/u_thread.h"
 #include "util/u_atomic.h"
+#include "util/u_cpu_detect.h"
 #include "util/timespec.h"
 #include "util/ptralloc.h"
 #include "nir.h"
@@ -1463,6 +1467,26 @@ lvp_get_properties(const struct lvp_physical_device *device, struct vk_propertie
 
 }
 
+static void
+lvp_physical_device_init_disk_cache(struct lvp_physical_device *device)
+{
+#ifdef ENABLE_SHADER_CACHE
+   /* The cached NIR only depends on the lavapipe/NIR code, the machine code
+    * is cached separately by llvmpipe.
+    */
+   blake3_hasher ctx;
+   unsigned char blake3[BLAKE3_KEY_LEN];
+   char cache_id[BLAKE3_HEX_LEN];
+   _mesa_blake3_init(&ctx);
+   if (!disk_cache_get_function_identifier(lvp_physical_device_init_disk_cache, &ctx))
+      return;
+   _mesa_blake3_final(&ctx, blake3);
+   mesa_bytes_to_hex(cache_id, blake3, BLAKE3_KEY_LEN);
+
+   device->vk.disk_cache = disk_cache_create("lavapipe", cache_id, 0);
+#endif
+}
+
 static VkResult VKAPI_CALL
 lvp_physical_device_init(struct lvp_physical_device *device,
                          struct lvp_instance *instance,
@@ -1522,10 +1546,13 @@ lvp_physical_device_init(struct lvp_physical_device *device,
 
    lvp_get_features(device, &device->vk.supported_features);
    lvp_get_properties(device, &device->vk.properties);
+   lvp_physical_device_init_disk_cache(device);
 
 #ifdef LVP_USE_WSI_PLATFORM
    result = lvp_init_wsi(device);
    if (result != VK_SUCCESS) {
+      if (device->vk.disk_cache)
+         disk_cache_destroy(device->vk.disk_cache);
       vk_physical_device_finish(&device->vk);
       vk_error(instance, result);
       goto fail;
@@ -1543,6 +1570,8 @@ lvp_physical_device_finish(struct lvp_physical_device *device)
 #ifdef LVP_USE_WSI_PLATFORM
    lvp_finish_wsi(device);
 #endif
+   if (device->vk.disk_cache)
+      disk_cache_destroy(device->vk.disk_cache);
    device->pscreen->destroy(device->pscreen);
    vk_physical_device_finish(&device->vk);
 }
@@ -1989,6 +2018,18 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDevice(
       return result;
    }
 
+   /* A graphics pipeline has at most five stages, one of which is
+    * compiled on the calling thread.
+    */
+   unsigned compile_threads =
+      debug_get_num_option("LVP_COMPILE_THREADS",
+                           MIN2(util_get_cpu_caps()->nr_cpus - 1, 4));
+   if (compile_threads) {
+      device->compile_queue_initialized =
+         util_queue_init(&device->compile_queue, "lvp_compile", 32,
+                         compile_threads, UTIL_QUEUE_INIT_RESIZE_IF_FULL, NULL);
+   }
+
    nir_builder b = nir_builder_init_simple_shader(MESA_SHADER_FRAGMENT, physical_device->drv_options[MESA_SHADER_FRAGMENT], "dummy_frag");
    struct pipe_shader_state shstate = {0};
    shstate.type = PIPE_SHADER_IR_NIR;
@@ -2022,6 +2063,16 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDevice(
 
    lvp_device_init_accel_struct_state(device);
 
+   /* Used for pipelines created without a VkPipelineCache */
+   struct vk_pipeline_cache_create_info cache_info = {
+      .weak_ref = true,
+   };
+   device->vk.mem_cache = vk_pipeline_cache_create(&device->vk, &cache_info, NULL);
+   if (!device->vk.mem_cache) {
+      lvp_DestroyDevice(lvp_device_to_handle(device), pAllocator);
+      return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+   }
+
    *pDevice = lvp_device_to_handle(device);
 
    return VK_SUCCESS;
@@ -2034,6 +2085,9 @@ VKAPI_ATTR void VKAPI_CALL lvp_DestroyDevice(
 {
    VK_FROM_HANDLE(lvp_device, device, _device);
 
+   if (device->vk.mem_cache)
+      vk_pipeline_cache_destroy(device->vk.mem_cache, NULL);
+
    lvp_device_finish_accel_struct_state(device);
 
    vk_meta_device_finish(&device->vk, &device->meta);
@@ -2059,6 +2113,9 @@ VKAPI_ATTR void VKAPI_CALL lvp_DestroyDevice(
    simple_mtx_destroy(&device->bda_lock);
    pipe_resource_reference(&device->zero_buffer, NULL);
 
+   if (device->compile_queue_initialized)
+      util_queue_destroy(&device->compile_queue);
+
    lvp_queue_finish(&device->queue);
    vk_device_finish(&device->vk);
    vk_free(&device->vk.alloc, device);
@@ -26,6 +26,7 @@
 #include "vk_nir_convert_ycbcr.h"
 #include "vk_nir_lower_descriptor_heaps.h"
 #include "vk_pipeline.h"
+#include "vk_pipeline_cache.h"
 #include "vk_render_pass.h"
 #include "vk_util.h"
 #include "glsl_types.h"
@@ -672,19 +673,191 @@ lvp_shader_init(struct lvp_shader *shader, nir_shader *nir)
    shader->pipeline_nir = lvp_create_pipeline_nir(nir);
 }
 
+static void
+lvp_hash_shader(struct lvp_pipeline *pipeline, const void *pipeline_pNext,
+                const VkPipelineShaderStageCreateInfo *sinfo, unsigned char *key)
+{
+   struct lvp_device *device = lvp_pipeline_device(pipeline);
+
+   struct vk_pipeline_robustness_state robustness;
+   vk_pipeline_robustness_state_fill(&device->vk.robustness_state, &robustness, pipeline_pNext, sinfo->pNext);
+
+   unsigned char stage_blake3[BLAKE3_KEY_LEN];
+   vk_pipeline_hash_shader_stage(pipeline->flags, sinfo, &robustness, stage_blake3);
+
+   blake3_hasher sctx;
+   _mesa_blake3_init(&sctx);
+   _mesa_blake3_update(&sctx, stage_blake3, sizeof(stage_blake3));
+   _mesa_blake3_update(&sctx, &pipeline->type, sizeof(pipeline->type));
+
+   const bool debug_info = gallivm_debug & GALLIVM_DEBUG_SYMBOLS;
+   _mesa_blake3_update(&sctx, &debug_info, sizeof(debug_info));
+
+   /* The lowering bakes the descriptor set layouts into the shader. */
+   if (pipeline->layout) {
+      const struct vk_pipeline_layout *layout = &pipeline->layout->vk;
+      _mesa_blake3_update(&sctx, &layout->set_count, sizeof(layout->set_count));
+      for (uint32_t i = 0; i < layout->set_count; i++) {
+         static const blake3_hash null_set = { 0 };
+         const struct vk_descriptor_set_layout *set_layout = layout->set_layouts[i];
+         _mesa_blake3_update(&sctx, set_layout ? set_layout->blake3 : null_set, sizeof(blake3_hash));
+      }
+      _mesa_blake3_update(&sctx, &pipeline->layout->push_constant_size,
+                          sizeof(pipeline->layout->push_constant_size));
+   }
+
+   _mesa_blake3_final(&sctx, key);
+}
+
+static nir_shader *
+lvp_shader_cache_lookup(struct lvp_pipeline *pipeline, struct vk_pipeline_cache *cache,
+                        const unsigned char *key, mesa_shader_stage stage, bool *cache_hit)
+{
+   struct lvp_device *device = lvp_pipeline_device(pipeline);
+   struct vk_pipeline_cache_object *object =
+      vk_pipeline_cache_lookup_object(cache, key, BLAKE3_KEY_LEN,
+                                      &vk_raw_data_cache_object_ops, cache_hit);
+   if (!object)
+      return NULL;
+
+   struct vk_raw_data_cache_object *data =
+      container_of(object, struct vk_raw_data_cache_object, base);
+   struct blob_reader blob;
+   blob_reader_init(&blob, data->data, data->data_size);
+   uint32_t push_constant_size = blob_read_uint32(&blob);
+   nir_shader *nir = nir_deserialize(NULL, lvp_device_physical(device)->drv_options[stage], &blob);
+   vk_pipeline_cache_object_unref(&device->vk, object);
+
+   if (nir) {
+      /* Same state lvp_spirv_to_nir() would have set up. */
+      struct lvp_shader *shader = &pipeline->shaders[stage];
+      shader->heaps = false;
+      shader->layout = pipeline->layout;
+      shader->push_constant_size = push_constant_size;
+   }
+   return nir;
+}
+
+static void
+lvp_shader_cache_insert(struct lvp_pipeline *pipeline, struct vk_pipeline_cache *cache,
+                        const unsigned char *key, const struct lvp_shader *shader,
+                        const nir_shader *nir)
+{
+   struct lvp_device *device = lvp_pipeline_device(pipeline);
+   struct blob blob;
+   blob_init(&blob);
+   blob_write_uint32(&blob, shader->push_constant_size);
+   nir_serialize(&blob, nir, false);
+
+   if (!blob.out_of_memory) {
+      struct vk_raw_data_cache_object *data =
+         vk_raw_data_cache_object_create(&device->vk, key, BLAKE3_KEY_LEN, blob.data, blob.size);
+      if (data) {
+         struct vk_pipeline_cache_object *object = vk_pipeline_cache_add_object(cache, &data->base);
+         vk_pipeline_cache_object_unref(&device->vk, object);
+      }
+   }
+   blob_finish(&blob);
+}
+
 static VkResult
-lvp_shader_compile_to_ir(struct lvp_pipeline *pipeline, const void *pipeline_pNext,
-                         const VkPipelineShaderStageCreateInfo *sinfo)
+lvp_shader_compile_to_ir(struct lvp_pipeline *pipeline, struct vk_pipeline_cache *cache,
+                         const void *pipeline_pNext,
+                         const VkPipelineShaderStageCreateInfo *sinfo,
+                         bool *cache_hit)
 {
    mesa_shader_stage stage = vk_to_mesa_shader_stage(sinfo->stage);
    assert(stage <= LVP_SHADER_STAGES && stage != MESA_SHADER_NONE);
+   struct lvp_shader *shader = &pipeline->shaders[stage];
+   unsigned char key[BLAKE3_KEY_LEN];
+   nir_shader *nir = NULL;
+
+   *cache_hit = false;
+
+   /* Descriptor heap mappings and execution graph lowering depend on state
+    * that isn't part of the key.
+    */
+   if (pipeline->heaps || pipeline->type == LVP_PIPELINE_EXEC_GRAPH)
+      cache = NULL;
+
+   if (cache) {
+      lvp_hash_shader(pipeline, pipeline_pNext, sinfo, key);
+      nir = lvp_shader_cache_lookup(pipeline, cache, key, stage, cache_hit);
+   }
+
+   if (!nir) {
+      *cache_hit = false;
+      VkResult result = lvp_spirv_to_nir(pipeline, pipeline_pNext, sinfo, &nir);
+      if (result != VK_SUCCESS)
+         return result;
+
+      if (cache)
+         lvp_shader_cache_insert(pipeline, cache, key, shader, nir);
+   }
+
+   lvp_shader_init(shader, nir);
+   return VK_SUCCESS;
+}
+
+struct lvp_stage_job {
+   struct util_queue_fence fence;
+   struct lvp_pipeline *pipeline;
+
+   /* Front-end: SPIR-V or cache to NIR */
+   struct vk_pipeline_cache *cache;
+   const void *pipeline_pNext;
+   const VkPipelineShaderStageCreateInfo *sinfo;
+   bool cache_hit;
+   VkResult result;
+
+   /* Back-end: finalize_nir() */
    nir_shader *nir;
-   VkResult result = lvp_spirv_to_nir(pipeline, pipeline_pNext, sinfo, &nir);
-   if (result == VK_SUCCESS) {
-      struct lvp_shader *shader = &pipeline->shaders[stage];
-      lvp_shader_init(shader, nir);
+};
+
+static void
+lvp_stage_job_compile_to_ir(void *data, void *gdata, int thread_index)
+{
+   struct lvp_stage_job *job = data;
+   job->result = lvp_shader_compile_to_ir(job->pipeline, job->cache,
+                                          job->pipeline_pNext, job->sinfo,
+                                          &job->cache_hit);
+}
+
+static void
+lvp_stage_job_finalize(void *data, void *gdata, int thread_index)
+{
+   struct lvp_stage_job *job = data;
+   struct pipe_screen *pscreen = lvp_pipeline_device(job->pipeline)->pscreen;
+   pscreen->finalize_nir(pscreen, job->nir, true);
+}
+
+/**
+ * Run one job per stage.  Each job only writes its own stage of the
+ * pipeline, so the calling thread runs the first job and the others go to
+ * the device's compile queue.
+ */
+static void
+lvp_run_stage_jobs(struct lvp_device *device, struct lvp_stage_job *jobs,
+                   unsigned num_jobs, util_queue_execute_func execute)
+{
+   if (num_jobs <= 1 || !device->compile_queue_initialized) {
+      for (unsigned i = 0; i < num_jobs; i++)
+         execute(&jobs[i], NULL, 0);
+      return;
+   }
+
+   for (unsigned i = 1; i < num_jobs; i++) {
+      util_queue_fence_init(&jobs[i].fence);
+      util_queue_add_job(&device->compile_queue, &jobs[i], &jobs[i].fence,
+                         execute, NULL, 0);
+   }
+
+   execute(&jobs[0], NULL, 0);
+
+   for (unsigned i = 1; i < num_jobs; i++) {
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
    }
-   return result;
 }
 
 static void
@@ -935,9 +1108,10 @@ copy_shader_sanitized(struct lvp_shader *dst, const struct lvp_shader *src)
 static VkResult
 lvp_graphics_pipeline_init(struct lvp_pipeline *pipeline,
                            struct lvp_device *device,
-                           struct lvp_pipeline_cache *cache,
+                           struct vk_pipeline_cache *cache,
                            const VkGraphicsPipelineCreateInfo *pCreateInfo,
-                           VkPipelineCreateFlagBits2KHR flags)
+                           VkPipelineCreateFlagBits2KHR flags,
+                           bool *cache_hit)
 {
    pipeline->type = LVP_PIPELINE_GRAPHICS;
    pipeline->flags = flags;
@@ -1025,6 +1199,8 @@ lvp_graphics_pipeline_init(struct lvp_pipeline *pipeline,
                                                    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT |
                                                    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT));
 
+   struct lvp_stage_job jobs[LVP_SHADER_STAGES];
+   unsigned num_jobs = 0;
    for (uint32_t i = 0; i < pCreateInfo->stageCount; i++) {
       const VkPipelineShaderStageCreateInfo *sinfo = &pCreateInfo->pStages[i];
       mesa_shader_stage stage = vk_to_mesa_shader_stage(sinfo->stage);
@@ -1035,18 +1211,29 @@ lvp_graphics_pipeline_init(struct lvp_pipeline *pipeline,
          if (!(pipeline->stages & VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT))
             continue;
       }
-      result = lvp_shader_compile_to_ir(pipeline, pCreateInfo->pNext, sinfo);
-      if (result != VK_SUCCESS)
-         goto fail;
+      assert(num_jobs < ARRAY_SIZE(jobs));
+      jobs[num_jobs++] = (struct lvp_stage_job) {
+         .pipeline = pipeline,
+         .cache = cache,
+         .pipeline_pNext = pCreateInfo->pNext,
+         .sinfo = sinfo,
+      };
+   }
 
-      switch (stage) {
-      case MESA_SHADER_FRAGMENT:
-         if (pipeline->shaders[MESA_SHADER_FRAGMENT].pipeline_nir->nir->info.fs.uses_sample_shading)
-            pipeline->force_min_sample = true;
-         break;
-      default: break;
+   lvp_run_stage_jobs(device, jobs, num_jobs, lvp_stage_job_compile_to_ir);
+
+   /* Report the first failure in stage order, like a serial compile. */
+   for (unsigned i = 0; i < num_jobs; i++) {
+      if (jobs[i].result != VK_SUCCESS) {
+         result = jobs[i].result;
+         goto fail;
       }
+      *cache_hit &= jobs[i].cache_hit;
    }
+
+   if (pipeline->shaders[MESA_SHADER_FRAGMENT].pipeline_nir &&
+       pipeline->shaders[MESA_SHADER_FRAGMENT].pipeline_nir->nir->info.fs.uses_sample_shading)
+      pipeline->force_min_sample = true;
    if (pCreateInfo->stageCount && pipeline->shaders[MESA_SHADER_TESS_EVAL].pipeline_nir) {
       nir_lower_patch_vertices(pipeline->shaders[MESA_SHADER_TESS_EVAL].pipeline_nir->nir, pipeline->shaders[MESA_SHADER_TESS_CTRL].pipeline_nir->nir->info.tess.tcs_vertices_out, NULL);
       merge_tess_info(&pipeline->shaders[MESA_SHADER_TESS_EVAL].pipeline_nir->nir->info, &pipeline->shaders[MESA_SHADER_TESS_CTRL].pipeline_nir->nir->info);
@@ -1121,19 +1308,49 @@ lvp_pipeline_shaders_compile(struct lvp_pipeline *pipeline, bool locked)
    struct lvp_device *device = lvp_pipeline_device(pipeline);
    if (pipeline->compiled)
       return;
+
+   /* finalize_nir() doesn't touch the context, so it runs in parallel and
+    * only the CSO creation is serialized on the queue lock.
+    */
+   struct lvp_stage_job jobs[ARRAY_SIZE(pipeline->shaders) + 1];
+   unsigned num_jobs = 0;
    for (uint32_t i = 0; i < ARRAY_SIZE(pipeline->shaders); i++) {
       if (!pipeline->shaders[i].pipeline_nir)
          continue;
 
-      mesa_shader_stage stage = i;
-      assert(stage == pipeline->shaders[i].pipeline_nir->nir->info.stage);
+      assert(i == pipeline->shaders[i].pipeline_nir->nir->info.stage);
+      jobs[num_jobs++] = (struct lvp_stage_job) {
+         .pipeline = pipeline,
+         .nir = nir_shader_clone(NULL, pipeline->shaders[i].pipeline_nir->nir),
+      };
+   }
+   const bool tess_ccw = pipeline->shaders[MESA_SHADER_TESS_EVAL].tess_ccw;
+   if (tess_ccw) {
+      jobs[num_jobs++] = (struct lvp_stage_job) {
+         .pipeline = pipeline,
+         .nir = nir_shader_clone(NULL, pipeline->shaders[MESA_SHADER_TESS_EVAL].tess_ccw->nir),
+      };
+   }
+
+   lvp_run_stage_jobs(device, jobs, num_jobs, lvp_stage_job_finalize);
+
+   if (!locked)
+      simple_mtx_lock(&device->queue.lock);
+
+   for (unsigned i = 0; i < num_jobs; i++) {
+      mesa_shader_stage stage = jobs[i].nir->info.stage;
+      struct lvp_shader *shader = &pipeline->shaders[stage];
+      void *state = lvp_shader_compile_stage(device, shader, jobs[i].nir);
 
-      pipeline->shaders[stage].shader_cso = lvp_shader_compile(device, &pipeline->shaders[stage],
-         nir_shader_clone(NULL, pipeline->shaders[stage].pipeline_nir->nir), locked);
-      if (pipeline->shaders[MESA_SHADER_TESS_EVAL].tess_ccw)
-         pipeline->shaders[MESA_SHADER_TESS_EVAL].tess_ccw_cso = lvp_shader_compile(device, &pipeline->shaders[stage],
-            nir_shader_clone(NULL, pipeline->shaders[MESA_SHADER_TESS_EVAL].tess_ccw->nir), locked);
+      if (tess_ccw && i == num_jobs - 1)
+         shader->tess_ccw_cso = state;
+      else
+         shader->shader_cso = state;
    }
+
+   if (!locked)
+      simple_mtx_unlock(&device->queue.lock);
+
    pipeline->compiled = true;
 }
 
@@ -1147,7 +1364,7 @@ lvp_graphics_pipeline_create(
    bool group)
 {
    VK_FROM_HANDLE(lvp_device, device, _device);
-   VK_FROM_HANDLE(lvp_pipeline_cache, cache, _cache);
+   VK_FROM_HANDLE(vk_pipeline_cache, cache, _cache);
    struct lvp_pipeline *pipeline;
    VkResult result;
 
@@ -1161,7 +1378,11 @@ lvp_graphics_pipeline_create(
    vk_object_base_init(&device->vk, &pipeline->base,
                        VK_OBJECT_TYPE_PIPELINE);
    uint64_t t0 = os_time_get_nano();
-   result = lvp_graphics_pipeline_init(pipeline, device, cache, pCreateInfo, flags);
+   const bool app_cache = cache != NULL;
+   bool cache_hit = pCreateInfo->stageCount > 0;
+   if (!cache)
+      cache = device->vk.mem_cache;
+   result = lvp_graphics_pipeline_init(pipeline, device, cache, pCreateInfo, flags, &cache_hit);
    if (result != VK_SUCCESS) {
       vk_free(&device->vk.alloc, pipeline);
       return result;
@@ -1171,6 +1392,8 @@ lvp_graphics_pipeline_create(
    if (feedback && !group) {
       feedback->pPipelineCreationFeedback->duration = os_time_get_nano() - t0;
       feedback->pPipelineCreationFeedback->flags = VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT;
+      if (app_cache && cache_hit)
+         feedback->pPipelineCreationFeedback->flags |= VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT;
       memset(feedback->pPipelineStageCreationFeedbacks, 0, sizeof(VkPipelineCreationFeedback) * feedback->pipelineStageCreationFeedbackCount);
    }
 
@@ -1219,9 +1442,10 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateGraphicsPipelines(
 static VkResult
 lvp_compute_pipeline_init(struct lvp_pipeline *pipeline,
                           struct lvp_device *device,
-                          struct lvp_pipeline_cache *cache,
+                          struct vk_pipeline_cache *cache,
                           const VkComputePipelineCreateInfo *pCreateInfo,
-                          VkPipelineCreateFlagBits2KHR flags)
+                          VkPipelineCreateFlagBits2KHR flags,
+                          bool *cache_hit)
 {
    pipeline->flags = flags;
    if (flags & VK_PIPELINE_CREATE_2_DESCRIPTOR_HEAP_BIT_EXT) {
@@ -1234,7 +1458,7 @@ lvp_compute_pipeline_init(struct lvp_pipeline *pipeline,
 
    pipeline->type = LVP_PIPELINE_COMPUTE;
 
-   VkResult result = lvp_shader_compile_to_ir(pipeline, pCreateInfo->pNext, &pCreateInfo->stage);
+   VkResult result = lvp_shader_compile_to_ir(pipeline, cache, pCreateInfo->pNext, &pCreateInfo->stage, cache_hit);
    if (result != VK_SUCCESS)
       return result;
 
@@ -1253,7 +1477,7 @@ lvp_compute_pipeline_create(
    VkPipeline *pPipeline)
 {
    VK_FROM_HANDLE(lvp_device, device, _device);
-   VK_FROM_HANDLE(lvp_pipeline_cache, cache, _cache);
+   VK_FROM_HANDLE(vk_pipeline_cache, cache, _cache);
    struct lvp_pipeline *pipeline;
    VkResult result;
 
@@ -1267,7 +1491,11 @@ lvp_compute_pipeline_create(
    vk_object_base_init(&device->vk, &pipeline->base,
                        VK_OBJECT_TYPE_PIPELINE);
    uint64_t t0 = os_time_get_nano();
-   result = lvp_compute_pipeline_init(pipeline, device, cache, pCreateInfo, flags);
+   const bool app_cache = cache != NULL;
+   if (!cache)
+      cache = device->vk.mem_cache;
+   bool cache_hit;
+   result = lvp_compute_pipeline_init(pipeline, device, cache, pCreateInfo, flags, &cache_hit);
    if (result != VK_SUCCESS) {
       vk_free(&device->vk.alloc, pipeline);
       return result;
@@ -1277,6 +1505,8 @@ lvp_compute_pipeline_create(
    if (feedback) {
       feedback->pPipelineCreationFeedback->duration = os_time_get_nano() - t0;
       feedback->pPipelineCreationFeedback->flags = VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT;
+      if (app_cache && cache_hit)
+         feedback->pPipelineCreationFeedback->flags |= VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT;
       memset(feedback->pPipelineStageCreationFeedbacks, 0, sizeof(VkPipelineCreationFeedback) * feedback->pipelineStageCreationFeedbackCount);
    }
 
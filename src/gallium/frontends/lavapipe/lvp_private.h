@@ -204,11 +204,6 @@ lvp_queue_device(const struct lvp_queue *queue)
    return (struct lvp_device *)queue->vk.base.device;
 }
 
-struct lvp_pipeline_cache {
-   struct vk_object_base base;
-   VkAllocationCallbacks alloc;
-};
-
 struct lvp_device {
    struct vk_device vk;
 
@@ -221,6 +216,10 @@ struct lvp_device {
    bool poison_mem;
    bool print_cmds;
 
+   /* Translates and finalizes the stages of a pipeline in parallel */
+   struct util_queue compile_queue;
+   bool compile_queue_initialized;
+
    struct lp_texture_handle *null_texture_handle;
    struct lp_texture_handle *null_image_handle;
    struct util_dynarray bda_texture_handles;
@@ -711,8 +710,6 @@ VK_DEFINE_NONDISP_HANDLE_CASTS(lvp_event, base, VkEvent, VK_OBJECT_TYPE_EVENT)
 VK_DEFINE_NONDISP_HANDLE_CASTS(lvp_image, vk.base, VkImage, VK_OBJECT_TYPE_IMAGE)
 VK_DEFINE_NONDISP_HANDLE_CASTS(lvp_image_view, vk.base, VkImageView,
                                VK_OBJECT_TYPE_IMAGE_VIEW);
-VK_DEFINE_NONDISP_HANDLE_CASTS(lvp_pipeline_cache, base, VkPipelineCache,
-                               VK_OBJECT_TYPE_PIPELINE_CACHE)
 VK_DEFINE_NONDISP_HANDLE_CASTS(lvp_pipeline, base, VkPipeline,
                                VK_OBJECT_TYPE_PIPELINE)
 VK_DEFINE_NONDISP_HANDLE_CASTS(lvp_shader, base, VkShaderEXT,
@@ -0,0 +1,306 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Measures vkCreateGraphicsPipelines on lavapipe by creating thousands of
+ * vertex + fragment pipelines.  Every pipeline specializes the fragment
+ * shader with a different constant, so none of them is found in the
+ * device's in-memory pipeline cache.  LVP_COMPILE_THREADS sets the number of
+ * threads that compile the stages of a pipeline.
+ *
+ * Usage: lvp_pipeline_bench [num_pipelines]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vulkan/vulkan.h>
+
+#include "util/macros.h"
+#include "util/os_time.h"
+
+PFN_vkVoidFunction VKAPI_CALL
+vk_icdGetInstanceProcAddr(VkInstance instance, const char *pName);
+
+#define FUNCTION_LIST               \
+   ITEM(DestroyInstance)            \
+   ITEM(EnumeratePhysicalDevices)   \
+   ITEM(CreateDevice)               \
+   ITEM(DestroyDevice)              \
+   ITEM(CreateShaderModule)         \
+   ITEM(DestroyShaderModule)        \
+   ITEM(CreatePipelineLayout)       \
+   ITEM(DestroyPipelineLayout)      \
+   ITEM(CreateGraphicsPipelines)    \
+   ITEM(DestroyPipeline)
+
+#define ITEM(n) static PFN_vk##n n;
+FUNCTION_LIST
+#undef ITEM
+
+/* OpCapability Shader
+ * OpMemoryModel Logical GLSL450
+ * OpEntryPoint Vertex %main "main" %pos
+ * OpDecorate %pos BuiltIn Position
+ * %pos = OpVariable %_ptr_Output_v4float Output
+ * ...
+ * OpStore %pos (0, 0, 0, 1)
+ */
+static const uint32_t vs_spirv[] = {
+   0x07230203, 0x00010000, 0x00000000, 0x0000000c, 0x00000000, 0x00020011,
+   0x00000001, 0x0003000e, 0x00000000, 0x00000001, 0x0006000f, 0x00000000,
+   0x00000001, 0x6e69616d, 0x00000000, 0x00000007, 0x00040047, 0x00000007,
+   0x0000000b, 0x00000000, 0x00020013, 0x00000002, 0x00030021, 0x00000003,
+   0x00000002, 0x00030016, 0x00000004, 0x00000020, 0x00040017, 0x00000005,
+   0x00000004, 0x00000004, 0x00040020, 0x00000006, 0x00000003, 0x00000005,
+   0x0004003b, 0x00000006, 0x00000007, 0x00000003, 0x0004002b, 0x00000004,
+   0x00000008, 0x00000000, 0x0004002b, 0x00000004, 0x00000009, 0x3f800000,
+   0x0007002c, 0x00000005, 0x0000000a, 0x00000008, 0x00000008, 0x00000008,
+   0x00000009, 0x00050036, 0x00000002, 0x00000001, 0x00000000, 0x00000003,
+   0x000200f8, 0x0000000b, 0x0003003e, 0x00000007, 0x0000000a, 0x000100fd,
+   0x00010038,
+};
+
+/* OpCapability Shader
+ * OpMemoryModel Logical GLSL450
+ * OpEntryPoint Fragment %main "main" %color
+ * OpExecutionMode %main OriginUpperLeft
+ * OpDecorate %color Location 0
+ * OpDecorate %k SpecId 0
+ * %k = OpSpecConstant %float 1
+ * ...
+ * %a = OpFMul %float %k %half
+ * %b = OpFMul %float %a %half
+ * OpStore %color (%k, %a, %b, 1)
+ */
+static const uint32_t fs_spirv[] = {
+   0x07230203, 0x00010000, 0x00000000, 0x0000000f, 0x00000000, 0x00020011,
+   0x00000001, 0x0003000e, 0x00000000, 0x00000001, 0x0006000f, 0x00000004,
+   0x00000001, 0x6e69616d, 0x00000000, 0x00000007, 0x00030010, 0x00000001,
+   0x00000007, 0x00040047, 0x00000007, 0x0000001e, 0x00000000, 0x00040047,
+   0x00000008, 0x00000001, 0x00000000, 0x00020013, 0x00000002, 0x00030021,
+   0x00000003, 0x00000002, 0x00030016, 0x00000004, 0x00000020, 0x00040017,
+   0x00000005, 0x00000004, 0x00000004, 0x00040020, 0x00000006, 0x00000003,
+   0x00000005, 0x0004003b, 0x00000006, 0x00000007, 0x00000003, 0x00040032,
+   0x00000004, 0x00000008, 0x3f800000, 0x0004002b, 0x00000004, 0x00000009,
+   0x3f000000, 0x0004002b, 0x00000004, 0x0000000a, 0x3f800000, 0x00050036,
+   0x00000002, 0x00000001, 0x00000000, 0x00000003, 0x000200f8, 0x0000000b,
+   0x00050085, 0x00000004, 0x0000000c, 0x00000008, 0x00000009, 0x00050085,
+   0x00000004, 0x0000000d, 0x0000000c, 0x00000009, 0x00070050, 0x00000005,
+   0x0000000e, 0x00000008, 0x0000000c, 0x0000000d, 0x0000000a, 0x0003003e,
+   0x00000007, 0x0000000e, 0x000100fd, 0x00010038,
+};
+
+static VkShaderModule
+create_shader_module(VkDevice device, const uint32_t *code, size_t size)
+{
+   const VkShaderModuleCreateInfo info = {
+      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      .codeSize = size,
+      .pCode = code,
+   };
+   VkShaderModule module = VK_NULL_HANDLE;
+
+   if (CreateShaderModule(device, &info, NULL, &module) != VK_SUCCESS)
+      return VK_NULL_HANDLE;
+
+   return module;
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned num_pipelines = argc > 1 ? atoi(argv[1]) : 4096;
+   const char *compile_threads = getenv("LVP_COMPILE_THREADS");
+   VkInstance instance;
+   VkPhysicalDevice physical_device;
+   VkDevice device;
+   int ret = 0;
+
+   const VkApplicationInfo app_info = {
+      .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+      .pApplicationName = "lvp_pipeline_bench",
+      .apiVersion = VK_API_VERSION_1_3,
+   };
+   const VkInstanceCreateInfo instance_info = {
+      .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+      .pApplicationInfo = &app_info,
+   };
+   PFN_vkCreateInstance CreateInstance =
+      (PFN_vkCreateInstance)vk_icdGetInstanceProcAddr(NULL, "vkCreateInstance");
+   if (CreateInstance(&instance_info, NULL, &instance) != VK_SUCCESS) {
+      fprintf(stderr, "vkCreateInstance failed\n");
+      return 1;
+   }
+
+#define ITEM(n) n = (PFN_vk##n)vk_icdGetInstanceProcAddr(instance, "vk" #n);
+   FUNCTION_LIST
+#undef ITEM
+
+   uint32_t device_count = 1;
+   if (EnumeratePhysicalDevices(instance, &device_count, &physical_device) < 0 ||
+       device_count == 0) {
+      fprintf(stderr, "no physical device\n");
+      DestroyInstance(instance, NULL);
+      return 1;
+   }
+
+   const float priority = 1.0f;
+   const VkDeviceQueueCreateInfo queue_info = {
+      .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+      .queueFamilyIndex = 0,
+      .queueCount = 1,
+      .pQueuePriorities = &priority,
+   };
+   const VkPhysicalDeviceVulkan13Features features13 = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+      .dynamicRendering = VK_TRUE,
+   };
+   const VkDeviceCreateInfo device_info = {
+      .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+      .pNext = &features13,
+      .queueCreateInfoCount = 1,
+      .pQueueCreateInfos = &queue_info,
+   };
+   if (CreateDevice(physical_device, &device_info, NULL, &device) != VK_SUCCESS) {
+      fprintf(stderr, "vkCreateDevice failed\n");
+      DestroyInstance(instance, NULL);
+      return 1;
+   }
+
+   VkShaderModule vs = create_shader_module(device, vs_spirv, sizeof(vs_spirv));
+   VkShaderModule fs = create_shader_module(device, fs_spirv, sizeof(fs_spirv));
+
+   const VkPipelineLayoutCreateInfo layout_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+   };
+   VkPipelineLayout layout = VK_NULL_HANDLE;
+   CreatePipelineLayout(device, &layout_info, NULL, &layout);
+
+   VkPipeline *pipelines = calloc(num_pipelines, sizeof(*pipelines));
+   if (!vs || !fs || !layout || !pipelines) {
+      fprintf(stderr, "failed to create the pipeline objects\n");
+      ret = 1;
+      goto out;
+   }
+
+   const VkSpecializationMapEntry spec_entry = {
+      .constantID = 0,
+      .offset = 0,
+      .size = sizeof(float),
+   };
+   float spec_value;
+   const VkSpecializationInfo spec_info = {
+      .mapEntryCount = 1,
+      .pMapEntries = &spec_entry,
+      .dataSize = sizeof(spec_value),
+      .pData = &spec_value,
+   };
+   const VkPipelineShaderStageCreateInfo stages[] = {
+      {
+         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+         .stage = VK_SHADER_STAGE_VERTEX_BIT,
+         .module = vs,
+         .pName = "main",
+      },
+      {
+         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+         .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+         .module = fs,
+         .pName = "main",
+         .pSpecializationInfo = &spec_info,
+      },
+   };
+   const VkPipelineVertexInputStateCreateInfo vertex_input = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+   };
+   const VkPipelineInputAssemblyStateCreateInfo input_assembly = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+      .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+   };
+   const VkPipelineViewportStateCreateInfo viewport = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+      .viewportCount = 1,
+      .scissorCount = 1,
+   };
+   const VkPipelineRasterizationStateCreateInfo rasterization = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+      .polygonMode = VK_POLYGON_MODE_FILL,
+      .cullMode = VK_CULL_MODE_NONE,
+      .lineWidth = 1.0f,
+   };
+   const VkPipelineMultisampleStateCreateInfo multisample = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+      .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+   };
+   const VkPipelineColorBlendAttachmentState blend_attachment = {
+      .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+   };
+   const VkPipelineColorBlendStateCreateInfo color_blend = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+      .attachmentCount = 1,
+      .pAttachments = &blend_attachment,
+   };
+   const VkDynamicState dynamic_states[] = {
+      VK_DYNAMIC_STATE_VIEWPORT,
+      VK_DYNAMIC_STATE_SCISSOR,
+   };
+   const VkPipelineDynamicStateCreateInfo dynamic = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+      .dynamicStateCount = ARRAY_SIZE(dynamic_states),
+      .pDynamicStates = dynamic_states,
+   };
+   const VkFormat color_format = VK_FORMAT_R8G8B8A8_UNORM;
+   const VkPipelineRenderingCreateInfo rendering = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+      .colorAttachmentCount = 1,
+      .pColorAttachmentFormats = &color_format,
+   };
+   const VkGraphicsPipelineCreateInfo pipeline_info = {
+      .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+      .pNext = &rendering,
+      .stageCount = ARRAY_SIZE(stages),
+      .pStages = stages,
+      .pVertexInputState = &vertex_input,
+      .pInputAssemblyState = &input_assembly,
+      .pViewportState = &viewport,
+      .pRasterizationState = &rasterization,
+      .pMultisampleState = &multisample,
+      .pColorBlendState = &color_blend,
+      .pDynamicState = &dynamic,
+      .layout = layout,
+   };
+
+   int64_t start = os_time_get_nano();
+   for (unsigned i = 0; i < num_pipelines; i++) {
+      spec_value = (float)i;
+      if (CreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info,
+                                  NULL, &pipelines[i]) != VK_SUCCESS) {
+         fprintf(stderr, "vkCreateGraphicsPipelines failed\n");
+         ret = 1;
+         break;
+      }
+   }
+   int64_t elapsed = MAX2(os_time_get_nano() - start, 1);
+
+   if (!ret) {
+      printf("%u pipelines on %s compile threads: %8.1f pipelines/s\n",
+             num_pipelines, compile_threads ? compile_threads : "default",
+             (double)num_pipelines * 1e9 / elapsed);
+   }
+
+   for (unsigned i = 0; i < num_pipelines; i++)
+      DestroyPipeline(device, pipelines[i], NULL);
+
+out:
+   free(pipelines);
+   DestroyPipelineLayout(device, layout, NULL);
+   DestroyShaderModule(device, fs, NULL);
+   DestroyShaderModule(device, vs, NULL);
+   DestroyDevice(device, NULL);
+   DestroyInstance(instance, NULL);
+
+   return ret;
+}
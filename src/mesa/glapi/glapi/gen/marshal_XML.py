@@ -24,6 +24,7 @@
 # building thread marshalling code.
 
 import gl_XML
+import re
 import sys
 import copy
 import typeexpr
@@ -232,6 +233,30 @@ class marshal_function(gl_XML.gl_function):
         # Sort the parameters by size to move the truncated type into the hole.
         self.packed_fixed_params = sorted(self.packed_fixed_params, key=lambda p: self.get_type_size(p))
 
+        # Determine whether consecutive calls can be coalesced, which is when
+        # the next call completely overwrites what the previous call set, and
+        # whether the previous call generates a GL error doesn't depend on
+        # the values. Apps often set the same uniform or vertex attrib
+        # several times before drawing.
+        #
+        # glUniform1i is excluded because an invalid texture unit for
+        # samplers is an error. Generic vertex attrib 0 is excluded because
+        # it emits a vertex inside glBegin/End.
+        self.marshal_coalesce_key = []
+        self.marshal_coalesce_condition = None
+
+        if (not self.variable_params and not self.packed_param_name and
+            not self.marshal_sync and not self.marshal_call_before and
+            not self.marshal_call_after and self.marshal_flavor() == 'async'):
+            if re.match(r'^(Program)?Uniform([1-4](f|d|ui|i64ARB|ui64ARB)|[2-4]i)$',
+                        self.name):
+                self.marshal_coalesce_key = [p.name for p in self.fixed_params
+                                             if p.name in ('program', 'location')]
+            elif re.match(r'^VertexAttrib[IL]?[1-4]N?(b|s|i|f|d|ub|us|ui|h)v?(ARB|NV|EXT)?$',
+                          self.name):
+                self.marshal_coalesce_key = ['index']
+                self.marshal_coalesce_condition = 'index != 0'
+
 
     def get_fixed_params(self, is_packed):
         return self.packed_fixed_params if is_packed else self.fixed_params
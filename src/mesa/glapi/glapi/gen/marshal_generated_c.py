@@ -210,8 +210,29 @@ class PrintCode(gl_XML.gl_print_base):
             elif assert_size:
                 out('assert(cmd_size >= 0 && cmd_size <= MARSHAL_MAX_CMD_SIZE);')
 
-        # Add the call into the batch.
         dispatch_cmd = 'DISPATCH_CMD_{0}{1}'.format(func.name, '_packed' if is_packed else '')
+
+        # Overwrite the previous call if it's the same call with the same key.
+        if func.marshal_coalesce_key:
+            out('struct glthread_state *glthread = &ctx->GLThread;')
+            out('{0} *last = ({0} *)glthread->LastCoalescable;'.format(struct))
+            list = ['last']
+            if func.marshal_coalesce_condition:
+                list.append(func.marshal_coalesce_condition)
+            list.append('_mesa_glthread_call_is_last(glthread, &last->cmd_base, align(cmd_size, 8) / 8)')
+            list.append('last->cmd_base.cmd_id == {0}'.format(dispatch_cmd))
+            for name in func.marshal_coalesce_key:
+                list.append('last->{0} == {0}'.format(name))
+
+            out('if ({0}) {{'.format((' &&\n' + ' ' * (current_indent + 4)).join(list)))
+            with indent():
+                self.print_marshal_fields(func, is_packed, 'last',
+                                          skip=func.marshal_coalesce_key)
+                out('glthread->num_coalesced++;')
+                out('return;')
+            out('}')
+
+        # Add the call into the batch.
         if func.get_fixed_params(is_packed) or func.variable_params:
             out('{0} *cmd = _mesa_glthread_allocate_command(ctx, {1}, cmd_size);'
                 .format(struct, dispatch_cmd))
@@ -221,24 +242,10 @@ class PrintCode(gl_XML.gl_print_base):
         if func.variable_params:
             out('cmd->num_slots = align(cmd_size, 8) / 8;')
 
-        for p in func.get_fixed_params(is_packed):
-            type = func.get_marshal_type(p)
+        self.print_marshal_fields(func, is_packed, 'cmd')
 
-            if p.count:
-                out('memcpy(cmd->{0}, {0}, {1});'.format(
-                        p.name, p.size_string()))
-            elif is_packed and p.name == func.packed_param_name:
-                out('cmd->{0} = (uintptr_t){0}; /* truncated */'.format(p.name))
-            elif type == 'GLenum8':
-                out('cmd->{0} = MIN2({0}, 0xff); /* clamped to 0xff (invalid enum) */'.format(p.name))
-            elif type == 'GLenum16':
-                out('cmd->{0} = MIN2({0}, 0xffff); /* clamped to 0xffff (invalid enum) */'.format(p.name))
-            elif type == 'GLclamped16i':
-                out('cmd->{0} = CLAMP({0}, INT16_MIN, INT16_MAX);'.format(p.name))
-            elif type == 'GLpacked16i':
-                out('cmd->{0} = {0} < 0 ? UINT16_MAX : MIN2({0}, UINT16_MAX);'.format(p.name))
-            else:
-                out('cmd->{0} = {0};'.format(p.name))
+        if func.marshal_coalesce_key:
+            out('glthread->LastCoalescable = &cmd->cmd_base;')
 
         if func.variable_params:
             out('char *variable_data = (char *) (cmd + 1);')
@@ -258,6 +265,29 @@ class PrintCode(gl_XML.gl_print_base):
                         out('variable_data += {0}_size;'.format(p.name))
                 i += 1
 
+    def print_marshal_fields(self, func, is_packed, cmd, skip=()):
+        for p in func.get_fixed_params(is_packed):
+            if p.name in skip:
+                continue
+
+            type = func.get_marshal_type(p)
+
+            if p.count:
+                out('memcpy({0}->{1}, {1}, {2});'.format(
+                        cmd, p.name, p.size_string()))
+            elif is_packed and p.name == func.packed_param_name:
+                out('{0}->{1} = (uintptr_t){1}; /* truncated */'.format(cmd, p.name))
+            elif type == 'GLenum8':
+                out('{0}->{1} = MIN2({1}, 0xff); /* clamped to 0xff (invalid enum) */'.format(cmd, p.name))
+            elif type == 'GLenum16':
+                out('{0}->{1} = MIN2({1}, 0xffff); /* clamped to 0xffff (invalid enum) */'.format(cmd, p.name))
+            elif type == 'GLclamped16i':
+                out('{0}->{1} = CLAMP({1}, INT16_MIN, INT16_MAX);'.format(cmd, p.name))
+            elif type == 'GLpacked16i':
+                out('{0}->{1} = {1} < 0 ? UINT16_MAX : MIN2({1}, UINT16_MAX);'.format(cmd, p.name))
+            else:
+                out('{0}->{1} = {1};'.format(cmd, p.name))
+
     def print_async_body(self, func):
         out('/* {0}: marshalled asynchronously */'.format(func.name))
         func.print_struct()
@@ -0,0 +1,78 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "main/sse_minmax.h"
+#include "util/macros.h"
+#include <immintrin.h>
+
+/* Restart indices are replaced by ~0 for the minimum and by 0 for the
+ * maximum, so that they never change the result.
+ */
+#define DEFINE_ARRAY_MIN_MAX_AVX2(name, type, bits)                           \
+void                                                                          \
+name(const type *indices, unsigned *min_index, unsigned *max_index,           \
+     unsigned count, bool restart, unsigned restart_index)                    \
+{                                                                             \
+   const type all_ones = (type)~0u;                                           \
+   type min_val = all_ones;                                                   \
+   type max_val = 0;                                                          \
+   unsigned i = 0;                                                            \
+                                                                              \
+   /* A restart index that doesn't fit in the index type never matches. */   \
+   restart = restart && restart_index <= all_ones;                            \
+                                                                              \
+   if (count >= 2 * (32 / sizeof(type))) {                                    \
+      const unsigned lanes = 32 / sizeof(type);                               \
+      const __m256i restart_vec = _mm256_set1_epi##bits((type)restart_index); \
+      __m256i min_vec = _mm256_set1_epi32(-1);                                \
+      __m256i max_vec = _mm256_setzero_si256();                               \
+      alignas(32) type min_arr[32 / sizeof(type)];                            \
+      alignas(32) type max_arr[32 / sizeof(type)];                            \
+                                                                              \
+      if (restart) {                                                          \
+         for (; i + lanes <= count; i += lanes) {                             \
+            __m256i v = _mm256_loadu_si256((const __m256i *)(indices + i));   \
+            __m256i is_restart = _mm256_cmpeq_epi##bits(v, restart_vec);      \
+            min_vec = _mm256_min_epu##bits(min_vec,                           \
+                                           _mm256_or_si256(v, is_restart));   \
+            max_vec = _mm256_max_epu##bits(max_vec,                           \
+                                           _mm256_andnot_si256(is_restart, v)); \
+         }                                                                    \
+      } else {                                                                \
+         for (; i + lanes <= count; i += lanes) {                             \
+            __m256i v = _mm256_loadu_si256((const __m256i *)(indices + i));   \
+            min_vec = _mm256_min_epu##bits(min_vec, v);                       \
+            max_vec = _mm256_max_epu##bits(max_vec, v);                       \
+         }                                                                    \
+      }                                                                       \
+                                                                              \
+      _mm256_store_si256((__m256i *)min_arr, min_vec);                        \
+      _mm256_store_si256((__m256i *)max_arr, max_vec);                        \
+      for (unsigned j = 0; j < lanes; j++) {                                  \
+         min_val = MIN2(min_val, min_arr[j]);                                 \
+         max_val = MAX2(max_val, max_arr[j]);                                 \
+      }                                                                       \
+   }                                                                          \
+                                                                              \
+   for (; i < count; i++) {                                                   \
+      if (restart && indices[i] == restart_index)                             \
+         continue;                                                            \
+      min_val = MIN2(min_val, indices[i]);                                    \
+      max_val = MAX2(max_val, indices[i]);                                    \
+   }                                                                          \
+                                                                              \
+   /* Only possible if every index was a restart index. */                    \
+   if (min_val == all_ones && max_val == 0) {                                 \
+      *min_index = ~0u;                                                       \
+      *max_index = 0;                                                         \
+   } else {                                                                   \
+      *min_index = min_val;                                                   \
+      *max_index = max_val;                                                   \
+   }                                                                          \
+}
+
+DEFINE_ARRAY_MIN_MAX_AVX2(_mesa_uint_array_min_max_avx2, uint32_t, 32)
+DEFINE_ARRAY_MIN_MAX_AVX2(_mesa_ushort_array_min_max_avx2, uint16_t, 16)
+DEFINE_ARRAY_MIN_MAX_AVX2(_mesa_ubyte_array_min_max_avx2, uint8_t, 8)
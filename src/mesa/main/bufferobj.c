@@ -69,6 +69,31 @@
 #define BUFFER_WARNING_CALL_COUNT 4
 
 
+/**
+ * Tell the VBO min/max index caches that [offset, offset + size) of the
+ * buffer has been modified.
+ */
+static void
+minmax_cache_invalidate(struct gl_buffer_object *bufObj,
+                        GLintptr offset, GLsizeiptr size)
+{
+   /* Draws in other contexts read and reset the range under the lock. */
+   simple_mtx_lock(&bufObj->MinMaxCacheMutex);
+
+   bufObj->MinMaxCacheDirty = true;
+
+   if (bufObj->MinMaxDirtyStart >= bufObj->MinMaxDirtyEnd) {
+      bufObj->MinMaxDirtyStart = offset;
+      bufObj->MinMaxDirtyEnd = offset + size;
+   } else {
+      bufObj->MinMaxDirtyStart = MIN2(bufObj->MinMaxDirtyStart, offset);
+      bufObj->MinMaxDirtyEnd = MAX2(bufObj->MinMaxDirtyEnd, offset + size);
+   }
+
+   simple_mtx_unlock(&bufObj->MinMaxCacheMutex);
+}
+
+
 /**
  * Replace data in a subrange of buffer object.  If the data range
  * specified by size + offset extends beyond the end of the buffer or
@@ -580,7 +605,7 @@ bufferobj_copy_subdata(struct gl_context *ctx,
    struct pipe_context *pipe = ctx->pipe;
    struct pipe_box box;
 
-   dst->MinMaxCacheDirty = true;
+   minmax_cache_invalidate(dst, writeOffset, size);
    if (!size)
       return;
 
@@ -2135,7 +2160,7 @@ buffer_storage(struct gl_context *ctx, struct gl_buffer_object *bufObj,
    FLUSH_VERTICES(ctx, 0, 0);
 
    bufObj->Immutable = GL_TRUE;
-   bufObj->MinMaxCacheDirty = true;
+   minmax_cache_invalidate(bufObj, 0, size);
 
    if (memObj) {
       res = bufferobj_data_mem(ctx, target, size, memObj, offset,
@@ -2372,7 +2397,7 @@ buffer_data(struct gl_context *ctx, struct gl_buffer_object *bufObj,
 
    FLUSH_VERTICES(ctx, 0, 0);
 
-   bufObj->MinMaxCacheDirty = true;
+   minmax_cache_invalidate(bufObj, 0, size);
 
 #ifdef VBO_DEBUG
    printf("glBufferDataARB(%u, sz %ld, from %p, usage 0x%x)\n",
@@ -2559,7 +2584,7 @@ _mesa_buffer_sub_data(struct gl_context *ctx, struct gl_buffer_object *bufObj,
       return;
 
    bufObj->NumSubDataCalls++;
-   bufObj->MinMaxCacheDirty = true;
+   minmax_cache_invalidate(bufObj, offset, size);
 
    _mesa_bufferobj_subdata(ctx, offset, size, data, bufObj);
 }
@@ -2764,7 +2789,7 @@ clear_buffer_sub_data(struct gl_context *ctx, struct gl_buffer_object *bufObj,
    if (size == 0)
       return;
 
-   bufObj->MinMaxCacheDirty = true;
+   minmax_cache_invalidate(bufObj, offset, size);
 
    if (!ctx->pipe->clear_buffer) {
       clear_buffer_subdata_sw(ctx, offset, size,
@@ -3688,7 +3713,7 @@ map_buffer_range(struct gl_context *ctx, struct gl_buffer_object *bufObj,
    }
 
    if (access & GL_MAP_WRITE_BIT) {
-      bufObj->MinMaxCacheDirty = true;
+      minmax_cache_invalidate(bufObj, offset, length);
    }
 
 #ifdef VBO_DEBUG
@@ -37,13 +37,18 @@
 #include "main/glthread_marshal.h"
 #include "main/hash.h"
 #include "main/pixelstore.h"
+#include "util/hash_table.h"
+#include "util/log.h"
 #include "util/u_atomic.h"
+#include "util/u_debug.h"
 #include "util/u_thread.h"
 #include "util/u_cpu_detect.h"
 #include "util/thread_sched.h"
 
 #include "state_tracker/st_context.h"
 
+DEBUG_GET_ONCE_BOOL_OPTION(glthread_show_syncs, "MESA_GLTHREAD_SHOW_SYNCS", false)
+
 static void
 glthread_update_global_locking(struct gl_context *ctx)
 {
@@ -243,8 +248,15 @@ _mesa_glthread_init(struct gl_context *ctx)
    }
    glthread->next_batch = &glthread->batches[glthread->next];
    glthread->used = 0;
+   glthread->batch_slots = MARSHAL_MAX_CMD_SIZE / 8;
    glthread->stats.queue = &glthread->queue;
 
+   if (debug_get_option_glthread_show_syncs()) {
+      glthread->sync_counts =
+         _mesa_hash_table_create(NULL, _mesa_hash_string,
+                                 _mesa_key_string_equal);
+   }
+
    _mesa_glthread_init_call_fence(&glthread->LastProgramChangeBatch);
    _mesa_glthread_init_call_fence(&glthread->LastDListChangeBatchIndex);
 
@@ -270,6 +282,48 @@ free_vao(void *data, UNUSED void *userData)
    free(data);
 }
 
+static int
+compare_sync_counts(const void *a, const void *b)
+{
+   const struct hash_entry *ea = *(const struct hash_entry **)a;
+   const struct hash_entry *eb = *(const struct hash_entry **)b;
+   uintptr_t ca = (uintptr_t)ea->data, cb = (uintptr_t)eb->data;
+
+   return ca < cb ? 1 : ca > cb ? -1 : strcmp(ea->key, eb->key);
+}
+
+static void
+glthread_print_stats(struct glthread_state *glthread)
+{
+   const struct util_queue_monitoring *stats = &glthread->stats;
+   unsigned num_entries = glthread->sync_counts->entries;
+
+   mesa_logi("glthread: batches = %u, average batch = %u bytes, "
+             "coalesced calls = %u, syncs = %u\n",
+             stats->num_batches,
+             stats->num_batches ?
+                (unsigned)((uint64_t)stats->num_offloaded_items * 8 /
+                           stats->num_batches) : 0,
+             glthread->num_coalesced, stats->num_syncs);
+
+   /* Sort by the number of syncs, most frequent first. */
+   const struct hash_entry **entries = malloc(num_entries * sizeof(*entries));
+   if (!entries)
+      return;
+
+   unsigned i = 0;
+   hash_table_foreach(glthread->sync_counts, entry)
+      entries[i++] = entry;
+   qsort(entries, num_entries, sizeof(*entries), compare_sync_counts);
+
+   for (i = 0; i < num_entries; i++) {
+      mesa_logi("glthread:    %8u syncs in %s\n",
+                (unsigned)(uintptr_t)entries[i]->data,
+                (const char *)entries[i]->key);
+   }
+   free(entries);
+}
+
 void
 _mesa_glthread_destroy(struct gl_context *ctx)
 {
@@ -280,6 +334,12 @@ _mesa_glthread_destroy(struct gl_context *ctx)
    if (util_queue_is_initialized(&glthread->queue)) {
       util_queue_destroy(&glthread->queue);
 
+      if (unlikely(glthread->sync_counts)) {
+         glthread_print_stats(glthread);
+         _mesa_hash_table_destroy(glthread->sync_counts, NULL);
+         glthread->sync_counts = NULL;
+      }
+
       for (unsigned i = 0; i < MARSHAL_MAX_BATCHES; i++)
          util_queue_fence_destroy(&glthread->batches[i].fence);
 
@@ -351,6 +411,31 @@ glthread_finalize_batch(struct glthread_state *glthread,
    glthread->LastCallList = NULL;
    glthread->LastBindBuffer1 = NULL;
    glthread->LastBindBuffer2 = NULL;
+   glthread->LastCoalescable = NULL;
+}
+
+/**
+ * Choose the size of the next batch based on whether the worker thread
+ * has finished the previous one.
+ *
+ * If it's still executing it, we are ahead and bigger batches don't delay
+ * anything, while they reduce the number of queue operations, which need
+ * locking and wake-ups on both threads. If it's idle, it's waiting for us,
+ * so submit smaller batches to give it work sooner. This uses the fence
+ * state instead of timing batches because reading the time is too
+ * expensive to do for every batch.
+ */
+static void
+glthread_update_batch_size(struct glthread_state *glthread)
+{
+   unsigned size = glthread->batch_slots + 1;
+
+   if (!util_queue_fence_is_signalled(&glthread->batches[glthread->last].fence))
+      size = MIN2(size * 2, MARSHAL_MAX_CMD_BUFFER_SIZE / 8);
+   else
+      size = MAX2(size / 2, MARSHAL_MIN_BATCH_SIZE / 8);
+
+   glthread->batch_slots = size - 1;
 }
 
 void
@@ -370,6 +455,7 @@ _mesa_glthread_flush_batch(struct gl_context *ctx)
 
    glthread_apply_thread_sched_policy(ctx, false);
    glthread_finalize_batch(glthread, &glthread->stats.num_offloaded_items);
+   glthread_update_batch_size(glthread);
 
    struct glthread_batch *next = glthread->next_batch;
 
@@ -426,17 +512,41 @@ _mesa_glthread_finish(struct gl_context *ctx)
        * it would be a sync if we did. So count it anyway.
        */
       synced = true;
+
+      /* The partial batch was executed by this thread, so start over with
+       * small batches, which keep that work short if the app syncs often.
+       */
+      glthread->batch_slots = MARSHAL_MAX_CMD_SIZE / 8;
    }
 
    if (synced)
       p_atomic_inc(&glthread->stats.num_syncs);
 }
 
+static void
+glthread_count_sync(struct glthread_state *glthread, const char *func)
+{
+   struct hash_entry *entry =
+      _mesa_hash_table_search(glthread->sync_counts, func);
+
+   if (entry)
+      entry->data = (void *)((uintptr_t)entry->data + 1);
+   else
+      _mesa_hash_table_insert(glthread->sync_counts, func, (void *)1);
+}
+
 void
 _mesa_glthread_finish_before(struct gl_context *ctx, const char *func)
 {
+   struct glthread_state *glthread = &ctx->GLThread;
+   unsigned num_syncs = glthread->stats.num_syncs;
+
    _mesa_glthread_finish(ctx);
 
+   if (unlikely(glthread->sync_counts) &&
+       glthread->stats.num_syncs != num_syncs)
+      glthread_count_sync(glthread, func);
+
    /* Uncomment this if you want to know where glthread syncs. */
    /*printf("fallback to sync: %s\n", func);*/
 }
@@ -24,7 +24,7 @@
 #ifndef _GLTHREAD_H
 #define _GLTHREAD_H
 
-/* The size of one batch and the maximum size of one call.
+/* The minimum size of one batch and the maximum size of one call.
  *
  * This should be as low as possible, so that:
  * - multiple synchronizations within a frame don't slow us down much
@@ -33,12 +33,20 @@
  *   chance of experiencing CPU cache thrashing
  * but it should be high enough so that u_queue overhead remains negligible.
  */
-#define MARSHAL_MAX_CMD_BUFFER_SIZE (8 * 1024)
+#define MARSHAL_MIN_BATCH_SIZE (8 * 1024)
+
+/* The maximum size of one batch, which is also the size of the buffer of
+ * each batch. Batches grow towards this while the worker thread is behind,
+ * because then bigger batches don't delay anything and submitting them costs
+ * less, and shrink back while the worker thread is idle. See
+ * glthread_update_batch_size.
+ */
+#define MARSHAL_MAX_CMD_BUFFER_SIZE (32 * 1024)
 
 /* We need to leave 1 slot at the end to insert the END marker for unmarshal
  * calls that look ahead to know where the batch ends.
  */
-#define MARSHAL_MAX_CMD_SIZE (MARSHAL_MAX_CMD_BUFFER_SIZE - 8)
+#define MARSHAL_MAX_CMD_SIZE (MARSHAL_MIN_BATCH_SIZE - 8)
 
 /* The number of batch slots in memory.
  *
@@ -66,6 +74,7 @@ extern "C" {
 struct gl_context;
 struct gl_buffer_object;
 struct _glapi_table;
+struct hash_table;
 
 /**
  * Client pixel packing/unpacking attributes
@@ -232,6 +241,13 @@ struct glthread_state
    /** Number of uint64_t elements filled already. */
    unsigned used;
 
+   /**
+    * Number of uint64_t elements after which the batch is submitted. This is
+    * between MARSHAL_MAX_CMD_SIZE / 8 and MARSHAL_MAX_CMD_BUFFER_SIZE / 8 - 1,
+    * which leaves room for the END marker.
+    */
+   unsigned batch_slots;
+
    /** Upload buffer. */
    struct gl_buffer_object *upload_buffer;
    uint8_t *upload_ptr;
@@ -298,6 +314,16 @@ struct glthread_state
    struct marshal_cmd_BindBuffer *LastBindBuffer1;
    struct marshal_cmd_BindBuffer *LastBindBuffer2;
 
+   /**
+    * The last added uniform or vertex attrib update, which the next update
+    * of the same location overwrites if nothing was added in between.
+    */
+   struct marshal_cmd_base *LastCoalescable;
+
+   /** Statistics for MESA_GLTHREAD_SHOW_SYNCS. */
+   unsigned num_coalesced;
+   struct hash_table *sync_counts; /**< function name -> number of syncs */
+
    /** Global mutex update info. */
    unsigned GlobalLockUpdateBatchCounter;
    bool LockGlobalMutexes;
@@ -37,6 +37,7 @@
 
 #include "macros.h"
 #include "mtypes.h"
+#include "util/u_queue.h"
 
 
 
@@ -892,3 +893,79 @@ _mesa_swap_bytes_2d_image(GLenum format, GLenum type,
       }
    }
 }
+
+
+/*
+ * Images smaller than this are processed on the calling thread. Bigger
+ * ones are split in bands of rows of at least this size.
+ */
+#define IMAGE_BAND_MIN_BYTES (256 * 1024)
+#define IMAGE_MAX_BANDS      16
+
+struct image_band_job {
+   mesa_image_rows_func func;
+   void *data;
+   unsigned first_row;
+   unsigned num_rows;
+   struct util_queue_fence fence;
+};
+
+static void
+image_band_job_execute(void *data, void *gdata, int thread_index)
+{
+   struct image_band_job *job = (struct image_band_job *)data;
+
+   job->func(job->data, job->first_row, job->num_rows);
+}
+
+
+/**
+ * Call func for bands of rows covering [0, height), in parallel on the
+ * queue's threads if the image is big enough. func must only access the
+ * rows it's given. The calling thread processes the first band itself and
+ * returns when all of them are done.
+ *
+ * \param queue  the worker pool, or NULL to always run on this thread
+ * \param bytes_per_row  an estimate of the memory touched by one row
+ */
+void
+_mesa_image_parallel_rows(struct util_queue *queue, unsigned height,
+                          size_t bytes_per_row, mesa_image_rows_func func,
+                          void *data)
+{
+   struct image_band_job jobs[IMAGE_MAX_BANDS];
+   size_t total_bytes = (size_t)height * bytes_per_row;
+   unsigned num_bands = 1;
+
+   if (queue && total_bytes >= 2 * IMAGE_BAND_MIN_BYTES) {
+      num_bands = MIN3(total_bytes / IMAGE_BAND_MIN_BYTES,
+                       queue->max_threads + 1,
+                       IMAGE_MAX_BANDS);
+      num_bands = MIN2(num_bands, height);
+   }
+
+   if (num_bands <= 1) {
+      func(data, 0, height);
+      return;
+   }
+
+   unsigned band_rows = DIV_ROUND_UP(height, num_bands);
+   num_bands = DIV_ROUND_UP(height, band_rows);
+
+   for (unsigned i = 1; i < num_bands; i++) {
+      jobs[i].func = func;
+      jobs[i].data = data;
+      jobs[i].first_row = i * band_rows;
+      jobs[i].num_rows = MIN2(band_rows, height - i * band_rows);
+      util_queue_fence_init(&jobs[i].fence);
+      util_queue_add_job(queue, &jobs[i], &jobs[i].fence,
+                         image_band_job_execute, NULL, 0);
+   }
+
+   func(data, 0, band_rows);
+
+   for (unsigned i = 1; i < num_bands; i++) {
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+}
@@ -29,9 +29,14 @@
 
 #include "util/glheader.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 struct gl_context;
 struct gl_pixelstore_attrib;
 struct gl_framebuffer;
+struct util_queue;
 
 extern void
 _mesa_swap2(GLushort *p, GLuint n);
@@ -134,4 +139,16 @@ _mesa_swap_bytes_2d_image(GLenum format, GLenum type,
                           GLsizei width, GLsizei height,
                           GLvoid *dst, const GLvoid *src);
 
+typedef void (*mesa_image_rows_func)(void *data, unsigned first_row,
+                                     unsigned num_rows);
+
+void
+_mesa_image_parallel_rows(struct util_queue *queue, unsigned height,
+                          size_t bytes_per_row, mesa_image_rows_func func,
+                          void *data);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
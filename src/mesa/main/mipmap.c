@@ -38,6 +38,7 @@
 #include "texstore.h"
 #include "image.h"
 #include "macros.h"
+#include "shared.h"
 #include "util/half_float.h"
 #include "util/format_rgb9e5.h"
 #include "util/format_r11g11b10f.h"
@@ -317,8 +318,37 @@ make_1d_mipmap(enum pipe_format format, GLint border,
 }
 
 
+struct mipmap_2d_rows {
+   enum pipe_format format;
+   GLint srcWidth;
+   const GLubyte *srcA, *srcB;
+   size_t srcStep;
+   GLint dstWidth;
+   GLubyte *dst;
+   size_t dstRowStride;
+};
+
+static void
+make_2d_mipmap_rows(void *data, unsigned first_row, unsigned num_rows)
+{
+   const struct mipmap_2d_rows *rows = data;
+   const GLubyte *srcA = rows->srcA + first_row * rows->srcStep;
+   const GLubyte *srcB = rows->srcB + first_row * rows->srcStep;
+   GLubyte *dst = rows->dst + first_row * rows->dstRowStride;
+
+   for (unsigned row = 0; row < num_rows; row++) {
+      do_row(rows->format, rows->srcWidth, srcA, srcB,
+             rows->dstWidth, dst);
+      srcA += rows->srcStep;
+      srcB += rows->srcStep;
+      dst += rows->dstRowStride;
+   }
+}
+
+
 static void
-make_2d_mipmap(enum pipe_format format, GLint border,
+make_2d_mipmap(struct util_queue *queue,
+               enum pipe_format format, GLint border,
                GLint srcWidth, GLint srcHeight,
                const GLubyte *srcPtr, GLint srcRowStride,
                GLint dstWidth, GLint dstHeight,
@@ -347,13 +377,19 @@ make_2d_mipmap(enum pipe_format format, GLint border,
 
    dst = dstPtr + border * ((dstWidth + 1) * bpt);
 
-   for (row = 0; row < dstHeightNB; row++) {
-      do_row(format, srcWidthNB, srcA, srcB,
-             dstWidthNB, dst);
-      srcA += srcRowStep * srcRowStride;
-      srcB += srcRowStep * srcRowStride;
-      dst += dstRowStride;
-   }
+   struct mipmap_2d_rows rows = {
+      .format = format,
+      .srcWidth = srcWidthNB,
+      .srcA = srcA,
+      .srcB = srcB,
+      .srcStep = (size_t)srcRowStep * srcRowStride,
+      .dstWidth = dstWidthNB,
+      .dst = dst,
+      .dstRowStride = dstRowStride,
+   };
+   _mesa_image_parallel_rows(queue, dstHeightNB,
+                             (size_t)srcRowStep * srcWidthNB * bpt,
+                             make_2d_mipmap_rows, &rows);
 
    /* This is ugly but probably won't be used much */
    if (border > 0) {
@@ -409,8 +445,71 @@ make_2d_mipmap(enum pipe_format format, GLint border,
 }
 
 
+struct mipmap_3d_images {
+   enum pipe_format format;
+   GLint border;
+   GLint bpt;
+   GLint srcWidth;
+   const GLubyte **srcPtr;
+   GLint srcRowStride;
+   GLint srcImageOffset;
+   GLint srcRowOffset;
+   GLint dstWidth, dstHeight;
+   GLubyte **dstPtr;
+   GLint dstRowStride;
+};
+
+static void
+make_3d_mipmap_images(void *data, unsigned first_img, unsigned num_imgs)
+{
+   const struct mipmap_3d_images *imgs = data;
+   const GLint border = imgs->border;
+   const GLint bpt = imgs->bpt;
+   const GLint srcRowStride = imgs->srcRowStride;
+   const GLint srcRowOffset = imgs->srcRowOffset;
+   const GLint dstRowStride = imgs->dstRowStride;
+   GLint row;
+
+   for (unsigned img = first_img; img < first_img + num_imgs; img++) {
+      /* first source image pointer, skipping border */
+      const GLubyte *imgSrcA = imgs->srcPtr[img * 2 + border]
+         + srcRowStride * border + bpt * border;
+      /* second source image pointer, skipping border */
+      const GLubyte *imgSrcB =
+         imgs->srcPtr[img * 2 + imgs->srcImageOffset + border]
+         + srcRowStride * border + bpt * border;
+
+      /* address of the dest image, skipping border */
+      GLubyte *imgDst = imgs->dstPtr[img + border]
+         + dstRowStride * border + bpt * border;
+
+      /* setup the four source row pointers and the dest row pointer */
+      const GLubyte *srcImgARowA = imgSrcA;
+      const GLubyte *srcImgARowB = imgSrcA + srcRowOffset;
+      const GLubyte *srcImgBRowA = imgSrcB;
+      const GLubyte *srcImgBRowB = imgSrcB + srcRowOffset;
+      GLubyte *dstImgRow = imgDst;
+
+      for (row = 0; row < imgs->dstHeight; row++) {
+         do_row_3D(imgs->format, imgs->srcWidth,
+                   srcImgARowA, srcImgARowB,
+                   srcImgBRowA, srcImgBRowB,
+                   imgs->dstWidth, dstImgRow);
+
+         /* advance to next rows */
+         srcImgARowA += srcRowStride + srcRowOffset;
+         srcImgARowB += srcRowStride + srcRowOffset;
+         srcImgBRowA += srcRowStride + srcRowOffset;
+         srcImgBRowB += srcRowStride + srcRowOffset;
+         dstImgRow += dstRowStride;
+      }
+   }
+}
+
+
 static void
-make_3d_mipmap(enum pipe_format format, GLint border,
+make_3d_mipmap(struct util_queue *queue,
+               enum pipe_format format, GLint border,
                GLint srcWidth, GLint srcHeight, GLint srcDepth,
                const GLubyte **srcPtr, GLint srcRowStride,
                GLint dstWidth, GLint dstHeight, GLint dstDepth,
@@ -422,7 +521,7 @@ make_3d_mipmap(enum pipe_format format, GLint border,
    const GLint dstWidthNB = dstWidth - 2 * border;
    const GLint dstHeightNB = dstHeight - 2 * border;
    const GLint dstDepthNB = dstDepth - 2 * border;
-   GLint img, row;
+   GLint img;
    size_t bytesPerSrcImage, bytesPerDstImage;
    GLint srcImageOffset, srcRowOffset;
 
@@ -450,49 +549,34 @@ make_3d_mipmap(enum pipe_format format, GLint border,
           srcWidth, srcHeight, srcDepth, dstWidth, dstHeight, dstDepth);
    */
 
-   for (img = 0; img < dstDepthNB; img++) {
-      /* first source image pointer, skipping border */
-      const GLubyte *imgSrcA = srcPtr[img * 2 + border]
-         + srcRowStride * border + bpt * border;
-      /* second source image pointer, skipping border */
-      const GLubyte *imgSrcB = srcPtr[img * 2 + srcImageOffset + border]
-         + srcRowStride * border + bpt * border;
-
-      /* address of the dest image, skipping border */
-      GLubyte *imgDst = dstPtr[img + border]
-         + dstRowStride * border + bpt * border;
-
-      /* setup the four source row pointers and the dest row pointer */
-      const GLubyte *srcImgARowA = imgSrcA;
-      const GLubyte *srcImgARowB = imgSrcA + srcRowOffset;
-      const GLubyte *srcImgBRowA = imgSrcB;
-      const GLubyte *srcImgBRowB = imgSrcB + srcRowOffset;
-      GLubyte *dstImgRow = imgDst;
-
-      for (row = 0; row < dstHeightNB; row++) {
-         do_row_3D(format, srcWidthNB,
-                   srcImgARowA, srcImgARowB,
-                   srcImgBRowA, srcImgBRowB,
-                   dstWidthNB, dstImgRow);
-
-         /* advance to next rows */
-         srcImgARowA += srcRowStride + srcRowOffset;
-         srcImgARowB += srcRowStride + srcRowOffset;
-         srcImgBRowA += srcRowStride + srcRowOffset;
-         srcImgBRowB += srcRowStride + srcRowOffset;
-         dstImgRow += dstRowStride;
-      }
-   }
+   struct mipmap_3d_images imgs = {
+      .format = format,
+      .border = border,
+      .bpt = bpt,
+      .srcWidth = srcWidthNB,
+      .srcPtr = srcPtr,
+      .srcRowStride = srcRowStride,
+      .srcImageOffset = srcImageOffset,
+      .srcRowOffset = srcRowOffset,
+      .dstWidth = dstWidthNB,
+      .dstHeight = dstHeightNB,
+      .dstPtr = dstPtr,
+      .dstRowStride = dstRowStride,
+   };
+   /* Each dest image reads up to four source rows per row. */
+   _mesa_image_parallel_rows(queue, dstDepthNB,
+                             (size_t)4 * dstHeightNB * srcWidthNB * bpt,
+                             make_3d_mipmap_images, &imgs);
 
 
    /* Luckily we can leverage the make_2d_mipmap() function here! */
    if (border > 0) {
       /* do front border image */
-      make_2d_mipmap(format, 1,
+      make_2d_mipmap(queue, format, 1,
                      srcWidth, srcHeight, srcPtr[0], srcRowStride,
                      dstWidth, dstHeight, dstPtr[0], dstRowStride);
       /* do back border image */
-      make_2d_mipmap(format, 1,
+      make_2d_mipmap(queue, format, 1,
                      srcWidth, srcHeight, srcPtr[srcDepth - 1], srcRowStride,
                      dstWidth, dstHeight, dstPtr[dstDepth - 1], dstRowStride);
 
@@ -571,7 +655,8 @@ make_3d_mipmap(enum pipe_format format, GLint border,
  * \param dstRowStride  stride between destination rows, in bytes
  */
 static void
-_mesa_generate_mipmap_level(GLenum target,
+_mesa_generate_mipmap_level(struct util_queue *queue,
+                            GLenum target,
                             enum pipe_format format,
                             GLint border,
                             GLint srcWidth, GLint srcHeight, GLint srcDepth,
@@ -596,12 +681,12 @@ _mesa_generate_mipmap_level(GLenum target,
    case GL_TEXTURE_CUBE_MAP_NEGATIVE_Y:
    case GL_TEXTURE_CUBE_MAP_POSITIVE_Z:
    case GL_TEXTURE_CUBE_MAP_NEGATIVE_Z:
-      make_2d_mipmap(format, border,
+      make_2d_mipmap(queue, format, border,
                      srcWidth, srcHeight, srcData[0], srcRowStride,
                      dstWidth, dstHeight, dstData[0], dstRowStride);
       break;
    case GL_TEXTURE_3D:
-      make_3d_mipmap(format, border,
+      make_3d_mipmap(queue, format, border,
                      srcWidth, srcHeight, srcDepth,
                      srcData, srcRowStride,
                      dstWidth, dstHeight, dstDepth,
@@ -619,7 +704,7 @@ _mesa_generate_mipmap_level(GLenum target,
    case GL_TEXTURE_2D_ARRAY_EXT:
    case GL_TEXTURE_CUBE_MAP_ARRAY:
       for (i = 0; i < dstDepth; i++) {
-         make_2d_mipmap(format, border,
+         make_2d_mipmap(queue, format, border,
                         srcWidth, srcHeight, srcData[i], srcRowStride,
                         dstWidth, dstHeight, dstData[i], dstRowStride);
       }
@@ -878,7 +963,8 @@ generate_mipmap_uncompressed(struct gl_context *ctx, GLenum target,
 
       if (success) {
          /* generate one mipmap level (for 1D/2D/3D/array/etc texture) */
-         _mesa_generate_mipmap_level(target, srcImage->TexFormat, border,
+         _mesa_generate_mipmap_level(_mesa_get_image_queue(ctx),
+                                     target, srcImage->TexFormat, border,
                                      srcWidth, srcHeight, srcDepth,
                                      (const GLubyte **) srcMaps, srcRowStride,
                                      dstWidth, dstHeight, dstDepth,
@@ -1041,7 +1127,8 @@ generate_mipmap_compressed(struct gl_context *ctx, GLenum target,
       /* Rescale src image to dest image.
        * This will loop over the slices of a 2D array.
        */
-      _mesa_generate_mipmap_level(target, temp_format, border,
+      _mesa_generate_mipmap_level(_mesa_get_image_queue(ctx),
+                                  target, temp_format, border,
                                   srcWidth, srcHeight, srcDepth,
                                   (const GLubyte **) temp_src_slices,
                                   temp_src_row_stride,
@@ -87,6 +87,7 @@ struct gl_program_parameter_list;
 struct gl_shader_spirv_data;
 struct set;
 struct shader_includes;
+struct vbo_minmax_summary;
 /*@}*/
 
 
@@ -1450,6 +1451,9 @@ struct gl_buffer_object
    unsigned MinMaxCacheHitIndices;
    unsigned MinMaxCacheMissIndices;
    struct hash_table *MinMaxCache;
+   struct vbo_minmax_summary *MinMaxSummary;
+   /** Byte range written since the summary was last updated */
+   GLintptr MinMaxDirtyStart, MinMaxDirtyEnd;
    simple_mtx_t MinMaxCacheMutex;
    bool MinMaxCacheDirty:1;
 
@@ -2522,6 +2526,12 @@ struct gl_shared_state
        */
       int64_t NoLockDuration;
    } GLThread;
+
+   /**
+    * Worker pool for texture upload conversion and mipmap generation on
+    * the CPU, created on first use. See _mesa_get_image_queue.
+    */
+   struct util_queue ImageQueue;
 };
 
 
@@ -46,8 +46,11 @@
 
 #include "util/hash_table.h"
 #include "util/set.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_debug.h"
 #include "util/u_memory.h"
 #include "util/u_process.h"
+#include "util/u_queue.h"
 #include "util/u_threaded_context.h"
 #include "state_tracker/st_context.h"
 
@@ -422,6 +425,9 @@ free_shared_state(struct gl_context *ctx, struct gl_shared_state *shared)
    assert(!shared->ReleaseResources.entries);
    _mesa_set_fini(&shared->ReleaseResources, NULL);
 
+   if (util_queue_is_initialized(&shared->ImageQueue))
+      util_queue_destroy(&shared->ImageQueue);
+
    simple_mtx_destroy(&shared->Mutex);
    simple_mtx_destroy(&shared->TexMutex);
 
@@ -429,6 +435,39 @@ free_shared_state(struct gl_context *ctx, struct gl_shared_state *shared)
 }
 
 
+DEBUG_GET_ONCE_NUM_OPTION(mesa_image_threads, "MESA_IMAGE_THREADS", -1)
+
+/**
+ * Return the worker pool used to split big texture conversions and mipmap
+ * generation in bands of rows, or NULL if it's disabled. It's shared by all
+ * the contexts of the share group.
+ */
+struct util_queue *
+_mesa_get_image_queue(struct gl_context *ctx)
+{
+   struct gl_shared_state *shared = ctx->Shared;
+   struct util_queue *queue = NULL;
+
+   /* Uploads block the application, so use all the other cores. */
+   int64_t num_threads = debug_get_option_mesa_image_threads();
+   if (num_threads < 0)
+      num_threads = util_get_cpu_caps()->nr_cpus - 1;
+   num_threads = MIN2(num_threads, 15);
+
+   if (num_threads <= 0)
+      return NULL;
+
+   simple_mtx_lock(&shared->Mutex);
+   if (util_queue_is_initialized(&shared->ImageQueue) ||
+       util_queue_init(&shared->ImageQueue, "glimg", 32, num_threads,
+                       UTIL_QUEUE_INIT_RESIZE_IF_FULL, NULL))
+      queue = &shared->ImageQueue;
+   simple_mtx_unlock(&shared->Mutex);
+
+   return queue;
+}
+
+
 /**
  * gl_shared_state objects are ref counted.
  * If ptr's refcount goes to zero, free the shared state.
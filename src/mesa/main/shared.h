@@ -26,6 +26,7 @@
 #define SHARED_H
 
 struct gl_context;
+struct util_queue;
 
 void
 _mesa_reference_shared_state(struct gl_context *ctx,
@@ -37,6 +38,9 @@ struct gl_shared_state *
 _mesa_alloc_shared_state(struct gl_context *ctx,
                          const struct st_config_options *options);
 
+struct util_queue *
+_mesa_get_image_queue(struct gl_context *ctx);
+
 bool
 _mesa_release_pending_resource(struct gl_context *ctx, struct pipe_resource *resource, bool frontend_released);
 #endif
@@ -0,0 +1,137 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ *
+ * Check that converting texture images in bands of rows on a thread pool
+ * gives the same result as a single conversion, for a few representative
+ * formats.  image_parallel_rows_bench measures the throughput.
+ */
+
+#include <gtest/gtest.h>
+#include <string.h>
+#include <vector>
+
+#include "util/u_queue.h"
+
+#include "main/format_utils.h"
+#include "main/image.h"
+
+namespace {
+
+struct convert_rows {
+   uint8_t *dst;
+   uint32_t dst_format;
+   size_t dst_stride;
+   uint8_t *src;
+   uint32_t src_format;
+   size_t src_stride;
+   unsigned width;
+};
+
+void
+convert_rows_func(void *data, unsigned first_row, unsigned num_rows)
+{
+   const struct convert_rows *c = (const struct convert_rows *)data;
+
+   _mesa_format_convert(c->dst + first_row * c->dst_stride, c->dst_format,
+                        c->dst_stride,
+                        c->src + first_row * c->src_stride, c->src_format,
+                        c->src_stride, c->width, num_rows, NULL);
+}
+
+struct format_pair {
+   const char *name;
+   uint32_t src_format;
+   unsigned src_bpp;
+   uint32_t dst_format;
+   unsigned dst_bpp;
+};
+
+class ImageParallelRowsTest : public ::testing::Test {
+protected:
+   void SetUp() override
+   {
+      ASSERT_TRUE(util_queue_init(&queue, "imgtest", 32, 4,
+                                  UTIL_QUEUE_INIT_RESIZE_IF_FULL, NULL));
+   }
+
+   void TearDown() override
+   {
+      util_queue_destroy(&queue);
+   }
+
+   void convert(struct util_queue *q, const format_pair &f,
+                uint8_t *src, uint8_t *dst)
+   {
+      struct convert_rows c = {
+         dst, f.dst_format, (size_t)width * f.dst_bpp,
+         src, f.src_format, (size_t)width * f.src_bpp,
+         width,
+      };
+
+      _mesa_image_parallel_rows(q, height, (size_t)width * f.dst_bpp,
+                                convert_rows_func, &c);
+   }
+
+   struct util_queue queue;
+   const unsigned width = 2048;
+   const unsigned height = 1024;
+};
+
+} /* anonymous namespace */
+
+TEST_F(ImageParallelRowsTest, ConvertMatchesSerial)
+{
+   const format_pair formats[] = {
+      { "RGBA8 -> BGRA8", MESA_FORMAT_R8G8B8A8_UNORM, 4,
+        MESA_FORMAT_B8G8R8A8_UNORM, 4 },
+      { "RGBA8 -> RGB565", MESA_FORMAT_R8G8B8A8_UNORM, 4,
+        MESA_FORMAT_B5G6R5_UNORM, 2 },
+      { "RGBA32F -> RGBA8", RGBA32_FLOAT, 16,
+        MESA_FORMAT_R8G8B8A8_UNORM, 4 },
+      { "RGBA32F -> RGBA16F", RGBA32_FLOAT, 16,
+        MESA_FORMAT_RGBA_FLOAT16, 8 },
+   };
+
+   for (const format_pair &f : formats) {
+      SCOPED_TRACE(f.name);
+
+      std::vector<uint8_t> src((size_t)width * height * f.src_bpp);
+      std::vector<uint8_t> serial((size_t)width * height * f.dst_bpp);
+      std::vector<uint8_t> parallel(serial.size());
+
+      if (f.src_bpp == 16) {
+         float *p = (float *)src.data();
+         for (size_t i = 0; i < src.size() / 4; i++)
+            p[i] = (float)(i % 1021) / 1020.0f;
+      } else {
+         for (size_t i = 0; i < src.size(); i++)
+            src[i] = (uint8_t)(i * 2654435761u >> 24);
+      }
+
+      convert(NULL, f, src.data(), serial.data());
+      convert(&queue, f, src.data(), parallel.data());
+
+      EXPECT_EQ(memcmp(serial.data(), parallel.data(), serial.size()), 0);
+   }
+}
+
+TEST_F(ImageParallelRowsTest, CoversAllRows)
+{
+   static const unsigned heights[] = { 1, 7, 64, 1000, 4099 };
+
+   for (unsigned h : heights) {
+      std::vector<uint8_t> rows(h);
+
+      /* 64 KB per row, so that all but the smallest heights are split. */
+      _mesa_image_parallel_rows(&queue, h, 64 * 1024,
+         [](void *data, unsigned first_row, unsigned num_rows) {
+            uint8_t *r = (uint8_t *)data;
+            for (unsigned i = first_row; i < first_row + num_rows; i++)
+               r[i]++;
+         }, rows.data());
+
+      for (unsigned i = 0; i < h; i++)
+         EXPECT_EQ(rows[i], 1) << "row " << i << " of " << h;
+   }
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Measures the throughput of texture format conversions run by
+ * _mesa_image_parallel_rows() serially and on a thread pool, for a few
+ * representative formats.  MESA_IMAGE_THREADS sets the number of threads.
+ *
+ * Usage: image_parallel_rows_bench [width] [height] [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "util/os_time.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_debug.h"
+#include "util/u_queue.h"
+
+#include "main/format_utils.h"
+#include "main/image.h"
+
+struct convert_rows {
+   uint8_t *dst;
+   uint32_t dst_format;
+   size_t dst_stride;
+   uint8_t *src;
+   uint32_t src_format;
+   size_t src_stride;
+   unsigned width;
+};
+
+struct format_pair {
+   const char *name;
+   uint32_t src_format;
+   unsigned src_bpp;
+   uint32_t dst_format;
+   unsigned dst_bpp;
+};
+
+static void
+convert_rows_func(void *data, unsigned first_row, unsigned num_rows)
+{
+   const struct convert_rows *c = data;
+
+   _mesa_format_convert(c->dst + first_row * c->dst_stride, c->dst_format,
+                        c->dst_stride,
+                        c->src + first_row * c->src_stride, c->src_format,
+                        c->src_stride, c->width, num_rows, NULL);
+}
+
+/* Returns the throughput in megapixels per second. */
+static double
+convert(struct util_queue *queue, const struct convert_rows *c,
+        unsigned height, unsigned dst_bpp, unsigned iterations)
+{
+   int64_t start = os_time_get_nano();
+   for (unsigned i = 0; i < iterations; i++) {
+      _mesa_image_parallel_rows(queue, height, (size_t)c->width * dst_bpp,
+                                convert_rows_func, (void *)c);
+   }
+   int64_t elapsed = MAX2(os_time_get_nano() - start, 1);
+
+   return (double)c->width * height * iterations * 1000.0 / elapsed;
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned width = argc > 1 ? atoi(argv[1]) : 2048;
+   unsigned height = argc > 2 ? atoi(argv[2]) : 1024;
+   unsigned iterations = argc > 3 ? atoi(argv[3]) : 8;
+   const struct format_pair formats[] = {
+      { "RGBA8 -> BGRA8", MESA_FORMAT_R8G8B8A8_UNORM, 4,
+        MESA_FORMAT_B8G8R8A8_UNORM, 4 },
+      { "RGBA8 -> RGB565", MESA_FORMAT_R8G8B8A8_UNORM, 4,
+        MESA_FORMAT_B5G6R5_UNORM, 2 },
+      { "RGBA32F -> RGBA8", RGBA32_FLOAT, 16,
+        MESA_FORMAT_R8G8B8A8_UNORM, 4 },
+      { "RGBA32F -> RGBA16F", RGBA32_FLOAT, 16,
+        MESA_FORMAT_RGBA_FLOAT16, 8 },
+   };
+
+   /* The same default as _mesa_get_image_queue() */
+   int64_t num_threads = debug_get_num_option("MESA_IMAGE_THREADS", -1);
+   if (num_threads < 0)
+      num_threads = util_get_cpu_caps()->nr_cpus - 1;
+   num_threads = CLAMP(num_threads, 1, 15);
+
+   struct util_queue queue;
+   if (!util_queue_init(&queue, "imgbench", 32, num_threads,
+                        UTIL_QUEUE_INIT_RESIZE_IF_FULL, NULL)) {
+      fprintf(stderr, "failed to create the thread pool\n");
+      return 1;
+   }
+
+   for (unsigned f = 0; f < ARRAY_SIZE(formats); f++) {
+      const struct format_pair *fmt = &formats[f];
+      uint8_t *src = malloc((size_t)width * height * fmt->src_bpp);
+      uint8_t *dst = malloc((size_t)width * height * fmt->dst_bpp);
+      if (!src || !dst) {
+         fprintf(stderr, "out of memory\n");
+         return 1;
+      }
+
+      if (fmt->src_bpp == 16) {
+         float *p = (float *)src;
+         for (size_t i = 0; i < (size_t)width * height * 4; i++)
+            p[i] = (float)(i % 1021) / 1020.0f;
+      } else {
+         for (size_t i = 0; i < (size_t)width * height * fmt->src_bpp; i++)
+            src[i] = (uint8_t)(i * 2654435761u >> 24);
+      }
+
+      const struct convert_rows c = {
+         dst, fmt->dst_format, (size_t)width * fmt->dst_bpp,
+         src, fmt->src_format, (size_t)width * fmt->src_bpp,
+         width,
+      };
+
+      double serial_mps = convert(NULL, &c, height, fmt->dst_bpp, iterations);
+      double parallel_mps =
+         convert(&queue, &c, height, fmt->dst_bpp, iterations);
+
+      printf("%-20s %8.1f Mpix/s serial, %8.1f Mpix/s on %u threads\n",
+             fmt->name, serial_mps, parallel_mps, queue.max_threads + 1);
+
+      free(src);
+      free(dst);
+   }
+
+   util_queue_destroy(&queue);
+
+   return 0;
+}
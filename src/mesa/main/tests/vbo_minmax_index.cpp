@@ -0,0 +1,184 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ *
+ * Check the per-block min/max index summary of index buffers against a
+ * plain scan of the same range.
+ */
+
+#include <gtest/gtest.h>
+#include <string.h>
+#include <vector>
+
+#include "main/mtypes.h"
+#include "vbo/vbo.h"
+
+namespace {
+
+/* Must match vbo_minmax_index.c */
+const unsigned block_size = 1024;
+const unsigned group_blocks = 64;
+
+class vbo_minmax_summary_test : public ::testing::Test {
+protected:
+   void SetUp() override;
+   void TearDown() override;
+
+   void write(unsigned first, unsigned count, uint16_t value);
+   unsigned check(unsigned first, unsigned count, bool restart = false,
+                  unsigned restart_index = 0);
+
+   std::vector<uint16_t> indices;
+   struct gl_buffer_object obj;
+};
+
+void
+vbo_minmax_summary_test::SetUp()
+{
+   /* Two full groups and a few blocks and indices more */
+   indices.resize((2 * group_blocks + 3) * block_size + 500);
+   for (unsigned i = 0; i < indices.size(); i++)
+      indices[i] = 1000 + (i * 7919) % 50000;
+
+   memset(&obj, 0, sizeof(obj));
+   obj.Size = indices.size() * sizeof(uint16_t);
+   simple_mtx_init(&obj.MinMaxCacheMutex, mtx_plain);
+}
+
+void
+vbo_minmax_summary_test::TearDown()
+{
+   vbo_delete_minmax_cache(&obj);
+   simple_mtx_destroy(&obj.MinMaxCacheMutex);
+}
+
+/* Write to the buffer and mark the range dirty, like bufferobj.c does */
+void
+vbo_minmax_summary_test::write(unsigned first, unsigned count, uint16_t value)
+{
+   for (unsigned i = first; i < first + count; i++)
+      indices[i] = value;
+
+   GLintptr start = first * sizeof(uint16_t);
+   GLintptr end = (first + count) * sizeof(uint16_t);
+
+   obj.MinMaxCacheDirty = true;
+   if (obj.MinMaxDirtyStart < obj.MinMaxDirtyEnd) {
+      start = MIN2(start, obj.MinMaxDirtyStart);
+      end = MAX2(end, obj.MinMaxDirtyEnd);
+   }
+   obj.MinMaxDirtyStart = start;
+   obj.MinMaxDirtyEnd = end;
+}
+
+/* Returns the number of indices the summary had to scan */
+unsigned
+vbo_minmax_summary_test::check(unsigned first, unsigned count, bool restart,
+                          unsigned restart_index)
+{
+   unsigned min, max, ref_min, ref_max, scanned = 0;
+
+   vbo_get_minmax_index_mapped(count, sizeof(uint16_t), restart_index, restart,
+                               &indices[first], &ref_min, &ref_max);
+
+   EXPECT_TRUE(vbo_get_minmax_summarized(&obj, &indices[first],
+                                         first * sizeof(uint16_t), count,
+                                         sizeof(uint16_t), restart,
+                                         restart_index, &min, &max, &scanned))
+      << "first " << first << " count " << count;
+   EXPECT_EQ(min, ref_min) << "first " << first << " count " << count;
+   EXPECT_EQ(max, ref_max) << "first " << first << " count " << count;
+
+   return scanned;
+}
+
+} // namespace
+
+TEST_F(vbo_minmax_summary_test, BlockBoundaries)
+{
+   const unsigned total = indices.size();
+   const unsigned firsts[] = {
+      0, 1, block_size - 1, block_size, block_size + 1,
+      group_blocks * block_size - 1, group_blocks * block_size,
+      group_blocks * block_size + 1,
+   };
+
+   for (unsigned first : firsts) {
+      for (unsigned end : { total, total - 500, total - 501, total - 499,
+                            (2 * group_blocks) * block_size,
+                            (2 * group_blocks) * block_size + 1 }) {
+         check(first, end - first);
+      }
+   }
+
+   /* The smallest range the summary is used for, just not filling a block */
+   check(block_size - 1, 2 * block_size);
+}
+
+TEST_F(vbo_minmax_summary_test, OnlyPartialBlocksAreRescanned)
+{
+   const unsigned first = block_size / 2;
+   const unsigned count = 10 * block_size;
+
+   /* Every block is read once, then only the indices around them */
+   EXPECT_EQ(check(first, count), count);
+   EXPECT_EQ(check(first, count), block_size);
+
+   /* Ranges within already summarized blocks don't scan them again */
+   EXPECT_EQ(check(block_size, 3 * block_size), 0u);
+}
+
+TEST_F(vbo_minmax_summary_test, PrimitiveRestart)
+{
+   const unsigned total = indices.size();
+
+   /* A block mixing restart indices with others, and one of only restarts */
+   for (unsigned i = 3 * block_size; i < 4 * block_size; i += 3)
+      indices[i] = 0xffff;
+   for (unsigned i = 5 * block_size; i < 6 * block_size; i++)
+      indices[i] = 0xffff;
+
+   /* The same blocks serve draws with and without primitive restart */
+   for (unsigned restart = 0; restart < 2; restart++) {
+      check(0, total, restart, 0xffff);
+      check(block_size / 2, 4 * block_size, restart, 0xffff);
+      check(5 * block_size, 2 * block_size, restart, 0xffff);
+      check(5 * block_size - 1, block_size + 1 + block_size, restart, 0xffff);
+   }
+
+   /* Nothing can match a restart index that is too large for the type */
+   check(0, total, true, 0x10000);
+
+   /* Other restart indices aren't summarized */
+   unsigned min, max, scanned;
+   EXPECT_FALSE(vbo_get_minmax_summarized(&obj, &indices[0], 0, total,
+                                          sizeof(uint16_t), true, 1000,
+                                          &min, &max, &scanned));
+}
+
+TEST_F(vbo_minmax_summary_test, DirtyRangeInvalidation)
+{
+   const unsigned total = indices.size();
+
+   check(0, total);
+
+   /* A write within a block only invalidates that block */
+   write(group_blocks * block_size + 10, 20, 2);
+   EXPECT_EQ(check(0, total), block_size + 500);
+
+   write(group_blocks * block_size + 10, 20, 60000);
+   EXPECT_EQ(check(0, total), block_size + 500);
+
+   /* A write across a block boundary invalidates both blocks */
+   write(3 * block_size - 5, 10, 0);
+   EXPECT_EQ(check(0, total), 2 * block_size + 500);
+
+   /* Writes before the next draw are merged into one range */
+   write(7 * block_size, 1, 1);
+   write(9 * block_size, 1, 65000);
+   EXPECT_EQ(check(0, total), 3 * block_size + 500);
+
+   /* The tail that isn't part of any block is always scanned */
+   write(total - 1, 1, 65535);
+   EXPECT_EQ(check(0, total), 500u);
+}
@@ -61,6 +61,7 @@
 #include "mtypes.h"
 #include "pack.h"
 #include "pbo.h"
+#include "shared.h"
 
 #include "texcompress.h"
 #include "texcompress_fxt1.h"
@@ -90,6 +91,35 @@ enum {
 typedef GLboolean (*StoreTexImageFunc)(TEXSTORE_PARAMS);
 
 
+struct texstore_copy_rows {
+   GLubyte *dst;
+   const GLubyte *src;
+   GLint dstRowStride;
+   GLint srcRowStride;
+   GLint bytesPerRow;
+};
+
+static void
+texstore_copy_rows(void *data, unsigned first_row, unsigned num_rows)
+{
+   const struct texstore_copy_rows *copy = data;
+   GLubyte *dstRow = copy->dst + (size_t)first_row * copy->dstRowStride;
+   const GLubyte *srcRow = copy->src + (size_t)first_row * copy->srcRowStride;
+
+   if (copy->dstRowStride == copy->srcRowStride &&
+       copy->dstRowStride == copy->bytesPerRow) {
+      memcpy(dstRow, srcRow, (size_t)copy->bytesPerRow * num_rows);
+      return;
+   }
+
+   for (unsigned row = 0; row < num_rows; row++) {
+      memcpy(dstRow, srcRow, copy->bytesPerRow);
+      dstRow += copy->dstRowStride;
+      srcRow += copy->srcRowStride;
+   }
+}
+
+
 /**
  * Teximage storage routine for when a simple memcpy will do.
  * No pixel transfer operations or special texel encodings allowed.
@@ -114,30 +144,21 @@ _mesa_memcpy_texture(struct gl_context *ctx,
         srcPacking, srcAddr, srcWidth, srcHeight, srcFormat, srcType, 0, 0, 0);
    const GLuint texelBytes = _mesa_get_format_bytes(dstFormat);
    const GLint bytesPerRow = srcWidth * texelBytes;
+   struct util_queue *queue = _mesa_get_image_queue(ctx);
+   GLint img;
 
-   if (dstRowStride == srcRowStride &&
-       dstRowStride == bytesPerRow) {
-      /* memcpy image by image */
-      GLint img;
-      for (img = 0; img < srcDepth; img++) {
-         GLubyte *dstImage = dstSlices[img];
-         memcpy(dstImage, srcImage, (size_t)bytesPerRow * srcHeight);
-         srcImage += srcImageStride;
-      }
-   }
-   else {
-      /* memcpy row by row */
-      GLint img, row;
-      for (img = 0; img < srcDepth; img++) {
-         const GLubyte *srcRow = srcImage;
-         GLubyte *dstRow = dstSlices[img];
-         for (row = 0; row < srcHeight; row++) {
-            memcpy(dstRow, srcRow, bytesPerRow);
-            dstRow += dstRowStride;
-            srcRow += srcRowStride;
-         }
-         srcImage += srcImageStride;
-      }
+   /* memcpy image by image, split in bands of rows for big images */
+   for (img = 0; img < srcDepth; img++) {
+      struct texstore_copy_rows copy = {
+         .dst = dstSlices[img],
+         .src = srcImage,
+         .dstRowStride = dstRowStride,
+         .srcRowStride = srcRowStride,
+         .bytesPerRow = bytesPerRow,
+      };
+      _mesa_image_parallel_rows(queue, srcHeight, bytesPerRow,
+                                texstore_copy_rows, &copy);
+      srcImage += srcImageStride;
    }
 }
 
@@ -675,6 +696,29 @@ texstore_compressed(TEXSTORE_PARAMS)
                            srcFormat, srcType, srcAddr, srcPacking);
 }
 
+struct texstore_convert_rows {
+   GLubyte *dst;
+   uint32_t dstFormat;
+   size_t dstRowStride;
+   GLubyte *src;
+   uint32_t srcFormat;
+   size_t srcRowStride;
+   unsigned width;
+   uint8_t *rebaseSwizzle;
+};
+
+static void
+texstore_convert_rows(void *data, unsigned first_row, unsigned num_rows)
+{
+   const struct texstore_convert_rows *convert = data;
+
+   _mesa_format_convert(convert->dst + first_row * convert->dstRowStride,
+                        convert->dstFormat, convert->dstRowStride,
+                        convert->src + first_row * convert->srcRowStride,
+                        convert->srcFormat, convert->srcRowStride,
+                        convert->width, num_rows, convert->rebaseSwizzle);
+}
+
 static GLboolean
 texstore_rgba(TEXSTORE_PARAMS)
 {
@@ -816,11 +860,23 @@ texstore_rgba(TEXSTORE_PARAMS)
       needRebase = false;
    }
 
+   struct util_queue *queue = _mesa_get_image_queue(ctx);
+   const size_t bytesPerRow =
+      (size_t)srcWidth * _mesa_get_format_bytes(dstFormat);
+
    for (img = 0; img < srcDepth; img++) {
-      _mesa_format_convert(dstSlices[img], dstFormat, dstRowStride,
-                           src, srcMesaFormat, srcRowStride,
-                           srcWidth, srcHeight,
-                           needRebase ? rebaseSwizzle : NULL);
+      struct texstore_convert_rows convert = {
+         .dst = dstSlices[img],
+         .dstFormat = dstFormat,
+         .dstRowStride = dstRowStride,
+         .src = src,
+         .srcFormat = srcMesaFormat,
+         .srcRowStride = srcRowStride,
+         .width = srcWidth,
+         .rebaseSwizzle = needRebase ? rebaseSwizzle : NULL,
+      };
+      _mesa_image_parallel_rows(queue, srcHeight, bytesPerRow,
+                                texstore_convert_rows, &convert);
       src += (size_t)srcHeight * srcRowStride;
    }
 
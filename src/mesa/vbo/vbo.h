@@ -230,6 +230,14 @@ vbo_get_minmax_index_mapped(unsigned count, unsigned index_size,
                             const void *indices,
                             unsigned *min_index, unsigned *max_index);
 
+bool
+vbo_get_minmax_summarized(struct gl_buffer_object *bufferObj,
+                          const void *indices, GLintptr offset,
+                          unsigned count, unsigned index_size,
+                          bool primitive_restart, unsigned restart_index,
+                          GLuint *min_index, GLuint *max_index,
+                          unsigned *scanned);
+
 void
 vbo_get_minmax_index(struct gl_context *ctx, struct gl_buffer_object *obj,
                      const void *ptr, GLintptr offset, unsigned count,
@@ -32,6 +32,7 @@
 #include "main/varray.h"
 #include "main/macros.h"
 #include "main/sse_minmax.h"
+#include "util/bitset.h"
 #include "util/hash_table.h"
 #include "util/u_memory.h"
 #include "pipe/p_state.h"
@@ -50,6 +51,43 @@ struct minmax_cache_entry {
 };
 
 
+/* Number of indices per block of the min/max summary. */
+#define MINMAX_BLOCK_SIZE 1024
+/* Number of blocks per group, the second level of the summary. */
+#define MINMAX_GROUP_BLOCKS 64
+
+
+struct minmax_summary_entry {
+   /* The all-ones index is excluded from min and max, so that the summary
+    * can also be used with fixed index primitive restart.
+    */
+   GLuint min;
+   GLuint max;
+   bool has_all_ones;
+};
+
+
+/**
+ * Min/max index of every MINMAX_BLOCK_SIZE indices of a buffer object, and
+ * of every MINMAX_GROUP_BLOCKS blocks. Unlike the cache above, this works
+ * for any sub-range of the buffer: only the indices at both ends of the
+ * range that don't fill a whole block have to be scanned.
+ *
+ * Entries are computed when a draw first covers them, and invalidated by
+ * the byte range that was written to the buffer.
+ */
+struct vbo_minmax_summary {
+   GLsizeiptr size;
+   unsigned index_size;
+   unsigned num_blocks;
+   unsigned num_groups;
+   struct minmax_summary_entry *blocks;
+   struct minmax_summary_entry *groups;
+   BITSET_WORD *valid_blocks;
+   BITSET_WORD *valid_groups;
+};
+
+
 static uint32_t
 vbo_minmax_cache_hash(const struct minmax_cache_key *key)
 {
@@ -93,11 +131,42 @@ vbo_use_minmax_cache(struct gl_buffer_object *bufferObj)
 }
 
 
+static void
+vbo_minmax_summary_destroy(struct vbo_minmax_summary *summary)
+{
+   if (!summary)
+      return;
+
+   free(summary->blocks);
+   free(summary->groups);
+   free(summary->valid_blocks);
+   free(summary->valid_groups);
+   free(summary);
+}
+
+
 void
 vbo_delete_minmax_cache(struct gl_buffer_object *bufferObj)
 {
    _mesa_hash_table_destroy(bufferObj->MinMaxCache, vbo_minmax_cache_delete_entry);
    bufferObj->MinMaxCache = NULL;
+   vbo_minmax_summary_destroy(bufferObj->MinMaxSummary);
+   bufferObj->MinMaxSummary = NULL;
+}
+
+
+static void
+vbo_minmax_cache_count_hits(struct gl_buffer_object *bufferObj, unsigned count)
+{
+   /* The hit counter saturates so that we don't accidently disable the
+    * cache in a long-running program.
+    */
+   unsigned new_hit_count = bufferObj->MinMaxCacheHitIndices + count;
+
+   if (new_hit_count >= bufferObj->MinMaxCacheHitIndices)
+      bufferObj->MinMaxCacheHitIndices = new_hit_count;
+   else
+      bufferObj->MinMaxCacheHitIndices = ~(unsigned)0;
 }
 
 
@@ -152,19 +221,11 @@ vbo_get_minmax_cached(struct gl_buffer_object *bufferObj,
    }
 
 out_invalidate:
-   if (found) {
-      /* The hit counter saturates so that we don't accidently disable the
-       * cache in a long-running program.
-       */
-      unsigned new_hit_count = bufferObj->MinMaxCacheHitIndices + count;
-
-      if (new_hit_count >= bufferObj->MinMaxCacheHitIndices)
-         bufferObj->MinMaxCacheHitIndices = new_hit_count;
-      else
-         bufferObj->MinMaxCacheHitIndices = ~(unsigned)0;
-   } else {
-      bufferObj->MinMaxCacheMissIndices += count;
-   }
+   /* Misses are counted by vbo_minmax_cache_store, which knows how many
+    * indices the summary saved us from scanning.
+    */
+   if (found)
+      vbo_minmax_cache_count_hits(bufferObj, count);
 
 out_disable:
    simple_mtx_unlock(&bufferObj->MinMaxCacheMutex);
@@ -172,11 +233,15 @@ out_disable:
 }
 
 
+/**
+ * Store the result of a lookup that missed the cache. \p scanned is the
+ * number of indices that actually had to be read.
+ */
 static void
 vbo_minmax_cache_store(struct gl_context *ctx,
                        struct gl_buffer_object *bufferObj,
                        unsigned index_size, GLintptr offset, GLuint count,
-                       GLuint min, GLuint max)
+                       GLuint scanned, GLuint min, GLuint max)
 {
    struct minmax_cache_entry *entry;
    struct hash_entry *table_entry;
@@ -187,6 +252,9 @@ vbo_minmax_cache_store(struct gl_context *ctx,
 
    simple_mtx_lock(&bufferObj->MinMaxCacheMutex);
 
+   bufferObj->MinMaxCacheMissIndices += scanned;
+   vbo_minmax_cache_count_hits(bufferObj, count - scanned);
+
    if (!bufferObj->MinMaxCache) {
       bufferObj->MinMaxCache =
          _mesa_hash_table_create(NULL,
@@ -234,6 +302,27 @@ vbo_get_minmax_index_mapped(unsigned count, unsigned index_size,
                             const void *indices,
                             unsigned *min_index, unsigned *max_index)
 {
+#if defined(USE_AVX2)
+   if (count >= 64 && util_get_cpu_caps()->has_avx2) {
+      switch (index_size) {
+      case 4:
+         _mesa_uint_array_min_max_avx2(indices, min_index, max_index, count,
+                                       restart, restartIndex);
+         return;
+      case 2:
+         _mesa_ushort_array_min_max_avx2(indices, min_index, max_index, count,
+                                         restart, restartIndex);
+         return;
+      case 1:
+         _mesa_ubyte_array_min_max_avx2(indices, min_index, max_index, count,
+                                        restart, restartIndex);
+         return;
+      default:
+         UNREACHABLE("not reached");
+      }
+   }
+#endif
+
    switch (index_size) {
    case 4: {
       const GLuint *ui_indices = (const GLuint *)indices;
@@ -313,6 +402,238 @@ vbo_get_minmax_index_mapped(unsigned count, unsigned index_size,
 }
 
 
+static unsigned
+vbo_all_ones_index(unsigned index_size)
+{
+   return index_size == 4 ? ~0u : (1u << (index_size * 8)) - 1;
+}
+
+
+static struct vbo_minmax_summary *
+vbo_minmax_summary_create(GLsizeiptr size, unsigned index_size)
+{
+   struct vbo_minmax_summary *summary = CALLOC_STRUCT(vbo_minmax_summary);
+   if (!summary)
+      return NULL;
+
+   summary->size = size;
+   summary->index_size = index_size;
+   summary->num_blocks = size / index_size / MINMAX_BLOCK_SIZE;
+   summary->num_groups = summary->num_blocks / MINMAX_GROUP_BLOCKS;
+
+   /* Not every buffer has a full group, keep the allocations non-empty. */
+   unsigned num_blocks = MAX2(summary->num_blocks, 1);
+   unsigned num_groups = MAX2(summary->num_groups, 1);
+   summary->blocks = malloc(num_blocks * sizeof(*summary->blocks));
+   summary->groups = malloc(num_groups * sizeof(*summary->groups));
+   summary->valid_blocks = calloc(BITSET_WORDS(num_blocks), sizeof(BITSET_WORD));
+   summary->valid_groups = calloc(BITSET_WORDS(num_groups), sizeof(BITSET_WORD));
+   if (!summary->blocks || !summary->groups ||
+       !summary->valid_blocks || !summary->valid_groups) {
+      vbo_minmax_summary_destroy(summary);
+      return NULL;
+   }
+
+   return summary;
+}
+
+
+/**
+ * Invalidate all blocks overlapping the byte range [start, end).
+ */
+static void
+vbo_minmax_summary_invalidate(struct vbo_minmax_summary *summary,
+                              GLintptr start, GLintptr end)
+{
+   const GLintptr block_bytes = summary->index_size * MINMAX_BLOCK_SIZE;
+   unsigned first = MAX2(start, 0) / block_bytes;
+   unsigned last = MIN2(DIV_ROUND_UP(end, block_bytes), summary->num_blocks);
+
+   if (first >= last)
+      return;
+
+   BITSET_CLEAR_RANGE(summary->valid_blocks, first, last - 1);
+
+   unsigned first_group = first / MINMAX_GROUP_BLOCKS;
+   if (first_group < summary->num_groups) {
+      unsigned last_group = MIN2((last - 1) / MINMAX_GROUP_BLOCKS,
+                                 summary->num_groups - 1);
+      BITSET_CLEAR_RANGE(summary->valid_groups, first_group, last_group);
+   }
+}
+
+
+static void
+vbo_minmax_summary_merge(struct minmax_summary_entry *dst,
+                         const struct minmax_summary_entry *src)
+{
+   dst->min = MIN2(dst->min, src->min);
+   dst->max = MAX2(dst->max, src->max);
+   dst->has_all_ones |= src->has_all_ones;
+}
+
+
+/**
+ * Compute the entry of a block if it isn't valid. \p data points to the
+ * first index of the block. Returns the number of indices scanned.
+ */
+static unsigned
+vbo_minmax_summary_fill_block(struct vbo_minmax_summary *summary,
+                              unsigned block, const void *data)
+{
+   struct minmax_summary_entry *entry = &summary->blocks[block];
+   const unsigned all_ones = vbo_all_ones_index(summary->index_size);
+
+   if (BITSET_TEST(summary->valid_blocks, block))
+      return 0;
+
+   vbo_get_minmax_index_mapped(MINMAX_BLOCK_SIZE, summary->index_size,
+                               0, false, data, &entry->min, &entry->max);
+   entry->has_all_ones = entry->max == all_ones;
+
+   /* Blocks using the all-ones index are usually primitive restart heavy,
+    * scan those once more without it.
+    */
+   if (entry->has_all_ones) {
+      vbo_get_minmax_index_mapped(MINMAX_BLOCK_SIZE, summary->index_size,
+                                  all_ones, true, data,
+                                  &entry->min, &entry->max);
+   }
+
+   BITSET_SET(summary->valid_blocks, block);
+   return MINMAX_BLOCK_SIZE;
+}
+
+
+/**
+ * Compute the min/max index of a range of the buffer from the per-block
+ * summary of the buffer, filling in the missing blocks as needed.
+ * \p indices points to the mapped first index of the range.
+ *
+ * Returns false if the summary can't be used for this range, in which case
+ * the whole range has to be scanned.
+ */
+bool
+vbo_get_minmax_summarized(struct gl_buffer_object *bufferObj,
+                          const void *indices, GLintptr offset,
+                          unsigned count, unsigned index_size,
+                          bool primitive_restart, unsigned restart_index,
+                          GLuint *min_index, GLuint *max_index,
+                          unsigned *scanned)
+{
+   const unsigned all_ones = vbo_all_ones_index(index_size);
+   struct vbo_minmax_summary *summary;
+
+   /* Nothing can match a restart index that doesn't fit in the index type,
+    * any other restart index than all-ones isn't summarized.
+    */
+   if (primitive_restart && restart_index > all_ones)
+      primitive_restart = false;
+   if (primitive_restart && restart_index != all_ones)
+      return false;
+
+   if (count < 2 * MINMAX_BLOCK_SIZE || offset % index_size ||
+       offset + (GLsizeiptr)count * index_size > bufferObj->Size)
+      return false;
+
+   const unsigned first = offset / index_size;
+   const unsigned end = first + count;
+   const unsigned first_block = DIV_ROUND_UP(first, MINMAX_BLOCK_SIZE);
+   const unsigned end_block = end / MINMAX_BLOCK_SIZE;
+
+   if (!vbo_use_minmax_cache(bufferObj))
+      return false;
+
+   simple_mtx_lock(&bufferObj->MinMaxCacheMutex);
+
+   summary = bufferObj->MinMaxSummary;
+   if (summary &&
+       (summary->size != bufferObj->Size || summary->index_size != index_size)) {
+      vbo_minmax_summary_destroy(summary);
+      summary = NULL;
+   }
+
+   if (!summary) {
+      summary = vbo_minmax_summary_create(bufferObj->Size, index_size);
+      bufferObj->MinMaxSummary = summary;
+      if (!summary) {
+         simple_mtx_unlock(&bufferObj->MinMaxCacheMutex);
+         return false;
+      }
+   } else if (bufferObj->MinMaxDirtyStart < bufferObj->MinMaxDirtyEnd) {
+      vbo_minmax_summary_invalidate(summary, bufferObj->MinMaxDirtyStart,
+                                    bufferObj->MinMaxDirtyEnd);
+   }
+   bufferObj->MinMaxDirtyStart = bufferObj->MinMaxDirtyEnd = 0;
+
+   struct minmax_summary_entry result = { ~0u, 0, false };
+   const char *block_data = (const char *)indices +
+      ((size_t)first_block * MINMAX_BLOCK_SIZE - first) * index_size;
+   const size_t block_bytes = MINMAX_BLOCK_SIZE * index_size;
+   unsigned num_scanned = 0;
+
+   for (unsigned b = first_block; b < end_block;) {
+      if (b % MINMAX_GROUP_BLOCKS == 0 && b + MINMAX_GROUP_BLOCKS <= end_block) {
+         const unsigned group = b / MINMAX_GROUP_BLOCKS;
+         struct minmax_summary_entry *entry = &summary->groups[group];
+
+         if (!BITSET_TEST(summary->valid_groups, group)) {
+            *entry = (struct minmax_summary_entry) { ~0u, 0, false };
+            for (unsigned i = 0; i < MINMAX_GROUP_BLOCKS; i++) {
+               num_scanned +=
+                  vbo_minmax_summary_fill_block(summary, b + i,
+                                                block_data + i * block_bytes);
+               vbo_minmax_summary_merge(entry, &summary->blocks[b + i]);
+            }
+            BITSET_SET(summary->valid_groups, group);
+         }
+
+         vbo_minmax_summary_merge(&result, entry);
+         block_data += MINMAX_GROUP_BLOCKS * block_bytes;
+         b += MINMAX_GROUP_BLOCKS;
+      } else {
+         num_scanned += vbo_minmax_summary_fill_block(summary, b, block_data);
+         vbo_minmax_summary_merge(&result, &summary->blocks[b]);
+         block_data += block_bytes;
+         b++;
+      }
+   }
+
+   simple_mtx_unlock(&bufferObj->MinMaxCacheMutex);
+
+   if (!primitive_restart && result.has_all_ones) {
+      result.min = MIN2(result.min, all_ones);
+      result.max = all_ones;
+   }
+
+   /* Scan the indices before the first and after the last whole block. */
+   const unsigned head = first_block * MINMAX_BLOCK_SIZE - first;
+   const unsigned tail = end - end_block * MINMAX_BLOCK_SIZE;
+   GLuint min, max;
+
+   if (head) {
+      vbo_get_minmax_index_mapped(head, index_size, restart_index,
+                                  primitive_restart, indices, &min, &max);
+      result.min = MIN2(result.min, min);
+      result.max = MAX2(result.max, max);
+   }
+   if (tail) {
+      vbo_get_minmax_index_mapped(tail, index_size, restart_index,
+                                  primitive_restart,
+                                  (const char *)indices +
+                                     (size_t)(count - tail) * index_size,
+                                  &min, &max);
+      result.min = MIN2(result.min, min);
+      result.max = MAX2(result.max, max);
+   }
+
+   *min_index = result.min;
+   *max_index = result.max;
+   *scanned = num_scanned + head + tail;
+   return true;
+}
+
+
 /**
  * Compute min and max elements by scanning the index buffer for
  * glDraw[Range]Elements() calls.
@@ -341,13 +662,19 @@ vbo_get_minmax_index(struct gl_context *ctx, struct gl_buffer_object *obj,
                                           obj, MAP_INTERNAL);
    }
 
-   vbo_get_minmax_index_mapped(count, index_size, restart_index,
-                               primitive_restart, indices,
-                               min_index, max_index);
+   unsigned scanned = count;
+   if (!obj ||
+       !vbo_get_minmax_summarized(obj, indices, offset, count, index_size,
+                                  primitive_restart, restart_index,
+                                  min_index, max_index, &scanned)) {
+      vbo_get_minmax_index_mapped(count, index_size, restart_index,
+                                  primitive_restart, indices,
+                                  min_index, max_index);
+   }
 
    if (obj) {
-      vbo_minmax_cache_store(ctx, obj, index_size, offset, count, *min_index,
-                             *max_index);
+      vbo_minmax_cache_store(ctx, obj, index_size, offset, count, scanned,
+                             *min_index, *max_index);
       _mesa_bufferobj_unmap(ctx, obj, MAP_INTERNAL);
    }
 }
@@ -0,0 +1,429 @@
+/*
+ * Copyright © 2026 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Trains the zstd dictionary used to compress the entries of an existing
+ * on-disk shader cache, and compares the compression ratio and throughput
+ * with and without it.
+ *
+ * Samples are read from the multi-file and the Mesa-DB cache layouts found
+ * below the given directory. The dictionary is stored as
+ * DISK_CACHE_COMPRESS_DICT_FILENAME in that directory, it's picked up by the
+ * applications creating the cache the next time they start.
+ */
+
+#include <ftw.h>
+#include <inttypes.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util/blob.h"
+#include "util/compress.h"
+#include "util/crc32.h"
+#include "util/disk_cache.h"
+#include "util/disk_cache_os.h"
+#include "util/mesa_cache_db.h"
+#include "util/os_file.h"
+#include "util/os_time.h"
+#include "util/u_dynarray.h"
+
+/* zstd's default dictionary size */
+#define DEFAULT_DICT_SIZE (110 * 1024)
+
+struct samples {
+   /* Dictionary the existing entries may be compressed with */
+   struct util_compress_dict *dict;
+
+   struct util_dynarray data;
+   struct util_dynarray sizes;
+   unsigned skipped;
+};
+
+static struct samples samples;
+
+/* Extracts the uncompressed payload of a cache item, see
+ * create_cache_item_header_and_blob() for the layout.
+ */
+static void
+add_cache_item(const void *item, size_t item_size)
+{
+   struct blob_reader reader;
+   blob_reader_init(&reader, item, item_size);
+
+   /* Driver keys: version, driver id, GPU name, pointer size and flags */
+   blob_read_uint8(&reader);
+   blob_read_string(&reader);
+   blob_read_string(&reader);
+   blob_read_uint8(&reader);
+   blob_read_bytes(&reader, sizeof(uint64_t));
+
+   if (blob_read_uint32(&reader) == CACHE_ITEM_TYPE_GLSL) {
+      uint32_t num_keys = blob_read_uint32(&reader);
+      blob_read_bytes(&reader, num_keys * sizeof(cache_key));
+   }
+
+   const struct cache_entry_file_data *cf_data =
+      blob_read_bytes(&reader, sizeof(*cf_data));
+   if (reader.overrun) {
+      samples.skipped++;
+      return;
+   }
+
+   size_t data_size = reader.end - reader.current;
+   const uint8_t *data = blob_read_bytes(&reader, data_size);
+   if (cf_data->crc32 != util_hash_crc32(data, data_size)) {
+      samples.skipped++;
+      return;
+   }
+
+   size_t offset = samples.data.size;
+   if (!util_dynarray_grow_bytes(&samples.data, 1,
+                                 cf_data->uncompressed_size)) {
+      samples.skipped++;
+      return;
+   }
+
+   if (!util_compress_inflate_dict(samples.dict, data, data_size,
+                                   (uint8_t *)samples.data.data + offset,
+                                   cf_data->uncompressed_size)) {
+      samples.data.size = offset;
+      samples.skipped++;
+      return;
+   }
+
+   util_dynarray_append_typed(&samples.sizes, size_t,
+                              cf_data->uncompressed_size);
+}
+
+static void
+add_db_entry(void *data, const uint8_t *key, const void *blob, size_t size)
+{
+   add_cache_item(blob, size);
+}
+
+static int
+add_file(const char *fpath, const struct stat *sb, int typeflag,
+         struct FTW *ftwbuf)
+{
+   if (typeflag != FTW_F)
+      return 0;
+
+   const char *name = fpath + ftwbuf->base;
+
+   if (!strcmp(name, "mesa_cache.db")) {
+      char *dir = strndup(fpath, ftwbuf->base);
+      struct mesa_cache_db db = {0};
+
+      if (dir && mesa_cache_db_open(&db, dir)) {
+         mesa_cache_db_foreach_entry(&db, add_db_entry, NULL);
+         mesa_cache_db_close(&db);
+      }
+
+      free(dir);
+      return 0;
+   }
+
+   /* Multi-file entries live in directories named after the first two hex
+    * digits of their key.
+    */
+   if (ftwbuf->level < 2 || fpath[ftwbuf->base - 4] != '/')
+      return 0;
+
+   size_t size;
+   char *item = os_read_file(fpath, &size);
+   if (item) {
+      add_cache_item(item, size);
+      free(item);
+   }
+
+   return 0;
+}
+
+static bool
+load_samples(const char *cache_dir)
+{
+   char *dict_path = NULL;
+
+   if (asprintf(&dict_path, "%s/%s", cache_dir,
+                DISK_CACHE_COMPRESS_DICT_FILENAME) == -1)
+      return false;
+
+   size_t dict_size;
+   char *dict_data = os_read_file(dict_path, &dict_size);
+   if (dict_data) {
+      samples.dict = util_compress_dict_create(dict_data, dict_size);
+      free(dict_data);
+   }
+   free(dict_path);
+
+   util_dynarray_init(&samples.data, NULL);
+   util_dynarray_init(&samples.sizes, NULL);
+
+   if (nftw(cache_dir, add_file, 16, FTW_PHYS) == -1) {
+      fprintf(stderr, "failed to walk %s\n", cache_dir);
+      return false;
+   }
+
+   unsigned num_samples = util_dynarray_num_elements(&samples.sizes, size_t);
+
+   printf("%u entries (%u skipped), %.1f MiB uncompressed\n", num_samples,
+          samples.skipped, samples.data.size / (1024.0 * 1024.0));
+
+   if (!num_samples) {
+      fprintf(stderr, "no cache entries found in %s\n", cache_dir);
+      return false;
+   }
+
+   return true;
+}
+
+static void *
+train(const void *data, const size_t *sizes, unsigned num_samples,
+      size_t max_dict_size, size_t *dict_size)
+{
+   void *dict_data = malloc(max_dict_size);
+   if (!dict_data)
+      return NULL;
+
+   *dict_size = util_compress_dict_train(dict_data, max_dict_size, data,
+                                         sizes, num_samples);
+   if (!*dict_size) {
+      fprintf(stderr, "failed to train the dictionary, this requires Mesa "
+                      "to be built with zstd\n");
+      free(dict_data);
+      return NULL;
+   }
+
+   return dict_data;
+}
+
+static int
+train_cmd(const char *cache_dir, size_t max_dict_size)
+{
+   size_t dict_size;
+   char *path = NULL, *tmp_path = NULL;
+   int ret = 1;
+
+   if (!load_samples(cache_dir))
+      return 1;
+
+   void *dict_data = train(samples.data.data, samples.sizes.data,
+                           util_dynarray_num_elements(&samples.sizes, size_t),
+                           max_dict_size, &dict_size);
+   if (!dict_data)
+      return 1;
+
+   if (asprintf(&path, "%s/%s", cache_dir,
+                DISK_CACHE_COMPRESS_DICT_FILENAME) == -1 ||
+       asprintf(&tmp_path, "%s.tmp", path) == -1)
+      goto out;
+
+   /* Applications only read the dictionary at startup, replace it
+    * atomically in case one starts meanwhile.
+    */
+   FILE *file = fopen(tmp_path, "wb");
+   bool written = file && fwrite(dict_data, dict_size, 1, file) == 1;
+   if (file && fclose(file))
+      written = false;
+
+   if (!written || rename(tmp_path, path)) {
+      fprintf(stderr, "failed to write %s\n", path);
+      unlink(tmp_path);
+      goto out;
+   }
+
+   printf("wrote a %zu bytes dictionary to %s\n", dict_size, path);
+   ret = 0;
+
+out:
+   free(tmp_path);
+   free(path);
+   free(dict_data);
+   return ret;
+}
+
+struct bench_result {
+   uint64_t compressed_size;
+   double compress_time;
+   double decompress_time;
+};
+
+static bool
+bench_dict(struct util_compress_dict *dict, const uint8_t *data,
+           const size_t *sizes, unsigned first, unsigned stride,
+           unsigned num_samples, struct bench_result *result)
+{
+   size_t max_size = 0;
+
+   for (unsigned i = 0; i < num_samples; i++)
+      max_size = MAX2(max_size, sizes[i]);
+
+   uint8_t *compressed = malloc(util_compress_max_compressed_len(max_size));
+   uint8_t *decompressed = malloc(max_size);
+   if (!compressed || !decompressed) {
+      free(compressed);
+      free(decompressed);
+      return false;
+   }
+
+   size_t offset = 0;
+   for (unsigned i = 0; i < num_samples; offset += sizes[i++]) {
+      if (i % stride != first)
+         continue;
+
+      int64_t start = os_time_get_nano();
+      size_t size =
+         util_compress_deflate_dict(dict, data + offset, sizes[i], compressed,
+                                    util_compress_max_compressed_len(max_size));
+      int64_t mid = os_time_get_nano();
+      bool ok = size &&
+                util_compress_inflate_dict(dict, compressed, size,
+                                           decompressed, sizes[i]);
+      int64_t end = os_time_get_nano();
+
+      if (!ok || memcmp(decompressed, data + offset, sizes[i])) {
+         fprintf(stderr, "entry %u doesn't round-trip\n", i);
+         free(compressed);
+         free(decompressed);
+         return false;
+      }
+
+      result->compressed_size += size;
+      result->compress_time += (mid - start) / 1000000000.0;
+      result->decompress_time += (end - mid) / 1000000000.0;
+   }
+
+   free(compressed);
+   free(decompressed);
+   return true;
+}
+
+static void
+print_result(const char *name, uint64_t size,
+             const struct bench_result *result)
+{
+   printf("%-16s ratio %5.2f, compress %8.1f MiB/s, decompress %8.1f MiB/s\n",
+          name, (double)size / result->compressed_size,
+          size / (1024.0 * 1024.0) / result->compress_time,
+          size / (1024.0 * 1024.0) / result->decompress_time);
+}
+
+static int
+bench_cmd(const char *cache_dir, size_t max_dict_size)
+{
+   struct util_compress_dict *dict;
+   const size_t *sizes;
+   unsigned num_samples, first = 0, stride = 1;
+   uint64_t size = 0;
+
+   if (!load_samples(cache_dir))
+      return 1;
+
+   sizes = samples.sizes.data;
+   num_samples = util_dynarray_num_elements(&samples.sizes, size_t);
+
+   dict = samples.dict;
+   if (!dict) {
+      /* Without a stored dictionary, train on every other entry and measure
+       * the remaining ones to not benchmark with the training set.
+       */
+      struct util_dynarray train_data, train_sizes;
+      size_t offset = 0, dict_size;
+
+      util_dynarray_init(&train_data, NULL);
+      util_dynarray_init(&train_sizes, NULL);
+      for (unsigned i = 0; i < num_samples; offset += sizes[i++]) {
+         if (i % 2)
+            continue;
+
+         util_dynarray_append_array(&train_data, uint8_t,
+                                    (uint8_t *)samples.data.data + offset,
+                                    sizes[i]);
+         util_dynarray_append_typed(&train_sizes, size_t, sizes[i]);
+      }
+
+      void *dict_data =
+         train(train_data.data, train_sizes.data,
+               util_dynarray_num_elements(&train_sizes, size_t),
+               max_dict_size, &dict_size);
+      util_dynarray_fini(&train_data);
+      util_dynarray_fini(&train_sizes);
+      if (!dict_data)
+         return 1;
+
+      dict = util_compress_dict_create(dict_data, dict_size);
+      free(dict_data);
+      if (!dict)
+         return 1;
+
+      first = 1;
+      stride = 2;
+      printf("trained a %zu bytes dictionary on half of the entries\n",
+             dict_size);
+   }
+
+   for (unsigned i = first; i < num_samples; i += stride)
+      size += sizes[i];
+
+   struct bench_result plain = {0}, with_dict = {0};
+   if (!bench_dict(NULL, samples.data.data, sizes, first, stride, num_samples,
+                   &plain) ||
+       !bench_dict(dict, samples.data.data, sizes, first, stride, num_samples,
+                   &with_dict))
+      return 1;
+
+   print_result("no dictionary:", size, &plain);
+   print_result("dictionary:", size, &with_dict);
+
+   if (dict != samples.dict)
+      util_compress_dict_destroy(dict);
+
+   return 0;
+}
+
+static void
+usage(const char *name)
+{
+   fprintf(stderr,
+           "Usage: %s train|bench <cache dir> [max dictionary size]\n"
+           "\n"
+           "  train  writes a dictionary trained from the cache entries to\n"
+           "         <cache dir>/%s\n"
+           "  bench  compares the compression ratio and throughput with and\n"
+           "         without the dictionary\n",
+           name, DISK_CACHE_COMPRESS_DICT_FILENAME);
+}
+
+int
+main(int argc, char **argv)
+{
+   size_t max_dict_size = DEFAULT_DICT_SIZE;
+   int ret;
+
+   if (argc < 3 || argc > 4) {
+      usage(basename(argv[0]));
+      return 1;
+   }
+
+   if (argc == 4)
+      max_dict_size = strtoul(argv[3], NULL, 10);
+
+   if (!strcmp(argv[1], "train")) {
+      ret = train_cmd(argv[2], max_dict_size);
+   } else if (!strcmp(argv[1], "bench")) {
+      ret = bench_cmd(argv[2], max_dict_size);
+   } else {
+      usage(basename(argv[0]));
+      return 1;
+   }
+
+   util_compress_dict_destroy(samples.dict);
+   util_dynarray_fini(&samples.data);
+   util_dynarray_fini(&samples.sizes);
+
+   return ret;
+}
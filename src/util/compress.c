@@ -36,10 +36,15 @@
 
 #ifdef HAVE_ZSTD
 #include "zstd.h"
+#include "zdict.h"
 #endif
 
+#include <stdlib.h>
+
 #include "util/compress.h"
 #include "util/perf/cpu_trace.h"
+#include "util/simple_mtx.h"
+#include "util/u_dynarray.h"
 #include "macros.h"
 
 /* 3 is the recomended level, with 22 as the absolute maximum */
@@ -166,4 +171,216 @@ util_compress_inflate(const uint8_t *in_data, size_t in_data_size,
 #endif
 }
 
+struct util_compress_dict {
+#ifdef HAVE_ZSTD
+   ZSTD_CDict *cdict;
+   ZSTD_DDict *ddict;
+   unsigned id;
+
+   /* Idle (de)compression contexts, reused across calls since creating
+    * them is costly compared to (de)compressing a small cache entry.
+    */
+   simple_mtx_t ctx_lock;
+   struct util_dynarray cctxs;
+   struct util_dynarray dctxs;
+#endif
+};
+
+#ifdef HAVE_ZSTD
+static ZSTD_CCtx *
+dict_get_cctx(struct util_compress_dict *dict)
+{
+   ZSTD_CCtx *cctx = NULL;
+
+   simple_mtx_lock(&dict->ctx_lock);
+   if (util_dynarray_num_elements(&dict->cctxs, ZSTD_CCtx *))
+      cctx = util_dynarray_pop(&dict->cctxs, ZSTD_CCtx *);
+   simple_mtx_unlock(&dict->ctx_lock);
+
+   return cctx ? cctx : ZSTD_createCCtx();
+}
+
+static void
+dict_put_cctx(struct util_compress_dict *dict, ZSTD_CCtx *cctx)
+{
+   simple_mtx_lock(&dict->ctx_lock);
+   ZSTD_CCtx **slot = util_dynarray_grow(&dict->cctxs, ZSTD_CCtx *, 1);
+   if (slot)
+      *slot = cctx;
+   else
+      ZSTD_freeCCtx(cctx);
+   simple_mtx_unlock(&dict->ctx_lock);
+}
+
+static ZSTD_DCtx *
+dict_get_dctx(struct util_compress_dict *dict)
+{
+   ZSTD_DCtx *dctx = NULL;
+
+   simple_mtx_lock(&dict->ctx_lock);
+   if (util_dynarray_num_elements(&dict->dctxs, ZSTD_DCtx *))
+      dctx = util_dynarray_pop(&dict->dctxs, ZSTD_DCtx *);
+   simple_mtx_unlock(&dict->ctx_lock);
+
+   return dctx ? dctx : ZSTD_createDCtx();
+}
+
+static void
+dict_put_dctx(struct util_compress_dict *dict, ZSTD_DCtx *dctx)
+{
+   simple_mtx_lock(&dict->ctx_lock);
+   ZSTD_DCtx **slot = util_dynarray_grow(&dict->dctxs, ZSTD_DCtx *, 1);
+   if (slot)
+      *slot = dctx;
+   else
+      ZSTD_freeDCtx(dctx);
+   simple_mtx_unlock(&dict->ctx_lock);
+}
+#endif
+
+/**
+ * Creates a dictionary from the output of util_compress_dict_train(), returns
+ * NULL if dictionaries aren't supported or the data isn't a dictionary.
+ */
+struct util_compress_dict *
+util_compress_dict_create(const void *dict_data, size_t dict_size)
+{
+#ifdef HAVE_ZSTD
+   struct util_compress_dict *dict;
+   unsigned id = ZSTD_getDictID_fromDict(dict_data, dict_size);
+
+   /* Only trained dictionaries carry an ID, which is needed to tell the
+    * frames compressed with it apart.
+    */
+   if (!id)
+      return NULL;
+
+   dict = calloc(1, sizeof(*dict));
+   if (!dict)
+      return NULL;
+
+   dict->id = id;
+   simple_mtx_init(&dict->ctx_lock, mtx_plain);
+   util_dynarray_init(&dict->cctxs, NULL);
+   util_dynarray_init(&dict->dctxs, NULL);
+   dict->cdict = ZSTD_createCDict(dict_data, dict_size, ZSTD_COMPRESSION_LEVEL);
+   dict->ddict = ZSTD_createDDict(dict_data, dict_size);
+   if (!dict->cdict || !dict->ddict) {
+      util_compress_dict_destroy(dict);
+      return NULL;
+   }
+
+   return dict;
+#else
+   return NULL;
+#endif
+}
+
+void
+util_compress_dict_destroy(struct util_compress_dict *dict)
+{
+   if (!dict)
+      return;
+
+#ifdef HAVE_ZSTD
+   util_dynarray_foreach(&dict->cctxs, ZSTD_CCtx *, cctx)
+      ZSTD_freeCCtx(*cctx);
+   util_dynarray_foreach(&dict->dctxs, ZSTD_DCtx *, dctx)
+      ZSTD_freeDCtx(*dctx);
+   util_dynarray_fini(&dict->cctxs);
+   util_dynarray_fini(&dict->dctxs);
+   simple_mtx_destroy(&dict->ctx_lock);
+
+   ZSTD_freeCDict(dict->cdict);
+   ZSTD_freeDDict(dict->ddict);
+#endif
+   free(dict);
+}
+
+/**
+ * Trains a dictionary from the concatenated samples, returns the size of
+ * the dictionary written to dict_buf or 0 on failure.
+ */
+size_t
+util_compress_dict_train(void *dict_buf, size_t dict_buf_size,
+                         const void *samples, const size_t *sample_sizes,
+                         unsigned num_samples)
+{
+#ifdef HAVE_ZSTD
+   size_t ret = ZDICT_trainFromBuffer(dict_buf, dict_buf_size, samples,
+                                      sample_sizes, num_samples);
+   if (ZDICT_isError(ret))
+      return 0;
+
+   return ret;
+#else
+   return 0;
+#endif
+}
+
+/* Compress data with the dictionary, or without if dict is NULL */
+size_t
+util_compress_deflate_dict(struct util_compress_dict *dict,
+                           const uint8_t *in_data, size_t in_data_size,
+                           uint8_t *out_data, size_t out_buff_size)
+{
+#ifdef HAVE_ZSTD
+   if (dict) {
+      MESA_TRACE_FUNC();
+
+      ZSTD_CCtx *cctx = dict_get_cctx(dict);
+      if (!cctx)
+         return 0;
+
+      size_t ret = ZSTD_compress_usingCDict(cctx, out_data, out_buff_size,
+                                            in_data, in_data_size,
+                                            dict->cdict);
+      dict_put_cctx(dict, cctx);
+
+      if (ZSTD_isError(ret))
+         return 0;
+
+      return ret;
+   }
+#endif
+
+   return util_compress_deflate(in_data, in_data_size, out_data,
+                                out_buff_size);
+}
+
+/**
+ * Decompresses data compressed with util_compress_deflate_dict(). Fails if
+ * it was compressed with a different dictionary than dict.
+ */
+bool
+util_compress_inflate_dict(struct util_compress_dict *dict,
+                           const uint8_t *in_data, size_t in_data_size,
+                           uint8_t *out_data, size_t out_data_size)
+{
+#ifdef HAVE_ZSTD
+   unsigned id = ZSTD_getDictID_fromFrame(in_data, in_data_size);
+
+   if (id) {
+      MESA_TRACE_FUNC();
+
+      if (!dict || dict->id != id)
+         return false;
+
+      ZSTD_DCtx *dctx = dict_get_dctx(dict);
+      if (!dctx)
+         return false;
+
+      size_t ret = ZSTD_decompress_usingDDict(dctx, out_data, out_data_size,
+                                              in_data, in_data_size,
+                                              dict->ddict);
+      dict_put_dctx(dict, dctx);
+
+      return !ZSTD_isError(ret);
+   }
+#endif
+
+   return util_compress_inflate(in_data, in_data_size, out_data,
+                                out_data_size);
+}
+
 #endif
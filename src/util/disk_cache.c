@@ -139,6 +139,8 @@ disk_cache_type_create(const char *gpu_name,
    if (strcmp(driver_id, "make_check_uncompressed") == 0)
       cache->compression_disabled = true;
 
+   disk_cache_load_compress_dict(local, cache);
+
    if (cache_type == DISK_CACHE_SINGLE_FILE) {
       if (!disk_cache_load_cache_index_foz(local, cache))
          goto path_fail;
@@ -334,6 +336,14 @@ disk_cache_destroy(struct disk_cache *cache)
       util_queue_finish(&cache->cache_queue);
       util_queue_destroy(&cache->cache_queue);
 
+      /* Only complete once the queued writes are done */
+      if (unlikely(cache->stats.enabled) &&
+          cache->type == DISK_CACHE_DATABASE) {
+         mesa_logi("disk shader cache:  writes = %u, write batches = %u\n",
+                   cache->stats.writes,
+                   cache->stats.write_batches);
+      }
+
       if (cache->foz_ro_cache)
          disk_cache_destroy(cache->foz_ro_cache);
 
@@ -341,11 +351,14 @@ disk_cache_destroy(struct disk_cache *cache)
          foz_destroy(&cache->foz_db);
 
       if (cache->type == DISK_CACHE_DATABASE)
-         mesa_cache_db_multipart_close(&cache->cache_db);
+         disk_cache_db_close(cache);
 
       disk_cache_destroy_mmap(cache);
    }
 
+   if (cache)
+      util_compress_dict_destroy(cache->compress_dict);
+
    ralloc_free(cache);
 }
 
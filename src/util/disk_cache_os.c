@@ -100,6 +100,7 @@ disk_cache_get_function_identifier(void *ptr, blake3_hasher *ctx)
 
 #include "util/blob.h"
 #include "util/crc32.h"
+#include "util/os_file.h"
 #include "util/u_debug.h"
 #include "util/ralloc.h"
 #include "util/rand_xor.h"
@@ -588,10 +589,11 @@ parse_and_validate_cache_item(struct disk_cache *cache, void *cache_item,
          goto fail;
    }
 
-   /* Load the CRC that was created when the file was written. */
-   struct cache_entry_file_data *cf_data =
-      (struct cache_entry_file_data *)
-         blob_read_bytes(&ci_blob_reader, sizeof(struct cache_entry_file_data));
+   /* Load the CRC that was created when the file was written. It's copied
+    * out as items mapped from a foz db have no particular alignment.
+    */
+   struct cache_entry_file_data cf_data;
+   blob_copy_bytes(&ci_blob_reader, &cf_data, sizeof(cf_data));
    if (ci_blob_reader.overrun)
       goto fail;
 
@@ -599,27 +601,28 @@ parse_and_validate_cache_item(struct disk_cache *cache, void *cache_item,
    const uint8_t *data = (uint8_t *) blob_read_bytes(&ci_blob_reader, cache_data_size);
 
    /* Check the data for corruption */
-   if (cf_data->crc32 != util_hash_crc32(data, cache_data_size))
+   if (cf_data.crc32 != util_hash_crc32(data, cache_data_size))
       goto fail;
 
    /* Uncompress the cache data */
-   uncompressed_data = malloc(cf_data->uncompressed_size);
+   uncompressed_data = malloc(cf_data.uncompressed_size);
    if (!uncompressed_data)
       goto fail;
 
    if (cache->compression_disabled) {
-      if (cf_data->uncompressed_size != cache_data_size)
+      if (cf_data.uncompressed_size != cache_data_size)
          goto fail;
 
       memcpy(uncompressed_data, data, cache_data_size);
    } else {
-      if (!util_compress_inflate(data, cache_data_size, uncompressed_data,
-                                 cf_data->uncompressed_size))
+      if (!util_compress_inflate_dict(cache->compress_dict, data,
+                                      cache_data_size, uncompressed_data,
+                                      cf_data.uncompressed_size))
          goto fail;
    }
 
    if (size)
-      *size = cf_data->uncompressed_size;
+      *size = cf_data.uncompressed_size;
 
    return uncompressed_data;
 
@@ -710,8 +713,9 @@ create_cache_item_header_and_blob(struct disk_cache_put_job *dc_job,
       if (compressed_data == NULL)
          return false;
       compressed_size =
-         util_compress_deflate(dc_job->data, dc_job->size,
-                              compressed_data, max_buf);
+         util_compress_deflate_dict(dc_job->cache->compress_dict,
+                                    dc_job->data, dc_job->size,
+                                    compressed_data, max_buf);
       if (compressed_size == 0)
          goto fail;
    }
@@ -1044,13 +1048,16 @@ disk_cache_load_item_foz(struct disk_cache *cache, const cache_key key,
                          size_t *size)
 {
    size_t cache_tem_size = 0;
-   void *cache_item = foz_read_entry(&cache->foz_db, key, &cache_tem_size);
+   bool mapped;
+   void *cache_item = foz_read_entry_mapped(&cache->foz_db, key,
+                                            &cache_tem_size, &mapped);
    if (!cache_item)
       return NULL;
 
    uint8_t *uncompressed_data =
        parse_and_validate_cache_item(cache, cache_item, cache_tem_size, size);
-   free(cache_item);
+   if (!mapped)
+      free(cache_item);
 
    return uncompressed_data;
 }
@@ -1101,6 +1108,27 @@ disk_cache_touch_cache_user_marker(char *path)
    free(marker_path);
 }
 
+void
+disk_cache_load_compress_dict(void *mem_ctx, struct disk_cache *cache)
+{
+   if (cache->compression_disabled ||
+       !debug_get_bool_option("MESA_SHADER_CACHE_COMPRESS_DICT", true))
+      return;
+
+   char *path = ralloc_asprintf(mem_ctx, "%s/%s", cache->path,
+                                DISK_CACHE_COMPRESS_DICT_FILENAME);
+   if (!path)
+      return;
+
+   size_t size;
+   char *data = os_read_file(path, &size);
+   if (!data)
+      return;
+
+   cache->compress_dict = util_compress_dict_create(data, size);
+   free(data);
+}
+
 bool
 disk_cache_mmap_cache_index(void *mem_ctx, struct disk_cache *cache)
 {
@@ -1200,27 +1228,135 @@ disk_cache_db_load_item(struct disk_cache *cache, const cache_key key,
    return uncompressed_data;
 }
 
+struct disk_cache_db_batch_entry {
+   cache_key key;
+   struct blob blob;
+};
+
+/* Write out everything queued for the group commit. Called with the batch
+ * lock held, which is dropped while writing so that the other queue threads
+ * can keep preparing and queueing entries meanwhile.
+ */
+static void
+disk_cache_db_commit_pending(struct disk_cache *cache)
+{
+   while (cache->db_batch.pending.size) {
+      struct util_dynarray batch = cache->db_batch.pending;
+      util_dynarray_init(&cache->db_batch.pending, NULL);
+
+      simple_mtx_unlock(&cache->db_batch.lock);
+
+      unsigned num_entries =
+         util_dynarray_num_elements(&batch, struct disk_cache_db_batch_entry);
+      struct mesa_cache_db_entry *entries =
+         malloc(num_entries * sizeof(*entries));
+
+      if (entries) {
+         unsigned i = 0;
+
+         util_dynarray_foreach(&batch, struct disk_cache_db_batch_entry, entry) {
+            entries[i].key = entry->key;
+            entries[i].blob = entry->blob.data;
+            entries[i].blob_size = entry->blob.size;
+            i++;
+         }
+
+         if (mesa_cache_db_multipart_entries_write(&cache->cache_db, entries,
+                                                   num_entries) &&
+             unlikely(cache->stats.enabled)) {
+            p_atomic_add(&cache->stats.writes, num_entries);
+            p_atomic_inc(&cache->stats.write_batches);
+         }
+
+         free(entries);
+      }
+
+      util_dynarray_foreach(&batch, struct disk_cache_db_batch_entry, entry)
+         blob_finish(&entry->blob);
+      util_dynarray_fini(&batch);
+
+      simple_mtx_lock(&cache->db_batch.lock);
+   }
+}
+
 bool
 disk_cache_db_write_item_to_disk(struct disk_cache_put_job *dc_job)
 {
+   struct disk_cache *cache = dc_job->cache;
    struct blob cache_blob;
    blob_init(&cache_blob);
 
+   /* Compression happens here, in parallel on all the queue threads */
    if (!create_cache_item_header_and_blob(dc_job, &cache_blob))
       return false;
 
-   bool r = mesa_cache_db_multipart_entry_write(&dc_job->cache->cache_db,
-                                                dc_job->key, cache_blob.data,
-                                                cache_blob.size);
+   if (!cache->db_batch.enabled) {
+      bool r = mesa_cache_db_multipart_entry_write(&cache->cache_db,
+                                                   dc_job->key, cache_blob.data,
+                                                   cache_blob.size);
 
-   blob_finish(&cache_blob);
-   return r;
+      if (r && unlikely(cache->stats.enabled)) {
+         p_atomic_inc(&cache->stats.writes);
+         p_atomic_inc(&cache->stats.write_batches);
+      }
+
+      blob_finish(&cache_blob);
+      return r;
+   }
+
+   simple_mtx_lock(&cache->db_batch.lock);
+
+   struct disk_cache_db_batch_entry *entry =
+      util_dynarray_grow(&cache->db_batch.pending,
+                         struct disk_cache_db_batch_entry, 1);
+   if (!entry) {
+      simple_mtx_unlock(&cache->db_batch.lock);
+      blob_finish(&cache_blob);
+      return false;
+   }
+
+   memcpy(entry->key, dc_job->key, sizeof(cache_key));
+   entry->blob = cache_blob;
+
+   /* The first thread to queue an entry commits the batch, the entries
+    * queued by other threads meanwhile are picked up by the same commit.
+    * The committing thread is a queue job itself, hence
+    * disk_cache_wait_for_idle() still waits for everything to be written.
+    */
+   if (!cache->db_batch.committing) {
+      cache->db_batch.committing = true;
+      disk_cache_db_commit_pending(cache);
+      cache->db_batch.committing = false;
+   }
+
+   simple_mtx_unlock(&cache->db_batch.lock);
+
+   return true;
 }
 
 bool
 disk_cache_db_load_cache_index(void *mem_ctx, struct disk_cache *cache)
 {
-   return mesa_cache_db_multipart_open(&cache->cache_db, cache->path);
+   if (!mesa_cache_db_multipart_open(&cache->cache_db, cache->path))
+      return false;
+
+   cache->db_batch.enabled =
+      debug_get_bool_option("MESA_DISK_CACHE_DATABASE_GROUP_COMMIT", true);
+   simple_mtx_init(&cache->db_batch.lock, mtx_plain);
+   util_dynarray_init(&cache->db_batch.pending, NULL);
+
+   return true;
+}
+
+void
+disk_cache_db_close(struct disk_cache *cache)
+{
+   assert(!cache->db_batch.pending.size);
+
+   util_dynarray_fini(&cache->db_batch.pending);
+   simple_mtx_destroy(&cache->db_batch.lock);
+
+   mesa_cache_db_multipart_close(&cache->cache_db);
 }
 
 static void
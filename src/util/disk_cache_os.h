@@ -36,11 +36,16 @@
 #include "util/fossilize_db.h"
 #include "util/mesa_cache_db.h"
 #include "util/mesa_cache_db_multipart.h"
+#include "util/simple_mtx.h"
+#include "util/u_dynarray.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Compression dictionary file, see src/tool/shader-cache. */
+#define DISK_CACHE_COMPRESS_DICT_FILENAME "zstd_dict"
+
 /* Number of bits to mask off from a cache key to get an index. */
 #define CACHE_INDEX_KEY_BITS 16
 
@@ -69,6 +74,17 @@ struct disk_cache {
 
    struct mesa_cache_db_multipart cache_db;
 
+   /* Group commit of the database writes: entries prepared by the queue
+    * threads are collected in pending and written by a single committing
+    * thread at once.
+    */
+   struct {
+      bool enabled;
+      bool committing;
+      simple_mtx_t lock;
+      struct util_dynarray pending;
+   } db_batch;
+
    enum disk_cache_type type;
 
    /* Seed for rand, which is used to pick a random directory */
@@ -97,10 +113,17 @@ struct disk_cache {
    /* Don't compress cached data. This is for testing purposes only. */
    bool compression_disabled;
 
+   /* Optional trained dictionary used to compress the cache entries, loaded
+    * from DISK_CACHE_COMPRESS_DICT_FILENAME in the cache directory.
+    */
+   struct util_compress_dict *compress_dict;
+
    struct {
       bool enabled;
       unsigned hits;
       unsigned misses;
+      unsigned writes;
+      unsigned write_batches;
    } stats;
 
    /* Internal RO FOZ cache for combined use of RO and RW caches. */
@@ -167,6 +190,9 @@ disk_cache_load_cache_index_foz(void *mem_ctx, struct disk_cache *cache);
 void
 disk_cache_touch_cache_user_marker(char *path);
 
+void
+disk_cache_load_compress_dict(void *mem_ctx, struct disk_cache *cache);
+
 bool
 disk_cache_mmap_cache_index(void *mem_ctx, struct disk_cache *cache);
 
@@ -183,6 +209,9 @@ disk_cache_db_write_item_to_disk(struct disk_cache_put_job *dc_job);
 bool
 disk_cache_db_load_cache_index(void *mem_ctx, struct disk_cache *cache);
 
+void
+disk_cache_db_close(struct disk_cache *cache);
+
 void
 disk_cache_delete_old_cache(void);
 
@@ -33,10 +33,12 @@
 #ifdef FOZ_DB_UTIL
 
 #include <assert.h>
+#include <fcntl.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -61,6 +63,40 @@ static const uint8_t stream_reference_magic_and_version[FOZ_REF_MAGIC_SIZE] = {
    0, 0, 0, FOSSILIZE_FORMAT_VERSION, /* 4 bytes to use for versioning. */
 };
 
+/* Read-only foz dbs can come with a "<name>_idx.foz.sorted" sidecar, holding
+ * their index entries sorted by hash. It's mapped as is, which avoids parsing
+ * the whole index when opening large precompiled caches. The sidecar is
+ * created at the first load if the cache directory is writable. Like the
+ * hash table filled by update_foz_index(), it holds one entry per 64bit hash,
+ * the last one in the index.
+ */
+#define FOZ_SORTED_INDEX_MAGIC "MESAFZSI"
+#define FOZ_SORTED_INDEX_VERSION 2
+#define FOZ_SORTED_INDEX_KEY_SIZE (FOSSILIZE_BLOB_HASH_LENGTH / 2)
+
+struct foz_sorted_index_header {
+   char magic[8];
+   uint32_t version;
+   uint32_t entry_size;
+   uint64_t num_entries;
+
+   /* The foz db files the index was built from */
+   uint64_t db_size;
+   uint64_t idx_size;
+   int64_t idx_mtime_sec;
+   int64_t idx_mtime_nsec;
+};
+
+struct foz_sorted_index_entry {
+   uint64_t hash;
+   uint64_t offset;
+   uint8_t key[FOZ_SORTED_INDEX_KEY_SIZE];
+   uint8_t pad[4];
+};
+
+static_assert(sizeof(struct foz_sorted_index_header) % 8 == 0, "");
+static_assert(sizeof(struct foz_sorted_index_entry) == 40, "");
+
 /* Mesa uses 160bit hashes to identify cache entries, a hash of this size
  * makes collisions virtually impossible for our use case. However the foz db
  * format uses a 64bit hash table to lookup file offsets for reading cache
@@ -208,6 +244,310 @@ static int lock_file_with_timeout(FILE *f, int64_t timeout)
    return err;
 }
 
+static bool
+foz_magic_valid(const uint8_t *magic)
+{
+   if (memcmp(magic, stream_reference_magic_and_version,
+              FOZ_REF_MAGIC_SIZE - 1))
+      return false;
+
+   int version = magic[FOZ_REF_MAGIC_SIZE - 1];
+   return version <= FOSSILIZE_FORMAT_VERSION &&
+          version >= FOSSILIZE_FORMAT_MIN_COMPAT_VERSION;
+}
+
+static int
+sorted_index_entry_compare(const void *_a, const void *_b)
+{
+   const struct foz_sorted_index_entry *a = _a;
+   const struct foz_sorted_index_entry *b = _b;
+
+   if (a->hash != b->hash)
+      return a->hash < b->hash ? -1 : 1;
+
+   return a->offset < b->offset ? -1 : a->offset > b->offset;
+}
+
+static bool
+sorted_index_header_valid(const struct foz_sorted_index_header *header,
+                          const struct stat *db_stat,
+                          const struct stat *idx_stat)
+{
+   return !memcmp(header->magic, FOZ_SORTED_INDEX_MAGIC,
+                  sizeof(header->magic)) &&
+          header->version == FOZ_SORTED_INDEX_VERSION &&
+          header->entry_size == sizeof(struct foz_sorted_index_entry) &&
+          header->db_size == db_stat->st_size &&
+          header->idx_size == idx_stat->st_size &&
+          header->idx_mtime_sec == idx_stat->st_mtim.tv_sec &&
+          header->idx_mtime_nsec == idx_stat->st_mtim.tv_nsec;
+}
+
+static bool
+load_sorted_index(struct foz_db_map *map, const char *filename,
+                  const struct stat *db_stat, const struct stat *idx_stat)
+{
+   const struct foz_sorted_index_header *header;
+   struct stat st;
+   void *index_map;
+
+   int fd = open(filename, O_RDONLY | O_CLOEXEC);
+   if (fd == -1)
+      return false;
+
+   if (fstat(fd, &st) == -1 || st.st_size < sizeof(*header)) {
+      close(fd);
+      return false;
+   }
+
+   index_map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+
+   if (index_map == MAP_FAILED)
+      return false;
+
+   header = index_map;
+   if (!sorted_index_header_valid(header, db_stat, idx_stat) ||
+       st.st_size != sizeof(*header) +
+                     header->num_entries * sizeof(*map->entries)) {
+      munmap(index_map, st.st_size);
+      return false;
+   }
+
+   map->entries = (const void *)(header + 1);
+   map->num_entries = header->num_entries;
+   map->index_map = index_map;
+   map->index_map_size = st.st_size;
+
+   return true;
+}
+
+/* Parses the whole foz db index and sorts its entries by hash */
+static bool
+build_sorted_index(struct foz_db_map *map, FILE *db_idx,
+                   const struct stat *idx_stat)
+{
+   size_t len = idx_stat->st_size;
+   uint64_t num_entries = 0;
+
+   const uint8_t *idx = mmap(NULL, len, PROT_READ, MAP_PRIVATE,
+                             fileno(db_idx), 0);
+   if (idx == MAP_FAILED)
+      return false;
+
+   const size_t record_size = FOSSILIZE_BLOB_HASH_LENGTH +
+                              sizeof(struct foz_payload_header) +
+                              sizeof(uint64_t);
+   struct foz_sorted_index_entry *entries =
+      malloc(MAX2((len - FOZ_REF_MAGIC_SIZE) / record_size, 1) *
+             sizeof(*entries));
+   if (!entries || !foz_magic_valid(idx)) {
+      free(entries);
+      munmap((void *)idx, len);
+      return false;
+   }
+
+   /* Same as update_foz_index(), stop at the first incomplete entry */
+   for (size_t offset = FOZ_REF_MAGIC_SIZE; offset + record_size <= len;
+        offset += record_size) {
+      struct foz_payload_header header;
+      memcpy(&header, idx + offset + FOSSILIZE_BLOB_HASH_LENGTH,
+             sizeof(header));
+      if (header.payload_size != sizeof(uint64_t))
+         break;
+
+      char hash_str[BLAKE3_HEX_LEN] = {0};
+      memcpy(hash_str, idx + offset, FOSSILIZE_BLOB_HASH_LENGTH);
+      memset(hash_str + FOSSILIZE_BLOB_HASH_LENGTH, '0',
+             BLAKE3_HEX_LEN - 1 - FOSSILIZE_BLOB_HASH_LENGTH);
+
+      uint8_t key[BLAKE3_KEY_LEN];
+      _mesa_blake3_hex_to_blake3(key, hash_str);
+
+      struct foz_sorted_index_entry *entry = &entries[num_entries++];
+      memset(entry, 0, sizeof(*entry));
+      memcpy(entry->key, key, sizeof(entry->key));
+      memcpy(&entry->offset, idx + offset + record_size - sizeof(uint64_t),
+             sizeof(entry->offset));
+      entry->hash = truncate_hash_to_64bits(key);
+   }
+
+   munmap((void *)idx, len);
+
+   qsort(entries, num_entries, sizeof(*entries), sorted_index_entry_compare);
+
+   /* Keep the last entry of each hash, as inserting into the hash table
+    * does. The db is append only, so it also has the highest offset.
+    */
+   uint64_t num_unique = 0;
+   for (uint64_t i = 0; i < num_entries; i++) {
+      if (i + 1 < num_entries && entries[i + 1].hash == entries[i].hash)
+         continue;
+      entries[num_unique++] = entries[i];
+   }
+   num_entries = num_unique;
+
+   map->entries = entries;
+   map->num_entries = num_entries;
+
+   return true;
+}
+
+static void
+write_sorted_index(const struct foz_db_map *map, const char *filename,
+                   const struct stat *db_stat, const struct stat *idx_stat)
+{
+   struct foz_sorted_index_header header = {
+      .magic = FOZ_SORTED_INDEX_MAGIC,
+      .version = FOZ_SORTED_INDEX_VERSION,
+      .entry_size = sizeof(struct foz_sorted_index_entry),
+      .num_entries = map->num_entries,
+      .db_size = db_stat->st_size,
+      .idx_size = idx_stat->st_size,
+      .idx_mtime_sec = idx_stat->st_mtim.tv_sec,
+      .idx_mtime_nsec = idx_stat->st_mtim.tv_nsec,
+   };
+   char *tmp_filename = NULL;
+
+   if (asprintf(&tmp_filename, "%s.%d.tmp", filename, getpid()) == -1)
+      return;
+
+   /* Write to a temporary file first, so that concurrent loads never map a
+    * partially written index.
+    */
+   FILE *file = fopen(tmp_filename, "wbx");
+   if (!file) {
+      free(tmp_filename);
+      return;
+   }
+
+   size_t entries_size = map->num_entries * sizeof(*map->entries);
+   bool written =
+      fwrite(&header, 1, sizeof(header), file) == sizeof(header) &&
+      fwrite(map->entries, 1, entries_size, file) == entries_size;
+
+   if (fclose(file) || !written || rename(tmp_filename, filename))
+      unlink(tmp_filename);
+
+   free(tmp_filename);
+}
+
+/* Maps a read-only foz db along with its sorted index, building the index if
+ * the sidecar is missing or stale. Returns false if the db can't be mapped,
+ * the caller then loads it through the hash table.
+ */
+static bool
+load_foz_db_mapped(struct foz_db *foz_db, FILE *db_idx,
+                   const char *idx_filename, uint8_t file_idx)
+{
+   struct foz_db_map map = {0};
+   struct stat db_stat, idx_stat;
+   char *sorted_filename = NULL;
+
+   if (fstat(fileno(foz_db->file[file_idx]), &db_stat) == -1 ||
+       fstat(fileno(db_idx), &idx_stat) == -1)
+      return false;
+
+   /* Empty dbs are handled by load_foz_dbs() */
+   if (db_stat.st_size < FOZ_REF_MAGIC_SIZE ||
+       idx_stat.st_size < FOZ_REF_MAGIC_SIZE ||
+       db_stat.st_size > SIZE_MAX)
+      return false;
+
+   map.data_size = db_stat.st_size;
+   map.data = mmap(NULL, map.data_size, PROT_READ, MAP_SHARED,
+                   fileno(foz_db->file[file_idx]), 0);
+   if (map.data == MAP_FAILED)
+      return false;
+
+   if (!foz_magic_valid(map.data) ||
+       asprintf(&sorted_filename, "%s.sorted", idx_filename) == -1)
+      goto fail;
+
+   if (!load_sorted_index(&map, sorted_filename, &db_stat, &idx_stat)) {
+      if (!build_sorted_index(&map, db_idx, &idx_stat))
+         goto fail;
+
+      write_sorted_index(&map, sorted_filename, &db_stat, &idx_stat);
+   }
+
+   free(sorted_filename);
+
+   simple_mtx_lock(&foz_db->mtx);
+   foz_db->map[file_idx] = map;
+   simple_mtx_unlock(&foz_db->mtx);
+
+   foz_db->alive = true;
+   return true;
+
+fail:
+   free(sorted_filename);
+   munmap((void *)map.data, map.data_size);
+   return false;
+}
+
+static void
+unmap_foz_db(struct foz_db_map *map)
+{
+   if (!map->data)
+      return;
+
+   munmap((void *)map->data, map->data_size);
+
+   if (map->index_map)
+      munmap(map->index_map, map->index_map_size);
+   else
+      free((void *)map->entries);
+
+   memset(map, 0, sizeof(*map));
+}
+
+static const struct foz_sorted_index_entry *
+search_sorted_index(const struct foz_db_map *map, uint64_t hash)
+{
+   uint64_t lo = 0, hi = map->num_entries;
+
+   while (lo < hi) {
+      uint64_t mid = lo + (hi - lo) / 2;
+      if (map->entries[mid].hash < hash)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+
+   if (lo < map->num_entries && map->entries[lo].hash == hash)
+      return &map->entries[lo];
+
+   return NULL;
+}
+
+/* Returns a pointer to the payload of the entry within the mapping */
+static void *
+read_mapped_entry(const struct foz_db_map *map, uint64_t offset, size_t *size)
+{
+   struct foz_payload_header header;
+
+   if (offset > map->data_size ||
+       map->data_size - offset < sizeof(header))
+      return NULL;
+
+   memcpy(&header, map->data + offset, sizeof(header));
+   offset += sizeof(header);
+
+   if (header.payload_size > map->data_size - offset)
+      return NULL;
+
+   const uint8_t *data = map->data + offset;
+
+   /* verify checksum */
+   if (header.crc != 0 &&
+       util_hash_crc32(data, header.payload_size) != header.crc)
+      return NULL;
+
+   *size = header.payload_size;
+   return (void *)data;
+}
+
 static bool
 load_foz_dbs(struct foz_db *foz_db, FILE *db_idx, uint8_t file_idx,
              bool read_only)
@@ -236,13 +576,7 @@ load_foz_dbs(struct foz_db *foz_db, FILE *db_idx, uint8_t file_idx,
       if (fread(magic, 1, FOZ_REF_MAGIC_SIZE, db_idx) != FOZ_REF_MAGIC_SIZE)
          goto fail;
 
-      if (memcmp(magic, stream_reference_magic_and_version,
-                 FOZ_REF_MAGIC_SIZE - 1))
-         goto fail;
-
-      int version = magic[FOZ_REF_MAGIC_SIZE - 1];
-      if (version > FOSSILIZE_FORMAT_VERSION ||
-          version < FOSSILIZE_FORMAT_MIN_COMPAT_VERSION)
+      if (!foz_magic_valid(magic))
          goto fail;
 
    } else {
@@ -307,24 +641,27 @@ load_foz_dbs_ro(struct foz_db *foz_db, const char *foz_dbs_ro)
       FILE *db_idx = fopen(idx_filename, "rb");
 
       free(filename);
-      free(idx_filename);
 
       if (!check_files_opened_successfully(foz_db->file[file_idx], db_idx)) {
          /* Prevent foz_destroy from destroying it a second time. */
          foz_db->file[file_idx] = NULL;
+         free(idx_filename);
 
          continue; /* Ignore invalid user provided filename and continue */
       }
 
-      if (!load_foz_dbs(foz_db, db_idx, file_idx, true)) {
+      if (!load_foz_db_mapped(foz_db, db_idx, idx_filename, file_idx) &&
+          !load_foz_dbs(foz_db, db_idx, file_idx, true)) {
          fclose(db_idx);
          fclose(foz_db->file[file_idx]);
          foz_db->file[file_idx] = NULL;
+         free(idx_filename);
 
          continue; /* Ignore invalid user provided foz db */
       }
 
       fclose(db_idx);
+      free(idx_filename);
       file_idx++;
 
       if (file_idx >= FOZ_MAX_DBS)
@@ -392,14 +729,16 @@ load_from_list_file(struct foz_db *foz_db, const char *foz_dbs_list_filename)
       idx_file = fopen(idx_filename, "rb");
 
       free(db_filename);
-      free(idx_filename);
 
-      if (!check_files_opened_successfully(db_file, idx_file))
+      if (!check_files_opened_successfully(db_file, idx_file)) {
+         free(idx_filename);
          continue;
+      }
 
       if (check_file_already_loaded(foz_db, db_file, file_idx)) {
          fclose(db_file);
          fclose(idx_file);
+         free(idx_filename);
 
          continue;
       }
@@ -407,15 +746,18 @@ load_from_list_file(struct foz_db *foz_db, const char *foz_dbs_list_filename)
       /* Must be set before calling load_foz_dbs() */
       foz_db->file[file_idx] = db_file;
 
-      if (!load_foz_dbs(foz_db, idx_file, file_idx, true)) {
+      if (!load_foz_db_mapped(foz_db, idx_file, idx_filename, file_idx) &&
+          !load_foz_dbs(foz_db, idx_file, file_idx, true)) {
          fclose(db_file);
          fclose(idx_file);
          foz_db->file[file_idx] = NULL;
+         free(idx_filename);
 
          continue;
       }
 
       fclose(idx_file);
+      free(idx_filename);
       file_idx++;
 
       if (file_idx >= FOZ_MAX_DBS)
@@ -567,6 +909,7 @@ foz_destroy(struct foz_db *foz_db)
    if (foz_db->db_idx)
       fclose(foz_db->db_idx);
    for (unsigned i = 0; i < FOZ_MAX_DBS; i++) {
+      unmap_foz_db(&foz_db->map[i]);
       if (foz_db->file[i])
          fclose(foz_db->file[i]);
    }
@@ -581,17 +924,22 @@ foz_destroy(struct foz_db *foz_db)
    memset(foz_db, 0, sizeof(*foz_db));
 }
 
-/* Here we lookup a cache entry in the index hash table. If an entry is found
- * we use the retrieved offset to read the cache entry from disk.
+/* Here we lookup a cache entry in the index hash table and the sorted
+ * indices of the mapped dbs. If an entry is found in a mapped db, a pointer
+ * to its payload is returned and *mapped is set, the pointer stays valid
+ * until foz_destroy(). Otherwise we use the retrieved offset to read the cache
+ * entry from disk into memory the caller has to free.
  */
 void *
-foz_read_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
-               size_t *size)
+foz_read_entry_mapped(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
+                      size_t *size, bool *mapped)
 {
    uint64_t hash = truncate_hash_to_64bits(cache_key_160bit);
 
    void *data = NULL;
 
+   *mapped = false;
+
    if (!foz_db->alive)
       return NULL;
 
@@ -604,6 +952,41 @@ foz_read_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
       entry = _mesa_hash_table_u64_search(foz_db->index_db, hash);
    }
    if (!entry) {
+      /* Like the hash table, let the most recently loaded db win */
+      for (unsigned i = FOZ_MAX_DBS; i-- > 0;) {
+         const struct foz_sorted_index_entry *sorted_entry;
+         size_t data_sz;
+
+         if (!foz_db->map[i].data)
+            continue;
+
+         sorted_entry = search_sorted_index(&foz_db->map[i], hash);
+         if (!sorted_entry)
+            continue;
+
+         /* An entry with the same 64bit hash but another key shadows the
+          * older dbs, as it does in the hash table.
+          */
+         if (memcmp(sorted_entry->key, cache_key_160bit,
+                    FOZ_SORTED_INDEX_KEY_SIZE)) {
+            simple_mtx_unlock(&foz_db->mtx);
+            return NULL;
+         }
+
+         /* Mapped dbs stay until foz_destroy(), no need to hold the lock */
+         struct foz_db_map map = foz_db->map[i];
+         simple_mtx_unlock(&foz_db->mtx);
+
+         data = read_mapped_entry(&map, sorted_entry->offset, &data_sz);
+         if (data) {
+            *mapped = true;
+            if (size)
+               *size = data_sz;
+         }
+
+         return data;
+      }
+
       simple_mtx_unlock(&foz_db->mtx);
       return NULL;
    }
@@ -652,6 +1035,33 @@ fail:
    return NULL;
 }
 
+void *
+foz_read_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
+               size_t *size)
+{
+   size_t data_sz;
+   bool mapped;
+
+   void *data = foz_read_entry_mapped(foz_db, cache_key_160bit, &data_sz,
+                                      &mapped);
+   if (!data || !mapped) {
+      if (data && size)
+         *size = data_sz;
+      return data;
+   }
+
+   void *copy = malloc(data_sz);
+   if (!copy)
+      return NULL;
+
+   memcpy(copy, data, data_sz);
+
+   if (size)
+      *size = data_sz;
+
+   return copy;
+}
+
 /* Here we write the cache entry to disk and store its offset in the index db.
  */
 bool
@@ -780,6 +1190,14 @@ foz_read_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
    return false;
 }
 
+void *
+foz_read_entry_mapped(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
+                      size_t *size, bool *mapped)
+{
+   *mapped = false;
+   return NULL;
+}
+
 bool
 foz_write_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
                 const void *blob, size_t size)
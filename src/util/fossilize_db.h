@@ -48,6 +48,10 @@
 #include "mesa-blake3.h"
 #include "simple_mtx.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /* Max number of DBs our implementation can read from at once */
 #define FOZ_MAX_DBS 9 /* Default DB + 8 Read only DBs */
 
@@ -77,6 +81,20 @@ struct foz_db_entry {
    struct foz_payload_header header;
 };
 
+/* Read-only foz db mapped into memory, along with its sorted index */
+struct foz_db_map {
+   const uint8_t *data;
+   size_t data_size;
+
+   /* One entry per 64bit hash sorted by hash, either mapped from the index
+    * sidecar file (index_map) or built at load time.
+    */
+   const struct foz_sorted_index_entry *entries;
+   uint64_t num_entries;
+   void *index_map;
+   size_t index_map_size;
+};
+
 struct foz_dbs_list_updater {
    int inotify_fd;
    int inotify_wd; /* watch descriptor */
@@ -91,6 +109,7 @@ struct foz_db {
    simple_mtx_t flock_mtx;           /* Mutex for flocking the file for writes */
    void *mem_ctx;
    struct hash_table_u64 *index_db;  /* Hash table of all foz db entries */
+   struct foz_db_map map[FOZ_MAX_DBS]; /* Mapped read-only foz dbs */
    bool alive;
    const char *cache_path;
    struct foz_dbs_list_updater updater;
@@ -106,8 +125,16 @@ void *
 foz_read_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
                size_t *size);
 
+void *
+foz_read_entry_mapped(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
+                      size_t *size, bool *mapped);
+
 bool
 foz_write_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
                 const void *blob, size_t size);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* FOSSILIZE_DB_H */
@@ -16,6 +16,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "crc32.h"
@@ -23,14 +25,21 @@
 #include "hash_table.h"
 #include "mesa-blake3.h"
 #include "mesa_cache_db.h"
+#include "os_file.h"
 #include "os_time.h"
 #include "ralloc.h"
+#include "u_atomic.h"
 #include "u_debug.h"
 #include "u_qsort.h"
 
 #define MESA_CACHE_DB_VERSION          1
 #define MESA_CACHE_DB_MAGIC            "MESA_DB"
 
+/* Minimum length of the read mappings; they are made larger than the
+ * file so that appended entries rarely force a remap.
+ */
+#define MESA_CACHE_DB_MIN_MAP_SIZE     (1 << 20)
+
 struct PACKED mesa_db_file_header {
    char magic[8];
    uint32_t version;
@@ -96,22 +105,65 @@ mesa_db_reopen_file(struct mesa_cache_db_file *db_file);
 static void
 mesa_db_close_file(struct mesa_cache_db_file *db_file);
 
+static void
+mesa_db_map_files(struct mesa_cache_db *db);
+
 static int
-mesa_db_flock(FILE *file, int op)
+mesa_db_flock_fd(int fd, int op)
 {
    int ret;
 
    do {
-      ret = flock(fileno(file), op);
+      ret = flock(fd, op);
    } while (ret < 0 && errno == EINTR);
 
    return ret;
 }
 
+static int
+mesa_db_flock(FILE *file, int op)
+{
+   return mesa_db_flock_fd(fileno(file), op);
+}
+
+/* flock() locks are owned by the open file description, which all threads
+ * share for the mapped files. The first mapped reader takes the shared lock
+ * on behalf of the others and the last one drops it.
+ */
+static bool
+mesa_db_mapped_read_lock(struct mesa_cache_db *db)
+{
+   bool ret = true;
+
+   simple_mtx_lock(&db->map_flock_mtx);
+
+   if (!db->map_readers &&
+       mesa_db_flock_fd(db->cache.map_fd, LOCK_SH) < 0)
+      ret = false;
+   else
+      db->map_readers++;
+
+   simple_mtx_unlock(&db->map_flock_mtx);
+
+   return ret;
+}
+
+static void
+mesa_db_mapped_read_unlock(struct mesa_cache_db *db)
+{
+   simple_mtx_lock(&db->map_flock_mtx);
+
+   if (!--db->map_readers)
+      mesa_db_flock_fd(db->cache.map_fd, LOCK_UN);
+
+   simple_mtx_unlock(&db->map_flock_mtx);
+}
+
 static bool
 mesa_db_lock(struct mesa_cache_db *db)
 {
    simple_mtx_lock(&db->flock_mtx);
+   u_rwlock_wrlock(&db->map_lock);
 
    if (!mesa_db_reopen_file(&db->index) ||
        !mesa_db_reopen_file(&db->cache))
@@ -131,6 +183,7 @@ close_files:
    mesa_db_close_file(&db->index);
    mesa_db_close_file(&db->cache);
 
+   u_rwlock_wrunlock(&db->map_lock);
    simple_mtx_unlock(&db->flock_mtx);
 
    return false;
@@ -145,6 +198,7 @@ mesa_db_unlock(struct mesa_cache_db *db)
    mesa_db_close_file(&db->index);
    mesa_db_close_file(&db->cache);
 
+   u_rwlock_wrunlock(&db->map_lock);
    simple_mtx_unlock(&db->flock_mtx);
 }
 
@@ -389,6 +443,8 @@ mesa_db_load(struct mesa_cache_db *db, bool reload)
          goto fail;
    }
 
+   mesa_db_map_files(db);
+
    if (!reload)
       mesa_db_unlock(db);
 
@@ -437,6 +493,7 @@ mesa_db_open_file(struct mesa_cache_db_file *db_file,
    if (asprintf(&db_file->path, "%s/%s", cache_path, filename) == -1)
       return false;
 
+   db_file->map_fd = -1;
    db_file->file = mesa_db_fopen(db_file->path);
    if (!db_file->file) {
       free(db_file->path);
@@ -477,6 +534,73 @@ mesa_db_free_file(struct mesa_cache_db_file *db_file)
    free(db_file->path);
 }
 
+static void
+mesa_db_unmap_file(struct mesa_cache_db_file *db_file)
+{
+   if (db_file->map)
+      munmap(db_file->map, db_file->map_size);
+
+   if (db_file->map_fd >= 0)
+      close(db_file->map_fd);
+
+   db_file->map_fd = -1;
+   db_file->map = NULL;
+   db_file->map_size = 0;
+   db_file->map_ino = 0;
+}
+
+/* (Re)map the file that is currently opened under the lock, unless the
+ * existing mapping already covers it. The mapping keeps its own file
+ * descriptor, so that it outlives the stdio stream closed on unlock.
+ */
+static bool
+mesa_db_map_file(struct mesa_cache_db_file *db_file, bool writable)
+{
+   struct stat st;
+   size_t map_size;
+   void *map;
+   int fd;
+
+   if (fstat(fileno(db_file->file), &st) < 0)
+      return false;
+
+   if (db_file->map && db_file->map_ino == st.st_ino &&
+       db_file->map_size >= st.st_size)
+      return true;
+
+   mesa_db_unmap_file(db_file);
+
+   fd = os_dupfd_cloexec(fileno(db_file->file));
+   if (fd < 0)
+      return false;
+
+   map_size = MAX2(st.st_size + st.st_size / 2, MESA_CACHE_DB_MIN_MAP_SIZE);
+   map = mmap(NULL, map_size, PROT_READ | (writable ? PROT_WRITE : 0),
+              MAP_SHARED, fd, 0);
+   if (map == MAP_FAILED) {
+      close(fd);
+      return false;
+   }
+
+   db_file->map_fd = fd;
+   db_file->map = map;
+   db_file->map_size = map_size;
+   db_file->map_ino = st.st_ino;
+
+   return true;
+}
+
+static void
+mesa_db_map_files(struct mesa_cache_db *db)
+{
+   /* The index mapping is written to update the entry access times */
+   if (!mesa_db_map_file(&db->cache, false) ||
+       !mesa_db_map_file(&db->index, true)) {
+      mesa_db_unmap_file(&db->cache);
+      mesa_db_unmap_file(&db->index);
+   }
+}
+
 static bool
 mesa_db_remove_file(struct mesa_cache_db_file *db_file,
                   const char *cache_path,
@@ -696,6 +820,8 @@ mesa_cache_db_open(struct mesa_cache_db *db, const char *cache_path)
       goto close_index;
 
    simple_mtx_init(&db->flock_mtx, mtx_plain);
+   u_rwlock_init(&db->map_lock);
+   simple_mtx_init(&db->map_flock_mtx, mtx_plain);
 
    db->index_db = _mesa_hash_table_u64_create(NULL);
    if (!db->index_db)
@@ -708,7 +834,11 @@ mesa_cache_db_open(struct mesa_cache_db *db, const char *cache_path)
 
 destroy_hash:
    _mesa_hash_table_u64_destroy(db->index_db);
+   mesa_db_unmap_file(&db->index);
+   mesa_db_unmap_file(&db->cache);
 destroy_mtx:
+   simple_mtx_destroy(&db->map_flock_mtx);
+   u_rwlock_destroy(&db->map_lock);
    simple_mtx_destroy(&db->flock_mtx);
 
    ralloc_free(db->mem_ctx);
@@ -740,9 +870,13 @@ void
 mesa_cache_db_close(struct mesa_cache_db *db)
 {
    _mesa_hash_table_u64_destroy(db->index_db);
+   simple_mtx_destroy(&db->map_flock_mtx);
+   u_rwlock_destroy(&db->map_lock);
    simple_mtx_destroy(&db->flock_mtx);
    ralloc_free(db->mem_ctx);
 
+   mesa_db_unmap_file(&db->index);
+   mesa_db_unmap_file(&db->cache);
    mesa_db_free_file(&db->index);
    mesa_db_free_file(&db->cache);
 }
@@ -760,6 +894,143 @@ mesa_cache_db_file_entry_size(void)
    return sizeof(struct mesa_cache_db_file_entry);
 }
 
+enum mesa_db_mapped_read {
+   MESA_DB_MAPPED_HIT,
+   MESA_DB_MAPPED_MISS,
+   MESA_DB_MAPPED_FALLBACK,
+};
+
+static bool
+mesa_db_mapped_uuid_valid(struct mesa_cache_db_file *db_file, uint64_t uuid)
+{
+   const struct mesa_db_file_header *header = db_file->map;
+
+   return !strncmp(header->magic, MESA_CACHE_DB_MAGIC, sizeof(header->magic)) &&
+          header->version == MESA_CACHE_DB_VERSION && header->uuid == uuid;
+}
+
+/* Look up an entry through the shared mappings of the database files.
+ *
+ * Concurrent readers of this process only take map_lock for reading and
+ * readers of all processes share a LOCK_SH flock() of the cache file, so
+ * lookups don't serialize against each other; writers still exclude them
+ * by taking LOCK_EX. The mappings are trusted only while the file headers
+ * carry the UUID of the loaded index and no other process has appended
+ * index entries that aren't loaded yet, otherwise the caller falls back
+ * to the locked path which reloads the index and remaps the files.
+ */
+static enum mesa_db_mapped_read
+mesa_db_read_entry_mapped(struct mesa_cache_db *db,
+                          const uint8_t *cache_key_160bit,
+                          void **data, size_t *size)
+{
+   uint64_t hash = to_mesa_cache_db_hash(cache_key_160bit);
+   enum mesa_db_mapped_read ret = MESA_DB_MAPPED_FALLBACK;
+   struct mesa_cache_db_file_entry cache_entry;
+   struct mesa_index_db_file_entry index_entry;
+   struct mesa_index_db_hash_entry *hash_entry;
+   struct stat cache_st, index_st;
+   uint64_t cache_end, index_end;
+   uint64_t access_time;
+   const uint8_t *blob;
+
+   *data = NULL;
+
+   u_rwlock_rdlock(&db->map_lock);
+
+   if (!db->alive || !db->cache.map || !db->index.map)
+      goto unlock;
+
+   /* The database files were replaced, e.g. wiped by another process */
+   if (stat(db->cache.path, &cache_st) < 0 ||
+       cache_st.st_ino != db->cache.map_ino)
+      goto unlock;
+
+   if (!mesa_db_mapped_read_lock(db))
+      goto unlock;
+
+   /* Access beyond the end of file would fault, check the sizes first */
+   if (fstat(db->cache.map_fd, &cache_st) < 0 ||
+       fstat(db->index.map_fd, &index_st) < 0 ||
+       cache_st.st_size < sizeof(struct mesa_db_file_header) ||
+       index_st.st_size != db->index.offset ||
+       index_st.st_size > db->index.map_size)
+      goto flock_unlock;
+
+   if (!mesa_db_mapped_uuid_valid(&db->cache, db->uuid) ||
+       !mesa_db_mapped_uuid_valid(&db->index, db->uuid))
+      goto flock_unlock;
+
+   hash_entry = _mesa_hash_table_u64_search(db->index_db, hash);
+   if (!hash_entry) {
+      ret = MESA_DB_MAPPED_MISS;
+      goto flock_unlock;
+   }
+
+   cache_end = hash_entry->cache_db_file_offset +
+               blob_file_size(hash_entry->size);
+   index_end = hash_entry->index_db_file_offset + sizeof(index_entry);
+
+   if (cache_end > cache_st.st_size || cache_end > db->cache.map_size ||
+       index_end > index_st.st_size)
+      goto flock_unlock;
+
+   blob = (const uint8_t *)db->cache.map + hash_entry->cache_db_file_offset;
+   memcpy(&cache_entry, blob, sizeof(cache_entry));
+
+   if (!mesa_db_cache_entry_valid(&cache_entry) ||
+       cache_entry.size != hash_entry->size)
+      goto flock_unlock;
+
+   if (memcmp(cache_entry.key, cache_key_160bit, sizeof(cache_entry.key))) {
+      ret = MESA_DB_MAPPED_MISS;
+      goto flock_unlock;
+   }
+
+   memcpy(&index_entry,
+          (uint8_t *)db->index.map + hash_entry->index_db_file_offset,
+          sizeof(index_entry));
+
+   if (!mesa_db_index_entry_valid(&index_entry) ||
+       index_entry.cache_db_file_offset != hash_entry->cache_db_file_offset ||
+       index_entry.size != hash_entry->size)
+      goto flock_unlock;
+
+   *data = malloc(cache_entry.size);
+   if (!*data) {
+      ret = MESA_DB_MAPPED_MISS;
+      goto flock_unlock;
+   }
+
+   memcpy(*data, blob + sizeof(cache_entry), cache_entry.size);
+
+   /* Let the locked path deal with the corruption */
+   if (util_hash_crc32(*data, cache_entry.size) != cache_entry.crc) {
+      free(*data);
+      *data = NULL;
+      goto flock_unlock;
+   }
+
+   /* Concurrent readers may race on the access time, any of the stores
+    * is good enough for the LRU eviction.
+    */
+   access_time = os_time_get_nano();
+   memcpy((uint8_t *)db->index.map + hash_entry->index_db_file_offset +
+          offsetof(struct mesa_index_db_file_entry, last_access_time),
+          &access_time, sizeof(access_time));
+   p_atomic_set(&hash_entry->last_access_time, access_time);
+
+   *size = cache_entry.size;
+   ret = MESA_DB_MAPPED_HIT;
+
+flock_unlock:
+   mesa_db_mapped_read_unlock(db);
+unlock:
+   u_rwlock_rdunlock(&db->map_lock);
+
+   return ret;
+}
+
 void *
 mesa_cache_db_read_entry(struct mesa_cache_db *db,
                          const uint8_t *cache_key_160bit,
@@ -771,6 +1042,15 @@ mesa_cache_db_read_entry(struct mesa_cache_db *db,
    struct mesa_index_db_hash_entry *hash_entry;
    void *data = NULL;
 
+   switch (mesa_db_read_entry_mapped(db, cache_key_160bit, &data, size)) {
+   case MESA_DB_MAPPED_HIT:
+      return data;
+   case MESA_DB_MAPPED_MISS:
+      return NULL;
+   case MESA_DB_MAPPED_FALLBACK:
+      break;
+   }
+
    if (!mesa_db_lock(db))
       return NULL;
 
@@ -783,6 +1063,9 @@ mesa_cache_db_read_entry(struct mesa_cache_db *db,
    if (!mesa_db_update_index(db))
       goto fail_fatal;
 
+   /* Let the following lookups take the mapped path */
+   mesa_db_map_files(db);
+
    hash_entry = _mesa_hash_table_u64_search(db->index_db, hash);
    if (!hash_entry)
       goto fail;
@@ -835,6 +1118,71 @@ fail:
    return NULL;
 }
 
+/**
+ * Calls cb for every entry of the database, without updating their access
+ * time. The database stays locked meanwhile, this is meant for tools
+ * inspecting an existing cache.
+ */
+bool
+mesa_cache_db_foreach_entry(struct mesa_cache_db *db,
+                            mesa_cache_db_entry_cb cb, void *data)
+{
+   struct mesa_cache_db_file_entry cache_entry;
+   void *blob = NULL;
+   size_t blob_size = 0;
+
+   if (!mesa_db_lock(db))
+      return false;
+
+   if (!db->alive)
+      goto fail;
+
+   if (mesa_db_uuid_changed(db) && !mesa_db_reload(db))
+      goto fail_fatal;
+
+   if (!mesa_db_update_index(db))
+      goto fail_fatal;
+
+   hash_table_u64_foreach(db->index_db, entry) {
+      struct mesa_index_db_hash_entry *hash_entry = entry.data;
+
+      if (!mesa_db_seek(db->cache.file, hash_entry->cache_db_file_offset) ||
+          !mesa_db_read(db->cache.file, &cache_entry) ||
+          !mesa_db_cache_entry_valid(&cache_entry))
+         goto fail_fatal;
+
+      if (cache_entry.size > blob_size) {
+         void *new_blob = realloc(blob, cache_entry.size);
+         if (!new_blob)
+            goto fail;
+
+         blob = new_blob;
+         blob_size = cache_entry.size;
+      }
+
+      if (!mesa_db_read_data(db->cache.file, blob, cache_entry.size) ||
+          util_hash_crc32(blob, cache_entry.size) != cache_entry.crc)
+         goto fail_fatal;
+
+      cb(data, cache_entry.key, blob, cache_entry.size);
+   }
+
+   free(blob);
+
+   mesa_db_unlock(db);
+
+   return true;
+
+fail_fatal:
+   mesa_db_zap(db);
+fail:
+   free(blob);
+
+   mesa_db_unlock(db);
+
+   return false;
+}
+
 static bool
 mesa_cache_db_has_space_locked(struct mesa_cache_db *db, size_t blob_size)
 {
@@ -848,16 +1196,74 @@ mesa_cache_db_eviction_size(struct mesa_cache_db *db)
    return db->max_cache_size / 2 - sizeof(struct mesa_db_file_header);
 }
 
-bool
-mesa_cache_db_entry_write(struct mesa_cache_db *db,
-                          const uint8_t *cache_key_160bit,
-                          const void *blob, size_t blob_size)
+/* Append an entry at the end of the files and add it to the index. The
+ * caller is responsible for flushing the files.
+ */
+static bool
+mesa_db_append_entry(struct mesa_cache_db *db, uint64_t hash,
+                     const uint8_t *cache_key_160bit,
+                     const void *blob, size_t blob_size,
+                     bool *fatal)
 {
-   uint64_t hash = to_mesa_cache_db_hash(cache_key_160bit);
-   struct mesa_index_db_hash_entry *hash_entry = NULL;
+   struct mesa_index_db_hash_entry *hash_entry;
    struct mesa_cache_db_file_entry cache_entry;
    struct mesa_index_db_file_entry index_entry;
 
+   memcpy(cache_entry.key, cache_key_160bit, sizeof(cache_entry.key));
+   cache_entry.crc = util_hash_crc32(blob, blob_size);
+   cache_entry.size = blob_size;
+
+   index_entry.hash = hash;
+   index_entry.size = blob_size;
+   index_entry.last_access_time = os_time_get_nano();
+   index_entry.cache_db_file_offset = ftell(db->cache.file);
+
+   hash_entry = ralloc(db->mem_ctx, struct mesa_index_db_hash_entry);
+   if (!hash_entry)
+      return false;
+
+   hash_entry->cache_db_file_offset = index_entry.cache_db_file_offset;
+   hash_entry->index_db_file_offset = ftell(db->index.file);
+   hash_entry->last_access_time = index_entry.last_access_time;
+   hash_entry->size = index_entry.size;
+
+   if (!mesa_db_write(db->cache.file, &cache_entry) ||
+       !mesa_db_write_data(db->cache.file, blob, blob_size) ||
+       !mesa_db_write(db->index.file, &index_entry)) {
+      ralloc_free(hash_entry);
+      *fatal = true;
+      return false;
+   }
+
+   _mesa_hash_table_u64_insert(db->index_db, hash, hash_entry);
+
+   return true;
+}
+
+/* Write a batch of entries with a single lock, space check and flush of
+ * the database files. Entries which are already present in the database
+ * are skipped.
+ */
+static bool
+mesa_db_entries_write(struct mesa_cache_db *db,
+                      const struct mesa_cache_db_entry *entries,
+                      unsigned num_entries, bool fail_on_existing)
+{
+   size_t total_size = 0;
+   bool fatal = false;
+   unsigned i;
+
+   if (!num_entries)
+      return true;
+
+   /* Sized like a single blob, for which the space checks account the
+    * file entry header of.
+    */
+   for (i = 0; i < num_entries; i++)
+      total_size += entries[i].blob_size;
+
+   total_size += (num_entries - 1) * sizeof(struct mesa_cache_db_file_entry);
+
    if (!mesa_db_lock(db))
       return false;
 
@@ -870,8 +1276,8 @@ mesa_cache_db_entry_write(struct mesa_cache_db *db,
    if (!mesa_db_seek_end(db->cache.file))
       goto fail_fatal;
 
-   if (!mesa_cache_db_has_space_locked(db, blob_size)) {
-      if (!mesa_db_compact(db, MAX2(blob_size, mesa_cache_db_eviction_size(db)),
+   if (!mesa_cache_db_has_space_locked(db, total_size)) {
+      if (!mesa_db_compact(db, MAX2(total_size, mesa_cache_db_eviction_size(db)),
                            NULL))
          goto fail_fatal;
    } else {
@@ -879,37 +1285,26 @@ mesa_cache_db_entry_write(struct mesa_cache_db *db,
          goto fail_fatal;
    }
 
-   hash_entry = _mesa_hash_table_u64_search(db->index_db, hash);
-   if (hash_entry) {
-      hash_entry = NULL;
-      goto fail;
-   }
-
    if (!mesa_db_seek_end(db->cache.file) ||
        !mesa_db_seek_end(db->index.file))
       goto fail_fatal;
 
-   memcpy(cache_entry.key, cache_key_160bit, sizeof(cache_entry.key));
-   cache_entry.crc = util_hash_crc32(blob, blob_size);
-   cache_entry.size = blob_size;
+   for (i = 0; i < num_entries; i++) {
+      uint64_t hash = to_mesa_cache_db_hash(entries[i].key);
 
-   index_entry.hash = hash;
-   index_entry.size = blob_size;
-   index_entry.last_access_time = os_time_get_nano();
-   index_entry.cache_db_file_offset = ftell(db->cache.file);
+      if (_mesa_hash_table_u64_search(db->index_db, hash)) {
+         if (fail_on_existing)
+            break;
 
-   hash_entry = ralloc(db->mem_ctx, struct mesa_index_db_hash_entry);
-   if (!hash_entry)
-      goto fail;
+         continue;
+      }
 
-   hash_entry->cache_db_file_offset = index_entry.cache_db_file_offset;
-   hash_entry->index_db_file_offset = ftell(db->index.file);
-   hash_entry->last_access_time = index_entry.last_access_time;
-   hash_entry->size = index_entry.size;
+      if (!mesa_db_append_entry(db, hash, entries[i].key, entries[i].blob,
+                                entries[i].blob_size, &fatal))
+         break;
+   }
 
-   if (!mesa_db_write(db->cache.file, &cache_entry) ||
-       !mesa_db_write_data(db->cache.file, blob, blob_size) ||
-       !mesa_db_write(db->index.file, &index_entry))
+   if (fatal)
       goto fail_fatal;
 
    fflush(db->cache.file);
@@ -917,22 +1312,40 @@ mesa_cache_db_entry_write(struct mesa_cache_db *db,
 
    db->index.offset = ftell(db->index.file);
 
-   _mesa_hash_table_u64_insert(db->index_db, hash, hash_entry);
-
    mesa_db_unlock(db);
 
-   return true;
+   return i == num_entries;
 
 fail_fatal:
    mesa_db_zap(db);
 fail:
    mesa_db_unlock(db);
 
-   ralloc_free(hash_entry);
-
    return false;
 }
 
+bool
+mesa_cache_db_entry_write(struct mesa_cache_db *db,
+                          const uint8_t *cache_key_160bit,
+                          const void *blob, size_t blob_size)
+{
+   struct mesa_cache_db_entry entry = {
+      .key = cache_key_160bit,
+      .blob = blob,
+      .blob_size = blob_size,
+   };
+
+   return mesa_db_entries_write(db, &entry, 1, true);
+}
+
+bool
+mesa_cache_db_entries_write(struct mesa_cache_db *db,
+                            const struct mesa_cache_db_entry *entries,
+                            unsigned num_entries)
+{
+   return mesa_db_entries_write(db, entries, num_entries, false);
+}
+
 bool
 mesa_cache_db_entry_remove(struct mesa_cache_db *db,
                            const uint8_t *cache_key_160bit)
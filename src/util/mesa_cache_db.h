@@ -15,6 +15,7 @@
 #include <stdio.h>
 
 #include "detect_os.h"
+#include "rwlock.h"
 #include "simple_mtx.h"
 
 #ifdef __cplusplus
@@ -26,6 +27,18 @@ struct mesa_cache_db_file {
    char *path;
    off_t offset;
    uint64_t uuid;
+
+   /* Persistent shared mapping used by the lock-light read path */
+   int map_fd;
+   void *map;
+   size_t map_size;
+   uint64_t map_ino;
+};
+
+struct mesa_cache_db_entry {
+   const uint8_t *key;
+   const void *blob;
+   size_t blob_size;
 };
 
 struct mesa_cache_db {
@@ -34,6 +47,13 @@ struct mesa_cache_db {
    struct mesa_cache_db_file index;
    uint64_t max_cache_size;
    simple_mtx_t flock_mtx;
+   /* Held for reading by mapped lookups, for writing together with
+    * flock_mtx by everything that changes index_db or the mappings.
+    */
+   struct u_rwlock map_lock;
+   /* flock() is shared by all threads, count the mapped readers holding it */
+   simple_mtx_t map_flock_mtx;
+   unsigned map_readers;
    void *mem_ctx;
    uint64_t uuid;
    bool alive;
@@ -63,10 +83,23 @@ mesa_cache_db_entry_write(struct mesa_cache_db *db,
                           const uint8_t *cache_key_160bit,
                           const void *blob, size_t blob_size);
 
+bool
+mesa_cache_db_entries_write(struct mesa_cache_db *db,
+                            const struct mesa_cache_db_entry *entries,
+                            unsigned num_entries);
+
 bool
 mesa_cache_db_entry_remove(struct mesa_cache_db *db,
                            const uint8_t *cache_key_160bit);
 
+typedef void (*mesa_cache_db_entry_cb)(void *data,
+                                       const uint8_t *cache_key_160bit,
+                                       const void *blob, size_t blob_size);
+
+bool
+mesa_cache_db_foreach_entry(struct mesa_cache_db *db,
+                            mesa_cache_db_entry_cb cb, void *data);
+
 bool
 mesa_db_wipe_path(const char *cache_path);
 
@@ -115,6 +148,14 @@ mesa_cache_db_entry_write(struct mesa_cache_db *db,
    return false;
 }
 
+static inline bool
+mesa_cache_db_entries_write(struct mesa_cache_db *db,
+                            const struct mesa_cache_db_entry *entries,
+                            unsigned num_entries)
+{
+   return false;
+}
+
 static inline bool
 mesa_cache_db_entry_remove(struct mesa_cache_db *db,
                            const uint8_t *cache_key_160bit)
@@ -122,6 +163,17 @@ mesa_cache_db_entry_remove(struct mesa_cache_db *db,
    return false;
 }
 
+typedef void (*mesa_cache_db_entry_cb)(void *data,
+                                       const uint8_t *cache_key_160bit,
+                                       const void *blob, size_t blob_size);
+
+static inline bool
+mesa_cache_db_foreach_entry(struct mesa_cache_db *db,
+                            mesa_cache_db_entry_cb cb, void *data)
+{
+   return false;
+}
+
 static inline bool
 mesa_db_wipe_path(const char *cache_path)
 {
@@ -168,10 +168,9 @@ mesa_cache_db_multipart_select_victim_part(struct mesa_cache_db_multipart *db)
    return victim;
 }
 
-bool
-mesa_cache_db_multipart_entry_write(struct mesa_cache_db_multipart *db,
-                                    const uint8_t *cache_key_160bit,
-                                    const void *blob, size_t blob_size)
+static int
+mesa_cache_db_multipart_select_write_part(struct mesa_cache_db_multipart *db,
+                                          size_t blob_size)
 {
    unsigned last_written_part = db->last_written_part;
    int wpart = -1;
@@ -197,14 +196,66 @@ mesa_cache_db_multipart_entry_write(struct mesa_cache_db_multipart *db,
       wpart = mesa_cache_db_multipart_select_victim_part(db);
 
    if (!mesa_cache_db_multipart_init_part(db, wpart))
-      return false;
+      return -1;
 
    db->last_written_part = wpart;
 
+   return wpart;
+}
+
+bool
+mesa_cache_db_multipart_entry_write(struct mesa_cache_db_multipart *db,
+                                    const uint8_t *cache_key_160bit,
+                                    const void *blob, size_t blob_size)
+{
+   int wpart = mesa_cache_db_multipart_select_write_part(db, blob_size);
+   if (wpart < 0)
+      return false;
+
    return mesa_cache_db_entry_write(db->parts[wpart], cache_key_160bit,
                                     blob, blob_size);
 }
 
+bool
+mesa_cache_db_multipart_entries_write(struct mesa_cache_db_multipart *db,
+                                      const struct mesa_cache_db_entry *entries,
+                                      unsigned num_entries)
+{
+   /* Split the batch into chunks of at most half a DB part, which is what
+    * the eviction of a full part frees, and pick the part for each chunk
+    * separately. A batch larger than a part would otherwise evict the
+    * whole part and overfill it, the chunks rather spread across the parts.
+    */
+   uint64_t max_chunk_size = db->max_cache_size / db->num_parts / 2;
+   bool ret = true;
+   unsigned start = 0;
+
+   while (start < num_entries) {
+      size_t chunk_size = entries[start].blob_size;
+      unsigned end = start + 1;
+
+      for (; end < num_entries; end++) {
+         size_t size = chunk_size + mesa_cache_db_file_entry_size() +
+                       entries[end].blob_size;
+
+         if (max_chunk_size && size > max_chunk_size)
+            break;
+
+         chunk_size = size;
+      }
+
+      int wpart = mesa_cache_db_multipart_select_write_part(db, chunk_size);
+      if (wpart < 0)
+         return false;
+
+      ret &= mesa_cache_db_entries_write(db->parts[wpart], &entries[start],
+                                         end - start);
+      start = end;
+   }
+
+   return ret;
+}
+
 void
 mesa_cache_db_multipart_entry_remove(struct mesa_cache_db_multipart *db,
                                      const uint8_t *cache_key_160bit)
@@ -10,6 +10,10 @@
 #include "mesa_cache_db.h"
 #include "simple_mtx.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 struct mesa_cache_db_multipart {
    struct mesa_cache_db **parts;
    unsigned int num_parts;
@@ -41,8 +45,17 @@ mesa_cache_db_multipart_entry_write(struct mesa_cache_db_multipart *db,
                                     const uint8_t *cache_key_160bit,
                                     const void *blob, size_t blob_size);
 
+bool
+mesa_cache_db_multipart_entries_write(struct mesa_cache_db_multipart *db,
+                                      const struct mesa_cache_db_entry *entries,
+                                      unsigned num_entries);
+
 void
 mesa_cache_db_multipart_entry_remove(struct mesa_cache_db_multipart *db,
                                      const uint8_t *cache_key_160bit);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* MESA_CACHE_DB_MULTIPART_H */
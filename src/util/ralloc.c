@@ -984,6 +984,41 @@ gc_sweep_end(gc_ctx *ctx)
    ctx->rubbish = NULL;
 }
 
+gc_ctx *
+gc_subcontext(gc_ctx *ctx)
+{
+   assert(!ctx->rubbish);
+
+   /* Not a ralloc child of ctx, so that creating and using it doesn't touch
+    * the parent context.
+    */
+   gc_ctx *sub = gc_context(NULL);
+   if (likely(sub))
+      sub->current_gen = ctx->current_gen;
+   return sub;
+}
+
+void
+gc_join_subcontext(gc_ctx *ctx, gc_ctx *sub)
+{
+   assert(!ctx->rubbish && !sub->rubbish);
+   assert(ctx->current_gen == sub->current_gen);
+
+   for (unsigned i = 0; i < NUM_FREELIST_BUCKETS; i++) {
+      list_for_each_entry(gc_slab, slab, &sub->slabs[i].slabs, link)
+         slab->ctx = ctx;
+
+      list_splicetail(&sub->slabs[i].slabs, &ctx->slabs[i].slabs);
+      list_splicetail(&sub->slabs[i].free_slabs, &ctx->slabs[i].free_slabs);
+   }
+
+   /* This takes the slabs and the allocations which are too large for them,
+    * whose context is their ralloc parent.
+    */
+   ralloc_adopt(ctx, sub);
+   ralloc_free(sub);
+}
+
 /***************************************************************************
  * Linear allocator for short-lived allocations.
  ***************************************************************************
@@ -522,6 +522,20 @@ void gc_sweep_start(gc_ctx *ctx);
 void gc_mark_live(gc_ctx *ctx, const void *mem);
 void gc_sweep_end(gc_ctx *ctx);
 
+/**
+ * GC contexts are not thread-safe.  To allocate from several threads, give
+ * each thread a sub-context from gc_subcontext() and hand them back with
+ * gc_join_subcontext() once the threads are done.  Joining moves everything
+ * allocated from the sub-context into the parent context and frees the
+ * sub-context itself.
+ *
+ * While a sub-context is in use, its thread may only free memory which was
+ * allocated from that sub-context, and the parent context must not be used
+ * or swept.
+ */
+gc_ctx *gc_subcontext(gc_ctx *ctx);
+void gc_join_subcontext(gc_ctx *ctx, gc_ctx *sub);
+
 /**
  * Declare C++ new and delete operators which use ralloc.
  *
@@ -38,6 +38,7 @@
 #include <unistd.h>
 #include <utime.h>
 
+#include "util/compress.h"
 #include "util/detect_os.h"
 #include "util/disk_cache_os.h"
 #include "util/disk_cache.h"
@@ -565,6 +566,250 @@ test_put_and_get_between_instances(const char *driver_id)
    disk_cache_destroy(cache2);
 }
 
+/* Restore an option saved with os_get_option_dup(), unsetting it if it
+ * wasn't set before.
+ */
+static void
+restore_option(const char *name, char *value)
+{
+   if (value)
+      os_set_option(name, value, true);
+   else
+      os_unset_option(name);
+
+   free(value);
+}
+
+/* Put a burst of items, which the database cache coalesces into batched
+ * writes, and check that all of them can be read back.
+ */
+static void
+test_put_burst_and_get(const char *driver_id)
+{
+   const unsigned num_items = 512;
+   uint8_t key[BLAKE3_KEY_LEN];
+   uint32_t item[64];
+   uint32_t *result;
+   size_t size;
+
+#ifdef SHADER_CACHE_DISABLE_BY_DEFAULT
+   os_set_option("MESA_SHADER_CACHE_DISABLE", "false", true);
+#endif /* SHADER_CACHE_DISABLE_BY_DEFAULT */
+
+   char *max_size = os_get_option_dup("MESA_SHADER_CACHE_MAX_SIZE");
+
+   os_set_option("MESA_SHADER_CACHE_SHOW_STATS", "true", true);
+   os_set_option("MESA_SHADER_CACHE_MAX_SIZE", "1M", true);
+
+   struct disk_cache *cache = disk_cache_create("test_burst", driver_id, 0);
+
+   for (unsigned i = 0; i < num_items; i++) {
+      for (unsigned j = 0; j < ARRAY_SIZE(item); j++)
+         item[j] = i * j;
+
+      disk_cache_compute_key(cache, item, sizeof(item), key);
+      disk_cache_put(cache, key, item, sizeof(item), NULL);
+   }
+
+   /* disk_cache_put() hands things off to a thread so wait for it. */
+   disk_cache_wait_for_idle(cache);
+
+   EXPECT_EQ(cache->stats.writes, num_items);
+   EXPECT_LE(cache->stats.write_batches, cache->stats.writes);
+
+   for (unsigned i = 0; i < num_items; i++) {
+      for (unsigned j = 0; j < ARRAY_SIZE(item); j++)
+         item[j] = i * j;
+
+      disk_cache_compute_key(cache, item, sizeof(item), key);
+      result = (uint32_t *) disk_cache_get(cache, key, &size);
+      ASSERT_NE(result, nullptr) << "disk_cache_get of burst item " << i;
+      EXPECT_EQ(size, sizeof(item));
+      EXPECT_EQ(memcmp(result, item, sizeof(item)), 0);
+      free(result);
+   }
+
+   disk_cache_destroy(cache);
+
+   os_unset_option("MESA_SHADER_CACHE_SHOW_STATS");
+   restore_option("MESA_SHADER_CACHE_MAX_SIZE", max_size);
+}
+
+static size_t
+make_dict_test_item(char *item, size_t item_size, unsigned i,
+                    const char *op)
+{
+   size_t size = 0;
+
+   for (unsigned j = 0; j < 16; j++) {
+      size += snprintf(item + size, item_size - size,
+                       "vec4 ssa_%u = %s ssa_%u, ssa_%u (block %u)\n",
+                       i + j, op, (i * 7 + j) % 97, j, i % 5);
+   }
+
+   return size + 1;
+}
+
+/* Train a dictionary from num_items test items, returns its size or 0 if
+ * dictionaries aren't supported.
+ */
+static size_t
+train_dict_for_test(char *dict, size_t dict_size, unsigned num_items,
+                    const char *op)
+{
+   struct util_dynarray samples, sample_sizes;
+   char item[1024];
+
+   util_dynarray_init(&samples, NULL);
+   util_dynarray_init(&sample_sizes, NULL);
+
+   for (unsigned i = 0; i < num_items; i++) {
+      size_t size = make_dict_test_item(item, sizeof(item), i, op);
+      util_dynarray_append_array(&samples, char, item, size);
+      util_dynarray_append_typed(&sample_sizes, size_t, size);
+   }
+
+   size_t size =
+      util_compress_dict_train(dict, dict_size, samples.data,
+                               (const size_t *)sample_sizes.data, num_items);
+
+   util_dynarray_fini(&samples);
+   util_dynarray_fini(&sample_sizes);
+
+   return size;
+}
+
+static void
+write_dict_for_test(struct disk_cache *cache, const char *dict,
+                    size_t dict_size)
+{
+   char *path = ralloc_asprintf(NULL, "%s/%s", cache->path,
+                                DISK_CACHE_COMPRESS_DICT_FILENAME);
+   FILE *file = fopen(path, "wb");
+   ASSERT_NE(file, nullptr) << "creating the dictionary file";
+   EXPECT_EQ(fwrite(dict, dict_size, 1, file), 1);
+   fclose(file);
+   ralloc_free(path);
+}
+
+/* Put items without and with a trained compression dictionary, check that
+ * both can be read back with the dictionary, and that the items compressed
+ * with it miss once the cache has a different dictionary.
+ *
+ * The dictionary is only used by caches which compress, whatever the
+ * driver_id of the other tests is.
+ */
+static void
+test_put_and_get_with_compress_dict(void)
+{
+   const char *driver_id = "make_check";
+   const unsigned num_items = 256;
+   char item[1024];
+   uint8_t key[BLAKE3_KEY_LEN];
+   char *result;
+   size_t size;
+
+#ifdef SHADER_CACHE_DISABLE_BY_DEFAULT
+   os_set_option("MESA_SHADER_CACHE_DISABLE", "false", true);
+#endif /* SHADER_CACHE_DISABLE_BY_DEFAULT */
+
+   char *max_size = os_get_option_dup("MESA_SHADER_CACHE_MAX_SIZE");
+   os_set_option("MESA_SHADER_CACHE_MAX_SIZE", "1M", true);
+
+   struct disk_cache *cache = disk_cache_create("test_compress_dict",
+                                                driver_id, 0);
+
+   /* The first half is compressed without dictionary */
+   for (unsigned i = 0; i < num_items / 2; i++) {
+      size = make_dict_test_item(item, sizeof(item), i, "fadd");
+      disk_cache_compute_key(cache, item, size, key);
+      disk_cache_put(cache, key, item, size, NULL);
+   }
+
+   /* disk_cache_put() hands things off to a thread so wait for it. */
+   disk_cache_wait_for_idle(cache);
+
+   char dict[16 * 1024];
+   size_t dict_size = train_dict_for_test(dict, sizeof(dict), num_items,
+                                          "fadd");
+   if (!dict_size) {
+      /* Without zstd, check that a bogus dictionary is ignored. */
+      strcpy(dict, "not a dictionary");
+      dict_size = strlen(dict);
+   }
+
+   write_dict_for_test(cache, dict, dict_size);
+   disk_cache_destroy(cache);
+
+   /* The second half is compressed with the dictionary */
+   cache = disk_cache_create("test_compress_dict", driver_id, 0);
+   bool has_dict = cache->compress_dict != NULL;
+#ifdef HAVE_ZSTD
+   EXPECT_TRUE(has_dict) << "loading the trained dictionary";
+#else
+   EXPECT_FALSE(has_dict) << "loading a dictionary without zstd";
+#endif
+
+   for (unsigned i = num_items / 2; i < num_items; i++) {
+      size = make_dict_test_item(item, sizeof(item), i, "fadd");
+      disk_cache_compute_key(cache, item, size, key);
+      disk_cache_put(cache, key, item, size, NULL);
+   }
+
+   disk_cache_wait_for_idle(cache);
+
+   for (unsigned i = 0; i < num_items; i++) {
+      size_t item_size = make_dict_test_item(item, sizeof(item), i, "fadd");
+      disk_cache_compute_key(cache, item, item_size, key);
+
+      result = (char *) disk_cache_get(cache, key, &size);
+      ASSERT_NE(result, nullptr) << "disk_cache_get of item " << i;
+      EXPECT_EQ(size, item_size);
+      EXPECT_STREQ(result, item);
+      free(result);
+   }
+
+   if (has_dict) {
+      /* Replace the dictionary with one trained from different data */
+      char other_dict[16 * 1024];
+      size_t other_dict_size =
+         train_dict_for_test(other_dict, sizeof(other_dict), num_items,
+                             "fmul");
+      ASSERT_NE(other_dict_size, 0);
+      write_dict_for_test(cache, other_dict, other_dict_size);
+      disk_cache_destroy(cache);
+
+      cache = disk_cache_create("test_compress_dict", driver_id, 0);
+      EXPECT_NE(cache->compress_dict, nullptr);
+
+      for (unsigned i = 0; i < num_items; i++) {
+         size_t item_size = make_dict_test_item(item, sizeof(item), i,
+                                                "fadd");
+         disk_cache_compute_key(cache, item, item_size, key);
+
+         result = (char *) disk_cache_get(cache, key, &size);
+         if (i < num_items / 2) {
+            ASSERT_NE(result, nullptr) << "disk_cache_get of item " << i
+                                       << " compressed without dictionary";
+            EXPECT_STREQ(result, item);
+         } else {
+            EXPECT_EQ(result, nullptr) << "disk_cache_get of item " << i
+                                       << " with another dictionary";
+         }
+         free(result);
+      }
+   }
+
+   char *path = ralloc_asprintf(NULL, "%s/%s", cache->path,
+                                DISK_CACHE_COMPRESS_DICT_FILENAME);
+   disk_cache_destroy(cache);
+
+   unlink(path);
+   ralloc_free(path);
+
+   restore_option("MESA_SHADER_CACHE_MAX_SIZE", max_size);
+}
+
 static void
 test_put_and_get_between_instances_with_eviction(const char *driver_id)
 {
@@ -761,6 +1006,8 @@ run_tests:
 
    test_put_key_and_get_key(driver_id);
 
+   test_put_and_get_with_compress_dict();
+
    os_set_option("MESA_DISK_CACHE_MULTI_FILE", "false", true);
 
    int err = rmrf_local(CACHE_TEST_TMP);
@@ -848,6 +1095,10 @@ TEST_F(Cache, Database)
 
    test_put_big_sized_entry_to_empty_cache(driver_id);
 
+   test_put_burst_and_get(driver_id);
+
+   test_put_and_get_with_compress_dict();
+
    os_set_option("MESA_DISK_CACHE_DATABASE", "false", true);
    os_unset_option("MESA_DISK_CACHE_DATABASE_NUM_PARTS");
 
@@ -939,6 +1190,13 @@ TEST_F(Cache, Combined)
    EXPECT_EQ(size, sizeof(blob)) << "disk_cache_get of existing item (size)";
    free(result);
 
+   /* The RO cache is mapped and its sorted index saved for the next loads */
+   char foz_ro_sorted_idx_file[1024];
+   sprintf(foz_ro_sorted_idx_file, "%s/ro_cache_idx.foz.sorted",
+           cache_sf_ro->path);
+   EXPECT_EQ(access(foz_ro_sorted_idx_file, R_OK), 0)
+      << "ro_cache_idx.foz.sorted missing";
+
    disk_cache_destroy(cache_sf_ro);
 
    /* Remove empty FOZ RW cache files created above. We only need RO cache. */
@@ -1247,6 +1505,190 @@ TEST_F(Cache, List)
 #endif /* ENABLE_SHADER_CACHE */
 }
 
+#ifdef FOZ_DB_UTIL
+struct foz_test_entry {
+   uint8_t key[BLAKE3_KEY_LEN];
+   const char *payload;
+};
+
+#define FOZ_TEST_PAYLOAD_SIZE 32
+
+/* Appends entries to a foz db the way foz_write_entry() does, but without
+ * skipping the keys that are already in the db.
+ */
+static void
+append_foz_db(const char *dir, const char *name,
+              const struct foz_test_entry *entries, unsigned num_entries)
+{
+   /* Same as stream_reference_magic_and_version in fossilize_db.c */
+   static const uint8_t magic[] = {
+      0x81, 'F', 'O', 'S', 'S', 'I', 'L', 'I', 'Z', 'E', 'D', 'B',
+      0, 0, 0, FOSSILIZE_FORMAT_VERSION,
+   };
+   char filename[1024];
+   char idx_filename[1024];
+
+   sprintf(filename, "%s/%s.foz", dir, name);
+   sprintf(idx_filename, "%s/%s_idx.foz", dir, name);
+
+   FILE *db = fopen(filename, "ab");
+   FILE *idx = fopen(idx_filename, "ab");
+   ASSERT_NE(db, nullptr) << filename;
+   ASSERT_NE(idx, nullptr) << idx_filename;
+
+   fseek(db, 0, SEEK_END);
+   if (ftell(db) == 0) {
+      fwrite(magic, 1, sizeof(magic), db);
+      fwrite(magic, 1, sizeof(magic), idx);
+   }
+
+   for (unsigned i = 0; i < num_entries; i++) {
+      char hash_str[BLAKE3_HEX_LEN];
+      _mesa_blake3_format(hash_str, entries[i].key);
+
+      struct foz_payload_header header;
+      header.payload_size = strlen(entries[i].payload) + 1;
+      header.format = FOSSILIZE_COMPRESSION_NONE;
+      header.crc = 0;
+      header.uncompressed_size = header.payload_size;
+
+      fwrite(hash_str, 1, FOSSILIZE_BLOB_HASH_LENGTH, db);
+      uint64_t offset = ftell(db);
+      fwrite(&header, 1, sizeof(header), db);
+      fwrite(entries[i].payload, 1, header.payload_size, db);
+
+      header.payload_size = sizeof(uint64_t);
+      header.uncompressed_size = sizeof(uint64_t);
+
+      fwrite(hash_str, 1, FOSSILIZE_BLOB_HASH_LENGTH, idx);
+      fwrite(&header, 1, sizeof(header), idx);
+      fwrite(&offset, 1, sizeof(offset), idx);
+   }
+
+   fclose(db);
+   fclose(idx);
+}
+
+/* Looks up the keys of entries either in the "foz_cache" db, which is read
+ * through the hash table, or in the "ro_cache" db, which is mapped. Missing
+ * entries are returned as empty strings.
+ */
+static void
+read_foz_db(char *dir, bool mapped, const struct foz_test_entry *entries,
+            unsigned num_entries, char (*results)[FOZ_TEST_PAYLOAD_SIZE])
+{
+   struct foz_db foz_db;
+
+   memset(&foz_db, 0, sizeof(foz_db));
+
+   if (mapped) {
+      os_set_option("MESA_DISK_CACHE_SINGLE_FILE", "false", true);
+      os_set_option("MESA_DISK_CACHE_READ_ONLY_FOZ_DBS", "ro_cache", true);
+   } else {
+      os_set_option("MESA_DISK_CACHE_SINGLE_FILE", "true", true);
+      os_unset_option("MESA_DISK_CACHE_READ_ONLY_FOZ_DBS");
+   }
+
+   ASSERT_TRUE(foz_prepare(&foz_db, dir)) << "foz_prepare failed";
+
+   for (unsigned i = 0; i < num_entries; i++) {
+      bool entry_mapped;
+      size_t size;
+      char *data = (char *) foz_read_entry_mapped(&foz_db, entries[i].key,
+                                                  &size, &entry_mapped);
+
+      results[i][0] = '\0';
+      if (data) {
+         EXPECT_EQ(entry_mapped, mapped) << entries[i].payload;
+         snprintf(results[i], FOZ_TEST_PAYLOAD_SIZE, "%s", data);
+         if (!entry_mapped)
+            free(data);
+      }
+   }
+
+   foz_destroy(&foz_db);
+}
+#endif /* FOZ_DB_UTIL */
+
+TEST_F(Cache, SortedIndex)
+{
+#ifndef ENABLE_SHADER_CACHE
+   GTEST_SKIP() << "ENABLE_SHADER_CACHE not defined.";
+#else
+#ifndef FOZ_DB_UTIL
+   GTEST_SKIP() << "FOZ_DB_UTIL not supported";
+#else
+   char dir[] = CACHE_TEST_TMP "/sorted-index";
+   char sorted_idx_file[1024];
+   char linear[5][FOZ_TEST_PAYLOAD_SIZE];
+   char mapped[5][FOZ_TEST_PAYLOAD_SIZE];
+   struct foz_test_entry entries[5];
+   struct stat before, after;
+
+   rmrf_local(CACHE_TEST_TMP);
+   ASSERT_EQ(mkdir(CACHE_TEST_TMP, 0755), 0);
+   ASSERT_EQ(mkdir(dir, 0755), 0);
+
+   memset(entries, 0, sizeof(entries));
+
+   entries[0].key[0] = 1;
+   entries[0].payload = "unique";
+
+   /* The same key twice */
+   entries[1].key[0] = 2;
+   entries[1].payload = "duplicate first";
+   entries[2].key[0] = 2;
+   entries[2].payload = "duplicate last";
+
+   /* Two keys with the same 64bit hash */
+   entries[3].key[0] = 3;
+   entries[3].key[19] = 1;
+   entries[3].payload = "collision first";
+   entries[4].key[0] = 3;
+   entries[4].key[19] = 2;
+   entries[4].payload = "collision last";
+
+   append_foz_db(dir, "foz_cache", entries, ARRAY_SIZE(entries));
+   append_foz_db(dir, "ro_cache", entries, ARRAY_SIZE(entries));
+
+   read_foz_db(dir, false, entries, ARRAY_SIZE(entries), linear);
+   read_foz_db(dir, true, entries, ARRAY_SIZE(entries), mapped);
+
+   /* The last entry of each 64bit hash shadows the previous ones */
+   EXPECT_STREQ(linear[0], "unique");
+   EXPECT_STREQ(linear[1], "duplicate last");
+   EXPECT_STREQ(linear[2], "duplicate last");
+   EXPECT_STREQ(linear[3], "");
+   EXPECT_STREQ(linear[4], "collision last");
+
+   for (unsigned i = 0; i < ARRAY_SIZE(entries); i++) {
+      EXPECT_STREQ(mapped[i], linear[i])
+         << "sorted index and hash table disagree on " << entries[i].payload;
+   }
+
+   /* Appending to the db makes the sidecar stale, it must not be used */
+   sprintf(sorted_idx_file, "%s/ro_cache_idx.foz.sorted", dir);
+   ASSERT_EQ(stat(sorted_idx_file, &before), 0) << "sidecar missing";
+
+   entries[0].key[0] = 4;
+   entries[0].payload = "appended";
+   append_foz_db(dir, "ro_cache", entries, 1);
+
+   read_foz_db(dir, true, entries, 1, mapped);
+   EXPECT_STREQ(mapped[0], "appended") << "stale sidecar used";
+
+   ASSERT_EQ(stat(sorted_idx_file, &after), 0) << "sidecar missing";
+   EXPECT_GT(after.st_size, before.st_size) << "stale sidecar not rebuilt";
+
+   os_unset_option("MESA_DISK_CACHE_SINGLE_FILE");
+   os_unset_option("MESA_DISK_CACHE_READ_ONLY_FOZ_DBS");
+
+   int err = rmrf_local(CACHE_TEST_TMP);
+   EXPECT_EQ(err, 0) << "Removing " CACHE_TEST_TMP " again";
+#endif /* FOZ_DB_UTIL */
+#endif /* ENABLE_SHADER_CACHE */
+}
+
 static void
 test_multipart_eviction(const char *driver_id)
 {
@@ -1350,6 +1792,81 @@ TEST_F(Cache, DatabaseMultipartEviction)
 #endif
 }
 
+/* Write a batch larger than a DB part and check that it is spread across
+ * the parts without overfilling any of them.
+ */
+static void
+test_multipart_batch_write(void)
+{
+   const unsigned num_parts = 4, part_size = 8 * 1024;
+   const unsigned num_entries = 64;
+   struct mesa_cache_db_multipart db;
+   struct mesa_cache_db_entry entries[num_entries];
+   uint8_t keys[num_entries][20];
+   uint8_t blobs[num_entries][256];
+   struct stat st;
+   size_t size;
+
+   os_set_option("MESA_DISK_CACHE_DATABASE_NUM_PARTS", "4", true);
+
+   int err = mkdir(CACHE_TEST_TMP "/multipart-batch", 0755);
+   ASSERT_EQ(err, 0) << "Creating " CACHE_TEST_TMP "/multipart-batch";
+
+   ASSERT_TRUE(mesa_cache_db_multipart_open(&db,
+                                            CACHE_TEST_TMP "/multipart-batch"));
+   mesa_cache_db_multipart_set_size_limit(&db, num_parts * part_size);
+
+   for (unsigned i = 0; i < num_entries; i++) {
+      memset(keys[i], i + 1, sizeof(keys[i]));
+      memset(blobs[i], i, sizeof(blobs[i]));
+
+      entries[i].key = keys[i];
+      entries[i].blob = blobs[i];
+      entries[i].blob_size = sizeof(blobs[i]);
+   }
+
+   EXPECT_TRUE(mesa_cache_db_multipart_entries_write(&db, entries,
+                                                     num_entries));
+
+   for (unsigned i = 0; i < num_parts; i++) {
+      if (!db.parts[i])
+         continue;
+
+      ASSERT_EQ(stat(db.parts[i]->cache.path, &st), 0);
+      /* The part limit doesn't include the 20 bytes DB file header */
+      EXPECT_LE(st.st_size, part_size + 20) << "size of DB part " << i;
+   }
+
+   for (unsigned i = 0; i < num_entries; i++) {
+      void *result = mesa_cache_db_multipart_read_entry(&db, keys[i], &size);
+      ASSERT_NE(result, nullptr) << "reading batch entry " << i;
+      EXPECT_EQ(size, sizeof(blobs[i]));
+      EXPECT_EQ(memcmp(result, blobs[i], size), 0);
+      free(result);
+   }
+
+   mesa_cache_db_multipart_close(&db);
+
+   os_unset_option("MESA_DISK_CACHE_DATABASE_NUM_PARTS");
+}
+
+TEST_F(Cache, DatabaseMultipartBatch)
+{
+#ifndef ENABLE_SHADER_CACHE
+   GTEST_SKIP() << "ENABLE_SHADER_CACHE not defined.";
+#else
+   rmrf_local(CACHE_TEST_TMP);
+
+   int err = mkdir(CACHE_TEST_TMP, 0755);
+   ASSERT_EQ(err, 0) << "Creating " CACHE_TEST_TMP;
+
+   test_multipart_batch_write();
+
+   err = rmrf_local(CACHE_TEST_TMP);
+   EXPECT_EQ(err, 0) << "Removing " CACHE_TEST_TMP " again";
+#endif
+}
+
 static void
 test_put_and_get_disabled(const char *driver_id)
 {
@@ -23,6 +23,7 @@
  */
 
 #include <gtest/gtest.h>
+#include "util/macros.h"
 #include "util/ralloc.h"
 
 #if defined(__LP64__) || defined(_WIN64)
@@ -46,3 +47,41 @@ TEST(gc_alloc, align)
       }
    }
 }
+
+TEST(gc_alloc, subcontext)
+{
+   gc_ctx *ctx = gc_context(NULL);
+   gc_ctx *sub = gc_subcontext(ctx);
+
+   void *small[64], *large[4];
+   for (unsigned i = 0; i < ARRAY_SIZE(small); i++) {
+      small[i] = gc_zalloc_size(sub, 8 + i * 8, 8);
+      EXPECT_EQ(gc_get_context(small[i]), sub);
+   }
+   for (unsigned i = 0; i < ARRAY_SIZE(large); i++)
+      large[i] = gc_zalloc_size(sub, 8192, 8);
+
+   gc_join_subcontext(ctx, sub);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(small); i++)
+      EXPECT_EQ(gc_get_context(small[i]), ctx);
+   for (unsigned i = 0; i < ARRAY_SIZE(large); i++)
+      EXPECT_EQ(gc_get_context(large[i]), ctx);
+
+   /* Joined memory can be freed and swept like any other. */
+   for (unsigned i = 0; i < ARRAY_SIZE(small); i += 2)
+      gc_free(small[i]);
+   gc_free(large[0]);
+
+   gc_sweep_start(ctx);
+   for (unsigned i = 1; i < ARRAY_SIZE(small); i += 2)
+      gc_mark_live(ctx, small[i]);
+   gc_mark_live(ctx, large[1]);
+   gc_sweep_end(ctx);
+
+   for (unsigned i = 1; i < ARRAY_SIZE(small); i += 2)
+      EXPECT_EQ(gc_get_context(small[i]), ctx);
+   EXPECT_EQ(gc_get_context(large[1]), ctx);
+
+   ralloc_free(ctx);
+}
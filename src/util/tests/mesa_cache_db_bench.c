@@ -0,0 +1,156 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Measures mesa_cache_db lookups per second with a varying number of
+ * concurrent reader threads.
+ *
+ * Usage: mesa_cache_db_bench [num_entries] [lookups_per_thread] [max_threads]
+ */
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "c11/threads.h"
+#include "util/disk_cache.h"
+#include "util/mesa_cache_db.h"
+#include "util/os_time.h"
+#include "util/u_cpu_detect.h"
+
+struct bench_thread {
+   struct mesa_cache_db *db;
+   unsigned num_entries;
+   unsigned num_lookups;
+   unsigned seed;
+   unsigned hits;
+};
+
+static void
+make_key(uint8_t *key, unsigned i)
+{
+   /* The first 8 bytes form the index hash, keep them unique */
+   memset(key, 0xa5, CACHE_KEY_SIZE);
+   memcpy(key, &i, sizeof(i));
+   key[7] = 0x5a;
+}
+
+static size_t
+entry_size(unsigned i)
+{
+   return 512 + (i * 97) % 4096;
+}
+
+static int
+lookup_thread(void *data)
+{
+   struct bench_thread *t = data;
+   uint8_t key[CACHE_KEY_SIZE];
+
+   for (unsigned n = 0; n < t->num_lookups; n++) {
+      unsigned i;
+      size_t size;
+      void *blob;
+
+      t->seed = t->seed * 1103515245 + 12345;
+      i = (t->seed >> 8) % t->num_entries;
+
+      make_key(key, i);
+      blob = mesa_cache_db_read_entry(t->db, key, &size);
+      if (blob) {
+         assert(size == entry_size(i));
+         assert(((uint8_t *)blob)[0] == (uint8_t)i);
+         t->hits++;
+         free(blob);
+      }
+   }
+
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned num_entries = argc > 1 ? atoi(argv[1]) : 4096;
+   unsigned num_lookups = argc > 2 ? atoi(argv[2]) : 100000;
+   unsigned max_threads = argc > 3 ? atoi(argv[3]) : 0;
+   char dir_template[] = "/tmp/mesa_cache_db_bench_XXXXXX";
+   struct mesa_cache_db db = {0};
+   uint8_t key[CACHE_KEY_SIZE];
+   uint8_t *blob;
+   char *dir;
+
+   if (!max_threads) {
+      max_threads = MIN2(util_get_cpu_caps()->nr_cpus, 16);
+   }
+
+   dir = mkdtemp(dir_template);
+   assert(dir);
+
+   if (!mesa_cache_db_open(&db, dir)) {
+      fprintf(stderr, "failed to open the cache database in %s\n", dir);
+      return 1;
+   }
+
+   mesa_cache_db_set_size_limit(&db, 1024ull * 1024 * 1024);
+
+   blob = malloc(entry_size(num_entries) + 4096);
+   assert(blob);
+
+   for (unsigned i = 0; i < num_entries; i++) {
+      memset(blob, i, entry_size(i));
+      make_key(key, i);
+      if (!mesa_cache_db_entry_write(&db, key, blob, entry_size(i))) {
+         fprintf(stderr, "failed to write entry %u\n", i);
+         return 1;
+      }
+   }
+
+   free(blob);
+
+   printf("%u entries, %u lookups per thread\n", num_entries, num_lookups);
+
+   for (unsigned num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+      struct bench_thread *threads = calloc(num_threads, sizeof(*threads));
+      thrd_t *handles = calloc(num_threads, sizeof(*handles));
+      unsigned hits = 0;
+      int64_t start, end;
+
+      assert(threads && handles);
+
+      start = os_time_get_nano();
+
+      for (unsigned t = 0; t < num_threads; t++) {
+         threads[t].db = &db;
+         threads[t].num_entries = num_entries;
+         threads[t].num_lookups = num_lookups;
+         threads[t].seed = t + 1;
+         thrd_create(&handles[t], lookup_thread, &threads[t]);
+      }
+
+      for (unsigned t = 0; t < num_threads; t++) {
+         thrd_join(handles[t], NULL);
+         hits += threads[t].hits;
+      }
+
+      end = os_time_get_nano();
+
+      printf("%2u threads: %10.0f lookups/s (%u/%u hits)\n", num_threads,
+             (double)num_threads * num_lookups * 1000000000.0 / (end - start),
+             hits, num_threads * num_lookups);
+
+      free(handles);
+      free(threads);
+   }
+
+   mesa_cache_db_close(&db);
+   mesa_db_wipe_path(dir);
+   rmdir(dir);
+
+   return 0;
+}
@@ -0,0 +1,273 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ *
+ * Testing priorities and job promotion of u_queue.h
+ */
+
+#include <gtest/gtest.h>
+#include <thread>
+
+#include "util/u_atomic.h"
+#include "util/u_queue.h"
+
+struct queue_test_job {
+   struct util_queue_fence fence;
+   int *order;
+   int *num_executed;
+   int index;
+};
+
+struct queue_test_gate {
+   struct util_queue_fence started;
+   struct util_queue_fence release;
+};
+
+static void
+gate_execute(void *data, void *gdata, int thread_index)
+{
+   struct queue_test_gate *gate = (struct queue_test_gate *)data;
+
+   util_queue_fence_signal(&gate->started);
+   util_queue_fence_wait(&gate->release);
+}
+
+static void
+record_execute(void *data, void *gdata, int thread_index)
+{
+   struct queue_test_job *job = (struct queue_test_job *)data;
+
+   job->order[p_atomic_inc_return(job->num_executed) - 1] = job->index;
+}
+
+class u_queue_test : public ::testing::Test {
+protected:
+   void SetUp() override
+   {
+      ASSERT_TRUE(util_queue_init(&queue, "test", 8, 1,
+                                  UTIL_QUEUE_INIT_RESIZE_IF_FULL, NULL));
+
+      /* Block the only thread, so that all the following jobs are queued. */
+      util_queue_fence_init(&gate.started);
+      util_queue_fence_init(&gate.release);
+      util_queue_fence_reset(&gate.started);
+      util_queue_fence_reset(&gate.release);
+      util_queue_fence_init(&gate_fence);
+      util_queue_add_job(&queue, &gate, &gate_fence, gate_execute, NULL, 0);
+      util_queue_fence_wait(&gate.started);
+   }
+
+   void TearDown() override
+   {
+      util_queue_destroy(&queue);
+      util_queue_fence_destroy(&gate_fence);
+      util_queue_fence_destroy(&gate.started);
+      util_queue_fence_destroy(&gate.release);
+   }
+
+   void add(struct queue_test_job *job, int index,
+            enum util_queue_priority priority)
+   {
+      job->order = order;
+      job->num_executed = &num_executed;
+      job->index = index;
+      util_queue_fence_init(&job->fence);
+      util_queue_add_job_with_priority(&queue, job, &job->fence,
+                                       record_execute, NULL, 0, priority);
+   }
+
+   struct util_queue queue;
+   struct queue_test_gate gate;
+   struct util_queue_fence gate_fence;
+   int order[64] = {};
+   int num_executed = 0;
+};
+
+TEST_F(u_queue_test, priority_order)
+{
+   struct queue_test_job jobs[6];
+
+   add(&jobs[0], 0, UTIL_QUEUE_PRIORITY_LOW);
+   add(&jobs[1], 1, UTIL_QUEUE_PRIORITY_NORMAL);
+   add(&jobs[2], 2, UTIL_QUEUE_PRIORITY_HIGH);
+   add(&jobs[3], 3, UTIL_QUEUE_PRIORITY_NORMAL);
+   add(&jobs[4], 4, UTIL_QUEUE_PRIORITY_HIGH);
+   add(&jobs[5], 5, UTIL_QUEUE_PRIORITY_LOW);
+
+   struct util_queue_stats stats;
+   util_queue_get_stats(&queue, &stats);
+   EXPECT_EQ(stats.num_queued[UTIL_QUEUE_PRIORITY_HIGH], 2);
+   EXPECT_EQ(stats.num_queued[UTIL_QUEUE_PRIORITY_NORMAL], 2);
+   EXPECT_EQ(stats.num_queued[UTIL_QUEUE_PRIORITY_LOW], 2);
+   /* The gate job */
+   EXPECT_EQ(stats.num_added[UTIL_QUEUE_PRIORITY_NORMAL], 3);
+
+   util_queue_fence_signal(&gate.release);
+   util_queue_finish(&queue);
+
+   const int expected[] = {2, 4, 1, 3, 0, 5};
+   ASSERT_EQ(num_executed, 6);
+   for (unsigned i = 0; i < 6; i++)
+      EXPECT_EQ(order[i], expected[i]);
+
+   util_queue_get_stats(&queue, &stats);
+   for (unsigned i = 0; i < UTIL_QUEUE_NUM_PRIORITIES; i++)
+      EXPECT_EQ(stats.num_queued[i], 0);
+   EXPECT_EQ(stats.max_queued[UTIL_QUEUE_PRIORITY_HIGH], 2);
+   EXPECT_EQ(stats.max_queued[UTIL_QUEUE_PRIORITY_NORMAL], 2);
+   /* util_queue_finish adds its barrier as a low priority job. */
+   EXPECT_GE(stats.max_queued[UTIL_QUEUE_PRIORITY_LOW], 2);
+   EXPECT_EQ(stats.num_promoted, 0);
+
+   for (unsigned i = 0; i < 6; i++)
+      util_queue_fence_destroy(&jobs[i].fence);
+}
+
+TEST_F(u_queue_test, promote)
+{
+   struct queue_test_job jobs[5];
+
+   add(&jobs[0], 0, UTIL_QUEUE_PRIORITY_LOW);
+   add(&jobs[1], 1, UTIL_QUEUE_PRIORITY_LOW);
+   add(&jobs[2], 2, UTIL_QUEUE_PRIORITY_LOW);
+   add(&jobs[3], 3, UTIL_QUEUE_PRIORITY_NORMAL);
+   add(&jobs[4], 4, UTIL_QUEUE_PRIORITY_HIGH);
+
+   EXPECT_TRUE(util_queue_promote_job(&queue, &jobs[1].fence));
+   /* Already high priority */
+   EXPECT_FALSE(util_queue_promote_job(&queue, &jobs[1].fence));
+   EXPECT_FALSE(util_queue_promote_job(&queue, &jobs[4].fence));
+
+   struct util_queue_stats stats;
+   util_queue_get_stats(&queue, &stats);
+   EXPECT_EQ(stats.num_queued[UTIL_QUEUE_PRIORITY_HIGH], 2);
+   EXPECT_EQ(stats.num_queued[UTIL_QUEUE_PRIORITY_LOW], 2);
+   EXPECT_EQ(stats.num_promoted, 1);
+
+   util_queue_fence_signal(&gate.release);
+   util_queue_finish(&queue);
+
+   const int expected[] = {4, 1, 3, 0, 2};
+   ASSERT_EQ(num_executed, 5);
+   for (unsigned i = 0; i < 5; i++)
+      EXPECT_EQ(order[i], expected[i]);
+
+   /* Signalled jobs can't be promoted. */
+   EXPECT_FALSE(util_queue_promote_job(&queue, &jobs[0].fence));
+
+   for (unsigned i = 0; i < 5; i++)
+      util_queue_fence_destroy(&jobs[i].fence);
+}
+
+TEST_F(u_queue_test, grow_with_priorities)
+{
+   struct queue_test_job jobs[24];
+
+   /* Exceeds the initial 8 jobs, so the rings have to be resized. */
+   for (unsigned i = 0; i < 24; i++)
+      add(&jobs[i], i, (enum util_queue_priority)(2 - i % 3));
+
+   EXPECT_TRUE(util_queue_promote_job(&queue, &jobs[21].fence));
+
+   util_queue_fence_signal(&gate.release);
+   util_queue_finish(&queue);
+
+   ASSERT_EQ(num_executed, 24);
+   /* High jobs, then the promoted job, then normal and low jobs. */
+   unsigned n = 0;
+   for (unsigned i = 2; i < 24; i += 3)
+      EXPECT_EQ(order[n++], (int)i);
+   EXPECT_EQ(order[n++], 21);
+   for (unsigned i = 1; i < 24; i += 3)
+      EXPECT_EQ(order[n++], (int)i);
+   for (unsigned i = 0; i < 24; i += 3) {
+      if (i != 21) {
+         EXPECT_EQ(order[n++], (int)i);
+      }
+   }
+
+   for (unsigned i = 0; i < 24; i++)
+      util_queue_fence_destroy(&jobs[i].fence);
+}
+
+TEST_F(u_queue_test, aging)
+{
+   struct queue_test_job jobs[41];
+
+   add(&jobs[0], 0, UTIL_QUEUE_PRIORITY_LOW);
+   for (unsigned i = 1; i < 41; i++)
+      add(&jobs[i], i, UTIL_QUEUE_PRIORITY_HIGH);
+
+   util_queue_fence_signal(&gate.release);
+   util_queue_finish(&queue);
+
+   /* The low priority job goes first once it was passed over too often. */
+   ASSERT_EQ(num_executed, 41);
+   for (unsigned i = 0; i < 41; i++) {
+      if (i < UTIL_QUEUE_MAX_SKIPPED)
+         EXPECT_EQ(order[i], (int)i + 1);
+      else if (i == UTIL_QUEUE_MAX_SKIPPED)
+         EXPECT_EQ(order[i], 0);
+      else
+         EXPECT_EQ(order[i], (int)i);
+   }
+
+   for (unsigned i = 0; i < 41; i++)
+      util_queue_fence_destroy(&jobs[i].fence);
+}
+
+TEST_F(u_queue_test, finish_ignores_later_jobs)
+{
+   struct queue_test_job jobs[41];
+   struct util_queue_fence finished;
+
+   add(&jobs[0], 0, UTIL_QUEUE_PRIORITY_LOW);
+
+   util_queue_fence_init(&finished);
+   util_queue_fence_reset(&finished);
+   std::thread finish_thread([&]() {
+      util_queue_finish(&queue);
+      util_queue_fence_signal(&finished);
+   });
+
+   /* Wait for the barrier */
+   struct util_queue_stats stats;
+   do {
+      std::this_thread::yield();
+      util_queue_get_stats(&queue, &stats);
+   } while (stats.num_added[UTIL_QUEUE_PRIORITY_LOW] < 2);
+
+   /* High priority jobs added after the barrier, the last one blocking */
+   for (unsigned i = 1; i < 41; i++)
+      add(&jobs[i], i, UTIL_QUEUE_PRIORITY_HIGH);
+
+   struct queue_test_gate gate2;
+   struct util_queue_fence gate2_fence;
+   util_queue_fence_init(&gate2.started);
+   util_queue_fence_init(&gate2.release);
+   util_queue_fence_reset(&gate2.started);
+   util_queue_fence_reset(&gate2.release);
+   util_queue_fence_init(&gate2_fence);
+   util_queue_add_job_with_priority(&queue, &gate2, &gate2_fence, gate_execute,
+                                    NULL, 0, UTIL_QUEUE_PRIORITY_HIGH);
+
+   util_queue_fence_signal(&gate.release);
+
+   /* The barrier is taken right after the low priority job. */
+   const int64_t timeout = os_time_get_absolute_timeout(10000000000ull);
+   EXPECT_TRUE(util_queue_fence_wait_timeout(&finished, timeout));
+   EXPECT_TRUE(util_queue_fence_is_signalled(&jobs[0].fence));
+   EXPECT_EQ(order[UTIL_QUEUE_MAX_SKIPPED], 0);
+
+   util_queue_fence_signal(&gate2.release);
+   finish_thread.join();
+   util_queue_finish(&queue);
+   EXPECT_EQ(num_executed, 41);
+
+   for (unsigned i = 0; i < 41; i++)
+      util_queue_fence_destroy(&jobs[i].fence);
+   util_queue_fence_destroy(&finished);
+   util_queue_fence_destroy(&gate2_fence);
+   util_queue_fence_destroy(&gate2.started);
+   util_queue_fence_destroy(&gate2.release);
+}
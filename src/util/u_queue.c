@@ -231,6 +231,73 @@ struct thread_input {
    int thread_index;
 };
 
+static inline struct util_queue_job *
+util_queue_ring_job(struct util_queue *queue, unsigned priority, int idx)
+{
+   return &queue->jobs[priority * queue->max_jobs + idx];
+}
+
+static void
+util_queue_finish_execute(void *data, void *gdata, int num_thread);
+
+/* Returns the priority of a queued job added before seq, other than a
+ * barrier, or UTIL_QUEUE_NUM_PRIORITIES if there is none.
+ */
+static unsigned
+util_queue_find_older_job_locked(struct util_queue *queue, unsigned seq)
+{
+   for (unsigned prio = 0; prio < UTIL_QUEUE_NUM_PRIORITIES; prio++) {
+      for (int n = 0; n < queue->rings[prio].num_queued; n++) {
+         const struct util_queue_job *job =
+            util_queue_ring_job(queue, prio,
+                                (queue->rings[prio].read_idx + n) %
+                                queue->max_jobs);
+         if (job->job && job->execute != util_queue_finish_execute &&
+             (int)(job->seq - seq) < 0)
+            return prio;
+      }
+   }
+   return UTIL_QUEUE_NUM_PRIORITIES;
+}
+
+/* Returns the priority of the ring to take the next job from. */
+static unsigned
+util_queue_select_ring_locked(struct util_queue *queue)
+{
+   unsigned prio = 0;
+   while (!queue->rings[prio].num_queued)
+      prio++;
+
+   /* Aging: a lower priority passed over too many times in a row goes first. */
+   for (unsigned p = prio + 1; p < UTIL_QUEUE_NUM_PRIORITIES; p++) {
+      if (queue->rings[p].num_queued &&
+          ++queue->rings[p].num_skipped > UTIL_QUEUE_MAX_SKIPPED) {
+         prio = p;
+         break;
+      }
+   }
+
+   /* util_queue_finish() only waits for the jobs added before its barrier.
+    * The barrier is taken as soon as all of them have been taken, whatever
+    * the priority of the jobs added after it, and never before.
+    */
+   const struct util_queue_job *low =
+      util_queue_ring_job(queue, UTIL_QUEUE_PRIORITY_LOW,
+                          queue->rings[UTIL_QUEUE_PRIORITY_LOW].read_idx);
+   if (queue->rings[UTIL_QUEUE_PRIORITY_LOW].num_queued &&
+       low->execute == util_queue_finish_execute) {
+      unsigned older = util_queue_find_older_job_locked(queue, low->seq);
+
+      if (older == UTIL_QUEUE_NUM_PRIORITIES)
+         prio = UTIL_QUEUE_PRIORITY_LOW;
+      else if (prio == UTIL_QUEUE_PRIORITY_LOW)
+         prio = older;
+   }
+
+   queue->rings[prio].num_skipped = 0;
+   return prio;
+}
+
 static int
 util_queue_thread_func(void *input)
 {
@@ -280,10 +347,15 @@ util_queue_thread_func(void *input)
          break;
       }
 
-      job = queue->jobs[queue->read_idx];
-      memset(&queue->jobs[queue->read_idx], 0, sizeof(struct util_queue_job));
-      queue->read_idx = (queue->read_idx + 1) % queue->max_jobs;
+      unsigned prio = util_queue_select_ring_locked(queue);
+      struct util_queue_job *ptr =
+         util_queue_ring_job(queue, prio, queue->rings[prio].read_idx);
+      job = *ptr;
+      memset(ptr, 0, sizeof(struct util_queue_job));
+      queue->rings[prio].read_idx =
+         (queue->rings[prio].read_idx + 1) % queue->max_jobs;
 
+      queue->rings[prio].num_queued--;
       queue->num_queued--;
       cnd_signal(&queue->has_space_cond);
       if (job.job)
@@ -302,15 +374,21 @@ util_queue_thread_func(void *input)
    /* signal remaining jobs if all threads are being terminated */
    mtx_lock(&queue->lock);
    if (queue->num_threads == 0) {
-      for (unsigned i = queue->read_idx; i != queue->write_idx;
-           i = (i + 1) % queue->max_jobs) {
-         if (queue->jobs[i].job) {
-            if (queue->jobs[i].fence)
-               util_queue_fence_signal(queue->jobs[i].fence);
-            queue->jobs[i].job = NULL;
+      for (unsigned prio = 0; prio < UTIL_QUEUE_NUM_PRIORITIES; prio++) {
+         for (int n = 0; n < queue->rings[prio].num_queued; n++) {
+            struct util_queue_job *ptr =
+               util_queue_ring_job(queue, prio,
+                                   (queue->rings[prio].read_idx + n) %
+                                   queue->max_jobs);
+            if (ptr->job) {
+               if (ptr->fence)
+                  util_queue_fence_signal(ptr->fence);
+               ptr->job = NULL;
+            }
          }
+         queue->rings[prio].read_idx = queue->rings[prio].write_idx;
+         queue->rings[prio].num_queued = 0;
       }
-      queue->read_idx = queue->write_idx;
       queue->num_queued = 0;
    }
    mtx_unlock(&queue->lock);
@@ -441,7 +519,8 @@ util_queue_init(struct util_queue *queue,
    cnd_init(&queue->has_space_cond);
 
    queue->jobs = (struct util_queue_job*)
-                 calloc(max_jobs, sizeof(struct util_queue_job));
+                 calloc(max_jobs * UTIL_QUEUE_NUM_PRIORITIES,
+                        sizeof(struct util_queue_job));
    if (!queue->jobs)
       goto fail;
 
@@ -546,6 +625,7 @@ util_queue_add_job_locked(struct util_queue *queue,
                           util_queue_execute_func execute,
                           util_queue_execute_func cleanup,
                           const size_t job_size,
+                          enum util_queue_priority priority,
                           bool locked)
 {
    struct util_queue_job *ptr;
@@ -582,25 +662,33 @@ util_queue_add_job_locked(struct util_queue *queue,
           */
          unsigned new_max_jobs = queue->max_jobs + 8;
          struct util_queue_job *jobs =
-            (struct util_queue_job*)calloc(new_max_jobs,
+            (struct util_queue_job*)calloc(new_max_jobs *
+                                           UTIL_QUEUE_NUM_PRIORITIES,
                                            sizeof(struct util_queue_job));
          assert(jobs);
 
-         /* Copy all queued jobs into the new list. */
+         /* Copy all queued jobs into the new rings. */
          unsigned num_jobs = 0;
-         unsigned i = queue->read_idx;
 
-         do {
-            jobs[num_jobs++] = queue->jobs[i];
-            i = (i + 1) % queue->max_jobs;
-         } while (i != queue->write_idx);
+         for (unsigned prio = 0; prio < UTIL_QUEUE_NUM_PRIORITIES; prio++) {
+            int num_ring_jobs = queue->rings[prio].num_queued;
+
+            for (int n = 0; n < num_ring_jobs; n++) {
+               jobs[prio * new_max_jobs + n] =
+                  *util_queue_ring_job(queue, prio,
+                                       (queue->rings[prio].read_idx + n) %
+                                       queue->max_jobs);
+            }
+
+            queue->rings[prio].read_idx = 0;
+            queue->rings[prio].write_idx = num_ring_jobs;
+            num_jobs += num_ring_jobs;
+         }
 
          assert(num_jobs == queue->num_queued);
 
          free(queue->jobs);
          queue->jobs = jobs;
-         queue->read_idx = 0;
-         queue->write_idx = num_jobs;
          queue->max_jobs = new_max_jobs;
       } else {
          /* Wait until there is a free slot. */
@@ -609,7 +697,7 @@ util_queue_add_job_locked(struct util_queue *queue,
       }
    }
 
-   ptr = &queue->jobs[queue->write_idx];
+   ptr = util_queue_ring_job(queue, priority, queue->rings[priority].write_idx);
    assert(ptr->job == NULL);
    ptr->job = job;
    ptr->global_data = queue->global_data;
@@ -617,10 +705,17 @@ util_queue_add_job_locked(struct util_queue *queue,
    ptr->execute = execute;
    ptr->cleanup = cleanup;
    ptr->job_size = job_size;
+   ptr->seq = queue->next_seq++;
 
-   queue->write_idx = (queue->write_idx + 1) % queue->max_jobs;
+   queue->rings[priority].write_idx =
+      (queue->rings[priority].write_idx + 1) % queue->max_jobs;
    queue->total_jobs_size += ptr->job_size;
 
+   queue->rings[priority].num_queued++;
+   queue->rings[priority].num_added++;
+   queue->rings[priority].max_queued =
+      MAX2(queue->rings[priority].max_queued,
+           queue->rings[priority].num_queued);
    queue->num_queued++;
    cnd_signal(&queue->has_queued_cond);
    if (!locked)
@@ -636,7 +731,39 @@ util_queue_add_job(struct util_queue *queue,
                    const size_t job_size)
 {
    util_queue_add_job_locked(queue, job, fence, execute, cleanup, job_size,
-                             false);
+                             UTIL_QUEUE_PRIORITY_NORMAL, false);
+}
+
+void
+util_queue_add_job_with_priority(struct util_queue *queue,
+                                 void *job,
+                                 struct util_queue_fence *fence,
+                                 util_queue_execute_func execute,
+                                 util_queue_execute_func cleanup,
+                                 const size_t job_size,
+                                 enum util_queue_priority priority)
+{
+   assert(priority < UTIL_QUEUE_NUM_PRIORITIES);
+   util_queue_add_job_locked(queue, job, fence, execute, cleanup, job_size,
+                             priority, false);
+}
+
+/* Find the queued job using the fence, return its priority or
+ * UTIL_QUEUE_NUM_PRIORITIES if it's not queued.
+ */
+static unsigned
+util_queue_find_job_locked(struct util_queue *queue,
+                           struct util_queue_fence *fence, int *idx)
+{
+   for (unsigned prio = 0; prio < UTIL_QUEUE_NUM_PRIORITIES; prio++) {
+      for (int n = 0; n < queue->rings[prio].num_queued; n++) {
+         *idx = (queue->rings[prio].read_idx + n) % queue->max_jobs;
+         if (util_queue_ring_job(queue, prio, *idx)->fence == fence)
+            return prio;
+      }
+   }
+
+   return UTIL_QUEUE_NUM_PRIORITIES;
 }
 
 /**
@@ -658,17 +785,17 @@ util_queue_drop_job(struct util_queue *queue, struct util_queue_fence *fence)
       return;
 
    mtx_lock(&queue->lock);
-   for (unsigned i = queue->read_idx; i != queue->write_idx;
-        i = (i + 1) % queue->max_jobs) {
-      if (queue->jobs[i].fence == fence) {
-         if (queue->jobs[i].cleanup)
-            queue->jobs[i].cleanup(queue->jobs[i].job, queue->global_data, -1);
-
-         /* Just clear it. The threads will treat as a no-op job. */
-         memset(&queue->jobs[i], 0, sizeof(queue->jobs[i]));
-         removed = true;
-         break;
-      }
+   int idx;
+   unsigned prio = util_queue_find_job_locked(queue, fence, &idx);
+   if (prio < UTIL_QUEUE_NUM_PRIORITIES) {
+      struct util_queue_job *ptr = util_queue_ring_job(queue, prio, idx);
+
+      if (ptr->cleanup)
+         ptr->cleanup(ptr->job, queue->global_data, -1);
+
+      /* Just clear it. The threads will treat as a no-op job. */
+      memset(ptr, 0, sizeof(*ptr));
+      removed = true;
    }
    mtx_unlock(&queue->lock);
 
@@ -678,6 +805,59 @@ util_queue_drop_job(struct util_queue *queue, struct util_queue_fence *fence)
       util_queue_fence_wait(fence);
 }
 
+/**
+ * Move a queued job to the end of the high priority jobs, so that it's
+ * executed before the normal and low priority jobs. Returns false if the job
+ * isn't queued anymore or is already high priority.
+ */
+bool
+util_queue_promote_job(struct util_queue *queue,
+                       struct util_queue_fence *fence)
+{
+   if (util_queue_fence_is_signalled(fence))
+      return false;
+
+   mtx_lock(&queue->lock);
+   int idx;
+   unsigned prio = util_queue_find_job_locked(queue, fence, &idx);
+   if (prio == UTIL_QUEUE_PRIORITY_HIGH || prio == UTIL_QUEUE_NUM_PRIORITIES) {
+      mtx_unlock(&queue->lock);
+      return false;
+   }
+
+   struct util_queue_job job = *util_queue_ring_job(queue, prio, idx);
+
+   /* Close the gap, the following jobs keep their order */
+   int write_idx = queue->rings[prio].write_idx;
+   for (int i = idx, next = (i + 1) % queue->max_jobs; next != write_idx;
+        i = next, next = (next + 1) % queue->max_jobs) {
+      *util_queue_ring_job(queue, prio, i) =
+         *util_queue_ring_job(queue, prio, next);
+   }
+
+   write_idx = (write_idx + queue->max_jobs - 1) % queue->max_jobs;
+   memset(util_queue_ring_job(queue, prio, write_idx), 0,
+          sizeof(struct util_queue_job));
+   queue->rings[prio].write_idx = write_idx;
+   queue->rings[prio].num_queued--;
+
+   /* The rings can't hold more than max_jobs jobs altogether, so there is
+    * always room in the high priority ring.
+    */
+   *util_queue_ring_job(queue, UTIL_QUEUE_PRIORITY_HIGH,
+                        queue->rings[UTIL_QUEUE_PRIORITY_HIGH].write_idx) = job;
+   queue->rings[UTIL_QUEUE_PRIORITY_HIGH].write_idx =
+      (queue->rings[UTIL_QUEUE_PRIORITY_HIGH].write_idx + 1) % queue->max_jobs;
+   queue->rings[UTIL_QUEUE_PRIORITY_HIGH].num_queued++;
+   queue->rings[UTIL_QUEUE_PRIORITY_HIGH].max_queued =
+      MAX2(queue->rings[UTIL_QUEUE_PRIORITY_HIGH].max_queued,
+           queue->rings[UTIL_QUEUE_PRIORITY_HIGH].num_queued);
+   queue->num_promoted++;
+
+   mtx_unlock(&queue->lock);
+   return true;
+}
+
 /**
  * Wait until all previously added jobs have completed.
  */
@@ -713,8 +893,12 @@ util_queue_finish(struct util_queue *queue)
 
    for (unsigned i = 0; i < queue->num_threads; ++i) {
       util_queue_fence_init(&fences[i]);
+      /* The barrier isn't taken before the jobs of all priorities added
+       * before it, see util_queue_select_ring_locked().
+       */
       util_queue_add_job_locked(queue, &barrier, &fences[i],
-                                util_queue_finish_execute, NULL, 0, true);
+                                util_queue_finish_execute, NULL, 0,
+                                UTIL_QUEUE_PRIORITY_LOW, true);
    }
    queue->create_threads_on_demand = true;
    mtx_unlock(&queue->lock);
@@ -736,3 +920,16 @@ util_queue_get_thread_time_nano(struct util_queue *queue, unsigned thread_index)
 
    return util_thread_get_time_nano(queue->threads[thread_index]);
 }
+
+void
+util_queue_get_stats(struct util_queue *queue, struct util_queue_stats *stats)
+{
+   mtx_lock(&queue->lock);
+   for (unsigned prio = 0; prio < UTIL_QUEUE_NUM_PRIORITIES; prio++) {
+      stats->num_queued[prio] = queue->rings[prio].num_queued;
+      stats->max_queued[prio] = queue->rings[prio].max_queued;
+      stats->num_added[prio] = queue->rings[prio].num_added;
+   }
+   stats->num_promoted = queue->num_promoted;
+   mtx_unlock(&queue->lock);
+}
@@ -211,6 +211,20 @@ util_queue_fence_wait_timeout(struct util_queue_fence *fence,
 
 typedef void (*util_queue_execute_func)(void *job, void *gdata, int thread_index);
 
+/* Jobs are executed in priority order, and in FIFO order within a priority.
+ * Blocking work should use the high priority, speculative or background work
+ * the low priority. A priority that was passed over UTIL_QUEUE_MAX_SKIPPED
+ * times in a row goes first once, so that lower priorities can't starve.
+ */
+#define UTIL_QUEUE_MAX_SKIPPED 32
+
+enum util_queue_priority {
+   UTIL_QUEUE_PRIORITY_HIGH,
+   UTIL_QUEUE_PRIORITY_NORMAL,
+   UTIL_QUEUE_PRIORITY_LOW,
+   UTIL_QUEUE_NUM_PRIORITIES,
+};
+
 struct util_queue_job {
    void *job;
    void *global_data;
@@ -218,6 +232,7 @@ struct util_queue_job {
    struct util_queue_fence *fence;
    util_queue_execute_func execute;
    util_queue_execute_func cleanup;
+   unsigned seq; /* order in which the jobs were added */
 };
 
 /* Put this into your context. */
@@ -233,7 +248,20 @@ struct util_queue {
    unsigned max_threads;
    unsigned num_threads; /* decreasing this number will terminate threads */
    int max_jobs;
-   int write_idx, read_idx; /* ring buffer pointers */
+
+   /* One ring buffer of max_jobs entries per priority, stored one after the
+    * other in jobs. num_queued counts the jobs of all rings.
+    */
+   struct {
+      int write_idx, read_idx; /* ring buffer pointers */
+      int num_queued;
+      unsigned max_queued;
+      unsigned num_added;
+      unsigned num_skipped; /* jobs taken from higher rings in a row */
+   } rings[UTIL_QUEUE_NUM_PRIORITIES];
+   unsigned num_promoted;
+   unsigned next_seq;
+
    size_t total_jobs_size;  /* memory use of all jobs in the queue */
    struct util_queue_job *jobs;
    void *global_data;
@@ -257,8 +285,30 @@ void util_queue_add_job(struct util_queue *queue,
                         util_queue_execute_func execute,
                         util_queue_execute_func cleanup,
                         const size_t job_size);
+void util_queue_add_job_with_priority(struct util_queue *queue,
+                                      void *job,
+                                      struct util_queue_fence *fence,
+                                      util_queue_execute_func execute,
+                                      util_queue_execute_func cleanup,
+                                      const size_t job_size,
+                                      enum util_queue_priority priority);
 void util_queue_drop_job(struct util_queue *queue,
                          struct util_queue_fence *fence);
+bool util_queue_promote_job(struct util_queue *queue,
+                            struct util_queue_fence *fence);
+
+/* Wait for a job, moving it to the front of the queue first if it hasn't
+ * started yet. Use this when the caller is blocked on the job.
+ */
+static inline void
+util_queue_job_wait(struct util_queue *queue, struct util_queue_fence *fence)
+{
+   if (util_queue_fence_is_signalled(fence))
+      return;
+
+   util_queue_promote_job(queue, fence);
+   util_queue_fence_wait(fence);
+}
 
 void util_queue_finish(struct util_queue *queue);
 
@@ -273,6 +323,16 @@ util_queue_adjust_num_threads(struct util_queue *queue, unsigned num_threads,
 int64_t util_queue_get_thread_time_nano(struct util_queue *queue,
                                         unsigned thread_index);
 
+struct util_queue_stats {
+   unsigned num_queued[UTIL_QUEUE_NUM_PRIORITIES]; /* current queue depth */
+   unsigned max_queued[UTIL_QUEUE_NUM_PRIORITIES]; /* highest queue depth */
+   unsigned num_added[UTIL_QUEUE_NUM_PRIORITIES];
+   unsigned num_promoted; /* jobs moved to the high priority while queued */
+};
+
+void util_queue_get_stats(struct util_queue *queue,
+                          struct util_queue_stats *stats);
+
 /* util_queue needs to be cleared to zeroes for this to work */
 static inline bool
 util_queue_is_initialized(struct util_queue *queue)
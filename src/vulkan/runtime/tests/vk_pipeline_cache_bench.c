@@ -0,0 +1,191 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Measures vk_pipeline_cache lookups and inserts per second with a varying
+ * number of threads sharing one cache, the way applications create pipelines
+ * from many threads.  A lookup miss creates and adds the object.  The weak
+ * reference mode (used for device-global caches) is measured too, there
+ * every object is removed from the cache again once its last user drops it.
+ *
+ * Usage: vk_pipeline_cache_bench [num_keys] [ops_per_thread] [max_threads]
+ */
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c11/threads.h"
+#include "util/os_time.h"
+#include "util/u_cpu_detect.h"
+
+#include "vk_alloc.h"
+#include "vk_device.h"
+#include "vk_physical_device.h"
+#include "vk_pipeline_cache.h"
+
+struct bench_key {
+   uint32_t index;
+   uint32_t pad[7];
+};
+
+struct bench_thread {
+   struct vk_pipeline_cache *cache;
+   unsigned num_keys;
+   unsigned num_ops;
+   unsigned seed;
+   unsigned hits;
+};
+
+static VKAPI_ATTR void VKAPI_CALL
+get_physical_device_properties(VkPhysicalDevice physicalDevice,
+                               VkPhysicalDeviceProperties *pProperties)
+{
+   memset(pProperties, 0, sizeof(*pProperties));
+}
+
+static void
+make_key(struct bench_key *key, unsigned i)
+{
+   memset(key, 0xa5, sizeof(*key));
+   key->index = i;
+}
+
+static struct vk_pipeline_cache_object *
+add_object(struct vk_pipeline_cache *cache, unsigned i)
+{
+   struct bench_key key;
+   make_key(&key, i);
+
+   struct vk_raw_data_cache_object *data_obj =
+      vk_raw_data_cache_object_create(cache->base.device, &key, sizeof(key),
+                                      &i, sizeof(i));
+   assert(data_obj);
+
+   return vk_pipeline_cache_add_object(cache, &data_obj->base);
+}
+
+static int
+bench_thread(void *data)
+{
+   struct bench_thread *t = data;
+   struct vk_device *device = t->cache->base.device;
+
+   for (unsigned n = 0; n < t->num_ops; n++) {
+      struct vk_pipeline_cache_object *object;
+      struct bench_key key;
+
+      t->seed = t->seed * 1103515245 + 12345;
+      unsigned i = (t->seed >> 8) % t->num_keys;
+
+      make_key(&key, i);
+      object = vk_pipeline_cache_lookup_object(t->cache, &key, sizeof(key),
+                                               &vk_raw_data_cache_object_ops,
+                                               NULL);
+      if (object) {
+         t->hits++;
+      } else {
+         object = add_object(t->cache, i);
+      }
+
+      struct vk_raw_data_cache_object *data_obj =
+         container_of(object, struct vk_raw_data_cache_object, base);
+      assert(data_obj->data_size == sizeof(i));
+      assert(*(const unsigned *)data_obj->data == i);
+
+      vk_pipeline_cache_object_unref(device, object);
+   }
+
+   return 0;
+}
+
+static void
+run(struct vk_device *device, bool weak_ref, unsigned num_keys,
+    unsigned num_ops, unsigned num_threads)
+{
+   const struct vk_pipeline_cache_create_info info = {
+      .force_enable = true,
+      .weak_ref = weak_ref,
+      .skip_disk_cache = true,
+   };
+   struct vk_pipeline_cache *cache =
+      vk_pipeline_cache_create(device, &info, NULL);
+   struct bench_thread *threads = calloc(num_threads, sizeof(*threads));
+   thrd_t *handles = calloc(num_threads, sizeof(*handles));
+   unsigned hits = 0;
+   int64_t start, end;
+
+   assert(cache && threads && handles);
+
+   /* Half of the keys are in the cache up front.  In the weak reference mode
+    * objects only stay in the cache while they are used, so it starts empty.
+    */
+   if (!weak_ref) {
+      for (unsigned i = 0; i < num_keys; i += 2)
+         vk_pipeline_cache_object_unref(device, add_object(cache, i));
+   }
+
+   start = os_time_get_nano();
+
+   for (unsigned t = 0; t < num_threads; t++) {
+      threads[t].cache = cache;
+      threads[t].num_keys = num_keys;
+      threads[t].num_ops = num_ops;
+      threads[t].seed = t + 1;
+      thrd_create(&handles[t], bench_thread, &threads[t]);
+   }
+
+   for (unsigned t = 0; t < num_threads; t++) {
+      thrd_join(handles[t], NULL);
+      hits += threads[t].hits;
+   }
+
+   end = os_time_get_nano();
+
+   printf("%2u threads, %-6s: %10.0f ops/s (%u/%u hits)\n", num_threads,
+          weak_ref ? "weak" : "strong",
+          (double)num_threads * num_ops * 1000000000.0 / (end - start),
+          hits, num_threads * num_ops);
+
+   vk_pipeline_cache_destroy(cache, NULL);
+   free(handles);
+   free(threads);
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned num_keys = argc > 1 ? atoi(argv[1]) : 4096;
+   unsigned num_ops = argc > 2 ? atoi(argv[2]) : 200000;
+   unsigned max_threads = argc > 3 ? atoi(argv[3]) : 0;
+
+   if (!max_threads) {
+      max_threads = MIN2(util_get_cpu_caps()->nr_cpus, 32);
+   }
+
+   /* The cache only needs the allocator and the properties of the physical
+    * device.
+    */
+   struct vk_physical_device physical_device = {0};
+   physical_device.base.type = VK_OBJECT_TYPE_PHYSICAL_DEVICE;
+   physical_device.dispatch_table.GetPhysicalDeviceProperties =
+      get_physical_device_properties;
+
+   struct vk_device device = {0};
+   device.base.type = VK_OBJECT_TYPE_DEVICE;
+   device.alloc = *vk_default_allocator();
+   device.physical = &physical_device;
+
+   printf("%u keys, %u ops per thread\n", num_keys, num_ops);
+
+   for (unsigned num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+      run(&device, false, num_keys, num_ops, num_threads);
+      run(&device, true, num_keys, num_ops, num_threads);
+   }
+
+   return 0;
+}
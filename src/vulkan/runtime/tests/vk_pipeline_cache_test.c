@@ -0,0 +1,323 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Tests importing pInitialData into a vk_pipeline_cache.  Objects are only
+ * deserialized by the first lookup with their real ops, keep their type when
+ * exported again before that, and must stay valid after a merge once the
+ * cache they were imported into is gone.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/blob.h"
+
+#include "vk_alloc.h"
+#include "vk_common_entrypoints.h"
+#include "vk_device.h"
+#include "vk_physical_device.h"
+#include "vk_pipeline_cache.h"
+
+#define NUM_OBJECTS 1000
+
+static unsigned num_failures;
+
+#define CHECK(cond)                                                        \
+   do {                                                                    \
+      if (!(cond)) {                                                       \
+         fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                 #cond);                                                   \
+         num_failures++;                                                   \
+      }                                                                    \
+   } while (0)
+
+/* For setup steps the rest of the test can't run without */
+#define REQUIRE(cond)                                                      \
+   do {                                                                    \
+      if (!(cond)) {                                                       \
+         fprintf(stderr, "%s:%d: required check failed: %s\n", __FILE__,   \
+                 __LINE__, #cond);                                         \
+         exit(1);                                                          \
+      }                                                                    \
+   } while (0)
+
+struct test_object {
+   struct vk_pipeline_cache_object base;
+   uint32_t key;
+   uint32_t value;
+};
+
+static unsigned num_deserialized;
+
+static VKAPI_ATTR void VKAPI_CALL
+get_physical_device_properties(VkPhysicalDevice physicalDevice,
+                               VkPhysicalDeviceProperties *pProperties)
+{
+   memset(pProperties, 0, sizeof(*pProperties));
+}
+
+static bool
+test_object_serialize(struct vk_pipeline_cache_object *object,
+                      struct blob *blob)
+{
+   struct test_object *obj = container_of(object, struct test_object, base);
+
+   blob_write_uint32(blob, obj->value);
+
+   return true;
+}
+
+static struct vk_pipeline_cache_object *
+test_object_deserialize(struct vk_pipeline_cache *cache,
+                        const void *key_data, size_t key_size,
+                        struct blob_reader *blob);
+
+static void
+test_object_destroy(struct vk_device *device,
+                    struct vk_pipeline_cache_object *object)
+{
+   free(container_of(object, struct test_object, base));
+}
+
+static const struct vk_pipeline_cache_object_ops test_object_ops = {
+   .serialize = test_object_serialize,
+   .deserialize = test_object_deserialize,
+   .destroy = test_object_destroy,
+};
+
+static const struct vk_pipeline_cache_object_ops *const import_ops[] = {
+   &test_object_ops,
+   NULL,
+};
+
+static struct test_object *
+test_object_create(struct vk_device *device, uint32_t key, uint32_t value)
+{
+   struct test_object *obj = calloc(1, sizeof(*obj));
+   REQUIRE(obj);
+
+   obj->key = key;
+   obj->value = value;
+   vk_pipeline_cache_object_init(device, &obj->base, &test_object_ops,
+                                 &obj->key, sizeof(obj->key));
+
+   return obj;
+}
+
+static struct vk_pipeline_cache_object *
+test_object_deserialize(struct vk_pipeline_cache *cache,
+                        const void *key_data, size_t key_size,
+                        struct blob_reader *blob)
+{
+   uint32_t key;
+
+   CHECK(key_size == sizeof(key));
+   memcpy(&key, key_data, sizeof(key));
+
+   struct test_object *obj =
+      test_object_create(cache->base.device, key, blob_read_uint32(blob));
+   num_deserialized++;
+
+   return &obj->base;
+}
+
+static struct vk_pipeline_cache *
+create_cache(struct vk_device *device, const void *data, size_t size)
+{
+   const VkPipelineCacheCreateInfo create_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+      .initialDataSize = size,
+      .pInitialData = data,
+   };
+   const struct vk_pipeline_cache_create_info info = {
+      .pCreateInfo = &create_info,
+      .force_enable = true,
+      .skip_disk_cache = true,
+   };
+
+   struct vk_pipeline_cache *cache =
+      vk_pipeline_cache_create(device, &info, NULL);
+   REQUIRE(cache);
+
+   return cache;
+}
+
+static void *
+get_cache_data(struct vk_device *device, struct vk_pipeline_cache *cache,
+               size_t *size)
+{
+   VkDevice _device = vk_device_to_handle(device);
+   VkPipelineCache _cache = vk_pipeline_cache_to_handle(cache);
+   VkResult result;
+
+   result = vk_common_GetPipelineCacheData(_device, _cache, size, NULL);
+   REQUIRE(result == VK_SUCCESS);
+
+   void *data = malloc(*size);
+   REQUIRE(data);
+
+   result = vk_common_GetPipelineCacheData(_device, _cache, size, data);
+   REQUIRE(result == VK_SUCCESS);
+
+   return data;
+}
+
+static void
+check_object(struct vk_device *device, struct vk_pipeline_cache *cache,
+             uint32_t key)
+{
+   bool cache_hit = false;
+   struct vk_pipeline_cache_object *object =
+      vk_pipeline_cache_lookup_object(cache, &key, sizeof(key),
+                                      &test_object_ops, &cache_hit);
+   CHECK(object && cache_hit);
+   if (object == NULL)
+      return;
+
+   CHECK(object->ops == &test_object_ops);
+   if (object->ops == &test_object_ops)
+      CHECK(container_of(object, struct test_object, base)->value == key * 3);
+
+   vk_pipeline_cache_object_unref(device, object);
+}
+
+/* Checks that the cache data holds every object with the type of
+ * test_object_ops.
+ */
+static void
+check_types(const void *data, size_t size)
+{
+   struct blob_reader blob;
+   blob_reader_init(&blob, data, size);
+
+   blob_skip_bytes(&blob, sizeof(struct vk_pipeline_cache_header));
+   uint32_t count = blob_read_uint32(&blob);
+   CHECK(count == NUM_OBJECTS);
+
+   for (uint32_t i = 0; i < count && !blob.overrun; i++) {
+      int32_t type = blob_read_uint32(&blob);
+      uint32_t key_size = blob_read_uint32(&blob);
+      uint32_t data_size = blob_read_uint32(&blob);
+      blob_skip_bytes(&blob, key_size);
+      blob_reader_align(&blob, VK_PIPELINE_CACHE_BLOB_ALIGN);
+      blob_skip_bytes(&blob, data_size);
+
+      CHECK(type == 0);
+   }
+   CHECK(!blob.overrun && blob.current == blob.end);
+}
+
+int
+main(void)
+{
+   struct vk_physical_device physical_device = {0};
+   physical_device.base.type = VK_OBJECT_TYPE_PHYSICAL_DEVICE;
+   physical_device.dispatch_table.GetPhysicalDeviceProperties =
+      get_physical_device_properties;
+   physical_device.pipeline_cache_import_ops = import_ops;
+
+   struct vk_device device = {0};
+   device.base.type = VK_OBJECT_TYPE_DEVICE;
+   device.alloc = *vk_default_allocator();
+   device.physical = &physical_device;
+
+   /* Serialize a cache holding NUM_OBJECTS objects */
+   struct vk_pipeline_cache *src = create_cache(&device, NULL, 0);
+   for (uint32_t key = 0; key < NUM_OBJECTS; key++) {
+      struct test_object *obj = test_object_create(&device, key, key * 3);
+      vk_pipeline_cache_object_unref(&device,
+         vk_pipeline_cache_add_object(src, &obj->base));
+   }
+
+   size_t size;
+   void *data = get_cache_data(&device, src, &size);
+   vk_pipeline_cache_destroy(src, NULL);
+
+   /* Importing doesn't deserialize anything, and the initial data is only
+    * valid during creation.
+    */
+   struct vk_pipeline_cache *cache = create_cache(&device, data, size);
+   memset(data, 0, size);
+   free(data);
+   CHECK(num_deserialized == 0);
+
+   /* Exporting objects that were never looked up keeps their type, so a
+    * cache created from the exported data deserializes them like the
+    * original.
+    */
+   data = get_cache_data(&device, cache, &size);
+   check_types(data, size);
+   struct vk_pipeline_cache *reimported = create_cache(&device, data, size);
+   free(data);
+   for (uint32_t key = 0; key < NUM_OBJECTS; key += 100)
+      check_object(&device, reimported, key);
+   CHECK(num_deserialized == NUM_OBJECTS / 100);
+   vk_pipeline_cache_destroy(reimported, NULL);
+   num_deserialized = 0;
+
+   /* Typed lookups deserialize each object once */
+   for (uint32_t key = 0; key < NUM_OBJECTS; key += 2)
+      check_object(&device, cache, key);
+   CHECK(num_deserialized == NUM_OBJECTS / 2);
+
+   for (uint32_t key = 0; key < NUM_OBJECTS; key += 2)
+      check_object(&device, cache, key);
+   CHECK(num_deserialized == NUM_OBJECTS / 2);
+
+   /* Half deserialized, half still raw */
+   data = get_cache_data(&device, cache, &size);
+   check_types(data, size);
+   free(data);
+
+   /* Raw lookups return the serialized data of objects not deserialized yet */
+   uint32_t raw_key = 1;
+   struct vk_pipeline_cache_object *raw_object =
+      vk_pipeline_cache_lookup_object(cache, &raw_key, sizeof(raw_key),
+                                      &vk_raw_data_cache_object_ops, NULL);
+   REQUIRE(raw_object);
+   struct vk_raw_data_cache_object *raw_data =
+      container_of(raw_object, struct vk_raw_data_cache_object, base);
+   CHECK(raw_data->data_size == sizeof(uint32_t));
+   CHECK(*(const uint32_t *)raw_data->data == 3);
+
+   /* Merged objects outlive the cache they were imported into */
+   struct vk_pipeline_cache *dst = create_cache(&device, NULL, 0);
+   VkPipelineCache _cache = vk_pipeline_cache_to_handle(cache);
+   VkResult result =
+      vk_common_MergePipelineCaches(vk_device_to_handle(&device),
+                                    vk_pipeline_cache_to_handle(dst),
+                                    1, &_cache);
+   CHECK(result == VK_SUCCESS);
+   vk_pipeline_cache_destroy(cache, NULL);
+
+   for (uint32_t key = 0; key < NUM_OBJECTS; key++)
+      check_object(&device, dst, key);
+   CHECK(num_deserialized == NUM_OBJECTS);
+
+   CHECK(*(const uint32_t *)raw_data->data == 3);
+   vk_pipeline_cache_object_unref(&device, raw_object);
+
+   /* A cache with a different header is ignored */
+   data = get_cache_data(&device, dst, &size);
+   ((struct vk_pipeline_cache_header *)data)->vendor_id++;
+   cache = create_cache(&device, data, size);
+   raw_key = 0;
+   CHECK(vk_pipeline_cache_lookup_object(cache, &raw_key, sizeof(raw_key),
+                                         &test_object_ops, NULL) == NULL);
+   vk_pipeline_cache_destroy(cache, NULL);
+   free(data);
+
+   vk_pipeline_cache_destroy(dst, NULL);
+
+   if (num_failures) {
+      fprintf(stderr, "vk_pipeline_cache: %u checks failed\n", num_failures);
+      return 1;
+   }
+
+   printf("vk_pipeline_cache: all tests passed\n");
+
+   return 0;
+}
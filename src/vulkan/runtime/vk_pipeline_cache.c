@@ -36,6 +36,23 @@
 #include "util/disk_cache.h"
 #include "util/hash_table.h"
 #include "util/set.h"
+#include "util/u_memory.h"
+
+/* Objects are partitioned by key hash into shards with their own lock, so
+ * that lookups and inserts of different keys from many threads rarely
+ * contend.
+ */
+#define VK_PIPELINE_CACHE_SHARD_BITS 4
+#define VK_PIPELINE_CACHE_SHARDS (1u << VK_PIPELINE_CACHE_SHARD_BITS)
+
+struct vk_pipeline_cache_shard {
+   struct set *objects;
+
+   /* Protects objects.  Padded to a cache line so that threads working on
+    * different shards don't bounce each other's lock.
+    */
+   EXCLUSIVE_CACHELINE(simple_mtx_t lock);
+};
 
 #define vk_pipeline_cache_log(cache, ...)                                      \
    if (cache->base.client_visible)                                             \
@@ -119,6 +136,8 @@ vk_raw_data_cache_object_create(struct vk_device *device,
                                  obj_key_data, key_size);
    data_obj->data = obj_data;
    data_obj->data_size = data_size;
+   data_obj->imported = false;
+   data_obj->type = -1;
 
    memcpy(obj_key_data, key_data, key_size);
    memcpy(obj_data, data, data_size);
@@ -143,43 +162,59 @@ object_key_hash(const void *void_object)
    return _mesa_hash_data(object->key_data, object->key_size);
 }
 
-static void
-vk_pipeline_cache_lock(struct vk_pipeline_cache *cache)
+/* The low bits of the hash select the bucket inside a set, so use the high
+ * bits to select the shard.
+ */
+static struct vk_pipeline_cache_shard *
+vk_pipeline_cache_get_shard(struct vk_pipeline_cache *cache, uint32_t hash)
 {
+   assert(cache->shards != NULL);
+   return &cache->shards[hash >> (32 - VK_PIPELINE_CACHE_SHARD_BITS)];
+}
 
+static void
+vk_pipeline_cache_lock(struct vk_pipeline_cache *cache,
+                       struct vk_pipeline_cache_shard *shard)
+{
    if (!(cache->flags & VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BIT))
-      simple_mtx_lock(&cache->lock);
+      simple_mtx_lock(&shard->lock);
 }
 
 static void
-vk_pipeline_cache_unlock(struct vk_pipeline_cache *cache)
+vk_pipeline_cache_unlock(struct vk_pipeline_cache *cache,
+                         struct vk_pipeline_cache_shard *shard)
 {
    if (!(cache->flags & VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BIT))
-      simple_mtx_unlock(&cache->lock);
+      simple_mtx_unlock(&shard->lock);
 }
 
-/* cache->lock must be held when calling */
+/* The lock of the shard for hash must be held when calling */
 static void
 vk_pipeline_cache_remove_object(struct vk_pipeline_cache *cache,
                                 uint32_t hash,
                                 struct vk_pipeline_cache_object *object)
 {
+   struct vk_pipeline_cache_shard *shard =
+      vk_pipeline_cache_get_shard(cache, hash);
    struct set_entry *entry =
-      _mesa_set_search_pre_hashed(cache->object_cache, hash, object);
+      _mesa_set_search_pre_hashed(shard->objects, hash, object);
    if (entry && entry->key == (const void *)object) {
       /* Drop the reference owned by the cache */
       if (!cache->weak_ref)
          vk_pipeline_cache_object_unref(cache->base.device, object);
 
-      _mesa_set_remove(cache->object_cache, entry);
+      _mesa_set_remove(shard->objects, entry);
    }
 }
 
 static inline struct vk_pipeline_cache_object *
 vk_pipeline_cache_object_weak_ref(struct vk_pipeline_cache *cache,
+                                  uint32_t hash,
                                   struct vk_pipeline_cache_object *object)
 {
    assert(!object->weak_owner);
+   assert(hash == object_key_hash(object));
+   object->key_hash = hash;
    p_atomic_set(&object->weak_owner, cache);
    return object;
 }
@@ -194,13 +229,18 @@ vk_pipeline_cache_object_unref(struct vk_device *device, struct vk_pipeline_cach
       if (p_atomic_dec_zero(&object->ref_cnt))
          object->ops->destroy(device, object);
    } else {
-      vk_pipeline_cache_lock(weak_owner);
+      /* The shard lock keeps lookups from taking a new reference while the
+       * object is being removed.
+       */
+      uint32_t hash = object->key_hash;
+      struct vk_pipeline_cache_shard *shard =
+         vk_pipeline_cache_get_shard(weak_owner, hash);
+
+      vk_pipeline_cache_lock(weak_owner, shard);
       bool destroy = p_atomic_dec_zero(&object->ref_cnt);
-      if (destroy) {
-         uint32_t hash = object_key_hash(object);
+      if (destroy)
          vk_pipeline_cache_remove_object(weak_owner, hash, object);
-      }
-      vk_pipeline_cache_unlock(weak_owner);
+      vk_pipeline_cache_unlock(weak_owner, shard);
       if (destroy)
          object->ops->destroy(device, object);
    }
@@ -254,6 +294,19 @@ vk_pipeline_cache_object_serialize(struct vk_pipeline_cache *cache,
    return true;
 }
 
+static void
+vk_pipeline_cache_put_disk_cache(struct vk_pipeline_cache *cache,
+                                 const void *key_data, size_t key_size,
+                                 const void *data, size_t data_size)
+{
+   struct disk_cache *disk_cache = get_disk_cache(cache);
+   if (!cache->skip_disk_cache && disk_cache) {
+      cache_key cache_key;
+      disk_cache_compute_key(disk_cache, key_data, key_size, cache_key);
+      disk_cache_put(disk_cache, cache_key, data, data_size, NULL);
+   }
+}
+
 static struct vk_pipeline_cache_object *
 vk_pipeline_cache_object_deserialize(struct vk_pipeline_cache *cache,
                                      const void *key_data, uint32_t key_size,
@@ -293,15 +346,17 @@ vk_pipeline_cache_insert_object(struct vk_pipeline_cache *cache,
 {
    assert(object->ops != NULL);
 
-   if (cache->object_cache == NULL)
+   if (cache->shards == NULL)
       return object;
 
    uint32_t hash = object_key_hash(object);
+   struct vk_pipeline_cache_shard *shard =
+      vk_pipeline_cache_get_shard(cache, hash);
 
-   vk_pipeline_cache_lock(cache);
+   vk_pipeline_cache_lock(cache, shard);
    bool found = false;
    struct set_entry *entry = _mesa_set_search_or_add_pre_hashed(
-       cache->object_cache, hash, object, &found);
+       shard->objects, hash, object, &found);
 
    struct vk_pipeline_cache_object *result = NULL;
    /* add reference to either the found or inserted object */
@@ -322,9 +377,9 @@ vk_pipeline_cache_insert_object(struct vk_pipeline_cache *cache,
       if (!cache->weak_ref)
          vk_pipeline_cache_object_ref(result);
       else
-         vk_pipeline_cache_object_weak_ref(cache, result);
+         vk_pipeline_cache_object_weak_ref(cache, hash, result);
    }
-   vk_pipeline_cache_unlock(cache);
+   vk_pipeline_cache_unlock(cache, shard);
 
    if (found) {
       vk_pipeline_cache_object_unref(cache->base.device, object);
@@ -352,21 +407,24 @@ vk_pipeline_cache_lookup_object(struct vk_pipeline_cache *cache,
 
    struct vk_pipeline_cache_object *object = NULL;
 
-   if (cache != NULL && cache->object_cache != NULL) {
-      vk_pipeline_cache_lock(cache);
+   if (cache != NULL && cache->shards != NULL) {
+      struct vk_pipeline_cache_shard *shard =
+         vk_pipeline_cache_get_shard(cache, hash);
+
+      vk_pipeline_cache_lock(cache, shard);
       struct set_entry *entry =
-         _mesa_set_search_pre_hashed(cache->object_cache, hash, &key);
+         _mesa_set_search_pre_hashed(shard->objects, hash, &key);
       if (entry) {
          object = vk_pipeline_cache_object_ref((void *)entry->key);
          if (cache_hit != NULL)
             *cache_hit = true;
       }
-      vk_pipeline_cache_unlock(cache);
+      vk_pipeline_cache_unlock(cache, shard);
    }
 
    if (object == NULL) {
       struct disk_cache *disk_cache = get_disk_cache(cache);
-      if (!cache->skip_disk_cache && disk_cache && cache->object_cache) {
+      if (!cache->skip_disk_cache && disk_cache && cache->shards) {
          cache_key cache_key;
          disk_cache_compute_key(disk_cache, key_data, key_size, cache_key);
 
@@ -406,13 +464,22 @@ vk_pipeline_cache_lookup_object(struct vk_pipeline_cache *cache,
          vk_pipeline_cache_log(cache,
                                "Deserializing pipeline cache object failed");
 
-         vk_pipeline_cache_lock(cache);
+         struct vk_pipeline_cache_shard *shard =
+            vk_pipeline_cache_get_shard(cache, hash);
+         vk_pipeline_cache_lock(cache, shard);
          vk_pipeline_cache_remove_object(cache, hash, object);
-         vk_pipeline_cache_unlock(cache);
+         vk_pipeline_cache_unlock(cache, shard);
          vk_pipeline_cache_object_unref(cache->base.device, object);
          return NULL;
       }
 
+      /* Imported objects skipped the disk cache at load time */
+      if (data_obj->imported) {
+         vk_pipeline_cache_put_disk_cache(cache, data_obj->base.key_data,
+                                          data_obj->base.key_size,
+                                          data_obj->data, data_obj->data_size);
+      }
+
       vk_pipeline_cache_object_unref(cache->base.device, object);
       object = vk_pipeline_cache_insert_object(cache, real_object);
    }
@@ -460,12 +527,8 @@ vk_pipeline_cache_create_and_insert_object(struct vk_pipeline_cache *cache,
                                            const void *data, size_t data_size,
                                            const struct vk_pipeline_cache_object_ops *ops)
 {
-   struct disk_cache *disk_cache = get_disk_cache(cache);
-   if (!cache->skip_disk_cache && disk_cache) {
-      cache_key cache_key;
-      disk_cache_compute_key(disk_cache, key_data, key_size, cache_key);
-      disk_cache_put(disk_cache, cache_key, data, data_size, NULL);
-   }
+   vk_pipeline_cache_put_disk_cache(cache, key_data, key_size,
+                                    data, data_size);
 
    struct vk_pipeline_cache_object *object =
        vk_pipeline_cache_object_deserialize(cache, key_data, key_size, data,
@@ -555,6 +618,23 @@ find_type_for_ops(const struct vk_physical_device *pdevice,
    return -1;
 }
 
+/* Raw objects imported from pInitialData keep the type they were imported
+ * with until a lookup deserializes them.
+ */
+static int32_t
+find_type_for_object(const struct vk_physical_device *pdevice,
+                     struct vk_pipeline_cache_object *object)
+{
+   if (object->ops == &vk_raw_data_cache_object_ops) {
+      struct vk_raw_data_cache_object *data_obj =
+         container_of(object, struct vk_raw_data_cache_object, base);
+      if (data_obj->type >= 0)
+         return data_obj->type;
+   }
+
+   return find_type_for_ops(pdevice, object->ops);
+}
+
 static const struct vk_pipeline_cache_object_ops *
 find_ops_for_type(const struct vk_physical_device *pdevice,
                   int32_t type)
@@ -572,6 +652,8 @@ static void
 vk_pipeline_cache_load(struct vk_pipeline_cache *cache,
                        const void *data, size_t size)
 {
+   struct vk_device *device = cache->base.device;
+
    struct blob_reader blob;
    blob_reader_init(&blob, data, size);
 
@@ -594,19 +676,88 @@ vk_pipeline_cache_load(struct vk_pipeline_cache *cache,
       if (blob.overrun)
          break;
 
-      const struct vk_pipeline_cache_object_ops *ops =
-         find_ops_for_type(cache->base.device->physical, type);
+      /* Non-weak caches keep the objects as raw data until the first lookup
+       * deserializes them with the right ops, so objects the application
+       * never looks up are never deserialized or written to the disk cache.
+       * pInitialData is only valid during vkCreatePipelineCache(), so the
+       * serialized data is still copied into each object.  Weak reference
+       * caches can't hold raw data objects.
+       */
+      struct vk_pipeline_cache_object *object;
+      if (!cache->weak_ref) {
+         struct vk_raw_data_cache_object *data_obj =
+            vk_raw_data_cache_object_create(device, key_data, key_size,
+                                            data, data_size);
+         object = NULL;
+         if (data_obj != NULL) {
+            data_obj->imported = true;
+            data_obj->type = type;
+            object = vk_pipeline_cache_insert_object(cache, &data_obj->base);
+         }
+      } else {
+         const struct vk_pipeline_cache_object_ops *ops =
+            find_ops_for_type(device->physical, type);
 
-      struct vk_pipeline_cache_object *object =
-         vk_pipeline_cache_create_and_insert_object(cache, key_data, key_size,
-                                                    data, data_size, ops);
+         object = vk_pipeline_cache_create_and_insert_object(cache, key_data,
+                                                             key_size, data,
+                                                             data_size, ops);
+      }
 
       if (object == NULL) {
          vk_pipeline_cache_log(cache, "Failed to load pipeline cache object");
          continue;
       }
 
-      vk_pipeline_cache_object_unref(cache->base.device, object);
+      vk_pipeline_cache_object_unref(device, object);
+   }
+}
+
+static void
+vk_pipeline_cache_destroy_shards(struct vk_pipeline_cache *cache,
+                                 const VkAllocationCallbacks *pAllocator)
+{
+   for (unsigned i = 0; i < VK_PIPELINE_CACHE_SHARDS; i++) {
+      struct vk_pipeline_cache_shard *shard = &cache->shards[i];
+      if (shard->objects == NULL)
+         continue;
+
+      if (!cache->weak_ref) {
+         set_foreach(shard->objects, entry) {
+            vk_pipeline_cache_object_unref(cache->base.device, (void *)entry->key);
+         }
+      } else {
+         assert(shard->objects->entries == 0);
+      }
+      _mesa_set_destroy(shard->objects, NULL);
+      simple_mtx_destroy(&shard->lock);
+   }
+
+   vk_free2(&cache->base.device->alloc, pAllocator, cache->shards);
+   cache->shards = NULL;
+}
+
+static void
+vk_pipeline_cache_create_shards(struct vk_pipeline_cache *cache,
+                                const VkAllocationCallbacks *pAllocator)
+{
+   cache->shards = vk_zalloc2(&cache->base.device->alloc, pAllocator,
+                              VK_PIPELINE_CACHE_SHARDS * sizeof(*cache->shards),
+                              8,
+                              VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+   if (cache->shards == NULL)
+      return;
+
+   for (unsigned i = 0; i < VK_PIPELINE_CACHE_SHARDS; i++) {
+      struct vk_pipeline_cache_shard *shard = &cache->shards[i];
+
+      shard->objects = _mesa_set_create(NULL, object_key_hash,
+                                        object_keys_equal);
+      if (shard->objects == NULL) {
+         /* Run without an in-memory cache, like when it's disabled */
+         vk_pipeline_cache_destroy_shards(cache, pAllocator);
+         return;
+      }
+      simple_mtx_init(&shard->lock, mtx_plain);
    }
 }
 
@@ -651,15 +802,11 @@ vk_pipeline_cache_create(struct vk_device *device,
    };
    memcpy(cache->header.uuid, pdevice_props.pipelineCacheUUID, VK_UUID_SIZE);
 
-   simple_mtx_init(&cache->lock, mtx_plain);
-
    if (info->force_enable ||
-       debug_get_bool_option("VK_ENABLE_PIPELINE_CACHE", true)) {
-      cache->object_cache = _mesa_set_create(NULL, object_key_hash,
-                                             object_keys_equal);
-   }
+       debug_get_bool_option("VK_ENABLE_PIPELINE_CACHE", true))
+      vk_pipeline_cache_create_shards(cache, pAllocator);
 
-   if (cache->object_cache && pCreateInfo->initialDataSize > 0) {
+   if (cache->shards && pCreateInfo->initialDataSize > 0) {
       vk_pipeline_cache_load(cache, pCreateInfo->pInitialData,
                              pCreateInfo->initialDataSize);
    }
@@ -671,17 +818,8 @@ void
 vk_pipeline_cache_destroy(struct vk_pipeline_cache *cache,
                           const VkAllocationCallbacks *pAllocator)
 {
-   if (cache->object_cache) {
-      if (!cache->weak_ref) {
-         set_foreach(cache->object_cache, entry) {
-            vk_pipeline_cache_object_unref(cache->base.device, (void *)entry->key);
-         }
-      } else {
-         assert(cache->object_cache->entries == 0);
-      }
-      _mesa_set_destroy(cache->object_cache, NULL);
-   }
-   simple_mtx_destroy(&cache->lock);
+   if (cache->shards)
+      vk_pipeline_cache_destroy_shards(cache, pAllocator);
    vk_object_free(cache->base.device, pAllocator, cache);
 }
 
@@ -747,11 +885,18 @@ vk_common_GetPipelineCacheData(VkDevice _device,
       return VK_INCOMPLETE;
    }
 
-   vk_pipeline_cache_lock(cache);
-
+   /* Each shard is only locked while it's being written, so objects added
+    * concurrently to other shards may or may not be included.
+    */
    VkResult result = VK_SUCCESS;
-   if (cache->object_cache != NULL) {
-      set_foreach(cache->object_cache, entry) {
+   for (unsigned i = 0; cache->shards != NULL &&
+                        i < VK_PIPELINE_CACHE_SHARDS &&
+                        result == VK_SUCCESS; i++) {
+      struct vk_pipeline_cache_shard *shard = &cache->shards[i];
+
+      vk_pipeline_cache_lock(cache, shard);
+
+      set_foreach(shard->objects, entry) {
          struct vk_pipeline_cache_object *object = (void *)entry->key;
 
          if (object->ops->serialize == NULL)
@@ -759,7 +904,7 @@ vk_common_GetPipelineCacheData(VkDevice _device,
 
          size_t blob_size_save = blob.size;
 
-         int32_t type = find_type_for_ops(device->physical, object->ops);
+         int32_t type = find_type_for_object(device->physical, object);
          blob_write_uint32(&blob, type);
          blob_write_uint32(&blob, object->key_size);
          intptr_t data_size_resv = blob_reserve_uint32(&blob);
@@ -791,9 +936,9 @@ vk_common_GetPipelineCacheData(VkDevice _device,
 
          count++;
       }
-   }
 
-   vk_pipeline_cache_unlock(cache);
+      vk_pipeline_cache_unlock(cache, shard);
+   }
 
    blob_overwrite_uint32(&blob, count_offset, count);
 
@@ -815,53 +960,63 @@ vk_common_MergePipelineCaches(VkDevice _device,
    assert(dst->base.device == device);
    assert(!dst->weak_ref);
 
-   if (!dst->object_cache)
+   if (!dst->shards)
       return VK_SUCCESS;
 
-   vk_pipeline_cache_lock(dst);
+   /* Equal keys have equal hashes, so an object always goes from a source
+    * shard to the destination shard with the same index.
+    */
+   for (unsigned s = 0; s < VK_PIPELINE_CACHE_SHARDS; s++) {
+      struct vk_pipeline_cache_shard *dst_shard = &dst->shards[s];
+      vk_pipeline_cache_lock(dst, dst_shard);
 
-   for (uint32_t i = 0; i < srcCacheCount; i++) {
-      VK_FROM_HANDLE(vk_pipeline_cache, src, pSrcCaches[i]);
-      assert(src->base.device == device);
+      for (uint32_t i = 0; i < srcCacheCount; i++) {
+         VK_FROM_HANDLE(vk_pipeline_cache, src, pSrcCaches[i]);
+         assert(src->base.device == device);
 
-      if (!src->object_cache)
-         continue;
+         if (!src->shards)
+            continue;
 
-      assert(src != dst);
-      if (src == dst)
-         continue;
+         assert(src != dst);
+         if (src == dst)
+            continue;
 
-      vk_pipeline_cache_lock(src);
-
-      set_foreach(src->object_cache, src_entry) {
-         struct vk_pipeline_cache_object *src_object = (void *)src_entry->key;
-
-         bool found_in_dst = false;
-         struct set_entry *dst_entry =
-            _mesa_set_search_or_add_pre_hashed(dst->object_cache,
-                                               src_entry->hash,
-                                               src_object, &found_in_dst);
-         if (found_in_dst) {
-            struct vk_pipeline_cache_object *dst_object = (void *)dst_entry->key;
-            if (dst_object->ops == &vk_raw_data_cache_object_ops &&
-                src_object->ops != &vk_raw_data_cache_object_ops) {
-               /* Even though dst has the object, it only has the blob version
-                * which isn't as useful.  Replace it with the real object.
-                */
-               vk_pipeline_cache_object_unref(device, dst_object);
-               dst_entry->key = vk_pipeline_cache_object_ref(src_object);
+         struct vk_pipeline_cache_shard *src_shard = &src->shards[s];
+         vk_pipeline_cache_lock(src, src_shard);
+
+         set_foreach(src_shard->objects, src_entry) {
+            struct vk_pipeline_cache_object *src_object =
+               (void *)src_entry->key;
+
+            bool found_in_dst = false;
+            struct set_entry *dst_entry =
+               _mesa_set_search_or_add_pre_hashed(dst_shard->objects,
+                                                  src_entry->hash,
+                                                  src_object, &found_in_dst);
+            if (found_in_dst) {
+               struct vk_pipeline_cache_object *dst_object =
+                  (void *)dst_entry->key;
+               if (dst_object->ops == &vk_raw_data_cache_object_ops &&
+                   src_object->ops != &vk_raw_data_cache_object_ops) {
+                  /* Even though dst has the object, it only has the blob
+                   * version which isn't as useful.  Replace it with the real
+                   * object.
+                   */
+                  vk_pipeline_cache_object_unref(device, dst_object);
+                  dst_entry->key = vk_pipeline_cache_object_ref(src_object);
+               }
+            } else {
+               /* We inserted src_object in dst so it needs a reference */
+               assert(dst_entry->key == (const void *)src_object);
+               vk_pipeline_cache_object_ref(src_object);
             }
-         } else {
-            /* We inserted src_object in dst so it needs a reference */
-            assert(dst_entry->key == (const void *)src_object);
-            vk_pipeline_cache_object_ref(src_object);
          }
+
+         vk_pipeline_cache_unlock(src, src_shard);
       }
 
-      vk_pipeline_cache_unlock(src);
+      vk_pipeline_cache_unlock(dst, dst_shard);
    }
 
-   vk_pipeline_cache_unlock(dst);
-
    return VK_SUCCESS;
 }
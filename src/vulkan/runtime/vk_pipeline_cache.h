@@ -110,6 +110,11 @@ struct vk_pipeline_cache_object {
    struct vk_pipeline_cache *weak_owner;
    uint32_t ref_cnt;
 
+   /* Hash of the key, set when the object is added to its weak_owner so that
+    * the last unref can find its shard without hashing the key again.
+    */
+   uint32_t key_hash;
+
    uint32_t data_size;
    const void *key_data;
    uint32_t key_size;
@@ -147,6 +152,8 @@ void
 vk_pipeline_cache_object_unref(struct vk_device *device,
                                struct vk_pipeline_cache_object *object);
 
+struct vk_pipeline_cache_shard;
+
 /** A generic implementation of VkPipelineCache */
 struct vk_pipeline_cache {
    struct vk_object_base base;
@@ -159,10 +166,10 @@ struct vk_pipeline_cache {
 
    struct vk_pipeline_cache_header header;
 
-   /** Protects object_cache */
-   simple_mtx_t lock;
-
-   struct set *object_cache;
+   /** Objects partitioned by key hash, NULL if the in-memory cache is
+    * disabled
+    */
+   struct vk_pipeline_cache_shard *shards;
 };
 
 VK_DEFINE_NONDISP_HANDLE_CASTS(vk_pipeline_cache, base, VkPipelineCache,
@@ -302,6 +309,17 @@ struct vk_raw_data_cache_object {
 
    const void *data;
    size_t data_size;
+
+   /* True if this object was loaded from pInitialData and hasn't been put
+    * in the disk cache yet.
+    */
+   bool imported;
+
+   /* The type this object was stored with in pInitialData, or -1.  Written
+    * back by vkGetPipelineCacheData() for objects that were never
+    * deserialized with their real ops.
+    */
+   int32_t type;
 };
 
 struct vk_raw_data_cache_object *